@@ -0,0 +1,1175 @@
+#ifndef QTX_ARCHIVE_C
+#define QTX_ARCHIVE_C
+
+#include "sdk.c"
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+// Compressed archive of decoded feed messages: the Msg records and Msg2
+// snapshots with their Msg2Level arrays that the handlers see, several
+// times smaller than a journal of the raw datagrams and decoded back into
+// the same records. A file is a header, a series of independent blocks of
+// up to ARCHIVE_BLOCK_RAW_BYTES of decoded records, and an index of the
+// blocks written on close, so a reader can start at any block and seek by
+// local time.
+//
+// Each record is a tag byte (kind = msg_type + 3, flags) and varints:
+//   local_ns   delta-of-delta over the block
+//   event_ms   delta to the previous record; tx_ms relative to event_ms
+//   sn_id      delta to the last sn_id + 1 of the symbol's channel
+//   price      integer ticks at a decimal scale, delta to the channel's
+//              last price, or the XOR of its bits with the last price when
+//              no scale up to ARCHIVE_MAX_SCALE is exact
+//   size       integer at a decimal scale, or XOR bits like prices
+// Depth prices are deltas to the level before, level 0 to the previous
+// snapshot's. A scale is only used when the decoder's division gives back
+// the exact double, so the archive is lossless except for Msg2's unused
+// asks_idx and bids_idx, which decode as 0. Channel state and symbol
+// names restart with every block.
+
+#define ARCHIVE_MAGIC 0x3148435241585451UL // "QTXARCH1"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_BLOCK_MAGIC 0x4b4c4251u // "QBLK"
+// Decoded bytes per block: large enough to amortise the block header and
+// the state restart (a few percent of the size at 64 KB), small enough
+// that a seek decodes little and the decoded block stays in L2
+#ifndef ARCHIVE_BLOCK_RAW_BYTES
+#define ARCHIVE_BLOCK_RAW_BYTES (64 * 1024)
+#endif
+// Zero bytes after each block payload, more than one record header or
+// depth level can read, so the decoder's reads past a corrupt record stay
+// inside the file until its end check catches it
+#define ARCHIVE_BLOCK_PAD 128
+#define ARCHIVE_MAX_SCALE 12
+#define ARCHIVE_MAX_LEVELS ((UDP_SIZE - (int)sizeof(Msg2)) / (int)sizeof(Msg2Level))
+#define ARCHIVE_CHANNELS 4
+
+// Tag byte: kind in the low 3 bits, msg_type + 3 or a symbol definition
+#define ARCHIVE_KIND_DEPTH 5
+#define ARCHIVE_KIND_SYMBOL 7
+// A scale byte follows (price scale in the low nibble, size in the high)
+// and price ticks are absolute
+#define ARCHIVE_F_SCALE 0x08
+#define ARCHIVE_F_PRICE_XOR 0x10
+#define ARCHIVE_F_SIZE_XOR 0x20
+// tx_ms equal to event_ms, 0, or a delta to event_ms
+#define ARCHIVE_TX_EVENT 0x00
+#define ARCHIVE_TX_ZERO 0x40
+#define ARCHIVE_TX_DELTA 0x80
+#define ARCHIVE_TX_MASK 0xc0
+
+typedef struct
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t block_raw_bytes;
+    // Symbol indexes are below this; the writer raises it as indexes grow
+    uint32_t max_index;
+    int64_t created_ns;
+    // File offset of the block index, 0 until the writer is closed
+    uint64_t index_offset;
+    uint64_t blocks;
+    uint64_t records;
+    uint64_t reserved;
+} ArchiveFileHeader;
+
+// Precedes every block; the payload is followed by ARCHIVE_BLOCK_PAD zero
+// bytes and padded to 8
+typedef struct
+{
+    uint32_t magic;
+    uint32_t bytes;
+    uint32_t records;
+    // Size of the decoded records
+    uint32_t raw_bytes;
+    int64_t min_local_ns;
+    int64_t max_local_ns;
+} ArchiveBlockHeader;
+
+typedef struct
+{
+    uint64_t offset;
+    // Records in the blocks before this one
+    uint64_t first_record;
+    int64_t min_local_ns;
+    int64_t max_local_ns;
+} ArchiveIndexEntry;
+
+// Coding state of one symbol's channel (bid, ask, trade or depth), stale
+// unless epoch is the current block's
+typedef struct
+{
+    uint32_t epoch;
+    uint8_t price_scale;
+    uint8_t size_scale;
+    int64_t last_sn;
+    // Last price in ticks and its bits; for depth level 0 of the asks, and
+    // of the bids in last_m2 and last_bits2
+    int64_t last_m;
+    int64_t last_m2;
+    uint64_t last_bits;
+    uint64_t last_bits2;
+    uint64_t last_size_bits;
+    double price_div;
+    double size_div;
+} ArchiveStream;
+
+static const double archive_pow10[ARCHIVE_MAX_SCALE + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+};
+
+// Channel of each kind: asks for msg_type -2/-1, bids for 0/1, trades +-3
+static const uint8_t archive_channel[8] = {
+    SEQ_CHANNEL_TRADE, SEQ_CHANNEL_ASK,   SEQ_CHANNEL_ASK,   SEQ_CHANNEL_BID,
+    SEQ_CHANNEL_BID,   SEQ_CHANNEL_DEPTH, SEQ_CHANNEL_TRADE, SEQ_CHANNEL_BID,
+};
+
+static inline void archive_stream_reset(ArchiveStream *s, uint32_t epoch)
+{
+    memset(s, 0, sizeof(*s));
+    s->epoch = epoch;
+    s->price_div = 1;
+    s->size_div = 1;
+}
+
+static inline uint64_t archive_bits(double v)
+{
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+static inline double archive_double(uint64_t bits)
+{
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static inline uint64_t archive_zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t archive_unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// Sum and difference of values that may be far apart, wrapping instead of
+// overflowing, so encoder and decoder agree on any input
+static inline int64_t archive_add(int64_t a, int64_t b)
+{
+    return (int64_t)((uint64_t)a + (uint64_t)b);
+}
+
+static inline int64_t archive_sub(int64_t a, int64_t b)
+{
+    return (int64_t)((uint64_t)a - (uint64_t)b);
+}
+
+static inline uint8_t *archive_put_varint(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static inline uint64_t archive_get_varint(const uint8_t **pp)
+{
+    const uint8_t *p = *pp;
+    uint64_t v = *p++;
+    if (v >= 0x80)
+    {
+        // At most 10 bytes, so a corrupt run of 0xff cannot run away
+        v &= 0x7f;
+        for (int shift = 7; shift < 64; shift += 7)
+        {
+            uint64_t b = *p++;
+            v |= (b & 0x7f) << shift;
+            if (b < 0x80)
+            {
+                break;
+            }
+        }
+    }
+    *pp = p;
+    return v;
+}
+
+// Ticks of v at scale, if (double)ticks / 10^scale gives back v exactly
+static inline int archive_ticks(double v, int scale, int64_t *m)
+{
+    double x = v * archive_pow10[scale];
+    if (!(x > -9e15 && x < 9e15))
+    {
+        return 0;
+    }
+    int64_t q = (int64_t)(x < 0 ? x - 0.5 : x + 0.5);
+    *m = q;
+    return archive_bits((double)q / archive_pow10[scale]) == archive_bits(v);
+}
+
+// Smallest exact scale from `from` up, -1 if there is none
+static int archive_find_scale(double v, int from)
+{
+    int64_t m;
+    for (int e = from; e <= ARCHIVE_MAX_SCALE; e++)
+    {
+        if (archive_ticks(v, e, &m))
+        {
+            return e;
+        }
+    }
+    return -1;
+}
+
+// Smallest scale from `scale` up at which v[0], v[stride], ... are all
+// exact, with their ticks in m; -1 if there is none
+static int archive_common_scale(const double *v, int count, int stride, int scale, int64_t *m)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (!archive_ticks(v[i * stride], scale, &m[i]))
+        {
+            scale = archive_find_scale(v[i * stride], scale + 1);
+            if (scale < 0)
+            {
+                return -1;
+            }
+            // Redo the earlier values at the finer scale
+            i = -1;
+        }
+    }
+    return scale;
+}
+
+// ---- Writer ----
+
+typedef struct
+{
+    int fd;
+    ArchiveFileHeader hdr;
+    uint64_t offset;
+    // Encoded payload of the open block
+    uint8_t *buf;
+    size_t len;
+    uint32_t block_records;
+    uint32_t block_raw;
+    int64_t min_local_ns;
+    int64_t max_local_ns;
+    // Block number, tags the channel states and symbol definitions
+    uint32_t epoch;
+    int64_t prev_local_ns;
+    int64_t prev_delta;
+    int64_t prev_event_ms;
+    // hdr.max_index * ARCHIVE_CHANNELS states; per index, the block its
+    // symbol was last defined in. Both double when a larger index arrives.
+    ArchiveStream *streams;
+    uint32_t *defined;
+    // Ticks of a snapshot's prices and sizes
+    int64_t *scratch;
+    ArchiveIndexEntry *index;
+    size_t index_cap;
+    unsigned long records;
+    unsigned long raw_bytes;
+    unsigned long bytes;
+    // Records not archived: an index beyond ARCHIVE_MAX_INDEX, a bad record,
+    // an allocation or a write error
+    unsigned long errors;
+} ArchiveWriter;
+
+static void archive_writer_free(ArchiveWriter *w)
+{
+    free(w->buf);
+    free(w->streams);
+    free(w->defined);
+    free(w->scratch);
+    free(w->index);
+    w->buf = NULL;
+    w->streams = NULL;
+    w->defined = NULL;
+    w->scratch = NULL;
+    w->index = NULL;
+}
+
+// Symbol indexes the writer has room for at first
+#define ARCHIVE_INITIAL_INDEXES 64
+// The header's max_index is a uint32_t that doubles from the initial size
+#define ARCHIVE_MAX_INDEX (1U << 31)
+
+// Create path, truncating it
+int archive_open(ArchiveWriter *w, const char *path)
+{
+    const unsigned int max_index = ARCHIVE_INITIAL_INDEXES;
+    memset(w, 0, sizeof(*w));
+    w->fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if (w->fd < 0)
+    {
+        perror("archive open failed");
+        return -1;
+    }
+    // A record encodes to under three times its decoded size, symbol
+    // definition included
+    w->buf = malloc(3 * ARCHIVE_BLOCK_RAW_BYTES + ARCHIVE_BLOCK_PAD + 8);
+    w->streams = calloc((size_t)max_index * ARCHIVE_CHANNELS, sizeof(ArchiveStream));
+    w->defined = calloc(max_index, sizeof(uint32_t));
+    w->scratch = malloc(2 * ARCHIVE_MAX_LEVELS * sizeof(int64_t));
+    if (w->buf == NULL || w->streams == NULL || w->defined == NULL || w->scratch == NULL)
+    {
+        perror("archive allocation failed");
+        archive_writer_free(w);
+        close(w->fd);
+        w->fd = -1;
+        return -1;
+    }
+    w->hdr.magic = ARCHIVE_MAGIC;
+    w->hdr.version = ARCHIVE_VERSION;
+    w->hdr.header_size = sizeof(ArchiveFileHeader);
+    w->hdr.block_raw_bytes = ARCHIVE_BLOCK_RAW_BYTES;
+    w->hdr.max_index = max_index;
+    w->hdr.created_ns = get_current_timestamp_ns();
+    if (pwrite(w->fd, &w->hdr, sizeof(w->hdr), 0) != sizeof(w->hdr))
+    {
+        perror("archive write failed");
+        archive_writer_free(w);
+        close(w->fd);
+        w->fd = -1;
+        return -1;
+    }
+    w->offset = sizeof(ArchiveFileHeader);
+    w->epoch = 1;
+    return 0;
+}
+
+// Write the open block with one pwritev and start the next
+static int archive_flush_block(ArchiveWriter *w)
+{
+    if (w->block_records == 0)
+    {
+        return 0;
+    }
+    int err = 0;
+    if (w->hdr.blocks == w->index_cap)
+    {
+        size_t cap = w->index_cap ? w->index_cap * 2 : 64;
+        ArchiveIndexEntry *index = realloc(w->index, cap * sizeof(*index));
+        if (index == NULL)
+        {
+            perror("archive index allocation failed");
+            err = -1;
+        }
+        else
+        {
+            w->index = index;
+            w->index_cap = cap;
+        }
+    }
+
+    size_t padded = (w->len + ARCHIVE_BLOCK_PAD + 7) & ~7UL;
+    memset(w->buf + w->len, 0, padded - w->len);
+    ArchiveBlockHeader bh = {ARCHIVE_BLOCK_MAGIC, (uint32_t)w->len, w->block_records, w->block_raw,
+                             w->min_local_ns, w->max_local_ns};
+    struct iovec iov[2] = {{&bh, sizeof(bh)}, {w->buf, padded}};
+    if (err == 0 && pwritev(w->fd, iov, 2, w->offset) != (ssize_t)(sizeof(bh) + padded))
+    {
+        perror("archive write failed");
+        err = -1;
+    }
+    if (err == 0)
+    {
+        w->index[w->hdr.blocks] = (ArchiveIndexEntry){w->offset, w->hdr.records, w->min_local_ns, w->max_local_ns};
+        w->hdr.blocks++;
+        w->hdr.records += w->block_records;
+        w->offset += sizeof(bh) + padded;
+        w->bytes += sizeof(bh) + padded;
+    }
+    else
+    {
+        w->errors += w->block_records;
+    }
+
+    w->len = 0;
+    w->block_records = 0;
+    w->block_raw = 0;
+    w->epoch++;
+    w->prev_local_ns = 0;
+    w->prev_delta = 0;
+    w->prev_event_ms = 0;
+    return err;
+}
+
+// Double the per-index tables until index fits and record the new bound
+// in the file header, before any record of index is written
+static int archive_reserve_index(ArchiveWriter *w, unsigned int index)
+{
+    if (index >= ARCHIVE_MAX_INDEX)
+    {
+        return -1;
+    }
+    uint32_t max_index = w->hdr.max_index;
+    while (max_index <= index)
+    {
+        max_index *= 2;
+    }
+    ArchiveStream *streams = realloc(w->streams, (size_t)max_index * ARCHIVE_CHANNELS * sizeof(ArchiveStream));
+    if (streams == NULL)
+    {
+        perror("archive allocation failed");
+        return -1;
+    }
+    w->streams = streams;
+    uint32_t *defined = realloc(w->defined, max_index * sizeof(uint32_t));
+    if (defined == NULL)
+    {
+        perror("archive allocation failed");
+        return -1;
+    }
+    w->defined = defined;
+    memset(streams + (size_t)w->hdr.max_index * ARCHIVE_CHANNELS, 0,
+           (size_t)(max_index - w->hdr.max_index) * ARCHIVE_CHANNELS * sizeof(ArchiveStream));
+    memset(defined + w->hdr.max_index, 0, (max_index - w->hdr.max_index) * sizeof(uint32_t));
+    w->hdr.max_index = max_index;
+    if (pwrite(w->fd, &w->hdr, sizeof(w->hdr), 0) != sizeof(w->hdr))
+    {
+        perror("archive write failed");
+        return -1;
+    }
+    return 0;
+}
+
+// Account a record of raw decoded bytes to the open block, flushing it
+// first if the record does not fit; returns the channel state, NULL if the
+// record cannot be archived. *fresh is set when the state restarted.
+static ArchiveStream *archive_begin(ArchiveWriter *w, const Subscription *sub, int kind, size_t raw,
+                                    long local_ns, int *fresh)
+{
+    if (w->fd < 0 || raw > ARCHIVE_BLOCK_RAW_BYTES ||
+        (sub->index >= w->hdr.max_index && archive_reserve_index(w, sub->index) < 0))
+    {
+        w->errors++;
+        return NULL;
+    }
+    if (w->block_raw + raw > ARCHIVE_BLOCK_RAW_BYTES)
+    {
+        archive_flush_block(w);
+    }
+    if (w->defined[sub->index] != w->epoch)
+    {
+        uint8_t *p = w->buf + w->len;
+        const char *symbol = subscription_symbol(sub);
+        size_t len = strnlen(symbol, MAX_SYMBOL_LEN - 1);
+        *p++ = ARCHIVE_KIND_SYMBOL;
+        p = archive_put_varint(p, sub->index);
+        *p++ = (uint8_t)len;
+        memcpy(p, symbol, len);
+        w->len = p + len - w->buf;
+        w->defined[sub->index] = w->epoch;
+    }
+    if (w->block_records == 0)
+    {
+        w->min_local_ns = local_ns;
+        w->max_local_ns = local_ns;
+    }
+    w->min_local_ns = local_ns < w->min_local_ns ? local_ns : w->min_local_ns;
+    w->max_local_ns = local_ns > w->max_local_ns ? local_ns : w->max_local_ns;
+    w->block_records++;
+    w->block_raw += raw;
+    w->records++;
+    w->raw_bytes += raw;
+
+    ArchiveStream *s = &w->streams[(size_t)sub->index * ARCHIVE_CHANNELS + archive_channel[kind]];
+    *fresh = s->epoch != w->epoch;
+    if (*fresh)
+    {
+        archive_stream_reset(s, w->epoch);
+    }
+    return s;
+}
+
+static inline int archive_tx_mode(long tx_ms, long event_ms)
+{
+    return tx_ms == event_ms ? ARCHIVE_TX_EVENT : tx_ms == 0 ? ARCHIVE_TX_ZERO : ARCHIVE_TX_DELTA;
+}
+
+// Fields every record starts with, after the tag
+static inline uint8_t *archive_put_header(ArchiveWriter *w, uint8_t *p, int tag, unsigned int index, long local_ns,
+                                          long event_ms, long tx_ms, ArchiveStream *s, long sn_id)
+{
+    p = archive_put_varint(p, index);
+    int64_t delta = archive_sub(local_ns, w->prev_local_ns);
+    p = archive_put_varint(p, archive_zigzag(archive_sub(delta, w->prev_delta)));
+    w->prev_local_ns = local_ns;
+    w->prev_delta = delta;
+    p = archive_put_varint(p, archive_zigzag(archive_sub(event_ms, w->prev_event_ms)));
+    w->prev_event_ms = event_ms;
+    if ((tag & ARCHIVE_TX_MASK) == ARCHIVE_TX_DELTA)
+    {
+        p = archive_put_varint(p, archive_zigzag(archive_sub(tx_ms, event_ms)));
+    }
+    p = archive_put_varint(p, archive_zigzag(archive_sub(archive_sub(sn_id, s->last_sn), 1)));
+    s->last_sn = sn_id;
+    return p;
+}
+
+// Flags and scales for a price and size set: scale only grows within a
+// block, a change or a fresh state is sent with ARCHIVE_F_SCALE
+static inline int archive_scale_flags(ArchiveStream *s, int fresh, int price_scale, int size_scale)
+{
+    int flags = fresh ? ARCHIVE_F_SCALE : 0;
+    if (price_scale < 0)
+    {
+        flags |= ARCHIVE_F_PRICE_XOR;
+    }
+    else if (price_scale != s->price_scale)
+    {
+        flags |= ARCHIVE_F_SCALE;
+        s->price_scale = (uint8_t)price_scale;
+    }
+    if (size_scale < 0)
+    {
+        flags |= ARCHIVE_F_SIZE_XOR;
+    }
+    else if (size_scale != s->size_scale)
+    {
+        flags |= ARCHIVE_F_SCALE;
+        s->size_scale = (uint8_t)size_scale;
+    }
+    return flags;
+}
+
+// Append an L1 tick or trade
+int archive_append(ArchiveWriter *w, const Subscription *sub, const Msg *msg)
+{
+    if (msg->msg_type < -3 || msg->msg_type > 3 || msg->msg_type == 2)
+    {
+        w->errors++;
+        return -1;
+    }
+    int kind = msg->msg_type + 3;
+    int fresh;
+    ArchiveStream *s = archive_begin(w, sub, kind, sizeof(Msg), msg->local_ns, &fresh);
+    if (s == NULL)
+    {
+        return -1;
+    }
+
+    int64_t pm = 0, sm = 0;
+    int price_scale = archive_ticks(msg->price, s->price_scale, &pm)
+                          ? s->price_scale
+                          : archive_find_scale(msg->price, s->price_scale + 1);
+    if (price_scale > s->price_scale)
+    {
+        archive_ticks(msg->price, price_scale, &pm);
+    }
+    int size_scale = archive_ticks(msg->size, s->size_scale, &sm)
+                         ? s->size_scale
+                         : archive_find_scale(msg->size, s->size_scale + 1);
+    if (size_scale > s->size_scale)
+    {
+        archive_ticks(msg->size, size_scale, &sm);
+    }
+    int tag = kind | archive_scale_flags(s, fresh, price_scale, size_scale) |
+              archive_tx_mode(msg->tx_ms, msg->event_ms);
+
+    uint8_t *p = w->buf + w->len;
+    *p++ = (uint8_t)tag;
+    p = archive_put_header(w, p, tag, sub->index, msg->local_ns, msg->event_ms, msg->tx_ms, s, msg->sn_id);
+    if (tag & ARCHIVE_F_SCALE)
+    {
+        *p++ = (uint8_t)(s->price_scale | s->size_scale << 4);
+    }
+    uint64_t bits = archive_bits(msg->price);
+    if (tag & ARCHIVE_F_PRICE_XOR)
+    {
+        p = archive_put_varint(p, bits ^ s->last_bits);
+        s->last_m = 0;
+    }
+    else
+    {
+        p = archive_put_varint(p, archive_zigzag(archive_sub(pm, tag & ARCHIVE_F_SCALE ? 0 : s->last_m)));
+        s->last_m = pm;
+    }
+    s->last_bits = bits;
+    bits = archive_bits(msg->size);
+    p = archive_put_varint(p, tag & ARCHIVE_F_SIZE_XOR ? bits ^ s->last_size_bits : archive_zigzag(sm));
+    s->last_size_bits = bits;
+    w->len = p - w->buf;
+    return 0;
+}
+
+// One side of a snapshot: dir 1 for asks (rising prices), -1 for bids
+static uint8_t *archive_put_levels(uint8_t *p, const Msg2Level *levels, const int64_t *pm, const int64_t *sm,
+                                   int count, int dir, int tag, int64_t *last_m, uint64_t *last_bits)
+{
+    if (count == 0)
+    {
+        return p;
+    }
+    int64_t m = tag & ARCHIVE_F_SCALE ? 0 : *last_m;
+    uint64_t bits = *last_bits;
+    uint64_t size_bits = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (tag & ARCHIVE_F_PRICE_XOR)
+        {
+            uint64_t b = archive_bits(levels[i].price);
+            p = archive_put_varint(p, b ^ bits);
+            bits = b;
+        }
+        else
+        {
+            p = archive_put_varint(p, archive_zigzag(dir * (pm[i] - m)));
+            m = pm[i];
+        }
+        if (tag & ARCHIVE_F_SIZE_XOR)
+        {
+            uint64_t b = archive_bits(levels[i].size);
+            p = archive_put_varint(p, b ^ size_bits);
+            size_bits = b;
+        }
+        else
+        {
+            p = archive_put_varint(p, archive_zigzag(sm[i]));
+        }
+    }
+    *last_m = tag & ARCHIVE_F_PRICE_XOR ? 0 : pm[0];
+    *last_bits = archive_bits(levels[0].price);
+    return p;
+}
+
+// Append a depth snapshot, levels holding asks_len asks then bids_len bids
+int archive_append_depth(ArchiveWriter *w, const Subscription *sub, const Msg2 *msg2, const Msg2Level *levels)
+{
+    int asks = msg2->asks_len;
+    int bids = msg2->bids_len;
+    if (msg2->msg_type != 2 || asks < 0 || bids < 0 || asks + bids > ARCHIVE_MAX_LEVELS)
+    {
+        w->errors++;
+        return -1;
+    }
+    int count = asks + bids;
+    int fresh;
+    ArchiveStream *s = archive_begin(w, sub, ARCHIVE_KIND_DEPTH, sizeof(Msg2) + count * sizeof(Msg2Level),
+                                     msg2->local_ns, &fresh);
+    if (s == NULL)
+    {
+        return -1;
+    }
+
+    int64_t *pm = w->scratch;
+    int64_t *sm = w->scratch + ARCHIVE_MAX_LEVELS;
+    int price_scale = archive_common_scale(&levels[0].price, count, 2, s->price_scale, pm);
+    int size_scale = archive_common_scale(&levels[0].size, count, 2, s->size_scale, sm);
+    int tag = ARCHIVE_KIND_DEPTH | archive_scale_flags(s, fresh, price_scale, size_scale) |
+              archive_tx_mode(msg2->tx_ms, msg2->event_ms);
+
+    uint8_t *p = w->buf + w->len;
+    *p++ = (uint8_t)tag;
+    p = archive_put_header(w, p, tag, sub->index, msg2->local_ns, msg2->event_ms, msg2->tx_ms, s, msg2->sn_id);
+    if (tag & ARCHIVE_F_SCALE)
+    {
+        *p++ = (uint8_t)(s->price_scale | s->size_scale << 4);
+    }
+    p = archive_put_varint(p, asks);
+    p = archive_put_varint(p, bids);
+    p = archive_put_levels(p, levels, pm, sm, asks, 1, tag, &s->last_m, &s->last_bits);
+    p = archive_put_levels(p, levels + asks, pm + asks, sm + asks, bids, -1, tag, &s->last_m2, &s->last_bits2);
+    w->len = p - w->buf;
+    return 0;
+}
+
+// Flush the open block, write the block index and close the file
+void archive_close(ArchiveWriter *w)
+{
+    if (w->fd < 0)
+    {
+        return;
+    }
+    archive_flush_block(w);
+    size_t len = w->hdr.blocks * sizeof(ArchiveIndexEntry);
+    if (len == 0 || pwrite(w->fd, w->index, len, w->offset) == (ssize_t)len)
+    {
+        w->hdr.index_offset = w->offset;
+    }
+    else
+    {
+        perror("archive index write failed");
+    }
+    if (pwrite(w->fd, &w->hdr, sizeof(w->hdr), 0) != sizeof(w->hdr))
+    {
+        perror("archive header write failed");
+    }
+    close(w->fd);
+    w->fd = -1;
+    archive_writer_free(w);
+}
+
+void print_archive_stats(const ArchiveWriter *w)
+{
+    printf("=== Archive ===\n");
+    printf("records %lu, raw %.1f MB, archived %.1f MB (%.2fx), blocks %lu, errors %lu\n", w->records,
+           w->raw_bytes / 1e6, w->bytes / 1e6, w->bytes ? (double)w->raw_bytes / w->bytes : 0.0,
+           (unsigned long)w->hdr.blocks, w->errors);
+    printf("===============\n");
+}
+
+// ---- Reader ----
+
+typedef struct
+{
+    char *base;
+    size_t map_len;
+    const ArchiveFileHeader *hdr;
+    ArchiveIndexEntry *index;
+    uint64_t blocks;
+    uint64_t records;
+    // Next block to decode
+    uint64_t block;
+    ArchiveStream *streams;
+    uint32_t epoch;
+    // Symbols by index, as defined in the blocks decoded so far; subs[i].symbol
+    // points at names[i], empty until a block defines it
+    Subscription *subs;
+    char (*names)[MAX_SYMBOL_LEN];
+    // Decoded records of the current block and the read position in them
+    char *out;
+    size_t out_len;
+    size_t pos;
+    unsigned long corrupt;
+} ArchiveReader;
+
+// Rebuild the index of a file whose writer did not close it, up to the
+// first incomplete block
+static int archive_scan_index(ArchiveReader *r)
+{
+    size_t cap = 0;
+    uint64_t offset = r->hdr->header_size;
+    while (offset + sizeof(ArchiveBlockHeader) <= r->map_len)
+    {
+        const ArchiveBlockHeader *bh = (const ArchiveBlockHeader *)(r->base + offset);
+        size_t padded = ((size_t)bh->bytes + ARCHIVE_BLOCK_PAD + 7) & ~7UL;
+        if (bh->magic != ARCHIVE_BLOCK_MAGIC || bh->raw_bytes > r->hdr->block_raw_bytes ||
+            offset + sizeof(*bh) + padded > r->map_len)
+        {
+            break;
+        }
+        if (r->blocks == cap)
+        {
+            cap = cap ? cap * 2 : 64;
+            ArchiveIndexEntry *index = realloc(r->index, cap * sizeof(*index));
+            if (index == NULL)
+            {
+                return -1;
+            }
+            r->index = index;
+        }
+        r->index[r->blocks++] = (ArchiveIndexEntry){offset, r->records, bh->min_local_ns, bh->max_local_ns};
+        r->records += bh->records;
+        offset += sizeof(*bh) + padded;
+    }
+    return 0;
+}
+
+void archive_reader_close(ArchiveReader *r)
+{
+    if (r->base != NULL)
+    {
+        munmap(r->base, r->map_len);
+        r->base = NULL;
+    }
+    free(r->index);
+    free(r->streams);
+    free(r->subs);
+    free(r->names);
+    free(r->out);
+    r->index = NULL;
+    r->streams = NULL;
+    r->subs = NULL;
+    r->names = NULL;
+    r->out = NULL;
+}
+
+int archive_reader_open(ArchiveReader *r, const char *path)
+{
+    memset(r, 0, sizeof(*r));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("archive open failed");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ArchiveFileHeader))
+    {
+        fprintf(stderr, "%s is not an archive\n", path);
+        close(fd);
+        return -1;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        perror("archive mmap failed");
+        return -1;
+    }
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+    r->base = base;
+    r->map_len = st.st_size;
+    r->hdr = (const ArchiveFileHeader *)base;
+    if (r->hdr->magic != ARCHIVE_MAGIC || r->hdr->version != ARCHIVE_VERSION ||
+        r->hdr->header_size < sizeof(ArchiveFileHeader) || r->hdr->block_raw_bytes > (64U << 20) ||
+        r->hdr->max_index > ARCHIVE_MAX_INDEX)
+    {
+        fprintf(stderr, "%s is not an archive\n", path);
+        archive_reader_close(r);
+        return -1;
+    }
+
+    // Without the index written on close, rebuild it from the blocks
+    uint64_t index_bytes = r->hdr->blocks * sizeof(ArchiveIndexEntry);
+    int indexed = r->hdr->index_offset != 0 && r->hdr->blocks < r->map_len &&
+                  r->hdr->index_offset + index_bytes <= r->map_len;
+    if (indexed && index_bytes > 0)
+    {
+        r->index = malloc(index_bytes);
+        if (r->index != NULL)
+        {
+            memcpy(r->index, r->base + r->hdr->index_offset, index_bytes);
+        }
+    }
+    r->blocks = indexed ? r->hdr->blocks : 0;
+    r->records = indexed ? r->hdr->records : 0;
+    int err = indexed ? 0 : archive_scan_index(r);
+    r->streams = calloc((size_t)r->hdr->max_index * ARCHIVE_CHANNELS, sizeof(ArchiveStream));
+    r->subs = calloc(r->hdr->max_index, sizeof(Subscription));
+    r->names = calloc(r->hdr->max_index, sizeof(*r->names));
+    r->out = malloc(r->hdr->block_raw_bytes);
+    if (err < 0 || (r->blocks > 0 && r->index == NULL) || r->streams == NULL || r->subs == NULL ||
+        r->names == NULL || r->out == NULL)
+    {
+        perror("archive reader allocation failed");
+        archive_reader_close(r);
+        return -1;
+    }
+    for (uint32_t i = 0; i < r->hdr->max_index; i++)
+    {
+        r->subs[i].symbol = r->names[i];
+    }
+    return 0;
+}
+
+// One side of a snapshot, the inverse of archive_put_levels()
+static inline const uint8_t *archive_get_levels(const uint8_t *p, const uint8_t *end, Msg2Level *levels,
+                                                uint64_t count, int dir, int tag, const ArchiveStream *s,
+                                                int64_t *last_m, uint64_t *last_bits)
+{
+    if (count == 0)
+    {
+        return p;
+    }
+    int64_t m = tag & ARCHIVE_F_SCALE ? 0 : *last_m;
+    double price_div = s->price_div;
+    double size_div = s->size_div;
+    if ((tag & (ARCHIVE_F_PRICE_XOR | ARCHIVE_F_SIZE_XOR)) == 0)
+    {
+        // Common case, both in ticks
+        int64_t first = m + dir * archive_unzigzag(archive_get_varint(&p));
+        m = first;
+        levels[0].price = (double)m / price_div;
+        levels[0].size = (double)archive_unzigzag(archive_get_varint(&p)) / size_div;
+        for (uint64_t i = 1; i < count && p <= end; i++)
+        {
+            m += dir * archive_unzigzag(archive_get_varint(&p));
+            levels[i].price = (double)m / price_div;
+            levels[i].size = (double)archive_unzigzag(archive_get_varint(&p)) / size_div;
+        }
+        *last_m = first;
+    }
+    else
+    {
+        uint64_t bits = *last_bits;
+        uint64_t size_bits = 0;
+        for (uint64_t i = 0; i < count && p <= end; i++)
+        {
+            uint64_t v = archive_get_varint(&p);
+            if (tag & ARCHIVE_F_PRICE_XOR)
+            {
+                bits ^= v;
+                levels[i].price = archive_double(bits);
+            }
+            else
+            {
+                m += dir * archive_unzigzag(v);
+                levels[i].price = (double)m / price_div;
+                *last_m = i == 0 ? m : *last_m;
+            }
+            v = archive_get_varint(&p);
+            if (tag & ARCHIVE_F_SIZE_XOR)
+            {
+                size_bits ^= v;
+                levels[i].size = archive_double(size_bits);
+            }
+            else
+            {
+                levels[i].size = (double)archive_unzigzag(v) / size_div;
+            }
+        }
+        if (tag & ARCHIVE_F_PRICE_XOR)
+        {
+            *last_m = 0;
+        }
+    }
+    *last_bits = archive_bits(levels[0].price);
+    return p;
+}
+
+// Decode a block payload into Msg and Msg2 + Msg2Level records back to
+// back at out; returns the number of records, -1 if the block is corrupt
+static long archive_decode(ArchiveReader *r, const uint8_t *p, const uint8_t *end, char *out, size_t *out_len)
+{
+    const uint32_t max_index = r->hdr->max_index;
+    const uint32_t epoch = ++r->epoch;
+    char *o = out;
+    char *o_end = out + r->hdr->block_raw_bytes;
+    int64_t local_ns = 0;
+    int64_t delta = 0;
+    int64_t event_ms = 0;
+    long records = 0;
+    while (p < end)
+    {
+        int tag = *p++;
+        int kind = tag & 7;
+        uint64_t index = archive_get_varint(&p);
+        if (index >= max_index)
+        {
+            return -1;
+        }
+        if (kind == ARCHIVE_KIND_SYMBOL)
+        {
+            unsigned int len = *p++;
+            if (len >= MAX_SYMBOL_LEN || p + len > end)
+            {
+                return -1;
+            }
+            Subscription *sub = &r->subs[index];
+            memcpy(r->names[index], p, len);
+            r->names[index][len] = '\0';
+            sub->index = (unsigned int)index;
+            sub->active = 1;
+            p += len;
+            continue;
+        }
+
+        delta = archive_add(delta, archive_unzigzag(archive_get_varint(&p)));
+        local_ns = archive_add(local_ns, delta);
+        event_ms = archive_add(event_ms, archive_unzigzag(archive_get_varint(&p)));
+        int64_t tx_ms = event_ms;
+        if ((tag & ARCHIVE_TX_MASK) == ARCHIVE_TX_ZERO)
+        {
+            tx_ms = 0;
+        }
+        else if ((tag & ARCHIVE_TX_MASK) == ARCHIVE_TX_DELTA)
+        {
+            tx_ms = archive_add(event_ms, archive_unzigzag(archive_get_varint(&p)));
+        }
+        ArchiveStream *s = &r->streams[index * ARCHIVE_CHANNELS + archive_channel[kind]];
+        if (s->epoch != epoch)
+        {
+            archive_stream_reset(s, epoch);
+        }
+        s->last_sn = archive_add(archive_add(s->last_sn, archive_unzigzag(archive_get_varint(&p))), 1);
+        if (tag & ARCHIVE_F_SCALE)
+        {
+            int scales = *p++;
+            if ((scales & 15) > ARCHIVE_MAX_SCALE || (scales >> 4) > ARCHIVE_MAX_SCALE)
+            {
+                return -1;
+            }
+            s->price_scale = scales & 15;
+            s->size_scale = scales >> 4;
+            s->price_div = archive_pow10[s->price_scale];
+            s->size_div = archive_pow10[s->size_scale];
+        }
+
+        if (kind != ARCHIVE_KIND_DEPTH)
+        {
+            if (o + sizeof(Msg) > o_end)
+            {
+                return -1;
+            }
+            Msg *msg = (Msg *)o;
+            msg->msg_type = kind - 3;
+            msg->index = (int)index;
+            msg->tx_ms = tx_ms;
+            msg->event_ms = event_ms;
+            msg->local_ns = local_ns;
+            msg->sn_id = s->last_sn;
+            uint64_t v = archive_get_varint(&p);
+            if (tag & ARCHIVE_F_PRICE_XOR)
+            {
+                s->last_bits ^= v;
+                s->last_m = 0;
+                msg->price = archive_double(s->last_bits);
+            }
+            else
+            {
+                s->last_m = archive_add(tag & ARCHIVE_F_SCALE ? 0 : s->last_m, archive_unzigzag(v));
+                msg->price = (double)s->last_m / s->price_div;
+                s->last_bits = archive_bits(msg->price);
+            }
+            v = archive_get_varint(&p);
+            if (tag & ARCHIVE_F_SIZE_XOR)
+            {
+                s->last_size_bits ^= v;
+                msg->size = archive_double(s->last_size_bits);
+            }
+            else
+            {
+                msg->size = (double)archive_unzigzag(v) / s->size_div;
+                s->last_size_bits = archive_bits(msg->size);
+            }
+            o += sizeof(Msg);
+        }
+        else
+        {
+            uint64_t asks = archive_get_varint(&p);
+            uint64_t bids = archive_get_varint(&p);
+            if (asks > ARCHIVE_MAX_LEVELS || bids > ARCHIVE_MAX_LEVELS ||
+                o + sizeof(Msg2) + (asks + bids) * sizeof(Msg2Level) > o_end)
+            {
+                return -1;
+            }
+            Msg2 *msg2 = (Msg2 *)o;
+            msg2->msg_type = 2;
+            msg2->index = (int)index;
+            msg2->tx_ms = tx_ms;
+            msg2->event_ms = event_ms;
+            msg2->local_ns = local_ns;
+            msg2->sn_id = s->last_sn;
+            msg2->asks_idx = 0;
+            msg2->asks_len = (int)asks;
+            msg2->bids_idx = 0;
+            msg2->bids_len = (int)bids;
+            Msg2Level *levels = (Msg2Level *)(msg2 + 1);
+            p = archive_get_levels(p, end, levels, asks, 1, tag, s, &s->last_m, &s->last_bits);
+            p = archive_get_levels(p, end, levels + asks, bids, -1, tag, s, &s->last_m2, &s->last_bits2);
+            o += sizeof(Msg2) + (asks + bids) * sizeof(Msg2Level);
+        }
+        records++;
+        if (p > end)
+        {
+            return -1;
+        }
+    }
+    *out_len = o - out;
+    return records;
+}
+
+// Decode block b into the reader's buffer and read from its start;
+// returns its record count, -1 if it is corrupt
+long archive_decode_block(ArchiveReader *r, uint64_t b)
+{
+    r->out_len = 0;
+    r->pos = 0;
+    r->block = b + 1;
+    if (b >= r->blocks)
+    {
+        return -1;
+    }
+    // The index comes from the file as well, so check its offset first
+    if (r->index[b].offset < r->hdr->header_size || r->index[b].offset + sizeof(ArchiveBlockHeader) > r->map_len)
+    {
+        r->corrupt++;
+        return -1;
+    }
+    const ArchiveBlockHeader *bh = (const ArchiveBlockHeader *)(r->base + r->index[b].offset);
+    const uint8_t *p = (const uint8_t *)(bh + 1);
+    if (bh->magic != ARCHIVE_BLOCK_MAGIC ||
+        r->index[b].offset + sizeof(*bh) + bh->bytes + ARCHIVE_BLOCK_PAD > r->map_len)
+    {
+        r->corrupt++;
+        return -1;
+    }
+    long records = archive_decode(r, p, p + bh->bytes, r->out, &r->out_len);
+    if (records < 0 || (uint64_t)records != bh->records)
+    {
+        r->out_len = 0;
+        r->corrupt++;
+        return -1;
+    }
+    return records;
+}
+
+static inline size_t archive_record_size(const Msg *msg)
+{
+    if (msg->msg_type != 2)
+    {
+        return sizeof(Msg);
+    }
+    const Msg2 *msg2 = (const Msg2 *)msg;
+    return sizeof(Msg2) + (size_t)(msg2->asks_len + msg2->bids_len) * sizeof(Msg2Level);
+}
+
+// Next record in capture order, a Msg2 followed by its levels when
+// msg_type is 2; *sub receives its symbol. NULL at the end; corrupt
+// blocks are skipped and counted.
+const Msg *archive_reader_next(ArchiveReader *r, Subscription **sub)
+{
+    while (r->pos >= r->out_len)
+    {
+        if (r->block >= r->blocks)
+        {
+            return NULL;
+        }
+        archive_decode_block(r, r->block);
+    }
+    const Msg *msg = (const Msg *)(r->out + r->pos);
+    r->pos += archive_record_size(msg);
+    *sub = &r->subs[msg->index];
+    return msg;
+}
+
+// Position the reader at the first record with local_ns >= local_ns, in
+// the first block whose records reach it
+void archive_seek(ArchiveReader *r, long local_ns)
+{
+    uint64_t lo = 0;
+    uint64_t hi = r->blocks;
+    while (lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (r->index[mid].max_local_ns < local_ns)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    r->block = lo;
+    r->out_len = 0;
+    r->pos = 0;
+    while (r->block < r->blocks && archive_decode_block(r, r->block) < 0)
+    {
+        // Corrupt block, try the next
+    }
+    while (r->pos < r->out_len)
+    {
+        const Msg *msg = (const Msg *)(r->out + r->pos);
+        if (msg->local_ns >= local_ns)
+        {
+            break;
+        }
+        r->pos += archive_record_size(msg);
+    }
+}
+
+#endif // QTX_ARCHIVE_C
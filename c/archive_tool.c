@@ -0,0 +1,221 @@
+#include "sdk.c"
+#include "journal.c"
+#include "archive.c"
+
+// Reads compressed archives (archive.c), written by stream.c with
+// CAPTURE_ARCHIVE or converted from a journal with ./replay -z.
+//
+// Compile: gcc -O2 -pthread -o archive_tool archive_tool.c
+// Usage:   ./archive_tool dump <archive> [from_local_ns] [count]
+//          ./archive_tool verify <archive> <journal prefix>
+//          ./archive_tool bench <archive> [seconds]
+//   dump    print records like ./replay -v, from a local time on
+//   verify  decode the journal like ./replay and check that the archive
+//           holds exactly the messages the handlers saw
+//   bench   decode rate of the whole archive and random seek latency
+
+typedef struct
+{
+    ArchiveReader *reader;
+    unsigned long checked;
+    unsigned long mismatches;
+    // Journal records after the archive's last one: stream.c journals in
+    // the receive thread, so datagrams the handlers never saw at shutdown
+    unsigned long missing;
+} VerifyState;
+
+static void verify_record(VerifyState *v, const Subscription *sub, const Msg *expected, size_t size)
+{
+    Subscription *archived_sub;
+    const Msg *archived = archive_reader_next(v->reader, &archived_sub);
+    v->checked++;
+    if (archived == NULL)
+    {
+        v->missing++;
+        return;
+    }
+    if (archive_record_size(archived) != size || memcmp(archived, expected, size) != 0 ||
+        strcmp(archived_sub->symbol, sub->symbol) != 0)
+    {
+        if (v->mismatches++ < 10)
+        {
+            fprintf(stderr, "mismatch at record %lu (%s, msg_type %d, sn_id %ld)\n", v->checked, sub->symbol,
+                    expected->msg_type, expected->sn_id);
+        }
+    }
+}
+
+static void verify_msg(Subscription *sub, const Msg *msg, void *ctx)
+{
+    verify_record((VerifyState *)ctx, sub, msg, sizeof(Msg));
+}
+
+static void verify_depth(Subscription *sub, const Msg2 *msg2, const Msg2Level *levels, void *ctx)
+{
+    // The archive keeps the levels right after the header, and not the
+    // unused index fields
+    static char record[UDP_SIZE];
+    size_t levels_size = (size_t)(msg2->asks_len + msg2->bids_len) * sizeof(Msg2Level);
+    Msg2 *copy = (Msg2 *)record;
+    *copy = *msg2;
+    copy->asks_idx = 0;
+    copy->bids_idx = 0;
+    memcpy(copy + 1, levels, levels_size);
+    verify_record((VerifyState *)ctx, sub, (const Msg *)copy, sizeof(Msg2) + levels_size);
+}
+
+static int verify(ArchiveReader *r, const char *prefix)
+{
+    static JournalReader journal;
+    if (journal_reader_open(&journal, prefix) < 0)
+    {
+        return 1;
+    }
+    VerifyState state = {r, 0, 0, 0};
+    StreamHandlers handlers = {
+        .on_ticker = verify_msg,
+        .on_trade = verify_msg,
+        .on_depth = verify_depth,
+        .ctx = &state,
+    };
+    char ack[UDP_SIZE];
+    const JournalRecord *rec;
+    while ((rec = journal_reader_next(&journal)) != NULL)
+    {
+        const char *payload = (const char *)(rec + 1);
+        if (rec->src_port == SUBSCRIPTION_MANAGER_PORT)
+        {
+            int len = rec->len < UDP_SIZE ? (int)rec->len : UDP_SIZE - 1;
+            memcpy(ack, payload, len);
+            add_subscripton(ack, len);
+            continue;
+        }
+        dispatch_packet(payload, (int)rec->len, &handlers);
+    }
+    journal_reader_close(&journal);
+    Subscription *sub;
+    unsigned long extra = 0;
+    while (archive_reader_next(r, &sub) != NULL)
+    {
+        extra++;
+    }
+    free_subscriptions();
+    printf("verified %lu records: %lu mismatches, %lu extra in the archive, %lu corrupt blocks, "
+           "%lu journal records past its end\n",
+           state.checked, state.mismatches, extra, r->corrupt, state.missing);
+    return state.mismatches == 0 && extra == 0 && r->corrupt == 0 ? 0 : 1;
+}
+
+static void dump(ArchiveReader *r, long from_ns, long count)
+{
+    if (from_ns > 0)
+    {
+        archive_seek(r, from_ns);
+    }
+    Subscription *sub;
+    const Msg *msg;
+    while (count-- > 0 && (msg = archive_reader_next(r, &sub)) != NULL)
+    {
+        if (msg->msg_type == 2)
+        {
+            const Msg2 *msg2 = (const Msg2 *)msg;
+            const Msg2Level *levels = (const Msg2Level *)(msg2 + 1);
+            printf("%s: depth, %d, %d, %ld", sub->symbol, msg2->asks_len, msg2->bids_len, msg2->local_ns);
+            if (msg2->asks_len > 0 && msg2->bids_len > 0)
+            {
+                printf(", %.8g / %.8g", levels[msg2->asks_len].price, levels[0].price);
+            }
+            printf("\n");
+        }
+        else
+        {
+            printf("%s: %s, %s, %.8g, %.8g, %ld\n", sub->symbol, abs(msg->msg_type) == 3 ? "trade" : "ticker",
+                   msg->msg_type == 3 ? "buy" : msg->msg_type == -3 ? "sell" : msg->msg_type > 0 ? "bid" : "ask",
+                   msg->price, msg->size, msg->local_ns);
+        }
+    }
+}
+
+static void bench(ArchiveReader *r, double seconds)
+{
+    if (r->blocks == 0)
+    {
+        printf("empty archive\n");
+        return;
+    }
+    unsigned long records = 0, raw = 0, passes = 0;
+    long long start = get_current_timestamp_ns();
+    long long elapsed = 0;
+    do
+    {
+        for (uint64_t b = 0; b < r->blocks; b++)
+        {
+            long n = archive_decode_block(r, b);
+            records += n > 0 ? n : 0;
+            raw += r->out_len;
+        }
+        passes++;
+        elapsed = get_current_timestamp_ns() - start;
+    } while (elapsed < seconds * 1e9);
+    double archived = (double)(r->map_len) * passes;
+    double ratio = raw / archived;
+    printf("decode: %.0f records/s, %.2f GB/s of records from %.2f GB/s of archive (%.2fx), %lu passes\n",
+           records / (elapsed / 1e9), raw / (double)elapsed, archived / elapsed, ratio, passes);
+    printf("replaying the archive beats reading raw records from storage slower than %.2f GB/s\n",
+           raw / (double)elapsed);
+
+    // Seek to random times within the archive
+    int seeks = 1000;
+    int64_t first = r->index[0].min_local_ns;
+    int64_t span = r->index[r->blocks - 1].max_local_ns - first;
+    Subscription *sub;
+    unsigned int seed = 1;
+    start = get_current_timestamp_ns();
+    for (int i = 0; i < seeks; i++)
+    {
+        archive_seek(r, first + (long)((double)rand_r(&seed) / RAND_MAX * span));
+        archive_reader_next(r, &sub);
+    }
+    printf("seek: %.1f us average over %d random seeks, %lu blocks\n",
+           (get_current_timestamp_ns() - start) / 1e3 / seeks, seeks, (unsigned long)r->blocks);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3 || (strcmp(argv[1], "verify") == 0 && argc < 4))
+    {
+        fprintf(stderr,
+                "usage: %s dump <archive> [from_local_ns] [count]\n"
+                "       %s verify <archive> <journal prefix>\n"
+                "       %s bench <archive> [seconds]\n",
+                argv[0], argv[0], argv[0]);
+        return 1;
+    }
+    ArchiveReader reader;
+    if (archive_reader_open(&reader, argv[2]) < 0)
+    {
+        return 1;
+    }
+    printf("%s: %lu records in %lu blocks, %.1f MB\n", argv[2], (unsigned long)reader.records,
+           (unsigned long)reader.blocks, reader.map_len / 1e6);
+    int status = 0;
+    if (strcmp(argv[1], "dump") == 0)
+    {
+        dump(&reader, argc > 3 ? atol(argv[3]) : 0, argc > 4 ? atol(argv[4]) : LONG_MAX);
+    }
+    else if (strcmp(argv[1], "verify") == 0)
+    {
+        status = verify(&reader, argv[3]);
+    }
+    else if (strcmp(argv[1], "bench") == 0)
+    {
+        bench(&reader, argc > 3 ? atof(argv[3]) : 1.0);
+    }
+    else
+    {
+        fprintf(stderr, "unknown command %s\n", argv[1]);
+        status = 1;
+    }
+    archive_reader_close(&reader);
+    return status;
+}
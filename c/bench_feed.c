@@ -0,0 +1,261 @@
+#ifndef SUBSCRIPTION_MANAGER
+#define SUBSCRIPTION_MANAGER "127.0.0.1"
+#endif
+#include "sdk.c"
+#include "histogram.c"
+
+// Throughput of the SDK decode loop (receive_batch + dispatch_packet with
+// handlers inline, as stream.c without the receive thread) against
+// sim_feed.c. Subscribes to symbols synthetic symbols, then asks the feed
+// for start_rate msgs/s and doubles the rate after every step the loop
+// kept up with. A step is sustained when no message was lost (sn_id gaps
+// not filled by late, reordered datagrams, less the messages the feed
+// dropped on purpose with loss_pct, which it reports on "#stats") and the
+// feed delivered at least 95% of the requested rate; the highest such
+// rate is reported with the feed-to-handler latency (local_ns to receive)
+// and the decode cost per message of every step. Every step ends with the
+// feed paused ("#rate 0"), which first closes each sequence, so gaps are
+// counted in the step they were made.
+//
+// Compile: gcc -O2 -pthread -o bench_feed bench_feed.c
+//          (-DSUBSCRIPTION_MANAGER='"10.0.0.5"' for a feed on another box)
+// Usage:   ./bench_feed [symbols] [start_rate] [seconds] [max_rate] [vlen] [cpu]
+//          e.g. ./sim_feed 0 8 10 20 & ./bench_feed 100 10000
+
+#define BENCH_WARMUP_NS 200000000LL
+// Time for the datagrams in flight to arrive once the feed is paused
+#define BENCH_SETTLE_NS 100000000LL
+#define BENCH_SYMBOL_FMT "sim:SYM%05d"
+
+typedef struct
+{
+    unsigned long msgs;
+    unsigned long depths;
+    unsigned long missing;
+    unsigned long stale;
+    unsigned long calls;
+    unsigned long packets;
+    long long decode_ns;
+} FeedCounters;
+
+static FeedCounters counters;
+static LatencyHistogram wire;
+// Last "#stats" answer: messages the feed dropped on purpose, -1 while
+// waiting for it
+static long feed_dropped = -1;
+
+static void on_bench_msg(Subscription *sub, const Msg *msg, void *ctx)
+{
+    hist_record(&wire, recv_timestamp_ns - msg->local_ns);
+    counters.msgs++;
+}
+
+static void on_bench_depth(Subscription *sub, const Msg2 *msg2, const Msg2Level *levels, void *ctx)
+{
+    hist_record(&wire, recv_timestamp_ns - msg2->local_ns);
+    counters.depths++;
+}
+
+static const StreamHandlers handlers = {
+    .on_ticker = on_bench_msg,
+    .on_trade = on_bench_msg,
+    .on_depth = on_bench_depth,
+};
+
+// Receive and decode until deadline, timing the decode part of each call
+static void drain_until(long long deadline)
+{
+    while (running && get_current_timestamp_ns() < deadline)
+    {
+        if (receive_batch(&handlers) > 0)
+        {
+            counters.decode_ns += get_current_timestamp_ns() - recv_timestamp_ns;
+        }
+    }
+}
+
+static void snapshot_counters(FeedCounters *out)
+{
+    *out = counters;
+    out->missing = 0;
+    out->stale = 0;
+    for (int i = 0; i < manager.subscription_count; i++)
+    {
+        const SeqTracker *seq = &manager.subscriptions[i]->seq;
+        out->missing += seq->missing;
+        out->stale += seq->stale;
+    }
+    out->calls = manager.batch.calls;
+    out->packets = manager.batch.packets;
+}
+
+// Picks the "#stats N" answer out of the manager port's datagrams
+static void on_bench_datagram(const char *buf, int len, unsigned short src_port, long long recv_ns, void *ctx)
+{
+    if (src_port == SUBSCRIPTION_MANAGER_PORT && len > 7 && memcmp(buf, "#stats ", 7) == 0)
+    {
+        feed_dropped = strtol(buf + 7, NULL, 10);
+    }
+}
+
+static int send_request(const char *request)
+{
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(SUBSCRIPTION_MANAGER_PORT);
+    inet_pton(AF_INET, SUBSCRIPTION_MANAGER, &server_addr.sin_addr);
+    if (sendto(manager.socket, request, strlen(request), 0, (struct sockaddr *)&server_addr,
+               sizeof(server_addr)) < 0)
+    {
+        perror("sendto failed");
+        return -1;
+    }
+    return 0;
+}
+
+static int send_rate(double rate)
+{
+    char request[64];
+    snprintf(request, sizeof(request), "#rate %.0f", rate);
+    return send_request(request);
+}
+
+// Pause the feed, let what is in flight arrive, then take the counters
+// and the feed's count of dropped messages. Returns -1 if the feed does
+// not answer "#stats".
+static int settle_counters(FeedCounters *out, long *dropped)
+{
+    send_rate(0);
+    drain_until(get_current_timestamp_ns() + BENCH_SETTLE_NS);
+    feed_dropped = -1;
+    send_request("#stats");
+    long long deadline = get_current_timestamp_ns() + 1000000000LL;
+    while (running && feed_dropped < 0 && get_current_timestamp_ns() < deadline)
+    {
+        receive_batch(&handlers);
+    }
+    snapshot_counters(out);
+    *dropped = feed_dropped;
+    if (feed_dropped < 0)
+    {
+        fprintf(stderr, "no #stats answer from %s:%d\n", SUBSCRIPTION_MANAGER, SUBSCRIPTION_MANAGER_PORT);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int symbols = argc > 1 ? atoi(argv[1]) : 100;
+    double rate = argc > 2 ? atof(argv[2]) : 10000;
+    int seconds = argc > 3 ? atoi(argv[3]) : 2;
+    double max_rate = argc > 4 ? atof(argv[4]) : 1e7;
+    int vlen = argc > 5 ? atoi(argv[5]) : 64;
+    int cpu = argc > 6 ? atoi(argv[6]) : -1;
+
+    if (init_subscription_manager() < 0 || init_batch_receiver(vlen, 100) < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    pin_current_thread(cpu);
+    set_datagram_hook(on_bench_datagram, NULL);
+    // The feed is paused between steps; lets the blocking receive notice
+    // the end of a settle period
+    struct timeval tv = {0, 100000};
+    setsockopt(manager.socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    // Subscribe at rate 0 so the acks are not queued behind data
+    send_rate(0);
+    char symbol[MAX_SYMBOL_LEN];
+    for (int i = 0; i < symbols; i++)
+    {
+        snprintf(symbol, sizeof(symbol), BENCH_SYMBOL_FMT, i);
+        subscribe(symbol);
+    }
+    long long deadline = get_current_timestamp_ns() + 3000000000LL;
+    while (manager.subscription_count < symbols && get_current_timestamp_ns() < deadline)
+    {
+        receive_batch(&handlers);
+    }
+    if (manager.subscription_count < symbols)
+    {
+        fprintf(stderr, "only %d of %d subscriptions acked by %s:%d\n", manager.subscription_count, symbols,
+                SUBSCRIPTION_MANAGER, SUBSCRIPTION_MANAGER_PORT);
+        return EXIT_FAILURE;
+    }
+
+    printf("   rate/s  achieved/s  depth/s     lost   dgram/call  decode ns/msg   p50 us   p99 us  p99.9 us"
+           "   max us\n");
+    double sustained = 0;
+    static HistogramSnapshot before;
+    static HistogramSnapshot after;
+    static HistogramSnapshot step;
+    FeedCounters paused;
+    long dropped_before;
+    if (settle_counters(&paused, &dropped_before) < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    for (; running && rate <= max_rate; rate *= 2)
+    {
+        send_rate(rate);
+        drain_until(get_current_timestamp_ns() + BENCH_WARMUP_NS);
+
+        FeedCounters start;
+        FeedCounters end;
+        snapshot_counters(&start);
+        hist_snapshot(&wire, &before);
+        long long begin = get_current_timestamp_ns();
+        drain_until(begin + seconds * 1000000000LL);
+        double elapsed = (get_current_timestamp_ns() - begin) / 1e9;
+        snapshot_counters(&end);
+        hist_snapshot(&wire, &after);
+        hist_diff(&step, &after, &before);
+        FeedCounters settled;
+        long dropped_after;
+        if (settle_counters(&settled, &dropped_after) < 0)
+        {
+            break;
+        }
+
+        unsigned long msgs = end.msgs - start.msgs;
+        unsigned long depths = end.depths - start.depths;
+        // Over the whole step, warm-up and settling included: a reordered
+        // datagram first shows up as a gap, then as stale, and the feed's
+        // own drops are not the loop's
+        long lost = (long)(settled.missing - paused.missing) - (long)(settled.stale - paused.stale) -
+                    (dropped_after - dropped_before);
+        paused = settled;
+        dropped_before = dropped_after;
+        unsigned long calls = end.calls - start.calls;
+        double achieved = msgs / elapsed;
+        printf("%9.0f %11.0f %8.0f %8ld %12.1f %14.1f %8.1f %8.1f %9.1f %8.1f\n", rate, achieved, depths / elapsed,
+               lost, calls ? (double)(end.packets - start.packets) / calls : 0.0,
+               msgs + depths ? (double)(end.decode_ns - start.decode_ns) / (msgs + depths) : 0.0,
+               hist_percentile(&step, 0.50) / 1e3, hist_percentile(&step, 0.99) / 1e3,
+               hist_percentile(&step, 0.999) / 1e3, step.max / 1e3);
+        if (lost > 0)
+        {
+            printf("%ld messages lost at %.0f msgs/s\n", lost, rate);
+            break;
+        }
+        if (achieved < rate * 0.95)
+        {
+            printf("feed delivered only %.0f%% of %.0f msgs/s, sender limited\n", achieved * 100 / rate, rate);
+            break;
+        }
+        sustained = rate;
+    }
+    printf("max sustained rate: %.0f msgs/s over %d symbols\n", sustained, symbols);
+
+    send_rate(0);
+    unsubscribe_all();
+    print_batch_stats();
+    free_batch_receiver();
+    free_subscriptions();
+    close(manager.socket);
+    return 0;
+}
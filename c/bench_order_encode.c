@@ -0,0 +1,134 @@
+#include "sdk.c"
+#include "order_encoder.c"
+
+// Cost of building a place request: the snprintf path the order clients
+// used against an OrderTemplate, with size/price given as lots/ticks and
+// as doubles converted on the fly. Also checks that both produce the same
+// fields for every encoded order, that the client_order_id counter stops
+// instead of wrapping and that a prefix too long for it is refused.
+//
+// Compile: gcc -O2 -pthread -o bench_order_encode bench_order_encode.c
+// Usage:   ./bench_order_encode [iterations]
+
+#define BENCH_SYMBOL "BTCUSDT"
+#define BENCH_CID_PREFIX "order-"
+#define BENCH_TICK 0.1
+#define BENCH_LOT 0.001
+
+static volatile unsigned long sink;
+
+static double elapsed_ns(long long start, long iterations)
+{
+    return (double)(get_current_timestamp_ns() - start) / iterations;
+}
+
+// Inputs vary per iteration so nothing is hoisted out of the loop
+static inline double bench_price(long i)
+{
+    return 75000.0 + (i & 1023) * BENCH_TICK;
+}
+
+static inline double bench_size(long i)
+{
+    return (1 + (i & 15)) * BENCH_LOT;
+}
+
+// Compare two place requests field by field, numerically for size/price
+static int same_request(const char *a, int a_len, const char *b, int b_len)
+{
+    char x[256], y[256];
+    snprintf(x, sizeof(x), "%.*s", a_len, a);
+    snprintf(y, sizeof(y), "%.*s", b_len, b);
+    char *save_x, *save_y;
+    char *fx = strtok_r(x, ",", &save_x);
+    char *fy = strtok_r(y, ",", &save_y);
+    for (int field = 0; fx != NULL && fy != NULL; field++)
+    {
+        if (field >= 8 ? strtod(fx, NULL) != strtod(fy, NULL) : strcmp(fx, fy) != 0)
+        {
+            return 0;
+        }
+        fx = strtok_r(NULL, ",", &save_x);
+        fy = strtok_r(NULL, ",", &save_y);
+    }
+    return fx == NULL && fy == NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 5000000;
+    static OrderTemplate t;
+    if (order_template_init(&t, ORDER_FIELD_ACCOUNT | ORDER_FIELD_POS_SIDE, 0, BENCH_SYMBOL, BENCH_TICK, BENCH_LOT, BENCH_CID_PREFIX, 0) < 0)
+    {
+        return 1;
+    }
+
+    // Correctness on a sample before timing anything
+    char buf[65536];
+    for (long i = 0; i < 100000; i++)
+    {
+        const char *msg;
+        int len = order_encode_place(&t, (int)i, (unsigned long long)i, (int)(i % 3) - 1, 1 + (i & 1), 2,
+                                     order_size_lots(&t, bench_size(i)), order_price_ticks(&t, bench_price(i)),
+                                     &msg);
+        int ref = snprintf(buf, sizeof(buf), "%d,1,%d,%s,%s%010lu,%d,%d,%d,%f,%f", (int)i, 0, BENCH_SYMBOL,
+                           BENCH_CID_PREFIX, (unsigned long)i, (int)(i % 3) - 1, 1 + (int)(i & 1), 2,
+                           bench_size(i), bench_price(i));
+        if (!same_request(msg, len, buf, ref))
+        {
+            fprintf(stderr, "mismatch:\n  %.*s\n  %s\n", len, msg, buf);
+            return 1;
+        }
+    }
+    static OrderTemplate last;
+    if (order_template_init(&last, 0, 0, BENCH_SYMBOL, BENCH_TICK, BENCH_LOT, BENCH_CID_PREFIX, ORDER_CID_LAST) < 0 ||
+        order_template_next_cid(&last) != ORDER_CID_LAST || order_template_next_cid(&last) != ORDER_CID_EXHAUSTED ||
+        order_template_next_cid(&last) != ORDER_CID_EXHAUSTED)
+    {
+        fprintf(stderr, "client_order_id counter did not stop at %llu\n", ORDER_CID_LAST);
+        return 1;
+    }
+    if (order_template_init(&last, 0, 0, BENCH_SYMBOL, BENCH_TICK, BENCH_LOT, "a-prefix-of-twenty-one", 0) == 0 ||
+        order_template_init(&last, 0, 0, BENCH_SYMBOL, BENCH_TICK, BENCH_LOT, BENCH_CID_PREFIX,
+                            ORDER_CID_LAST + 1) == 0)
+    {
+        fprintf(stderr, "template accepted a cid that does not fit\n");
+        return 1;
+    }
+
+    long long start = get_current_timestamp_ns();
+    for (long i = 0; i < iterations; i++)
+    {
+        int len = snprintf(buf, sizeof(buf), "%d,1,%d,%s,%s%010lu,%d,%d,%d,%f,%f", (int)i, 0, BENCH_SYMBOL,
+                           BENCH_CID_PREFIX, (unsigned long)i, 0, 1, 2, bench_size(i), bench_price(i));
+        sink += len + buf[len - 1];
+    }
+    double snprintf_ns = elapsed_ns(start, iterations);
+
+    start = get_current_timestamp_ns();
+    for (long i = 0; i < iterations; i++)
+    {
+        const char *msg;
+        int len = order_encode_place(&t, (int)i, (unsigned long long)i, 0, 1, 2, 1 + (i & 15),
+                                     750000 + (i & 1023), &msg);
+        sink += len + msg[len - 1];
+    }
+    double ticks_ns = elapsed_ns(start, iterations);
+
+    start = get_current_timestamp_ns();
+    for (long i = 0; i < iterations; i++)
+    {
+        const char *msg;
+        int len = order_encode_place(&t, (int)i, (unsigned long long)i, 0, 1, 2,
+                                     order_size_lots(&t, bench_size(i)), order_price_ticks(&t, bench_price(i)),
+                                     &msg);
+        sink += len + msg[len - 1];
+    }
+    double doubles_ns = elapsed_ns(start, iterations);
+
+    printf("%ld iterations, 100000 encodings verified against snprintf\n", iterations);
+    printf("snprintf            %7.1f ns/order\n", snprintf_ns);
+    printf("template (ticks)    %7.1f ns/order  %5.1fx\n", ticks_ns, snprintf_ns / ticks_ns);
+    printf("template (doubles)  %7.1f ns/order  %5.1fx\n", doubles_ns, snprintf_ns / doubles_ns);
+    return 0;
+}
@@ -0,0 +1,383 @@
+#include "sdk.c"
+#include "order_response.c"
+#include "order_json.c"
+#include "order_manager.c"
+
+// Throughput of order_parse() against the parse_response() the order
+// clients used before the session: it copied idx, type and payload into a
+// Response holding a 64KB payload array and returned it by value. Both run
+// over the same recorded replies (built-in samples, or a file with one
+// reply per line) and are checked to agree first. The order fields
+// order_json.c extracts from the replies documented in the examples and
+// by the exchanges are checked as well, and so is the state each reply
+// moves an OrderManager order to.
+//
+// Compile: gcc -O2 -pthread -o bench_order_parse bench_order_parse.c
+// Usage:   ./bench_order_parse [iterations] [responses.txt]
+
+#define BUFFER_SIZE 65536
+#define BENCH_MAX_RESPONSES 4096
+
+// ---- Previous parser, unchanged ----
+
+typedef struct
+{
+    int idx;
+    char response_type[16];
+    char payload[BUFFER_SIZE - 32];
+    int is_valid;
+} Response;
+
+__attribute__((noinline)) Response parse_response(const char *raw_response)
+{
+    Response resp = {0};
+    resp.is_valid = 0;
+
+    const char *first_colon = strchr(raw_response, ':');
+    if (!first_colon)
+        return resp;
+
+    const char *second_colon = strchr(first_colon + 1, ':');
+    if (!second_colon)
+        return resp;
+
+    char idx_str[16] = {0};
+    size_t idx_len = first_colon - raw_response;
+    if (idx_len >= sizeof(idx_str))
+        return resp;
+    strncpy(idx_str, raw_response, idx_len);
+    resp.idx = atoi(idx_str);
+
+    size_t type_len = second_colon - first_colon - 1;
+    if (type_len >= sizeof(resp.response_type))
+        return resp;
+    strncpy(resp.response_type, first_colon + 1, type_len);
+
+    strncpy(resp.payload, second_colon + 1, sizeof(resp.payload) - 1);
+
+    resp.is_valid = 1;
+    return resp;
+}
+
+// ---- Recorded replies ----
+
+static const char *samples[] = {
+    "0:k:0",
+    "1:k:1",
+    "17:e:ORDER_NOT_FOUND-unknown order",
+    "18:e:NOT_CONNECTED-please connect first",
+    "2051:r:{\"code\":-2011,\"msg\":\"Unknown order sent.\"}",
+    "2052:r:{\"id\":\"a1b2\",\"status\":200,\"result\":{\"symbol\":\"BTCUSDT\",\"orderId\":4045184729,"
+    "\"clientOrderId\":\"x-1731998734001\",\"price\":\"75000.00\",\"origQty\":\"0.002\",\"executedQty\":\"0.000\","
+    "\"status\":\"NEW\",\"timeInForce\":\"GTX\",\"type\":\"LIMIT\",\"side\":\"BUY\",\"positionSide\":\"LONG\","
+    "\"updateTime\":1731998734187},\"rateLimits\":[{\"rateLimitType\":\"ORDERS\",\"interval\":\"SECOND\","
+    "\"intervalNum\":10,\"limit\":300,\"count\":1}]}",
+    "a:0:{\"e\":\"ORDER_TRADE_UPDATE\",\"T\":1731998734190,\"E\":1731998734191,\"o\":{\"s\":\"BTCUSDT\","
+    "\"c\":\"x-1731998734001\",\"S\":\"BUY\",\"o\":\"LIMIT\",\"f\":\"GTX\",\"q\":\"0.002\",\"p\":\"75000\","
+    "\"X\":\"NEW\",\"i\":4045184729,\"l\":\"0\",\"z\":\"0\",\"L\":\"0\",\"T\":1731998734187,\"ps\":\"LONG\"}}",
+    "a:1:{\"channel\":\"futures.orders\",\"event\":\"update\",\"result\":[{\"id\":58828289,\"contract\":"
+    "\"BTC_USDT\",\"size\":1,\"left\":0,\"fill_price\":\"75000\",\"text\":\"t-1731998734001\",\"status\":"
+    "\"finished\",\"finish_as\":\"filled\"}]}",
+    "123456:r:{\"header\":{\"status\":\"200\"},\"data\":{\"result\":{\"req_id\":\"123456\",\"id\":\"58828289\","
+    "\"text\":\"t-1731998734001\",\"status\":\"open\",\"contract\":\"BTC_USDT\",\"size\":1,\"price\":\"75000\"}}}",
+};
+
+// ---- Field extraction checks ----
+
+typedef struct
+{
+    int exchange;
+    const char *reply;
+    // Expected OrderFills; the fields below describe the first one
+    int fills;
+    long long order_id;
+    const char *symbol;
+    const char *status;
+    double filled_qty;
+    double avg_price;
+} ExtractCheck;
+
+static const ExtractCheck extract_checks[] = {
+    // Replies as documented in place_order_binance_udp.c
+    {EXCHANGE_BINANCE, "1:r:{\"orderId\":123,\"status\":\"NEW\"}", 1, 123, "", "NEW", 0, 0},
+    {EXCHANGE_BINANCE, "2:r:{\"orderId\":123,\"status\":\"CANCELED\"}", 1, 123, "", "CANCELED", 0, 0},
+    {EXCHANGE_BINANCE, "a:0:{\"e\":\"executionReport\",\"s\":\"BTCUSDT\"}", 1, 0, "BTCUSDT", "", 0, 0},
+    // Spot REST order reply and executionReport, average price from the quote quantity
+    {EXCHANGE_BINANCE,
+     "3:r:{\"symbol\":\"BTCUSDT\",\"orderId\":28,\"orderListId\":-1,\"clientOrderId\":\"6gCrw2kRUAF9CvJDGP16IP\","
+     "\"transactTime\":1507725176595,\"price\":\"0.00000000\",\"origQty\":\"10.00000000\",\"executedQty\":"
+     "\"10.00000000\",\"cummulativeQuoteQty\":\"25.00000000\",\"status\":\"FILLED\",\"timeInForce\":\"GTC\","
+     "\"type\":\"MARKET\",\"side\":\"SELL\"}",
+     1, 28, "BTCUSDT", "FILLED", 10, 2.5},
+    {EXCHANGE_BINANCE,
+     "a:0:{\"e\":\"executionReport\",\"E\":1499405658658,\"s\":\"ETHBTC\",\"c\":\"mUvoqJxFIILMdfAW5iGSOW\","
+     "\"S\":\"BUY\",\"o\":\"LIMIT\",\"f\":\"GTC\",\"q\":\"1.00000000\",\"p\":\"0.10264410\",\"P\":\"0.00000000\","
+     "\"F\":\"0.00000000\",\"g\":-1,\"C\":\"\",\"x\":\"TRADE\",\"X\":\"PARTIALLY_FILLED\",\"r\":\"NONE\","
+     "\"i\":4293153,\"l\":\"0.50000000\",\"z\":\"0.50000000\",\"L\":\"0.10264410\",\"n\":\"0\",\"N\":null,"
+     "\"T\":1499405658657,\"t\":-1,\"I\":8641984,\"w\":true,\"m\":false,\"M\":false,\"O\":1499405658657,"
+     "\"Z\":\"0.05132205\",\"Y\":\"0.00000000\",\"Q\":\"0.00000000\"}",
+     1, 4293153, "ETHBTC", "PARTIALLY_FILLED", 0.5, 0.1026441},
+    // WebSocket API reply and futures ORDER_TRADE_UPDATE (samples above)
+    {EXCHANGE_BINANCE, NULL, 1, 4045184729LL, "BTCUSDT", "NEW", 0, 0},
+    {EXCHANGE_BINANCE, NULL, 1, 4045184729LL, "BTCUSDT", "NEW", 0, 0},
+    // An exponent far out of range parses to 0 at once, not after 1e9 steps
+    {EXCHANGE_BINANCE, "4:r:{\"orderId\":124,\"status\":\"NEW\",\"executedQty\":\"1e-999999999\"}", 1, 124, "",
+     "NEW", 0, 0},
+    // Error body and an account event carry no order
+    {EXCHANGE_BINANCE, "2051:r:{\"code\":-2011,\"msg\":\"Unknown order sent.\"}", 0},
+    {EXCHANGE_BINANCE,
+     "a:0:{\"e\":\"outboundAccountPosition\",\"E\":1564034571105,\"u\":1564034571073,\"B\":[{\"a\":\"ETH\","
+     "\"f\":\"10000.000000\",\"l\":\"0.000000\"}]}",
+     0},
+    {EXCHANGE_GATEIO, NULL, 1, 58828289, "BTC_USDT", "finished", 1, 75000},
+    {EXCHANGE_GATEIO, NULL, 1, 58828289, "BTC_USDT", "open", 0, 0},
+};
+
+// Replies of the NULL entries above, in order
+static const int extract_samples[] = {5, 6, 7, 8};
+
+static int check_extraction()
+{
+    int failures = 0;
+    int sample = 0;
+    for (unsigned int i = 0; i < sizeof(extract_checks) / sizeof(extract_checks[0]); i++)
+    {
+        const ExtractCheck *c = &extract_checks[i];
+        const char *reply = c->reply != NULL ? c->reply : samples[extract_samples[sample++]];
+        OrderResponse resp;
+        OrderFill fills[4];
+        int count = -1;
+        if (order_parse(reply, strlen(reply), &resp) == 0)
+        {
+            count = order_json_fills(&order_exchanges[c->exchange], &resp, fills, 4);
+        }
+        int ok = count == c->fills;
+        if (ok && count > 0)
+        {
+            const OrderFill *f = &fills[0];
+            ok = f->order_id == c->order_id && strcmp(f->symbol, c->symbol) == 0 &&
+                 strcmp(f->status, c->status) == 0 && fabs(f->filled_qty - c->filled_qty) < 1e-9 &&
+                 fabs(f->avg_price - c->avg_price) < 1e-6;
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "extraction mismatch (%d fills) on: %.80s\n", count, reply);
+            if (count > 0)
+            {
+                print_order_fill(&fills[0]);
+            }
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// State an order reaches from PENDING_NEW on a reply to its place request,
+// or from PENDING_CANCEL on a reply to its cancel request
+typedef struct
+{
+    int exchange;
+    int kind;
+    const char *reply;
+    int state;
+} ManagerCheck;
+
+static const ManagerCheck manager_checks[] = {
+    // Binance replies as sent: flat, ACK response type (no status), WebSocket API
+    {EXCHANGE_BINANCE, ORDER_PLACE, "7:r:{\"orderId\":123,\"status\":\"NEW\"}", ORDER_STATE_ACKED},
+    {EXCHANGE_BINANCE, ORDER_PLACE,
+     "7:r:{\"symbol\":\"BTCUSDT\",\"orderId\":28,\"orderListId\":-1,\"clientOrderId\":\"6gCrw2kRUAF9CvJDGP16IP\","
+     "\"transactTime\":1507725176595}",
+     ORDER_STATE_ACKED},
+    {EXCHANGE_BINANCE, ORDER_PLACE,
+     "7:r:{\"id\":\"a1b2\",\"status\":200,\"result\":{\"symbol\":\"BTCUSDT\",\"orderId\":4045184729,"
+     "\"clientOrderId\":\"x-1731998734001\",\"origQty\":\"0.002\",\"executedQty\":\"0.000\",\"status\":\"NEW\"},"
+     "\"rateLimits\":[{\"rateLimitType\":\"ORDERS\",\"interval\":\"SECOND\",\"limit\":300,\"count\":1}]}",
+     ORDER_STATE_ACKED},
+    {EXCHANGE_BINANCE, ORDER_PLACE, "7:r:{\"orderId\":123,\"status\":\"EXPIRED\"}", ORDER_STATE_CANCELLED},
+    // Only an explicit error rejects
+    {EXCHANGE_BINANCE, ORDER_PLACE,
+     "7:r:{\"code\":-2010,\"msg\":\"Account has insufficient balance for requested action.\"}",
+     ORDER_STATE_REJECTED},
+    {EXCHANGE_BINANCE, ORDER_PLACE,
+     "7:r:{\"id\":\"a1b2\",\"status\":400,\"error\":{\"code\":-1102,\"msg\":\"Mandatory parameter 'quantity' "
+     "was not sent.\"}}",
+     ORDER_STATE_REJECTED},
+    {EXCHANGE_BINANCE, ORDER_PLACE, "7:e:NOT_CONNECTED-please connect first", ORDER_STATE_REJECTED},
+    {EXCHANGE_BINANCE, ORDER_CANCEL, "7:r:{\"code\":-2011,\"msg\":\"Unknown order sent.\"}", ORDER_STATE_ACKED},
+    {EXCHANGE_BINANCE, ORDER_CANCEL, "7:r:{\"orderId\":123,\"status\":\"CANCELED\"}", ORDER_STATE_CANCELLED},
+    {EXCHANGE_GATEIO, ORDER_PLACE,
+     "7:r:{\"header\":{\"response_time\":\"1681986204784\",\"status\":\"200\",\"channel\":\"futures.order_place\","
+     "\"event\":\"api\"},\"data\":{\"result\":{\"req_id\":\"7\",\"ack\":true}}}",
+     ORDER_STATE_ACKED},
+    {EXCHANGE_GATEIO, ORDER_PLACE,
+     "7:r:{\"header\":{\"response_time\":\"1681986204784\",\"status\":\"400\",\"channel\":\"futures.order_place\","
+     "\"event\":\"api\"},\"data\":{\"errs\":{\"label\":\"INVALID_PARAM_VALUE\",\"message\":\"size\"}}}",
+     ORDER_STATE_REJECTED},
+};
+
+static int check_manager()
+{
+    int failures = 0;
+    for (unsigned int i = 0; i < sizeof(manager_checks) / sizeof(manager_checks[0]); i++)
+    {
+        const ManagerCheck *c = &manager_checks[i];
+        OrderSession session;
+        memset(&session, 0, sizeof(session));
+        session.exchange = &order_exchanges[c->exchange];
+        OrderManager m;
+        if (order_manager_init(&m, &session, 4, 1, NULL, NULL) < 0)
+        {
+            return 1;
+        }
+        ManagedOrder *o = order_manager_new(&m, 0, "BTCUSDT", "x-1731998734001", 1, 0.002, 75000);
+        // The order was placed with idx 6 and is being cancelled with 7,
+        // or is being placed with 7
+        OrderRequest req = {.kind = c->kind, .idx = 7, .user = o};
+        o->place_idx = c->kind == ORDER_PLACE ? 7 : 6;
+        if (c->kind == ORDER_CANCEL)
+        {
+            o->cancel_idx = 7;
+            o->state = ORDER_STATE_PENDING_CANCEL;
+        }
+        // A terminal order is released but keeps its state
+        OrderResponse resp;
+        if (order_parse(c->reply, strlen(c->reply), &resp) < 0)
+        {
+            fprintf(stderr, "unparsed: %s\n", c->reply);
+            failures++;
+        }
+        else
+        {
+            order_manager_on_response(&m, &req, &resp);
+            if (o->state != c->state)
+            {
+                fprintf(stderr, "order %s instead of %s on: %.80s\n", order_state_name(o->state),
+                        order_state_name(c->state), c->reply);
+                failures++;
+            }
+        }
+        order_manager_free(&m);
+    }
+    return failures;
+}
+
+static char *responses[BENCH_MAX_RESPONSES];
+static int response_lens[BENCH_MAX_RESPONSES];
+static int response_count;
+
+static void add_response(const char *line, int len)
+{
+    if (response_count >= BENCH_MAX_RESPONSES)
+    {
+        return;
+    }
+    // NUL-terminated like the session's receive buffers
+    char *copy = malloc(len + 1);
+    memcpy(copy, line, len);
+    copy[len] = '\0';
+    responses[response_count] = copy;
+    response_lens[response_count++] = len;
+}
+
+static int load_responses(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        perror("open responses failed");
+        return -1;
+    }
+    static char line[BUFFER_SIZE];
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        int len = strcspn(line, "\r\n");
+        if (len > 0)
+        {
+            add_response(line, len);
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+// The previous parser has no auth or untyped form; compare where it applies
+static int same_result(const Response *old, const OrderResponse *resp)
+{
+    if (!old->is_valid || resp->type == ORDER_RESP_AUTH || resp->type == ORDER_RESP_UNTYPED)
+    {
+        return 1;
+    }
+    return old->idx == resp->idx && old->response_type[0] == resp->type && old->response_type[1] == '\0' &&
+           (int)strlen(old->payload) == resp->payload_len &&
+           memcmp(old->payload, resp->payload, resp->payload_len) == 0;
+}
+
+static volatile unsigned long sink;
+
+int main(int argc, char *argv[])
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 2000000;
+    if (argc > 2)
+    {
+        if (load_responses(argv[2]) < 0)
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        for (unsigned int i = 0; i < sizeof(samples) / sizeof(samples[0]); i++)
+        {
+            add_response(samples[i], strlen(samples[i]));
+        }
+    }
+    if (response_count == 0)
+    {
+        fprintf(stderr, "no responses\n");
+        return 1;
+    }
+
+    static Response old;
+    long bytes = 0;
+    for (int i = 0; i < response_count; i++)
+    {
+        OrderResponse resp;
+        old = parse_response(responses[i]);
+        if (order_parse(responses[i], response_lens[i], &resp) < 0 || !same_result(&old, &resp))
+        {
+            fprintf(stderr, "mismatch on: %.80s\n", responses[i]);
+            return 1;
+        }
+        bytes += response_lens[i];
+    }
+    if (check_extraction() > 0 || check_manager() > 0)
+    {
+        return 1;
+    }
+
+    long long start = get_current_timestamp_ns();
+    for (long i = 0; i < iterations; i++)
+    {
+        old = parse_response(responses[i % response_count]);
+        sink += old.idx + old.payload[0];
+    }
+    double old_ns = (double)(get_current_timestamp_ns() - start) / iterations;
+
+    start = get_current_timestamp_ns();
+    for (long i = 0; i < iterations; i++)
+    {
+        int r = (int)(i % response_count);
+        OrderResponse resp;
+        if (order_parse(responses[r], response_lens[r], &resp) == 0)
+        {
+            sink += resp.idx + resp.payload[0];
+        }
+    }
+    double new_ns = (double)(get_current_timestamp_ns() - start) / iterations;
+
+    printf("%d responses (avg %ld bytes), %ld iterations\n", response_count, bytes / response_count, iterations);
+    printf("parse_response  %8.1f ns/response  %8.0f k/s\n", old_ns, 1e6 / old_ns);
+    printf("order_parse     %8.1f ns/response  %8.0f k/s  %6.1fx\n", new_ns, 1e6 / new_ns, old_ns / new_ns);
+    return 0;
+}
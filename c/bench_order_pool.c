@@ -0,0 +1,352 @@
+#include "order_pool.c"
+
+// Order throughput of an OrderPool over loopback as accounts are added.
+// A built-in echo server (one SO_REUSEPORT socket and thread per account)
+// acks every request; each account gets a producer thread that keeps
+// BENCH_WINDOW places in flight through order_pool_place. With enough
+// free cores (producer, worker and echo thread per account) the total
+// rate should grow linearly with the account count.
+//
+// Before timing, commands that cannot be sent are checked to be answered:
+// places beyond the rate limiter's burst come back as RATE_LIMITED, places
+// queued on an account whose connect was never sent as NOT_CONNECTED, and
+// closing the pool with that account in it returns.
+//
+// Compile: gcc -O2 -pthread -o bench_order_pool bench_order_pool.c
+// Usage:   ./bench_order_pool [max_accounts] [seconds] [first_cpu]
+//          Workers run on first_cpu.., producers after them (-1: no pinning)
+
+#define BENCH_PORT 9289
+#define BENCH_LOCAL_PORT 9300
+#define BENCH_WINDOW 64
+#define BENCH_VLEN 64
+#define BENCH_CHECK_ORDERS 10
+
+static _Atomic int echo_running = 1;
+
+typedef struct
+{
+    int fd;
+    pthread_t thread;
+} EchoServer;
+
+// Answer "idx,mode,..." with "idx:k:account" (connect) or "idx:k:ok"
+static void *echo_main(void *arg)
+{
+    EchoServer *e = (EchoServer *)arg;
+    static __thread char in[BENCH_VLEN][512];
+    static __thread char out[BENCH_VLEN][32];
+    struct iovec in_iov[BENCH_VLEN], out_iov[BENCH_VLEN];
+    struct sockaddr_in from[BENCH_VLEN];
+    struct mmsghdr in_msgs[BENCH_VLEN], out_msgs[BENCH_VLEN];
+    memset(in_msgs, 0, sizeof(in_msgs));
+    memset(out_msgs, 0, sizeof(out_msgs));
+    for (int i = 0; i < BENCH_VLEN; i++)
+    {
+        in_iov[i].iov_base = in[i];
+        in_iov[i].iov_len = sizeof(in[i]) - 1;
+        in_msgs[i].msg_hdr.msg_iov = &in_iov[i];
+        in_msgs[i].msg_hdr.msg_iovlen = 1;
+        in_msgs[i].msg_hdr.msg_name = &from[i];
+        out_iov[i].iov_base = out[i];
+        out_msgs[i].msg_hdr.msg_iov = &out_iov[i];
+        out_msgs[i].msg_hdr.msg_iovlen = 1;
+        out_msgs[i].msg_hdr.msg_name = &from[i];
+        out_msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+    }
+    while (atomic_load(&echo_running))
+    {
+        for (int i = 0; i < BENCH_VLEN; i++)
+        {
+            in_msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        }
+        int n = recvmmsg(e->fd, in_msgs, BENCH_VLEN, MSG_WAITFORONE, NULL);
+        if (n <= 0)
+        {
+            continue;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            char *p = in[i];
+            p[in_msgs[i].msg_len] = '\0';
+            char *comma = strchr(p, ',');
+            int len = 0;
+            if (comma != NULL)
+            {
+                int idx_len = (int)(comma - p);
+                memcpy(out[i], p, idx_len);
+                len = idx_len;
+                if (comma[1] == '0')
+                {
+                    // Account index is the last field of the connect
+                    len += snprintf(out[i] + len, sizeof(out[i]) - len, ":k:%s", strrchr(p, ',') + 1);
+                }
+                else
+                {
+                    memcpy(out[i] + len, ":k:ok", 5);
+                    len += 5;
+                }
+            }
+            out_iov[i].iov_len = len;
+        }
+        sendmmsg(e->fd, out_msgs, n, 0);
+    }
+    return NULL;
+}
+
+static int echo_start(EchoServer *e)
+{
+    e->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int one = 1;
+    setsockopt(e->fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    struct timeval tv = {0, 100000};
+    setsockopt(e->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(BENCH_PORT);
+    if (bind(e->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("echo bind failed");
+        return -1;
+    }
+    return pthread_create(&e->thread, NULL, echo_main, e) == 0 ? 0 : -1;
+}
+
+// Completed places per account, written by the account's worker
+static _Atomic unsigned long completed[POOL_MAX_ACCOUNTS];
+static _Atomic int producing;
+
+typedef struct
+{
+    OrderPool *pool;
+    int slot;
+    int cpu;
+    unsigned long submitted;
+    pthread_t thread;
+} Producer;
+
+static void on_bench_response(OrderSession *s, const OrderRequest *req, const OrderResponse *resp, void *ctx)
+{
+    if (req != NULL && req->kind == ORDER_PLACE)
+    {
+        atomic_fetch_add_explicit(&completed[order_pool_account(s)->slot], 1, memory_order_relaxed);
+    }
+}
+
+static void *producer_main(void *arg)
+{
+    Producer *p = (Producer *)arg;
+    pin_current_thread(p->cpu);
+    char cid[32];
+    while (atomic_load_explicit(&producing, memory_order_relaxed))
+    {
+        if (p->submitted - atomic_load_explicit(&completed[p->slot], memory_order_relaxed) >= BENCH_WINDOW)
+        {
+            cpu_relax();
+            continue;
+        }
+        snprintf(cid, sizeof(cid), "x-%d-%lu", p->slot, p->submitted);
+        if (order_pool_place(p->pool, p->slot, "BTCUSDT", cid, 0, 1, 1, 0.001, 80000.0, NULL) == 0)
+        {
+            p->submitted++;
+        }
+    }
+    return NULL;
+}
+
+// Places of the check, by answer
+static _Atomic unsigned long check_acked;
+static _Atomic unsigned long check_rate_limited;
+static _Atomic unsigned long check_not_connected;
+
+static void on_check_response(OrderSession *s, const OrderRequest *req, const OrderResponse *resp, void *ctx)
+{
+    if (req == NULL || req->kind != ORDER_PLACE)
+    {
+        return;
+    }
+    if (resp->type == ORDER_RESP_ACK)
+    {
+        atomic_fetch_add(&check_acked, 1);
+    }
+    else if (resp->idx == -1 && resp->payload_len == (int)strlen(POOL_ERR_RATE_LIMITED) &&
+             memcmp(resp->payload, POOL_ERR_RATE_LIMITED, resp->payload_len) == 0)
+    {
+        atomic_fetch_add(&check_rate_limited, 1);
+    }
+    else if (resp->idx == -1 && resp->payload_len == (int)strlen(POOL_ERR_NOT_CONNECTED) &&
+             memcmp(resp->payload, POOL_ERR_NOT_CONNECTED, resp->payload_len) == 0)
+    {
+        atomic_fetch_add(&check_not_connected, 1);
+    }
+}
+
+// Slot 0 connects behind a limiter with a burst of 2; slot 1's account has
+// no bucket in the limiter, so its connect is never sent. Returns 0 if
+// every place was answered as expected.
+static int check_unsent(void)
+{
+    static OrderPool pool;
+    static RateLimiter limiter;
+    if (rate_limiter_init(&limiter, 1) < 0)
+    {
+        return -1;
+    }
+    RateLimit limit = {.rate = 1, .burst = 2};
+    rate_limiter_set(&limiter, EXCHANGE_BINANCE, -1, RATE_CLASS_ORDER, &limit);
+    OrderPoolConfig config = {
+        .exchange = EXCHANGE_BINANCE,
+        .server_ip = "127.0.0.1",
+        .server_port = BENCH_PORT,
+        .local_port_base = BENCH_LOCAL_PORT,
+        .first_cpu = -1,
+        .max_inflight = BENCH_WINDOW,
+        .timeout_ms = 1000,
+        .limiter = &limiter,
+        .handlers = {.on_response = on_check_response},
+    };
+    order_pool_init(&pool, &config);
+    PoolCredentials connected = {.api_key = "KEY", .api_secret = "SECRET", .account_index = 0};
+    PoolCredentials refused = {.api_key = "KEY", .api_secret = "SECRET", .account_index = 1};
+    if (order_pool_add(&pool, &connected) < 0 || order_pool_wait_ready(&pool, 0, 1000) != POOL_READY ||
+        order_pool_add(&pool, &refused) < 0)
+    {
+        fprintf(stderr, "check accounts did not start\n");
+        order_pool_close(&pool);
+        rate_limiter_free(&limiter);
+        return -1;
+    }
+    char cid[32];
+    for (int i = 0; i < BENCH_CHECK_ORDERS; i++)
+    {
+        snprintf(cid, sizeof(cid), "c-%d", i);
+        order_pool_place(&pool, 0, "BTCUSDT", cid, 0, 1, 1, 0.001, 80000.0, NULL);
+        order_pool_place(&pool, 1, "BTCUSDT", cid, 0, 1, 1, 0.001, 80000.0, NULL);
+    }
+    long long deadline = get_current_timestamp_ns() + 2000000000LL;
+    while (atomic_load(&check_acked) + atomic_load(&check_rate_limited) + atomic_load(&check_not_connected) <
+               2 * BENCH_CHECK_ORDERS &&
+           get_current_timestamp_ns() < deadline)
+    {
+        usleep(1000);
+    }
+    // A worker that never drained its failed account kept this from returning
+    alarm(5);
+    order_pool_close(&pool);
+    alarm(0);
+    rate_limiter_free(&limiter);
+
+    unsigned long acked = atomic_load(&check_acked);
+    unsigned long rate_limited = atomic_load(&check_rate_limited);
+    unsigned long not_connected = atomic_load(&check_not_connected);
+    printf("check: %lu acked, %lu rate limited, %lu not connected\n", acked, rate_limited, not_connected);
+    return acked == 2 && rate_limited == BENCH_CHECK_ORDERS - 2 && not_connected == BENCH_CHECK_ORDERS ? 0 : -1;
+}
+
+// Total places per second with n accounts
+static double bench_accounts(int n, int seconds, int first_cpu)
+{
+    static OrderPool pool;
+    OrderPoolConfig config = {
+        .exchange = EXCHANGE_BINANCE,
+        .server_ip = "127.0.0.1",
+        .server_port = BENCH_PORT,
+        .local_port_base = BENCH_LOCAL_PORT,
+        .first_cpu = first_cpu,
+        .max_inflight = BENCH_WINDOW * 2,
+        .timeout_ms = 1000,
+        .handlers = {.on_response = on_bench_response},
+    };
+    order_pool_init(&pool, &config);
+    for (int i = 0; i < n; i++)
+    {
+        atomic_store(&completed[i], 0);
+        PoolCredentials credentials = {.api_key = "KEY", .api_secret = "SECRET", .account_index = i};
+        if (order_pool_add(&pool, &credentials) < 0 || order_pool_wait_ready(&pool, i, 1000) != POOL_READY)
+        {
+            fprintf(stderr, "account %d did not connect\n", i);
+            order_pool_close(&pool);
+            return 0;
+        }
+    }
+
+    Producer producers[POOL_MAX_ACCOUNTS];
+    atomic_store(&producing, 1);
+    for (int i = 0; i < n; i++)
+    {
+        producers[i] = (Producer){.pool = &pool, .slot = i, .cpu = first_cpu >= 0 ? first_cpu + n + i : -1};
+        pthread_create(&producers[i].thread, NULL, producer_main, &producers[i]);
+    }
+    // Measure after a short warm-up
+    usleep(200000);
+    unsigned long start_count = 0;
+    for (int i = 0; i < n; i++)
+    {
+        start_count += atomic_load(&completed[i]);
+    }
+    long long start = get_current_timestamp_ns();
+    sleep(seconds);
+    unsigned long end_count = 0;
+    for (int i = 0; i < n; i++)
+    {
+        end_count += atomic_load(&completed[i]);
+    }
+    double elapsed = (get_current_timestamp_ns() - start) / 1e9;
+
+    atomic_store(&producing, 0);
+    for (int i = 0; i < n; i++)
+    {
+        pthread_join(producers[i].thread, NULL);
+    }
+    order_pool_close(&pool);
+    return (end_count - start_count) / elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+    int max_accounts = argc > 1 ? atoi(argv[1]) : 4;
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+    int first_cpu = argc > 3 ? atoi(argv[3]) : -1;
+    if (max_accounts < 1 || max_accounts > POOL_MAX_ACCOUNTS)
+    {
+        fprintf(stderr, "max_accounts must be 1..%d\n", POOL_MAX_ACCOUNTS);
+        return 1;
+    }
+
+    static EchoServer echo[POOL_MAX_ACCOUNTS];
+    for (int i = 0; i < max_accounts; i++)
+    {
+        if (echo_start(&echo[i]) < 0)
+        {
+            return 1;
+        }
+    }
+
+    if (check_unsent() < 0)
+    {
+        fprintf(stderr, "unsent commands not answered as expected\n");
+        return 1;
+    }
+
+    printf("accounts  orders/s   per account  scaling\n");
+    double single = 0;
+    for (int n = 1; n <= max_accounts; n *= 2)
+    {
+        double rate = bench_accounts(n, seconds, first_cpu);
+        if (n == 1)
+        {
+            single = rate;
+        }
+        printf("%8d  %9.0f  %11.0f  %6.2fx\n", n, rate, rate / n, single > 0 ? rate / single : 0.0);
+    }
+
+    atomic_store(&echo_running, 0);
+    for (int i = 0; i < max_accounts; i++)
+    {
+        pthread_join(echo[i].thread, NULL);
+        close(echo[i].fd);
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include "sdk.c"
+#include "histogram.c"
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+// Wake-up latency of the three ways to wait for the feed socket, over
+// loopback: blocking recvmmsg, epoll_wait + non-blocking drain, and spin
+// (MSG_DONTWAIT with SO_BUSY_POLL). A sender thread stamps each datagram
+// with CLOCK_REALTIME right before sendto; the receiver measures until
+// receive_batch() hands it to the handler. Use separate, isolated cores
+// for the two threads, otherwise spin mode competes with the sender.
+//
+// Compile: gcc -O2 -pthread -o bench_recv bench_recv.c
+// Usage:   ./bench_recv [count] [interval_us] [receiver_cpu] [sender_cpu]
+
+#define BENCH_PORT 9189
+#define BENCH_INDEX 1
+#define BENCH_BUSY_POLL_US 50
+#define BENCH_VLEN 64
+
+#define BENCH_BLOCK 0
+#define BENCH_EPOLL 1
+#define BENCH_SPIN 2
+
+typedef struct
+{
+    int count;
+    int interval_us;
+    int cpu;
+} BenchSender;
+
+static LatencyHistogram wakeup;
+static volatile int received;
+
+static void on_bench_msg(Subscription *sub, const Msg *msg, void *ctx)
+{
+    hist_record(&wakeup, recv_timestamp_ns - msg->local_ns);
+    received++;
+}
+
+static void *sender_main(void *arg)
+{
+    BenchSender *s = (BenchSender *)arg;
+    pin_current_thread(s->cpu);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    to.sin_port = htons(BENCH_PORT);
+
+    Msg msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_type = 1;
+    msg.index = BENCH_INDEX;
+    long long next = get_current_timestamp_ns();
+    for (int i = 0; i < s->count; i++)
+    {
+        // Pace without sleeping, a sleeping sender would add its own wake-up jitter
+        next += s->interval_us * 1000LL;
+        while (get_current_timestamp_ns() < next)
+        {
+            sched_yield();
+        }
+        msg.sn_id = i + 1;
+        msg.local_ns = get_current_timestamp_ns();
+        sendto(fd, &msg, sizeof(msg), 0, (struct sockaddr *)&to, sizeof(to));
+    }
+    close(fd);
+    return NULL;
+}
+
+static int open_bench_socket()
+{
+    manager.socket = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(BENCH_PORT);
+    if (manager.socket < 0 || bind(manager.socket, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bench socket failed");
+        return -1;
+    }
+    // Lets the blocking mode notice the end of a run
+    struct timeval tv = {0, 100000};
+    setsockopt(manager.socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return 0;
+}
+
+static double thread_cpu_ms()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return ru.ru_utime.tv_sec * 1e3 + ru.ru_utime.tv_usec / 1e3 +
+           ru.ru_stime.tv_sec * 1e3 + ru.ru_stime.tv_usec / 1e3;
+}
+
+static void run_mode(const char *name, int mode, BenchSender *sender, const StreamHandlers *handlers)
+{
+    if (open_bench_socket() < 0)
+    {
+        exit(1);
+    }
+    // epoll waits in the kernel, then drains without blocking
+    set_receive_mode(mode == BENCH_BLOCK ? RECV_MODE_BLOCK : RECV_MODE_SPIN,
+                     mode == BENCH_SPIN ? BENCH_BUSY_POLL_US : 0);
+    int ep = -1;
+    if (mode == BENCH_EPOLL)
+    {
+        ep = epoll_create1(0);
+        struct epoll_event ev = {.events = EPOLLIN};
+        epoll_ctl(ep, EPOLL_CTL_ADD, manager.socket, &ev);
+    }
+
+    memset(&wakeup, 0, sizeof(wakeup));
+    memset(&manager.by_index[BENCH_INDEX]->seq, 0, sizeof(SeqTracker));
+    received = 0;
+    manager.batch.empty_polls = 0;
+    double cpu_start = thread_cpu_ms();
+    long long wall_start = get_current_timestamp_ns();
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, sender_main, sender);
+    // Stop when everything arrived or a second after the last send was due
+    long long deadline = wall_start + (long long)sender->count * sender->interval_us * 1000LL + 1000000000LL;
+    while (received < sender->count && get_current_timestamp_ns() < deadline)
+    {
+        if (ep >= 0)
+        {
+            struct epoll_event ev;
+            if (epoll_wait(ep, &ev, 1, 100) <= 0)
+            {
+                continue;
+            }
+        }
+        receive_batch(handlers);
+    }
+    pthread_join(thread, NULL);
+
+    double cpu_ms = thread_cpu_ms() - cpu_start;
+    double wall_ms = (get_current_timestamp_ns() - wall_start) / 1e6;
+    static HistogramSnapshot snap;
+    hist_snapshot(&wakeup, &snap);
+    printf("%-6s n=%-7lu lost=%-5d p50=%7.1f p99=%7.1f p999=%7.1f max=%8.1f us, cpu %5.1f%%\n",
+           name, snap.total, sender->count - received,
+           hist_percentile(&snap, 0.50) / 1e3,
+           hist_percentile(&snap, 0.99) / 1e3,
+           hist_percentile(&snap, 0.999) / 1e3,
+           snap.max / 1e3,
+           wall_ms > 0 ? 100.0 * cpu_ms / wall_ms : 0.0);
+
+    if (ep >= 0)
+    {
+        close(ep);
+    }
+    close(manager.socket);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchSender sender = {
+        .count = argc > 1 ? atoi(argv[1]) : 20000,
+        .interval_us = argc > 2 ? atoi(argv[2]) : 50,
+        .cpu = argc > 4 ? atoi(argv[4]) : -1,
+    };
+    int receiver_cpu = argc > 3 ? atoi(argv[3]) : -1;
+    pin_current_thread(receiver_cpu);
+
+    // Register the bench symbol (BENCH_INDEX) the way a subscription ack would
+    char ack[] = "1:bench:loopback";
+    add_subscripton(ack, sizeof(ack) - 1);
+    if (init_batch_receiver(BENCH_VLEN, 0) < 0)
+    {
+        return 1;
+    }
+    StreamHandlers handlers = {
+        .on_ticker = on_bench_msg,
+    };
+
+    printf("%d datagrams every %d us, receiver cpu %d, sender cpu %d\n",
+           sender.count, sender.interval_us, receiver_cpu, sender.cpu);
+    run_mode("block", BENCH_BLOCK, &sender, &handlers);
+    run_mode("epoll", BENCH_EPOLL, &sender, &handlers);
+    run_mode("spin", BENCH_SPIN, &sender, &handlers);
+
+    free_batch_receiver();
+    free_subscriptions();
+    return 0;
+}
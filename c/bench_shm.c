@@ -0,0 +1,221 @@
+#include "sdk.c"
+#include "shm_feed.c"
+
+// Publish + read cost of the shared-memory fan-out (shm_feed.c) within one
+// process, on a private segment. Before timing, the ring's wrap handling is
+// checked: records of mixed sizes are published and read back over many
+// laps and compared field by field, starting with a lap that leaves an
+// 8-byte tail, shorter than a record header, which the publisher must skip
+// without writing a marker. Guard pages behind the publisher's and the
+// reader's mappings turn any access past the ring into a fault.
+//
+// Compile: gcc -O2 -pthread -o bench_shm bench_shm.c -lrt
+// Usage:   ./bench_shm [records] [ring_kb]
+
+#define BENCH_SHM_NAME "/qtx_bench_shm"
+#define BENCH_CHECK_RECORDS 200000
+#define BENCH_MAX_LEVELS 400
+#define BENCH_BATCH 64
+
+static ShmPublisher pub;
+static ShmReader reader;
+static Msg2Level levels[2 * BENCH_MAX_LEVELS];
+// sn_id of the next record to publish and to read back
+static long next_sn = 1;
+static long expected_sn = 1;
+static unsigned long short_tails;
+static unsigned long marked_tails;
+static unsigned long mismatches;
+
+// Move a mapping in front of an inaccessible page; returns its new address
+static void *guard_mapping(void *base, size_t len)
+{
+    char *area = mmap(NULL, len + 4096, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED)
+    {
+        perror("guard mmap failed");
+        return base;
+    }
+    void *moved = mremap(base, len, len, MREMAP_MAYMOVE | MREMAP_FIXED, area);
+    if (moved == MAP_FAILED)
+    {
+        perror("guard mremap failed");
+        munmap(area, len + 4096);
+        return base;
+    }
+    return moved;
+}
+
+// Publish one record whose payload is derived from its sn_id; levels < 0
+// publishes a Msg, otherwise a depth snapshot with that many levels
+static void publish(int level_count)
+{
+    unsigned long capacity = pub.mask + 1;
+    unsigned long offset = pub.pos & pub.mask;
+    size_t payload = level_count < 0 ? sizeof(Msg) : sizeof(Msg2) + level_count * sizeof(Msg2Level);
+    unsigned long need = (sizeof(ShmRecord) + payload + 7) & ~7UL;
+    if (offset + need > capacity)
+    {
+        if (capacity - offset < sizeof(ShmRecord))
+        {
+            short_tails++;
+        }
+        else
+        {
+            marked_tails++;
+        }
+    }
+
+    long sn = next_sn++;
+    if (level_count < 0)
+    {
+        Msg msg = {1, 1, sn, sn, sn, sn, (double)sn, 1.0};
+        shm_publish(&pub, SHM_REC_MSG, &msg, sizeof(msg), NULL, 0);
+        return;
+    }
+    Msg2 msg2 = {2, 1, sn, sn, sn, sn, 0, level_count / 2, 0, level_count - level_count / 2};
+    for (int i = 0; i < level_count; i++)
+    {
+        levels[i].price = (double)(sn + i);
+        levels[i].size = (double)i;
+    }
+    shm_publish(&pub, SHM_REC_DEPTH, &msg2, sizeof(msg2), levels, level_count * sizeof(Msg2Level));
+}
+
+// Read everything published so far and check it against the sn_id sequence
+static void drain()
+{
+    ShmRecordView view;
+    int rc;
+    while ((rc = shm_reader_next(&reader, &view)) != 0)
+    {
+        if (rc < 0)
+        {
+            fprintf(stderr, "unexpected overrun at sn_id %ld\n", expected_sn);
+            mismatches++;
+            expected_sn = next_sn;
+            continue;
+        }
+        long sn = expected_sn++;
+        if (view.type == SHM_REC_MSG)
+        {
+            if (view.msg->msg_type != 1 || view.msg->sn_id != sn || view.msg->price != (double)sn)
+            {
+                mismatches++;
+            }
+            continue;
+        }
+        int count = view.msg2->asks_len + view.msg2->bids_len;
+        int bad = view.msg2->msg_type != 2 || view.msg2->sn_id != sn;
+        for (int i = 0; i < count && !bad; i++)
+        {
+            bad = view.levels[i].price != (double)(sn + i) || view.levels[i].size != (double)i;
+        }
+        mismatches += bad;
+    }
+}
+
+// Publish until the ring's remaining tail is exactly tail bytes (a
+// multiple of 8 below a Msg record), reading along
+static void leave_tail(unsigned long tail)
+{
+    const unsigned long msg_need = sizeof(ShmRecord) + sizeof(Msg);
+    const unsigned long level_need = sizeof(Msg2Level);
+    unsigned long capacity = pub.mask + 1;
+    for (;;)
+    {
+        unsigned long left = capacity - (pub.pos & pub.mask);
+        if (left == tail)
+        {
+            return;
+        }
+        // A depth record is a Msg record plus whole levels, so it can only
+        // close a gap that is a multiple of the level size
+        unsigned long gap = left - tail;
+        if (gap >= msg_need && (gap - msg_need) % level_need == 0)
+        {
+            unsigned long count = (gap - msg_need) / level_need;
+            publish(count < 2 * BENCH_MAX_LEVELS ? (int)count : 2 * BENCH_MAX_LEVELS - 1);
+        }
+        else
+        {
+            publish(-1);
+        }
+        drain();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    long records = argc > 1 ? atol(argv[1]) : 10000000;
+    unsigned long ring_bytes = (argc > 2 ? atol(argv[2]) : 256) * 1024UL;
+    if (shm_publisher_create(&pub, BENCH_SHM_NAME, ring_bytes, 16) < 0 ||
+        shm_reader_attach(&reader, BENCH_SHM_NAME) < 0)
+    {
+        return 1;
+    }
+    pub.hdr = guard_mapping(pub.hdr, pub.map_len);
+    pub.ring = (char *)pub.hdr + pub.hdr->ring_offset;
+    reader.hdr = guard_mapping((void *)reader.hdr, reader.map_len);
+    reader.ring = (const char *)reader.hdr + reader.hdr->ring_offset;
+
+    // 8 bytes left at the end of the ring: the next record wraps without a marker
+    leave_tail(8);
+    publish(-1);
+    drain();
+    if (short_tails != 1 || expected_sn != next_sn)
+    {
+        fprintf(stderr, "8-byte tail not skipped\n");
+        mismatches++;
+    }
+
+    // Random sizes over many laps, reading often enough never to be lapped
+    unsigned int seed = 1;
+    unsigned long unread = 0;
+    for (long i = 0; i < BENCH_CHECK_RECORDS; i++)
+    {
+        int level_count = rand_r(&seed) % 4 == 0 ? rand_r(&seed) % (2 * BENCH_MAX_LEVELS) : -1;
+        unsigned long before = pub.pos;
+        publish(level_count);
+        unread += pub.pos - before;
+        if (unread > ring_bytes / 4)
+        {
+            drain();
+            unread = 0;
+        }
+    }
+    drain();
+    printf("check: %ld records, %lu wraps with a marker, %lu short tails skipped, %lu mismatches\n",
+           next_sn - 1, marked_tails, short_tails, mismatches);
+    if (mismatches > 0 || short_tails < 2)
+    {
+        shm_reader_detach(&reader);
+        shm_publisher_destroy(&pub);
+        return 1;
+    }
+
+    // Publish and read Msg records in batches, as a reader keeping up would
+    ShmRecordView view;
+    Msg msg = {1, 1, 0, 0, 0, 0, 1.0, 1.0};
+    unsigned long read = 0;
+    long long start = get_current_timestamp_ns();
+    for (long i = 0; i < records; i += BENCH_BATCH)
+    {
+        for (int j = 0; j < BENCH_BATCH; j++)
+        {
+            msg.sn_id = i + j;
+            shm_publish(&pub, SHM_REC_MSG, &msg, sizeof(msg), NULL, 0);
+        }
+        while (shm_reader_next(&reader, &view) > 0)
+        {
+            read += view.msg->sn_id >= 0;
+        }
+    }
+    double ns = (double)(get_current_timestamp_ns() - start);
+    printf("publish + read: %.1f ns/record, %.1f M records/s, %lu read, %lu overruns\n", ns / read, read * 1e3 / ns,
+           read, reader.overruns);
+
+    shm_reader_detach(&reader);
+    shm_publisher_destroy(&pub);
+    return 0;
+}
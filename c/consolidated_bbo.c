@@ -0,0 +1,447 @@
+#ifndef QTX_CONSOLIDATED_BBO_C
+#define QTX_CONSOLIDATED_BBO_C
+
+#include "sdk.c"
+#include <ctype.h>
+#include <float.h>
+#include <math.h>
+
+// Consolidated top of book of one instrument across venues. Venue
+// symbols ("okx-swap:BTC-USDT-SWAP", "bybit:BTCUSDT", ...) are mapped to a
+// canonical instrument ("BTCUSDT"); each one owns a lane of fixed-width
+// arrays holding that venue's best bid and ask, and every L1 tick or
+// depth snapshot updates its lane and then the consolidated best: O(1)
+// when the venue improves on or keeps the best, otherwise one max/min
+// reduction over the BBO_MAX_VENUES lanes (contiguous doubles, no
+// branches on venue count, vectorised by the compiler). Empty lanes
+// hold a bid of 0 and an ask of DBL_MAX so they never win.
+//
+// Feed indexes are routed to lanes through a table filled when each
+// subscription is acknowledged (bbo_on_subscribe), so the per-message
+// lookup is two array reads and nothing is resolved on the data path.
+
+// Lanes per instrument; a multiple of the vector width
+#define BBO_MAX_VENUES 8
+#define BBO_VENUE_LEN 24
+
+// Bits returned by bbo_apply_*: which consolidated side changed (price,
+// size or venue)
+#define BBO_BID_CHANGED 1
+#define BBO_ASK_CHANGED 2
+
+typedef struct
+{
+    double bid[BBO_MAX_VENUES];
+    double ask[BBO_MAX_VENUES];
+    double bid_size[BBO_MAX_VENUES];
+    double ask_size[BBO_MAX_VENUES];
+    long local_ns[BBO_MAX_VENUES];
+    char venue[BBO_MAX_VENUES][BBO_VENUE_LEN];
+    int venue_count;
+    char symbol[MAX_SYMBOL_LEN];
+
+    // Consolidated top; venue -1 while no venue quotes that side
+    double best_bid;
+    double best_ask;
+    double best_bid_size;
+    double best_ask_size;
+    int best_bid_venue;
+    int best_ask_venue;
+
+    unsigned long updates;
+    unsigned long bid_changes;
+    unsigned long ask_changes;
+    // Updates that took the best venue's price away and needed a reduction
+    unsigned long rescans;
+    // Updates after which the best bid was at or above the best ask
+    unsigned long crossed;
+} __attribute__((aligned(64))) ConsolidatedBook;
+
+typedef struct
+{
+    char symbol[MAX_SYMBOL_LEN];
+    int book;
+    int venue;
+} BboMapping;
+
+typedef struct
+{
+    ConsolidatedBook *books;
+    int book_count;
+    int max_books;
+    BboMapping *mappings;
+    int mapping_count;
+    int max_mappings;
+    // Feed symbol index (Subscription.index) -> its mapping, NULL when the
+    // symbol is not consolidated; set by bbo_on_subscribe()
+    IndexTable routes;
+} BboRegistry;
+
+// Room for max_books instruments of up to BBO_MAX_VENUES venues each
+int bbo_init(BboRegistry *r, int max_books)
+{
+    memset(r, 0, sizeof(*r));
+    r->books = aligned_alloc(64, (size_t)max_books * sizeof(ConsolidatedBook));
+    r->mappings = calloc((size_t)max_books * BBO_MAX_VENUES, sizeof(BboMapping));
+    if (r->books == NULL || r->mappings == NULL)
+    {
+        perror("consolidated bbo allocation failed");
+        free(r->books);
+        free(r->mappings);
+        return -1;
+    }
+    r->max_books = max_books;
+    r->max_mappings = max_books * BBO_MAX_VENUES;
+    return 0;
+}
+
+void bbo_free(BboRegistry *r)
+{
+    free(r->books);
+    free(r->mappings);
+    index_table_free(&r->routes);
+    memset(r, 0, sizeof(*r));
+}
+
+static void bbo_book_init(ConsolidatedBook *book, const char *symbol)
+{
+    memset(book, 0, sizeof(*book));
+    snprintf(book->symbol, sizeof(book->symbol), "%s", symbol);
+    for (int i = 0; i < BBO_MAX_VENUES; i++)
+    {
+        book->ask[i] = DBL_MAX;
+    }
+    book->best_ask = DBL_MAX;
+    book->best_bid_venue = -1;
+    book->best_ask_venue = -1;
+}
+
+// Canonical instrument of a venue symbol: the part after "venue:",
+// upper-cased, without separators or a trailing "SWAP", and with KuCoin
+// futures' "XBT...M" spelled "BTC...". "okx-swap:BTC-USDT-SWAP",
+// "gate-io-futures:BTC_USDT" and "kucoin-futures:XBTUSDTM" all give
+// "BTCUSDT". Spot and futures of a pair map to the same name, so add only
+// the venues that should be consolidated together.
+void bbo_canonical_name(const char *venue_symbol, char *out, size_t len)
+{
+    const char *colon = strchr(venue_symbol, ':');
+    const char *p = colon != NULL ? colon + 1 : venue_symbol;
+    size_t n = 0;
+    for (; *p != '\0' && n + 1 < len; p++)
+    {
+        if (*p != '-' && *p != '_' && *p != '/')
+        {
+            out[n++] = (char)toupper((unsigned char)*p);
+        }
+    }
+    out[n] = '\0';
+    if (n > 4 && strcmp(out + n - 4, "SWAP") == 0)
+    {
+        out[n -= 4] = '\0';
+    }
+    if (colon != NULL && strncmp(venue_symbol, "kucoin-futures:", 15) == 0 && strncmp(out, "XBT", 3) == 0)
+    {
+        memcpy(out, "BTC", 3);
+        if (n > 0 && out[n - 1] == 'M')
+        {
+            out[--n] = '\0';
+        }
+    }
+}
+
+ConsolidatedBook *bbo_find(BboRegistry *r, const char *canonical)
+{
+    for (int i = 0; i < r->book_count; i++)
+    {
+        if (strcmp(r->books[i].symbol, canonical) == 0)
+        {
+            return &r->books[i];
+        }
+    }
+    return NULL;
+}
+
+// Route venue_symbol (as subscribed) to the instrument canonical, NULL
+// for bbo_canonical_name(). Returns the instrument's book, NULL if it is
+// full or the registry is. Mappings are matched when a symbol's
+// subscription is acknowledged, so add them all before receiving.
+ConsolidatedBook *bbo_add(BboRegistry *r, const char *venue_symbol, const char *canonical)
+{
+    char name[MAX_SYMBOL_LEN];
+    if (canonical == NULL)
+    {
+        bbo_canonical_name(venue_symbol, name, sizeof(name));
+        canonical = name;
+    }
+    ConsolidatedBook *book = bbo_find(r, canonical);
+    if (book == NULL && r->book_count < r->max_books)
+    {
+        book = &r->books[r->book_count++];
+        bbo_book_init(book, canonical);
+    }
+    if (book == NULL || book->venue_count == BBO_MAX_VENUES || r->mapping_count == r->max_mappings ||
+        strlen(venue_symbol) >= MAX_SYMBOL_LEN)
+    {
+        fprintf(stderr, "bbo: cannot add %s\n", venue_symbol);
+        return NULL;
+    }
+    int venue = book->venue_count++;
+    const char *colon = strchr(venue_symbol, ':');
+    int venue_len = colon != NULL ? (int)(colon - venue_symbol) : (int)strlen(venue_symbol);
+    snprintf(book->venue[venue], BBO_VENUE_LEN, "%.*s", venue_len, venue_symbol);
+
+    BboMapping *m = &r->mappings[r->mapping_count++];
+    snprintf(m->symbol, sizeof(m->symbol), "%s", venue_symbol);
+    m->book = (int)(book - r->books);
+    m->venue = venue;
+    return book;
+}
+
+// SubscriptionHook: route sub's index to the mapping of its symbol, or to
+// none. Register with add_subscription_hook(bbo_on_subscribe, r).
+int bbo_on_subscribe(Subscription *sub, void *ctx)
+{
+    BboRegistry *r = ctx;
+    BboMapping *mapping = NULL;
+    for (int i = 0; i < r->mapping_count; i++)
+    {
+        if (strcmp(r->mappings[i].symbol, sub->symbol) == 0)
+        {
+            mapping = &r->mappings[i];
+            break;
+        }
+    }
+    if (mapping == NULL && index_table_get(&r->routes, sub->index) == NULL)
+    {
+        return 0;
+    }
+    return index_table_set(&r->routes, sub->index, mapping);
+}
+
+// Lane of sub's symbol, NULL if it is not mapped
+static inline const BboMapping *bbo_route(BboRegistry *r, const Subscription *sub)
+{
+    return index_table_get(&r->routes, sub->index);
+}
+
+// First lane holding the largest value
+static inline int bbo_argmax(const double *v)
+{
+    double best = v[0];
+    for (int i = 1; i < BBO_MAX_VENUES; i++)
+    {
+        best = v[i] > best ? v[i] : best;
+    }
+    int at = 0;
+    for (int i = BBO_MAX_VENUES - 1; i >= 0; i--)
+    {
+        at = v[i] == best ? i : at;
+    }
+    return at;
+}
+
+static inline int bbo_argmin(const double *v)
+{
+    double best = v[0];
+    for (int i = 1; i < BBO_MAX_VENUES; i++)
+    {
+        best = v[i] < best ? v[i] : best;
+    }
+    int at = 0;
+    for (int i = BBO_MAX_VENUES - 1; i >= 0; i--)
+    {
+        at = v[i] == best ? i : at;
+    }
+    return at;
+}
+
+// Store venue's bid (a price <= 0 or size <= 0 clears it) and refresh the
+// consolidated bid. Returns BBO_BID_CHANGED or 0.
+static inline int bbo_set_bid(ConsolidatedBook *book, int venue, double price, double size)
+{
+    if (!(price > 0 && size > 0))
+    {
+        price = 0;
+        size = 0;
+    }
+    book->bid[venue] = price;
+    book->bid_size[venue] = size;
+
+    double old_price = book->best_bid;
+    double old_size = book->best_bid_size;
+    int old_venue = book->best_bid_venue;
+    if (price > book->best_bid || (venue == old_venue && price == book->best_bid))
+    {
+        book->best_bid = price;
+        book->best_bid_size = size;
+        book->best_bid_venue = venue;
+    }
+    else if (venue == old_venue)
+    {
+        int at = bbo_argmax(book->bid);
+        book->best_bid = book->bid[at];
+        book->best_bid_size = book->bid_size[at];
+        book->best_bid_venue = book->bid[at] > 0 ? at : -1;
+        book->rescans++;
+    }
+    else
+    {
+        return 0;
+    }
+    return book->best_bid != old_price || book->best_bid_size != old_size || book->best_bid_venue != old_venue
+               ? BBO_BID_CHANGED
+               : 0;
+}
+
+// Same for the ask side; a cleared ask is DBL_MAX
+static inline int bbo_set_ask(ConsolidatedBook *book, int venue, double price, double size)
+{
+    if (!(price > 0 && size > 0))
+    {
+        price = DBL_MAX;
+        size = 0;
+    }
+    book->ask[venue] = price;
+    book->ask_size[venue] = size;
+
+    double old_price = book->best_ask;
+    double old_size = book->best_ask_size;
+    int old_venue = book->best_ask_venue;
+    if (price < book->best_ask || (venue == old_venue && price == book->best_ask))
+    {
+        book->best_ask = price;
+        book->best_ask_size = size;
+        book->best_ask_venue = price < DBL_MAX ? venue : -1;
+    }
+    else if (venue == old_venue)
+    {
+        int at = bbo_argmin(book->ask);
+        book->best_ask = book->ask[at];
+        book->best_ask_size = book->ask_size[at];
+        book->best_ask_venue = book->ask[at] < DBL_MAX ? at : -1;
+        book->rescans++;
+    }
+    else
+    {
+        return 0;
+    }
+    return book->best_ask != old_price || book->best_ask_size != old_size || book->best_ask_venue != old_venue
+               ? BBO_ASK_CHANGED
+               : 0;
+}
+
+static inline int bbo_finish(ConsolidatedBook *book, int venue, long local_ns, int changed)
+{
+    book->local_ns[venue] = local_ns;
+    book->updates++;
+    book->bid_changes += changed & BBO_BID_CHANGED;
+    book->ask_changes += (changed & BBO_ASK_CHANGED) >> 1;
+    book->crossed += book->best_bid_venue >= 0 && book->best_ask_venue >= 0 && book->best_bid >= book->best_ask;
+    return changed;
+}
+
+// Apply an L1 tick (msg_type 1 bid, -1 ask). *out receives the
+// instrument's book when sub is mapped. Returns the BBO_*_CHANGED bits.
+int bbo_apply_l1(BboRegistry *r, const Subscription *sub, const Msg *msg, ConsolidatedBook **out)
+{
+    const BboMapping *route = bbo_route(r, sub);
+    if (route == NULL || (msg->msg_type != 1 && msg->msg_type != -1))
+    {
+        return 0;
+    }
+    ConsolidatedBook *book = &r->books[route->book];
+    if (out != NULL)
+    {
+        *out = book;
+    }
+    int changed = msg->msg_type == 1 ? bbo_set_bid(book, route->venue, msg->price, msg->size)
+                                     : bbo_set_ask(book, route->venue, msg->price, msg->size);
+    return bbo_finish(book, route->venue, msg->local_ns, changed);
+}
+
+// Apply the top of a depth snapshot (asks_len asks followed by bids_len
+// bids; the best of each side is taken, the feed need not sort them)
+int bbo_apply_depth(BboRegistry *r, const Subscription *sub, const Msg2 *msg2, const Msg2Level *levels,
+                    ConsolidatedBook **out)
+{
+    const BboMapping *route = bbo_route(r, sub);
+    if (route == NULL)
+    {
+        return 0;
+    }
+    ConsolidatedBook *book = &r->books[route->book];
+    if (out != NULL)
+    {
+        *out = book;
+    }
+    double ask = 0, ask_size = 0, bid = 0, bid_size = 0;
+    for (int i = 0; i < msg2->asks_len; i++)
+    {
+        if (levels[i].size > 0 && (ask_size == 0 || levels[i].price < ask))
+        {
+            ask = levels[i].price;
+            ask_size = levels[i].size;
+        }
+    }
+    const Msg2Level *bids = levels + msg2->asks_len;
+    for (int i = 0; i < msg2->bids_len; i++)
+    {
+        if (bids[i].size > 0 && bids[i].price > bid)
+        {
+            bid = bids[i].price;
+            bid_size = bids[i].size;
+        }
+    }
+    int changed = bbo_set_bid(book, route->venue, bid, bid_size) | bbo_set_ask(book, route->venue, ask, ask_size);
+    return bbo_finish(book, route->venue, msg2->local_ns, changed);
+}
+
+// Clear venues whose last update (local_ns) is older than max_age_ns, so
+// a stalled feed stops setting the consolidated price. Returns the
+// BBO_*_CHANGED bits.
+int bbo_expire(ConsolidatedBook *book, long long now_ns, long long max_age_ns)
+{
+    int changed = 0;
+    for (int i = 0; i < book->venue_count; i++)
+    {
+        if (now_ns - book->local_ns[i] > max_age_ns && (book->bid[i] > 0 || book->ask[i] < DBL_MAX))
+        {
+            changed |= bbo_set_bid(book, i, 0, 0) | bbo_set_ask(book, i, 0, 0);
+        }
+    }
+    return changed;
+}
+
+// Cross-venue spread, best ask minus best bid; negative when one venue's
+// bid is above another's ask. NAN while either side is empty.
+static inline double bbo_spread(const ConsolidatedBook *book)
+{
+    return book->best_bid_venue >= 0 && book->best_ask_venue >= 0 ? book->best_ask - book->best_bid : NAN;
+}
+
+static inline double bbo_mid(const ConsolidatedBook *book)
+{
+    return book->best_bid_venue >= 0 && book->best_ask_venue >= 0 ? (book->best_ask + book->best_bid) / 2 : NAN;
+}
+
+static inline const char *bbo_venue_name(const ConsolidatedBook *book, int venue)
+{
+    return venue >= 0 ? book->venue[venue] : "-";
+}
+
+void print_bbo_stats(const BboRegistry *r)
+{
+    printf("=== Consolidated BBO ===\n");
+    for (int i = 0; i < r->book_count; i++)
+    {
+        const ConsolidatedBook *book = &r->books[i];
+        printf("%s: bid %.8g (%s) / ask %.8g (%s), spread %.8g, %d venues\n", book->symbol, book->best_bid,
+               bbo_venue_name(book, book->best_bid_venue), book->best_ask_venue >= 0 ? book->best_ask : NAN,
+               bbo_venue_name(book, book->best_ask_venue), bbo_spread(book), book->venue_count);
+        printf("  updates %lu, bid changes %lu, ask changes %lu, rescans %lu, crossed %lu\n", book->updates,
+               book->bid_changes, book->ask_changes, book->rescans, book->crossed);
+    }
+    printf("========================\n");
+}
+
+#endif // QTX_CONSOLIDATED_BBO_C
@@ -0,0 +1,417 @@
+#ifndef QTX_HISTOGRAM_C
+#define QTX_HISTOGRAM_C
+
+#include "sdk.c"
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Log-linear latency histograms in the HdrHistogram layout: values below
+// 2^HIST_SUB_BITS get one bucket each, every power of two above that is
+// split into 2^HIST_SUB_BITS linear buckets, so the relative error stays
+// under 2^-HIST_SUB_BITS (about 3%) from nanoseconds up to 2^HIST_MAX_BITS
+// ns (~18 minutes). Recording is a bucket lookup and a relaxed increment:
+// no locks, no allocation, no division.
+#define HIST_SUB_BITS 5
+#define HIST_MAX_BITS 40
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+// Latency measured per message
+#define LAT_EXCHANGE 0 // exchange event_ms -> server local_ns
+#define LAT_WIRE 1     // server local_ns -> client receive
+#define LAT_HANDLER 2  // client receive -> handler done
+// Only with kernel RX timestamps (enable_rx_timestamps), splitting LAT_WIRE
+#define LAT_NETWORK 3  // server local_ns -> kernel RX timestamp
+#define LAT_QUEUE 4    // kernel RX timestamp -> client receive
+#define LAT_METRICS 5
+
+// Message kinds kept apart
+#define LAT_TICKER 0
+#define LAT_TRADE 1
+#define LAT_DEPTH 2
+#define LAT_TYPES 3
+
+// Written by one thread, read by any: each counter is only ever stored by
+// the recording thread, so relaxed load + store is enough and a concurrent
+// snapshot sees every bucket at some recent value.
+typedef struct
+{
+    _Atomic uint64_t counts[HIST_BUCKETS];
+    _Atomic uint64_t total;
+    // Negative samples (clock skew between hosts) land in bucket 0
+    _Atomic uint64_t negative;
+    _Atomic int64_t max;
+} LatencyHistogram;
+
+// Plain copy of a histogram, owned by the reader
+typedef struct
+{
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t negative;
+    int64_t max;
+} HistogramSnapshot;
+
+static inline int hist_bucket(int64_t value)
+{
+    if (value < HIST_SUB_COUNT)
+    {
+        return value < 0 ? 0 : (int)value;
+    }
+    int msb = 63 - __builtin_clzll((uint64_t)value);
+    if (msb >= HIST_MAX_BITS)
+    {
+        return HIST_BUCKETS - 1;
+    }
+    int shift = msb - HIST_SUB_BITS;
+    return ((shift + 1) << HIST_SUB_BITS) + (int)((value >> shift) - HIST_SUB_COUNT);
+}
+
+// Largest value that maps to bucket
+static inline int64_t hist_bucket_value(int bucket)
+{
+    if (bucket < HIST_SUB_COUNT)
+    {
+        return bucket;
+    }
+    int shift = (bucket >> HIST_SUB_BITS) - 1;
+    int64_t base = (int64_t)(HIST_SUB_COUNT + (bucket & (HIST_SUB_COUNT - 1))) << shift;
+    return base + ((int64_t)1 << shift) - 1;
+}
+
+static inline void hist_bump(_Atomic uint64_t *counter)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+// Single-writer record
+static inline void hist_record(LatencyHistogram *h, int64_t value)
+{
+    hist_bump(&h->counts[hist_bucket(value)]);
+    hist_bump(&h->total);
+    if (value < 0)
+    {
+        hist_bump(&h->negative);
+    }
+    else if (value > atomic_load_explicit(&h->max, memory_order_relaxed))
+    {
+        atomic_store_explicit(&h->max, value, memory_order_relaxed);
+    }
+}
+
+void hist_snapshot(const LatencyHistogram *h, HistogramSnapshot *out)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+    {
+        out->counts[i] = atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+        total += out->counts[i];
+    }
+    // Sum of the copied buckets, so percentiles stay consistent with them
+    out->total = total;
+    out->negative = atomic_load_explicit(&h->negative, memory_order_relaxed);
+    out->max = atomic_load_explicit(&h->max, memory_order_relaxed);
+}
+
+// Samples recorded between prev and cur. The exact max is not tracked per
+// interval, it is the upper bound of the highest non-empty bucket instead.
+void hist_diff(HistogramSnapshot *out, const HistogramSnapshot *cur, const HistogramSnapshot *prev)
+{
+    out->total = 0;
+    out->max = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+    {
+        out->counts[i] = cur->counts[i] - prev->counts[i];
+        if (out->counts[i] != 0)
+        {
+            out->total += out->counts[i];
+            out->max = hist_bucket_value(i);
+        }
+    }
+    out->negative = cur->negative - prev->negative;
+    if (out->max > cur->max)
+    {
+        out->max = cur->max;
+    }
+}
+
+// Value at quantile q (0..1), reported as its bucket's upper bound
+int64_t hist_percentile(const HistogramSnapshot *s, double q)
+{
+    if (s->total == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * s->total + 0.5);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += s->counts[i];
+        if (seen >= rank)
+        {
+            int64_t value = hist_bucket_value(i);
+            return value < s->max ? value : s->max;
+        }
+    }
+    return s->max;
+}
+
+// Histograms of one symbol. prev is the reporter's copy from its last
+// interval and is never touched by the recording thread.
+typedef struct SymbolLatency
+{
+    char symbol[MAX_SYMBOL_LEN];
+    LatencyHistogram hist[LAT_TYPES][LAT_METRICS];
+    HistogramSnapshot prev[LAT_TYPES][LAT_METRICS];
+    // Next entry replaced by a later symbol on the same index
+    struct SymbolLatency *retired;
+} SymbolLatency;
+
+// Per-symbol histograms addressed by subscription index. Entries are
+// allocated by latency_on_subscribe() on the thread processing acks, so
+// recording never allocates, and the table grows with the subscriptions
+// without moving, so a reporter thread can walk it at any time.
+typedef struct
+{
+    IndexTable slots;
+    // Entries of reused indexes; the recording thread may still hold one,
+    // so they live until latency_free()
+    SymbolLatency *retired;
+    // Messages of symbols without an entry
+    _Atomic uint64_t untracked;
+} LatencyRegistry;
+
+int latency_init(LatencyRegistry *r)
+{
+    memset(&r->slots, 0, sizeof(r->slots));
+    r->retired = NULL;
+    atomic_init(&r->untracked, 0);
+    return 0;
+}
+
+// SubscriptionHook: give sub's index an entry for its symbol.
+// Register with add_subscription_hook(latency_on_subscribe, r).
+int latency_on_subscribe(Subscription *sub, void *ctx)
+{
+    LatencyRegistry *r = ctx;
+    SymbolLatency *old = index_table_get(&r->slots, sub->index);
+    if (old != NULL && strcmp(old->symbol, sub->symbol) == 0)
+    {
+        return 0;
+    }
+    SymbolLatency *s = calloc(1, sizeof(SymbolLatency));
+    if (s == NULL)
+    {
+        perror("latency histogram allocation failed");
+        return -1;
+    }
+    snprintf(s->symbol, sizeof(s->symbol), "%s", sub->symbol);
+    if (index_table_set(&r->slots, sub->index, s) < 0)
+    {
+        free(s);
+        return -1;
+    }
+    if (old != NULL)
+    {
+        old->retired = r->retired;
+        r->retired = old;
+    }
+    return 0;
+}
+
+void latency_free(LatencyRegistry *r)
+{
+    unsigned int i = 0;
+    for (SymbolLatency *s; (s = index_table_next(&r->slots, &i)) != NULL; i++)
+    {
+        free(s);
+    }
+    while (r->retired != NULL)
+    {
+        SymbolLatency *next = r->retired->retired;
+        free(r->retired);
+        r->retired = next;
+    }
+    index_table_free(&r->slots);
+}
+
+// msg_type 1/-1 ticker, 3/-3 trade, 2 depth
+static inline int latency_type_of(int msg_type)
+{
+    if (msg_type == 1 || msg_type == -1)
+    {
+        return LAT_TICKER;
+    }
+    return msg_type == 2 ? LAT_DEPTH : LAT_TRADE;
+}
+
+static inline SymbolLatency *latency_slot(LatencyRegistry *r, const Subscription *sub)
+{
+    return index_table_get(&r->slots, sub->index);
+}
+
+// Record the exchange and wire legs of one message. recv_ns is the
+// client's receive time and kernel_ns the kernel RX timestamp or 0
+// (recv_timestamp_ns / recv_kernel_ns on the dispatching thread).
+static inline void latency_record_arrival(LatencyRegistry *r, const Subscription *sub, int msg_type,
+                                          long event_ms, long local_ns, long long recv_ns,
+                                          long long kernel_ns)
+{
+    SymbolLatency *s = latency_slot(r, sub);
+    if (s == NULL)
+    {
+        hist_bump(&r->untracked);
+        return;
+    }
+    LatencyHistogram *h = s->hist[latency_type_of(msg_type)];
+    // Some feeds leave event_ms unset
+    if (event_ms > 0)
+    {
+        hist_record(&h[LAT_EXCHANGE], local_ns - event_ms * 1000000L);
+    }
+    hist_record(&h[LAT_WIRE], recv_ns - local_ns);
+    if (kernel_ns > 0)
+    {
+        hist_record(&h[LAT_NETWORK], kernel_ns - local_ns);
+        hist_record(&h[LAT_QUEUE], recv_ns - kernel_ns);
+    }
+}
+
+// Record receive -> handler done for one message
+static inline void latency_record_handler(LatencyRegistry *r, const Subscription *sub, int msg_type,
+                                          long long recv_ns, long long done_ns)
+{
+    SymbolLatency *s = latency_slot(r, sub);
+    if (s != NULL)
+    {
+        hist_record(&s->hist[latency_type_of(msg_type)][LAT_HANDLER], done_ns - recv_ns);
+    }
+}
+
+// Cumulative snapshot of one histogram; 0 if the symbol has no samples yet
+int latency_snapshot(LatencyRegistry *r, unsigned int index, int type, int metric, HistogramSnapshot *out)
+{
+    SymbolLatency *s = index_table_get(&r->slots, index);
+    if (s == NULL)
+    {
+        return 0;
+    }
+    hist_snapshot(&s->hist[type][metric], out);
+    return 1;
+}
+
+static const char *latency_type_names[LAT_TYPES] = {"ticker", "trade", "depth"};
+static const char *latency_metric_names[LAT_METRICS] = {"exchange", "wire", "handler", "network", "queue"};
+
+// One line per non-empty histogram, values in microseconds:
+// <unix_ms> <symbol> <type> <metric> n=.. p50=.. p99=.. p999=.. max=.. neg=..
+// interval = 1 reports samples since the previous interval dump (only one
+// thread may dump intervals), 0 reports everything since start.
+void latency_dump(LatencyRegistry *r, FILE *out, int interval)
+{
+    static HistogramSnapshot cur, diff;
+    long long now_ms = get_current_timestamp_ns() / 1000000LL;
+    unsigned int i = 0;
+    for (SymbolLatency *s; (s = index_table_next(&r->slots, &i)) != NULL; i++)
+    {
+        for (int t = 0; t < LAT_TYPES; t++)
+        {
+            for (int m = 0; m < LAT_METRICS; m++)
+            {
+                hist_snapshot(&s->hist[t][m], &cur);
+                const HistogramSnapshot *view = &cur;
+                if (interval)
+                {
+                    hist_diff(&diff, &cur, &s->prev[t][m]);
+                    s->prev[t][m] = cur;
+                    view = &diff;
+                }
+                if (view->total == 0)
+                {
+                    continue;
+                }
+                fprintf(out, "%lld %s %s %s n=%lu p50=%.1f p99=%.1f p999=%.1f max=%.1f neg=%lu\n",
+                        now_ms, s->symbol, latency_type_names[t], latency_metric_names[m],
+                        view->total,
+                        hist_percentile(view, 0.50) / 1e3,
+                        hist_percentile(view, 0.99) / 1e3,
+                        hist_percentile(view, 0.999) / 1e3,
+                        view->max / 1e3,
+                        view->negative);
+            }
+        }
+    }
+    uint64_t untracked = atomic_load_explicit(&r->untracked, memory_order_relaxed);
+    if (untracked != 0)
+    {
+        fprintf(out, "%lld untracked n=%lu\n", now_ms, untracked);
+    }
+    fflush(out);
+}
+
+// Background thread that appends an interval dump every period_sec seconds
+typedef struct
+{
+    LatencyRegistry *registry;
+    FILE *out;
+    int period_sec;
+    pthread_t thread;
+} LatencyReporter;
+
+static void *latency_reporter_main(void *arg)
+{
+    LatencyReporter *rep = (LatencyReporter *)arg;
+    while (running)
+    {
+        // Sleep in short steps so shutdown is not delayed by a whole period
+        for (int i = 0; i < rep->period_sec * 10 && running; i++)
+        {
+            usleep(100000);
+        }
+        latency_dump(rep->registry, rep->out, 1);
+    }
+    return NULL;
+}
+
+// path NULL or "-" writes to stdout
+int start_latency_reporter(LatencyReporter *rep, LatencyRegistry *r, const char *path, int period_sec)
+{
+    rep->registry = r;
+    rep->period_sec = period_sec > 0 ? period_sec : 1;
+    rep->out = stdout;
+    if (path != NULL && strcmp(path, "-") != 0)
+    {
+        rep->out = fopen(path, "a");
+        if (rep->out == NULL)
+        {
+            perror("latency dump open failed");
+            return -1;
+        }
+    }
+    if (pthread_create(&rep->thread, NULL, latency_reporter_main, rep) != 0)
+    {
+        perror("latency reporter start failed");
+        if (rep->out != stdout)
+        {
+            fclose(rep->out);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+void stop_latency_reporter(LatencyReporter *rep)
+{
+    pthread_join(rep->thread, NULL);
+    if (rep->out != stdout)
+    {
+        fclose(rep->out);
+    }
+}
+
+#endif // QTX_HISTOGRAM_C
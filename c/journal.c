@@ -0,0 +1,462 @@
+#ifndef QTX_JOURNAL_C
+#define QTX_JOURNAL_C
+
+#include "sdk.c"
+#include <stdint.h>
+#include <sys/stat.h>
+
+// Binary capture of raw feed datagrams. Every capture is a run of
+// pre-allocated, mmap'd segment files <prefix>-rNNNN-000000.qj, -000001.qj,
+// ... Appending is a single memcpy into the mapping: no formatting and no
+// write() per datagram. Segments rotate when full and are trimmed to their
+// used length by a helper thread, which also maps the next one in advance.
+
+#define JOURNAL_MAGIC 0x314c4e524a585451UL // "QTXJRNL1"
+#define JOURNAL_VERSION 1
+// Runs of one prefix are numbered <prefix>-r0000, -r0001, ...
+#define JOURNAL_MAX_RUNS 10000
+
+typedef struct
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t segment;
+    uint64_t segment_bytes;
+    // Bytes of records following the header
+    uint64_t used;
+    int64_t created_ns;
+    // Same in every segment of one run (its start time), 0 before runs
+    uint64_t run_id;
+    uint64_t reserved;
+} JournalSegmentHeader;
+
+// Precedes every captured datagram; the payload is padded to 8 bytes
+typedef struct
+{
+    uint32_t len;
+    uint16_t src_port;
+    uint16_t flags;
+    int64_t recv_ns;
+} JournalRecord;
+
+// One mapped segment file
+typedef struct
+{
+    int fd;
+    char *base;
+    unsigned long segment;
+} JournalSegment;
+
+typedef struct
+{
+    // Prefix of this run, <prefix>-rNNNN
+    char prefix[256];
+    unsigned long segment_bytes;
+    uint64_t run_id;
+    unsigned long segment;
+    int fd;
+    char *base;
+    JournalSegmentHeader *hdr;
+    unsigned long offset;
+    unsigned long records;
+    unsigned long bytes;
+    unsigned long rotations;
+    unsigned long drops;
+    // Rotations that had to wait for the next segment
+    unsigned long stalls;
+
+    // The helper thread maps the next segment ahead of time and trims and
+    // closes full ones, so rotating on the receive thread only swaps
+    // pointers. Both hand-offs go through lock.
+    pthread_t helper;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t ready;
+    int stop;
+    // spare: mapped and waiting; spare_state is one of JOURNAL_SPARE_*
+    JournalSegment spare;
+    int spare_state;
+    // retired: full segment and its used length, to be trimmed and closed
+    JournalSegment retired;
+    unsigned long retired_used;
+    int retire_pending;
+} Journal;
+
+#define JOURNAL_SPARE_WANTED 0
+#define JOURNAL_SPARE_READY 1
+#define JOURNAL_SPARE_FAILED 2
+
+typedef struct
+{
+    char prefix[256];
+    unsigned long segment;
+    uint64_t run_id;
+    char *base;
+    size_t map_len;
+    unsigned long offset;
+    unsigned long end;
+} JournalReader;
+
+static void journal_segment_path(char *path, size_t size, const char *prefix, unsigned long segment)
+{
+    snprintf(path, size, "%s-%06lu.qj", prefix, segment);
+}
+
+// Create, reserve and map one segment file of j's run
+static int journal_map_segment(const Journal *j, unsigned long segment, JournalSegment *seg)
+{
+    char path[320];
+    journal_segment_path(path, sizeof(path), j->prefix, segment);
+    int fd = open(path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        perror("journal open failed");
+        return -1;
+    }
+    // Reserve the blocks up front so appends never hit ENOSPC via SIGBUS
+    int err = posix_fallocate(fd, 0, j->segment_bytes);
+    if (err != 0)
+    {
+        fprintf(stderr, "journal fallocate failed: %s\n", strerror(err));
+        close(fd);
+        return -1;
+    }
+    // No MAP_POPULATE: pre-faulting a whole segment costs as much as the
+    // writes it saves, first-touch faults spread that cost instead
+    char *base = mmap(NULL, j->segment_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        perror("journal mmap failed");
+        close(fd);
+        return -1;
+    }
+
+    JournalSegmentHeader *hdr = (JournalSegmentHeader *)base;
+    hdr->magic = JOURNAL_MAGIC;
+    hdr->version = JOURNAL_VERSION;
+    hdr->header_size = sizeof(JournalSegmentHeader);
+    hdr->segment = segment;
+    hdr->segment_bytes = j->segment_bytes;
+    hdr->used = 0;
+    hdr->created_ns = get_current_timestamp_ns();
+    hdr->run_id = j->run_id;
+    seg->fd = fd;
+    seg->base = base;
+    seg->segment = segment;
+    return 0;
+}
+
+// Trim a segment to its used length and close it; unused spares are removed
+static void journal_unmap_segment(const Journal *j, JournalSegment *seg, unsigned long used, int remove)
+{
+    if (seg->base == NULL)
+    {
+        return;
+    }
+    munmap(seg->base, j->segment_bytes);
+    if (remove)
+    {
+        char path[320];
+        journal_segment_path(path, sizeof(path), j->prefix, seg->segment);
+        unlink(path);
+    }
+    else if (ftruncate(seg->fd, used) < 0)
+    {
+        perror("journal trim failed");
+    }
+    close(seg->fd);
+    seg->base = NULL;
+}
+
+static void journal_use_segment(Journal *j, const JournalSegment *seg)
+{
+    j->fd = seg->fd;
+    j->base = seg->base;
+    j->segment = seg->segment;
+    j->hdr = (JournalSegmentHeader *)j->base;
+    j->hdr->created_ns = get_current_timestamp_ns();
+    j->offset = sizeof(JournalSegmentHeader);
+}
+
+static void *journal_helper_main(void *arg)
+{
+    Journal *j = (Journal *)arg;
+    pthread_mutex_lock(&j->lock);
+    while (!j->stop)
+    {
+        if (j->retire_pending)
+        {
+            JournalSegment seg = j->retired;
+            unsigned long used = j->retired_used;
+            j->retire_pending = 0;
+            pthread_mutex_unlock(&j->lock);
+            journal_unmap_segment(j, &seg, used, 0);
+            pthread_mutex_lock(&j->lock);
+        }
+        else if (j->spare_state == JOURNAL_SPARE_WANTED)
+        {
+            unsigned long segment = j->segment + 1;
+            pthread_mutex_unlock(&j->lock);
+            JournalSegment seg;
+            int err = journal_map_segment(j, segment, &seg);
+            pthread_mutex_lock(&j->lock);
+            j->spare = seg;
+            j->spare_state = err < 0 ? JOURNAL_SPARE_FAILED : JOURNAL_SPARE_READY;
+            pthread_cond_signal(&j->ready);
+        }
+        else
+        {
+            pthread_cond_wait(&j->wake, &j->lock);
+        }
+    }
+    pthread_mutex_unlock(&j->lock);
+    return NULL;
+}
+
+// Start a new run of prefix: its segments are <prefix>-rNNNN-000000.qj, ...
+// with NNNN the first run number not taken yet, so every capture replays
+// on its own (./replay <prefix>-rNNNN)
+int journal_open(Journal *j, const char *prefix, unsigned long segment_bytes)
+{
+    memset(j, 0, sizeof(*j));
+    j->segment_bytes = segment_bytes;
+    if (segment_bytes < sizeof(JournalSegmentHeader) + sizeof(JournalRecord) + UDP_SIZE)
+    {
+        fprintf(stderr, "journal segment size %lu is too small\n", segment_bytes);
+        return -1;
+    }
+
+    char path[320];
+    for (unsigned long run = 0;; run++)
+    {
+        if (run == JOURNAL_MAX_RUNS)
+        {
+            fprintf(stderr, "journal %s has no free run number\n", prefix);
+            return -1;
+        }
+        snprintf(j->prefix, sizeof(j->prefix), "%s-r%04lu", prefix, run);
+        journal_segment_path(path, sizeof(path), j->prefix, 0);
+        if (access(path, F_OK) != 0)
+        {
+            break;
+        }
+    }
+    j->run_id = (uint64_t)get_current_timestamp_ns();
+
+    JournalSegment seg;
+    if (journal_map_segment(j, 0, &seg) < 0)
+    {
+        return -1;
+    }
+    journal_use_segment(j, &seg);
+
+    pthread_mutex_init(&j->lock, NULL);
+    pthread_cond_init(&j->wake, NULL);
+    pthread_cond_init(&j->ready, NULL);
+    j->spare_state = JOURNAL_SPARE_WANTED;
+    int err = pthread_create(&j->helper, NULL, journal_helper_main, j);
+    if (err != 0)
+    {
+        fprintf(stderr, "pthread_create failed: %s\n", strerror(err));
+        journal_unmap_segment(j, &seg, j->offset, 0);
+        j->base = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void journal_close(Journal *j)
+{
+    if (j->base == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&j->lock);
+    j->stop = 1;
+    pthread_cond_signal(&j->wake);
+    pthread_mutex_unlock(&j->lock);
+    pthread_join(j->helper, NULL);
+
+    if (j->retire_pending)
+    {
+        journal_unmap_segment(j, &j->retired, j->retired_used, 0);
+    }
+    if (j->spare_state == JOURNAL_SPARE_READY)
+    {
+        journal_unmap_segment(j, &j->spare, 0, 1);
+    }
+    JournalSegment seg = {j->fd, j->base, j->segment};
+    journal_unmap_segment(j, &seg, j->offset, 0);
+    j->base = NULL;
+    j->hdr = NULL;
+    pthread_mutex_destroy(&j->lock);
+    pthread_cond_destroy(&j->wake);
+    pthread_cond_destroy(&j->ready);
+}
+
+// Switch to the segment the helper prepared and hand it the full one.
+// Waits only if the helper has not finished mapping it yet.
+static int journal_rotate(Journal *j)
+{
+    pthread_mutex_lock(&j->lock);
+    if (j->spare_state == JOURNAL_SPARE_WANTED)
+    {
+        j->stalls++;
+        while (j->spare_state == JOURNAL_SPARE_WANTED)
+        {
+            pthread_cond_wait(&j->ready, &j->lock);
+        }
+    }
+    if (j->spare_state == JOURNAL_SPARE_FAILED)
+    {
+        // Retry on the next append
+        j->spare_state = JOURNAL_SPARE_WANTED;
+        pthread_cond_signal(&j->wake);
+        pthread_mutex_unlock(&j->lock);
+        return -1;
+    }
+    // The helper retires before it maps, so a ready spare means the
+    // previous retirement is done
+    j->retired = (JournalSegment){j->fd, j->base, j->segment};
+    j->retired_used = j->offset;
+    j->retire_pending = 1;
+    journal_use_segment(j, &j->spare);
+    j->spare_state = JOURNAL_SPARE_WANTED;
+    j->rotations++;
+    pthread_cond_signal(&j->wake);
+    pthread_mutex_unlock(&j->lock);
+    return 0;
+}
+
+// Append one datagram, rotating to the next segment when this one is full
+int journal_append(Journal *j, const char *buf, int len, unsigned short src_port, long long recv_ns)
+{
+    unsigned long need = (sizeof(JournalRecord) + (unsigned long)len + 7) & ~7UL;
+    if (j->offset + need > j->segment_bytes && journal_rotate(j) < 0)
+    {
+        j->drops++;
+        return -1;
+    }
+
+    JournalRecord *rec = (JournalRecord *)(j->base + j->offset);
+    rec->len = (uint32_t)len;
+    rec->src_port = src_port;
+    rec->flags = 0;
+    rec->recv_ns = recv_ns;
+    memcpy(rec + 1, buf, len);
+    j->offset += need;
+    j->hdr->used = j->offset - sizeof(JournalSegmentHeader);
+    j->records++;
+    j->bytes += len;
+    return 0;
+}
+
+// DatagramHook adapter: set_datagram_hook(journal_capture, &journal)
+void journal_capture(const char *buf, int len, unsigned short src_port, long long recv_ns, void *ctx)
+{
+    journal_append((Journal *)ctx, buf, len, src_port, recv_ns);
+}
+
+static int journal_reader_map(JournalReader *r)
+{
+    char path[320];
+    journal_segment_path(path, sizeof(path), r->prefix, r->segment);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(JournalSegmentHeader))
+    {
+        close(fd);
+        return -1;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    const JournalSegmentHeader *hdr = (const JournalSegmentHeader *)base;
+    if (hdr->magic != JOURNAL_MAGIC || hdr->version != JOURNAL_VERSION)
+    {
+        fprintf(stderr, "%s is not a journal segment\n", path);
+        munmap(base, st.st_size);
+        return -1;
+    }
+    // A later segment left over from another capture under the same name
+    // ends this one
+    if (r->segment == 0)
+    {
+        r->run_id = hdr->run_id;
+    }
+    else if (hdr->run_id != r->run_id || hdr->segment != r->segment)
+    {
+        fprintf(stderr, "%s belongs to another capture, stopping before it\n", path);
+        munmap(base, st.st_size);
+        return -1;
+    }
+    r->base = base;
+    r->map_len = st.st_size;
+    r->offset = hdr->header_size;
+    r->end = hdr->header_size + hdr->used;
+    if (r->end > r->map_len)
+    {
+        r->end = r->map_len;
+    }
+    return 0;
+}
+
+// Open a run (<prefix>-rNNNN, or a journal written before runs) at its
+// first segment
+int journal_reader_open(JournalReader *r, const char *prefix)
+{
+    memset(r, 0, sizeof(*r));
+    snprintf(r->prefix, sizeof(r->prefix), "%s", prefix);
+    if (journal_reader_map(r) < 0)
+    {
+        fprintf(stderr, "cannot open journal %s\n", prefix);
+        return -1;
+    }
+    return 0;
+}
+
+void journal_reader_close(JournalReader *r)
+{
+    if (r->base != NULL)
+    {
+        munmap(r->base, r->map_len);
+        r->base = NULL;
+    }
+}
+
+// Next record in capture order, continuing across segments. Returns the
+// record (payload follows it in the mapping) or NULL at the end.
+const JournalRecord *journal_reader_next(JournalReader *r)
+{
+    while (r->base != NULL)
+    {
+        if (r->offset + sizeof(JournalRecord) <= r->end)
+        {
+            const JournalRecord *rec = (const JournalRecord *)(r->base + r->offset);
+            unsigned long size = (sizeof(JournalRecord) + rec->len + 7) & ~7UL;
+            if (r->offset + size <= r->end)
+            {
+                r->offset += size;
+                return rec;
+            }
+        }
+        journal_reader_close(r);
+        r->segment++;
+        if (journal_reader_map(r) < 0)
+        {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+#endif // QTX_JOURNAL_C
@@ -0,0 +1,331 @@
+#ifndef QTX_ORDER_ENCODER_C
+#define QTX_ORDER_ENCODER_C
+
+#include "sdk.c"
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+
+// Allocation-free order encoding. A template per (account, symbol) holds
+// the constant bytes of the place and cancel requests; encoding an order
+// writes idx into headroom in front of them, rewrites the fixed-width
+// client_order_id counter in place and appends the variable tail with
+// integer and fixed-point writers. No snprintf, no floating point
+// formatting, no format string parsing.
+
+#define ORDER_TEMPLATE_MAX 256
+// Room in front of the constant bytes for the longest idx (INT_MAX)
+#define ORDER_IDX_HEADROOM 10
+// Digits of the client_order_id counter
+#define ORDER_CID_DIGITS 10
+// Largest counter that fits them; order_template_next_cid stops after it
+#define ORDER_CID_LAST 9999999999ULL
+#define ORDER_CID_EXHAUSTED ULLONG_MAX
+// Longest client_order_id (prefix + counter) every exchange accepts:
+// Gate.io's 30 ("t-" included), OKX allows 32, Binance and Bybit 36
+#define ORDER_CID_MAX 30
+#define ORDER_MAX_DECIMALS 12
+
+// Optional fields of place/cancel requests, depending on the exchange
+#define ORDER_FIELD_ACCOUNT 1
+#define ORDER_FIELD_POS_SIDE 2
+
+static const char order_digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const long long order_pow10[ORDER_MAX_DECIMALS + 1] = {
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL,
+    100000000LL, 1000000000LL, 10000000000LL, 100000000000LL, 1000000000000LL};
+
+// Write v backwards so that its last digit lands at end[-1]; returns the
+// first digit
+static inline char *fmt_uint_rev(char *end, unsigned long long v)
+{
+    while (v >= 100)
+    {
+        unsigned int pair = (unsigned int)(v % 100) * 2;
+        v /= 100;
+        *--end = order_digit_pairs[pair + 1];
+        *--end = order_digit_pairs[pair];
+    }
+    if (v >= 10)
+    {
+        *--end = order_digit_pairs[v * 2 + 1];
+        *--end = order_digit_pairs[v * 2];
+    }
+    else
+    {
+        *--end = (char)('0' + v);
+    }
+    return end;
+}
+
+// Write v at out; returns the number of bytes
+static inline int fmt_uint(char *out, unsigned long long v)
+{
+    char tmp[20];
+    char *start = fmt_uint_rev(tmp + sizeof(tmp), v);
+    int len = (int)(tmp + sizeof(tmp) - start);
+    memcpy(out, start, len);
+    return len;
+}
+
+static inline int fmt_int(char *out, long long v)
+{
+    if (v < 0)
+    {
+        *out = '-';
+        return 1 + fmt_uint(out + 1, 0ULL - (unsigned long long)v);
+    }
+    return fmt_uint(out, (unsigned long long)v);
+}
+
+// Write units * 10^-decimals with exactly decimals fraction digits
+static inline int fmt_fixed(char *out, long long units, int decimals)
+{
+    char *p = out;
+    unsigned long long u = (unsigned long long)units;
+    if (units < 0)
+    {
+        *p++ = '-';
+        u = 0ULL - u;
+    }
+    if (decimals <= 0)
+    {
+        return (int)(p - out) + fmt_uint(p, u);
+    }
+    unsigned long long scale = (unsigned long long)order_pow10[decimals];
+    p += fmt_uint(p, u / scale);
+    *p++ = '.';
+    unsigned long long frac = u % scale;
+    for (int i = decimals - 1; i >= 0; i--)
+    {
+        p[i] = (char)('0' + frac % 10);
+        frac /= 10;
+    }
+    return (int)(p - out) + decimals;
+}
+
+// Like fmt_fixed but drops trailing fraction zeros (and the point)
+static inline int fmt_fixed_trim(char *out, long long units, int decimals)
+{
+    int len = fmt_fixed(out, units, decimals);
+    if (decimals > 0)
+    {
+        while (out[len - 1] == '0')
+        {
+            len--;
+        }
+        if (out[len - 1] == '.')
+        {
+            len--;
+        }
+    }
+    return len;
+}
+
+// Round to nearest without libm; inputs are far below 2^63
+static inline long long order_round(double x)
+{
+    return (long long)(x >= 0 ? x + 0.5 : x - 0.5);
+}
+
+// Smallest number of decimals that represents step exactly, -1 if none
+static int order_step_decimals(double step)
+{
+    for (int d = 0; d <= ORDER_MAX_DECIMALS; d++)
+    {
+        double scaled = step * order_pow10[d];
+        if (fabs(scaled - order_round(scaled)) < 1e-9 * scaled)
+        {
+            return d;
+        }
+    }
+    return -1;
+}
+
+// Constant parts of one (account, symbol)'s requests:
+// place:  [idx headroom]",1,account,symbol,"cid_prefix[counter]  + tail
+// cancel: [idx headroom]",-1,account,symbol,"cid_prefix[counter]
+// where "account," and the tail's pos_side are present only if fields
+// has ORDER_FIELD_ACCOUNT / ORDER_FIELD_POS_SIDE
+typedef struct
+{
+    char place[ORDER_TEMPLATE_MAX];
+    char cancel[ORDER_TEMPLATE_MAX];
+    // Offset of the counter digits and of the end of the cid in each buffer
+    int place_cid_digits;
+    int place_end;
+    int cancel_cid_digits;
+    int cancel_end;
+    int account;
+    int fields;
+    // price = ticks * tick_units * 10^-price_decimals, same for size/lots
+    double tick_size;
+    int price_decimals;
+    long long tick_units;
+    double lot_size;
+    int size_decimals;
+    long long lot_units;
+    unsigned long long next_cid;
+    // Entry of the session's pre-trade checks for (account, symbol), set by
+    // order_session_template()
+    void *pre_trade;
+} OrderTemplate;
+
+static int order_template_fill(char *buf, const char *mode, int fields, int account, const char *symbol,
+                               const char *cid_prefix, int *cid_digits)
+{
+    char *p = buf + ORDER_IDX_HEADROOM;
+    int len;
+    if (fields & ORDER_FIELD_ACCOUNT)
+    {
+        len = snprintf(p, ORDER_TEMPLATE_MAX - ORDER_IDX_HEADROOM - ORDER_CID_DIGITS - 96,
+                       ",%s,%d,%s,%s", mode, account, symbol, cid_prefix);
+    }
+    else
+    {
+        len = snprintf(p, ORDER_TEMPLATE_MAX - ORDER_IDX_HEADROOM - ORDER_CID_DIGITS - 96,
+                       ",%s,%s,%s", mode, symbol, cid_prefix);
+    }
+    if (len < 0 || len >= ORDER_TEMPLATE_MAX - ORDER_IDX_HEADROOM - ORDER_CID_DIGITS - 96)
+    {
+        return -1;
+    }
+    *cid_digits = ORDER_IDX_HEADROOM + len;
+    memset(buf + *cid_digits, '0', ORDER_CID_DIGITS);
+    return *cid_digits + ORDER_CID_DIGITS;
+}
+
+// Build the template for one account and symbol. tick_size and lot_size
+// are the symbol's price and quantity steps (e.g. 0.1 and 0.001; 1 for
+// Gate.io contracts). client_order_ids are cid_prefix followed by a
+// ORDER_CID_DIGITS wide counter starting at first_cid (at most
+// ORDER_CID_LAST), so the prefix must satisfy the exchange's rules
+// (Gate.io: "t-") and leave room for the counter within ORDER_CID_MAX.
+// fields are the exchange's ORDER_FIELD_* (OrderExchange.fields). This is
+// the only place that formats with snprintf.
+int order_template_init(OrderTemplate *t, int fields, int account, const char *symbol, double tick_size,
+                        double lot_size, const char *cid_prefix, unsigned long long first_cid)
+{
+    memset(t, 0, sizeof(*t));
+    if (strlen(cid_prefix) + ORDER_CID_DIGITS > ORDER_CID_MAX)
+    {
+        fprintf(stderr, "cid prefix \"%s\" leaves no room for %d counter digits within %d characters\n", cid_prefix,
+                ORDER_CID_DIGITS, ORDER_CID_MAX);
+        return -1;
+    }
+    if (first_cid > ORDER_CID_LAST)
+    {
+        fprintf(stderr, "first cid %llu has more than %d digits\n", first_cid, ORDER_CID_DIGITS);
+        return -1;
+    }
+    t->price_decimals = order_step_decimals(tick_size);
+    t->size_decimals = order_step_decimals(lot_size);
+    if (tick_size <= 0 || lot_size <= 0 || t->price_decimals < 0 || t->size_decimals < 0)
+    {
+        fprintf(stderr, "unsupported tick %g / lot %g for %s\n", tick_size, lot_size, symbol);
+        return -1;
+    }
+    t->tick_size = tick_size;
+    t->tick_units = order_round(tick_size * order_pow10[t->price_decimals]);
+    t->lot_size = lot_size;
+    t->lot_units = order_round(lot_size * order_pow10[t->size_decimals]);
+    t->account = account;
+    t->fields = fields;
+    t->next_cid = first_cid;
+
+    t->place_end = order_template_fill(t->place, "1", fields, account, symbol, cid_prefix, &t->place_cid_digits);
+    t->cancel_end = order_template_fill(t->cancel, "-1", fields, account, symbol, cid_prefix, &t->cancel_cid_digits);
+    if (t->place_end < 0 || t->cancel_end < 0)
+    {
+        fprintf(stderr, "order template for %s is too long\n", symbol);
+        return -1;
+    }
+    return 0;
+}
+
+// Price in whole ticks, rounded to the nearest tick
+static inline long long order_price_ticks(const OrderTemplate *t, double price)
+{
+    return order_round(price / t->tick_size);
+}
+
+// Size in whole lots, rounded down so an order never exceeds the request
+static inline long long order_size_lots(const OrderTemplate *t, double size)
+{
+    double lots = size / t->lot_size + 1e-9;
+    return lots > 0 ? (long long)lots : 0;
+}
+
+static inline void order_patch_cid(char *digits, unsigned long long cid)
+{
+    for (int i = ORDER_CID_DIGITS - 1; i >= 0; i--)
+    {
+        digits[i] = (char)('0' + cid % 10);
+        cid /= 10;
+    }
+}
+
+// Encode a place request for client order cid. *msg is set to the start
+// of the request inside the template, valid until the next encode.
+// Returns its length.
+static inline int order_encode_place(OrderTemplate *t, int idx, unsigned long long cid, int pos_side,
+                                     int side, int order_type, long long size_lots, long long price_ticks,
+                                     const char **msg)
+{
+    char *start = fmt_uint_rev(t->place + ORDER_IDX_HEADROOM, (unsigned int)idx);
+    order_patch_cid(t->place + t->place_cid_digits, cid);
+    char *p = t->place + t->place_end;
+    *p++ = ',';
+    if (t->fields & ORDER_FIELD_POS_SIDE)
+    {
+        p += fmt_int(p, pos_side);
+        *p++ = ',';
+    }
+    p += fmt_int(p, side);
+    *p++ = ',';
+    p += fmt_int(p, order_type);
+    *p++ = ',';
+    p += fmt_fixed(p, size_lots * t->lot_units, t->size_decimals);
+    *p++ = ',';
+    p += fmt_fixed(p, price_ticks * t->tick_units, t->price_decimals);
+    *msg = start;
+    return (int)(p - start);
+}
+
+// Encode a cancel request for client order cid
+static inline int order_encode_cancel(OrderTemplate *t, int idx, unsigned long long cid, const char **msg)
+{
+    char *start = fmt_uint_rev(t->cancel + ORDER_IDX_HEADROOM, (unsigned int)idx);
+    order_patch_cid(t->cancel + t->cancel_cid_digits, cid);
+    *msg = start;
+    return (int)(t->cancel + t->cancel_end - start);
+}
+
+// Next client_order_id counter of the template, ORDER_CID_EXHAUSTED once
+// ORDER_CID_LAST has been handed out: wrapping around would repeat ids
+// that may still be live, so build a new template (another prefix) then
+static inline unsigned long long order_template_next_cid(OrderTemplate *t)
+{
+    if (t->next_cid > ORDER_CID_LAST)
+    {
+        if (t->next_cid++ == ORDER_CID_LAST + 1)
+        {
+            fprintf(stderr, "client_order_id counter exhausted after %llu\n", ORDER_CID_LAST);
+        }
+        return ORDER_CID_EXHAUSTED;
+    }
+    return t->next_cid++;
+}
+
+#endif // QTX_ORDER_ENCODER_C
@@ -0,0 +1,169 @@
+#ifndef QTX_ORDER_EXCHANGE_C
+#define QTX_ORDER_EXCHANGE_C
+
+#include "sdk.c"
+#include "order_encoder.c"
+
+// Request encoders per exchange. All venues share "idx,mode,..." framing
+// but differ in which fields the place/cancel requests carry:
+//   binance, gate.io: account,symbol,cid,pos_side,side,order_type,size,price
+//   okx:              account,symbol,cid,side,order_type,size,price
+//   bybit, bitget:    symbol,cid,side,order_type,size,price
+// and in the credentials connect takes. Encoders write the body after
+// "idx," and return its length, or -1 if it does not fit in size bytes.
+
+#define EXCHANGE_BINANCE 0
+#define EXCHANGE_GATEIO 1
+#define EXCHANGE_OKX 2
+#define EXCHANGE_BYBIT 3
+#define EXCHANGE_BITGET 4
+#define EXCHANGE_COUNT 5
+
+// Longest symbol or client_order_id accepted by the encoders
+#define ORDER_FIELD_MAX 64
+
+typedef struct
+{
+    const char *name;
+    // ORDER_FIELD_* present in place/cancel requests
+    int fields;
+    int (*encode_connect)(char *out, int size, const char *api_key, const char *api_secret,
+                          const char *passphrase, int account_index);
+    int (*encode_place)(char *out, int fields, int account, const char *symbol, const char *client_order_id,
+                        int pos_side, int side, int order_type, long long size_units, long long price_units,
+                        int decimals);
+    int (*encode_cancel)(char *out, int fields, int account, const char *symbol, const char *client_order_id);
+} OrderExchange;
+
+static inline char *order_put_str(char *p, const char *s, int len)
+{
+    memcpy(p, s, len);
+    return p + len;
+}
+
+// key,secret[,passphrase][,account_index]: passphrase (Gate.io user_id) is
+// optional but its field must be present when account_index is given
+static int encode_connect_optional(char *out, int size, const char *api_key, const char *api_secret,
+                                   const char *passphrase, int account_index)
+{
+    int len;
+    if (account_index >= 0)
+    {
+        len = snprintf(out, size, "0,%s,%s,%s,%d", api_key, api_secret,
+                       passphrase != NULL ? passphrase : "", account_index);
+    }
+    else if (passphrase != NULL && passphrase[0] != '\0')
+    {
+        len = snprintf(out, size, "0,%s,%s,%s", api_key, api_secret, passphrase);
+    }
+    else
+    {
+        len = snprintf(out, size, "0,%s,%s", api_key, api_secret);
+    }
+    return len < 0 || len >= size ? -1 : len;
+}
+
+// key,secret,passphrase (OKX, Bitget)
+static int encode_connect_passphrase(char *out, int size, const char *api_key, const char *api_secret,
+                                     const char *passphrase, int account_index)
+{
+    int len = snprintf(out, size, "0,%s,%s,%s", api_key, api_secret, passphrase != NULL ? passphrase : "");
+    return len < 0 || len >= size ? -1 : len;
+}
+
+// key,secret (Bybit)
+static int encode_connect_basic(char *out, int size, const char *api_key, const char *api_secret,
+                                const char *passphrase, int account_index)
+{
+    int len = snprintf(out, size, "0,%s,%s", api_key, api_secret);
+    return len < 0 || len >= size ? -1 : len;
+}
+
+// Place body for any field layout; size/price are units * 10^-decimals
+static int encode_place_fields(char *out, int fields, int account, const char *symbol, const char *client_order_id,
+                               int pos_side, int side, int order_type, long long size_units, long long price_units,
+                               int decimals)
+{
+    int symbol_len = strnlen(symbol, ORDER_FIELD_MAX + 1);
+    int cid_len = strnlen(client_order_id, ORDER_FIELD_MAX + 1);
+    if (symbol_len > ORDER_FIELD_MAX || cid_len > ORDER_FIELD_MAX)
+    {
+        return -1;
+    }
+    char *p = out;
+    *p++ = '1';
+    *p++ = ',';
+    if (fields & ORDER_FIELD_ACCOUNT)
+    {
+        p += fmt_int(p, account);
+        *p++ = ',';
+    }
+    p = order_put_str(p, symbol, symbol_len);
+    *p++ = ',';
+    p = order_put_str(p, client_order_id, cid_len);
+    *p++ = ',';
+    if (fields & ORDER_FIELD_POS_SIDE)
+    {
+        p += fmt_int(p, pos_side);
+        *p++ = ',';
+    }
+    p += fmt_int(p, side);
+    *p++ = ',';
+    p += fmt_int(p, order_type);
+    *p++ = ',';
+    p += fmt_fixed_trim(p, size_units, decimals);
+    *p++ = ',';
+    p += fmt_fixed_trim(p, price_units, decimals);
+    return (int)(p - out);
+}
+
+static int encode_cancel_fields(char *out, int fields, int account, const char *symbol, const char *client_order_id)
+{
+    int symbol_len = strnlen(symbol, ORDER_FIELD_MAX + 1);
+    int cid_len = strnlen(client_order_id, ORDER_FIELD_MAX + 1);
+    if (symbol_len > ORDER_FIELD_MAX || cid_len > ORDER_FIELD_MAX)
+    {
+        return -1;
+    }
+    char *p = out;
+    *p++ = '-';
+    *p++ = '1';
+    *p++ = ',';
+    if (fields & ORDER_FIELD_ACCOUNT)
+    {
+        p += fmt_int(p, account);
+        *p++ = ',';
+    }
+    p = order_put_str(p, symbol, symbol_len);
+    *p++ = ',';
+    p = order_put_str(p, client_order_id, cid_len);
+    return (int)(p - out);
+}
+
+static const OrderExchange order_exchanges[EXCHANGE_COUNT] = {
+    [EXCHANGE_BINANCE] = {"binance", ORDER_FIELD_ACCOUNT | ORDER_FIELD_POS_SIDE,
+                          encode_connect_optional, encode_place_fields, encode_cancel_fields},
+    [EXCHANGE_GATEIO] = {"gateio", ORDER_FIELD_ACCOUNT | ORDER_FIELD_POS_SIDE,
+                         encode_connect_optional, encode_place_fields, encode_cancel_fields},
+    [EXCHANGE_OKX] = {"okx", ORDER_FIELD_ACCOUNT,
+                      encode_connect_passphrase, encode_place_fields, encode_cancel_fields},
+    [EXCHANGE_BYBIT] = {"bybit", 0,
+                        encode_connect_basic, encode_place_fields, encode_cancel_fields},
+    [EXCHANGE_BITGET] = {"bitget", 0,
+                         encode_connect_passphrase, encode_place_fields, encode_cancel_fields},
+};
+
+// EXCHANGE_* by name, -1 if unknown
+int order_exchange_id(const char *name)
+{
+    for (int i = 0; i < EXCHANGE_COUNT; i++)
+    {
+        if (strcmp(order_exchanges[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#endif // QTX_ORDER_EXCHANGE_C
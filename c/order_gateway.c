@@ -0,0 +1,114 @@
+#ifndef QTX_ORDER_GATEWAY_C
+#define QTX_ORDER_GATEWAY_C
+
+#include "sdk.c"
+#include "order_session.c"
+#include <sys/epoll.h>
+
+// One event loop over any number of order sessions, typically one per
+// exchange (and account). All session sockets sit in a single epoll set,
+// so one thread drives every venue: order_gateway_poll() drains the
+// sessions that became readable and runs the timeouts of all of them.
+// Sessions are opened and closed by the caller; the gateway only borrows
+// them.
+
+#define GATEWAY_MAX_SESSIONS 64
+
+typedef struct
+{
+    int epoll_fd;
+    OrderSession *sessions[GATEWAY_MAX_SESSIONS];
+    int count;
+} OrderGateway;
+
+int order_gateway_init(OrderGateway *gw)
+{
+    memset(gw, 0, sizeof(*gw));
+    gw->epoll_fd = epoll_create1(0);
+    if (gw->epoll_fd < 0)
+    {
+        perror("epoll_create1 failed");
+        return -1;
+    }
+    return 0;
+}
+
+// Start multiplexing an open session
+int order_gateway_add(OrderGateway *gw, OrderSession *s)
+{
+    if (gw->count >= GATEWAY_MAX_SESSIONS)
+    {
+        fprintf(stderr, "order gateway is full (%d sessions)\n", GATEWAY_MAX_SESSIONS);
+        return -1;
+    }
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = s};
+    if (epoll_ctl(gw->epoll_fd, EPOLL_CTL_ADD, order_session_fd(s), &ev) < 0)
+    {
+        perror("epoll_ctl failed");
+        return -1;
+    }
+    gw->sessions[gw->count++] = s;
+    return 0;
+}
+
+// Requests in flight over all sessions
+unsigned int order_gateway_inflight(const OrderGateway *gw)
+{
+    unsigned int inflight = 0;
+    for (int i = 0; i < gw->count; i++)
+    {
+        inflight += gw->sessions[i]->inflight;
+    }
+    return inflight;
+}
+
+// Wait up to timeout_ms (-1: forever, 0: not at all) for responses, but
+// no longer than the next wheel tick while requests are in flight.
+// Returns the number of responses, auth updates and timeouts delivered.
+int order_gateway_poll(OrderGateway *gw, int timeout_ms)
+{
+    if (order_gateway_inflight(gw) > 0 && (timeout_ms < 0 || timeout_ms > ORDER_WHEEL_TICK_MS))
+    {
+        timeout_ms = ORDER_WHEEL_TICK_MS;
+    }
+    struct epoll_event events[GATEWAY_MAX_SESSIONS];
+    int ready = epoll_wait(gw->epoll_fd, events, GATEWAY_MAX_SESSIONS, timeout_ms);
+    if (ready < 0 && errno != EINTR)
+    {
+        perror("epoll_wait failed");
+    }
+    int delivered = 0;
+    for (int i = 0; i < ready; i++)
+    {
+        delivered += order_session_poll((OrderSession *)events[i].data.ptr);
+    }
+    // Sessions that were readable already ran their wheel; this is a no-op
+    // for them within the same tick
+    for (int i = 0; i < gw->count; i++)
+    {
+        delivered += order_session_expire(gw->sessions[i]);
+    }
+    return delivered;
+}
+
+// Block until no session has a request in flight
+void order_gateway_wait(OrderGateway *gw)
+{
+    while (order_gateway_inflight(gw) > 0)
+    {
+        order_gateway_poll(gw, -1);
+    }
+}
+
+// Release the epoll set; the sessions stay open
+void order_gateway_close(OrderGateway *gw)
+{
+    if (gw->epoll_fd >= 0)
+    {
+        close(gw->epoll_fd);
+        gw->epoll_fd = -1;
+    }
+    gw->count = 0;
+}
+
+#endif // QTX_ORDER_GATEWAY_C
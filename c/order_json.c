@@ -0,0 +1,743 @@
+#ifndef QTX_ORDER_JSON_C
+#define QTX_ORDER_JSON_C
+
+#include "sdk.c"
+#include "order_exchange.c"
+#include "order_response.c"
+#include <stddef.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// On-demand field extraction from the exchange JSON carried in "r:" and
+// "a:" payloads. No DOM and no allocation: one pass over the payload finds
+// structural characters 16 bytes at a time (SSE2, scalar elsewhere), skips
+// strings whole, and only looks at keys that are direct members of the
+// schema's container object ("result", "o", ...). Matching values are
+// converted straight into an OrderFill. A container that is an array of
+// objects (Gate.io batched order updates) yields one OrderFill per object.
+// Where one response type carries several layouts (Binance's flat and
+// wrapped replies, futures and spot order events), a selector schema
+// picks the layout from a top-level member first.
+
+// OrderFill.present bits
+#define FILL_ORDER_ID 0x001
+#define FILL_CLIENT_ID 0x002
+#define FILL_SYMBOL 0x004
+#define FILL_STATUS 0x008
+#define FILL_SIDE 0x010
+#define FILL_FILLED 0x020
+#define FILL_AVG_PRICE 0x040
+#define FILL_QTY 0x080
+#define FILL_REMAINING 0x100
+#define FILL_REASON 0x200
+#define FILL_QUOTE 0x400
+
+// How a matched value is stored
+#define JSON_INT 0     // number or numeric string -> long long
+#define JSON_DECIMAL 1 // number or numeric string -> double
+#define JSON_TEXT 2    // string, copied and NUL-terminated (truncated)
+#define JSON_SIDE 3    // "BUY"/"buy" -> 1, "SELL"/"sell" -> 2
+
+#define FILL_TEXT_MAX 40
+
+// Order state as reported by the exchange, normalised to one layout
+typedef struct
+{
+    long long order_id;
+    char client_order_id[FILL_TEXT_MAX];
+    char symbol[FILL_TEXT_MAX];
+    // Exchange status text (NEW, FILLED, open, finished, ...)
+    char status[FILL_TEXT_MAX];
+    // Binance execution type, Gate.io finish_as
+    char reason[FILL_TEXT_MAX];
+    // 1 buy, 2 sell, as in place requests; 0 unknown
+    int side;
+    double qty;
+    double filled_qty;
+    double remaining_qty;
+    double avg_price;
+    // Cumulative filled quote quantity (Binance spot), 0 if not sent
+    double filled_quote;
+    // FILL_* bits of the fields that were found
+    int present;
+} OrderFill;
+
+typedef struct
+{
+    const char *key;
+    int key_len;
+    int kind;
+    int offset;
+    int bit;
+} JsonField;
+
+#define JSON_FIELD(key, kind, member, bit) {key, sizeof(key) - 1, kind, offsetof(OrderFill, member), bit}
+
+// Key lookup: open-addressed slots hashed on (first byte, last byte,
+// length), so a key costs one or two probes whatever the field count
+#define JSON_SLOTS 64
+
+typedef struct JsonSchema
+{
+    const char *name;
+    // Key of the object (or array of objects) holding the fields, NULL:
+    // the top-level object
+    const char *container;
+    const JsonField *fields;
+    int field_count;
+    // Derive what the exchange does not send directly
+    void (*finish)(OrderFill *fill);
+    // Field index + 1 per slot, 0 = empty; built on first use
+    signed char slots[JSON_SLOTS];
+    int ready;
+    // Selector schemas have no fields: this returns the schema of the
+    // payload's layout, NULL when it holds no order
+    struct JsonSchema *(*select)(const char *json, int len);
+} JsonSchema;
+
+// ---- Scanning ----
+
+// Structural characters ('"', '{', '}', '[', ']') are found 64 bytes at a
+// time into a bitmask and then visited with ctz, so dense JSON costs one
+// bit operation per character of interest rather than one search each
+#define JSON_BLOCK 64
+
+typedef struct
+{
+    const char *block;
+    const char *end;
+    // Unvisited structural characters of block, bit i = block[i]
+    unsigned long long mask;
+} JsonScanner;
+
+static inline int json_is_structural(char c)
+{
+    // '[' and '{' differ only in bit 0x20, as do ']' and '}'
+    return c == '"' || (c | 0x20) == '{' || (c | 0x20) == '}';
+}
+
+static inline unsigned long long json_block_mask(const char *p, const char *end)
+{
+    unsigned long long mask = 0;
+    int n = end - p < JSON_BLOCK ? (int)(end - p) : JSON_BLOCK;
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i folded = _mm_or_si128(v, case_bit);
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                    _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)));
+        mask |= (unsigned long long)(unsigned int)_mm_movemask_epi8(hits) << i;
+    }
+#endif
+    for (; i < n; i++)
+    {
+        mask |= (unsigned long long)json_is_structural(p[i]) << i;
+    }
+    return mask;
+}
+
+static inline void json_scanner_init(JsonScanner *sc, const char *json, const char *end)
+{
+    sc->block = json;
+    sc->end = end;
+    sc->mask = json_block_mask(json, end);
+}
+
+// Next unvisited structural character, end if none
+static inline const char *json_next(JsonScanner *sc)
+{
+    while (sc->mask == 0)
+    {
+        sc->block += JSON_BLOCK;
+        if (sc->block >= sc->end)
+        {
+            return sc->end;
+        }
+        sc->mask = json_block_mask(sc->block, sc->end);
+    }
+    const char *p = sc->block + __builtin_ctzll(sc->mask);
+    sc->mask &= sc->mask - 1;
+    return p;
+}
+
+// Closing quote of the string whose content starts at start (its opening
+// quote already visited), end if unterminated
+static inline const char *json_string_end(JsonScanner *sc, const char *start)
+{
+    for (;;)
+    {
+        const char *p = json_next(sc);
+        if (p >= sc->end)
+        {
+            return sc->end;
+        }
+        if (*p != '"')
+        {
+            continue;
+        }
+        // Escaped if preceded by an odd run of backslashes
+        const char *b = p;
+        while (b > start && b[-1] == '\\')
+        {
+            b--;
+        }
+        if (((p - b) & 1) == 0)
+        {
+            return p;
+        }
+    }
+}
+
+static inline const char *json_skip_space(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+    {
+        p++;
+    }
+    return p;
+}
+
+// Exponents beyond this give 0 or infinity (doubles end near 1e308 and
+// 1e-324 with the mantissa's digits)
+#define JSON_MAX_EXPONENT 350
+
+// Plain decimal ("-12.345", "1e-5") without libm or locale
+static double json_parse_decimal(const char *p, const char *end)
+{
+    int negative = p < end && *p == '-';
+    p += negative;
+    double value = 0;
+    while (p < end && (unsigned int)(*p - '0') < 10)
+    {
+        value = value * 10 + (*p++ - '0');
+    }
+    if (p < end && *p == '.')
+    {
+        // Fraction as an integer, one rounding step instead of one per digit
+        p++;
+        long long fraction = 0;
+        double scale = 1;
+        while (p < end && (unsigned int)(*p - '0') < 10)
+        {
+            if (scale < 1e18)
+            {
+                fraction = fraction * 10 + (*p - '0');
+                scale *= 10;
+            }
+            p++;
+        }
+        value += fraction / scale;
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        int exp_negative = p < end && *p == '-';
+        p += p < end && (*p == '-' || *p == '+');
+        int exponent = 0;
+        while (p < end && (unsigned int)(*p - '0') < 10)
+        {
+            // Past the range of a double either way; stop counting so the
+            // loop below stays short whatever the digits say
+            if (exponent <= JSON_MAX_EXPONENT)
+            {
+                exponent = exponent * 10 + (*p - '0');
+            }
+            p++;
+        }
+        if (exponent > JSON_MAX_EXPONENT)
+        {
+            exponent = JSON_MAX_EXPONENT + 1;
+        }
+        while (exponent-- > 0)
+        {
+            value = exp_negative ? value / 10 : value * 10;
+        }
+    }
+    return negative ? -value : value;
+}
+
+static long long json_parse_int(const char *p, const char *end)
+{
+    int negative = p < end && *p == '-';
+    p += negative;
+    long long value = 0;
+    while (p < end && (unsigned int)(*p - '0') < 10)
+    {
+        value = value * 10 + (*p++ - '0');
+    }
+    return negative ? -value : value;
+}
+
+// Store the value text [value, value_end) into fill
+static void json_store(const JsonField *field, const char *value, const char *value_end, OrderFill *fill)
+{
+    char *member = (char *)fill + field->offset;
+    switch (field->kind)
+    {
+    case JSON_INT:
+        *(long long *)member = json_parse_int(value, value_end);
+        break;
+    case JSON_DECIMAL:
+        *(double *)member = json_parse_decimal(value, value_end);
+        break;
+    case JSON_TEXT:
+    {
+        int len = (int)(value_end - value);
+        if (len > FILL_TEXT_MAX - 1)
+        {
+            len = FILL_TEXT_MAX - 1;
+        }
+        memcpy(member, value, len);
+        member[len] = '\0';
+        break;
+    }
+    case JSON_SIDE:
+        *(int *)member = value < value_end ? ((value[0] | 0x20) == 'b' ? 1 : (value[0] | 0x20) == 's' ? 2 : 0) : 0;
+        break;
+    }
+    fill->present |= field->bit;
+}
+
+// Store the value starting at p (after the ':'), moving the scanner past
+// it. Nested objects and arrays are not fields and are left to the caller.
+static inline void json_store_value(JsonScanner *sc, const JsonField *field, const char *p, OrderFill *fill)
+{
+    const char *end = sc->end;
+    if (p >= end || *p == '{' || *p == '[')
+    {
+        return;
+    }
+    if (*p == '"')
+    {
+        // Visit the opening quote, then find the closing one
+        json_next(sc);
+        const char *value_end = json_string_end(sc, p + 1);
+        json_store(field, p + 1, value_end, fill);
+        return;
+    }
+    const char *value_end = p;
+    while (value_end < end && *value_end != ',' && *value_end != '}' && *value_end != ']' &&
+           *value_end != ' ' && *value_end != '\n' && *value_end != '\r' && *value_end != '\t')
+    {
+        value_end++;
+    }
+    json_store(field, p, value_end, fill);
+}
+
+static inline unsigned int json_key_hash(const char *key, int len)
+{
+    return ((unsigned char)key[0] * 7u + (unsigned char)key[len - 1] * 3u + (unsigned int)len) & (JSON_SLOTS - 1);
+}
+
+static void json_schema_prepare(JsonSchema *schema)
+{
+    signed char slots[JSON_SLOTS];
+    memset(slots, 0, sizeof(slots));
+    for (int i = 0; i < schema->field_count && i < JSON_SLOTS / 2; i++)
+    {
+        const JsonField *field = &schema->fields[i];
+        unsigned int h = json_key_hash(field->key, field->key_len);
+        while (slots[h] != 0)
+        {
+            h = (h + 1) & (JSON_SLOTS - 1);
+        }
+        slots[h] = (signed char)(i + 1);
+    }
+    memcpy(schema->slots, slots, sizeof(slots));
+    __atomic_store_n(&schema->ready, 1, __ATOMIC_RELEASE);
+}
+
+static inline const JsonField *json_find_field(const JsonSchema *schema, const char *key, int len)
+{
+    if (len == 0)
+    {
+        return NULL;
+    }
+    for (unsigned int h = json_key_hash(key, len); schema->slots[h] != 0; h = (h + 1) & (JSON_SLOTS - 1))
+    {
+        const JsonField *field = &schema->fields[schema->slots[h] - 1];
+        if (field->key_len == len && memcmp(field->key, key, len) == 0)
+        {
+            return field;
+        }
+    }
+    return NULL;
+}
+
+// Value of the member key (past the ':') of the object json starts with,
+// NULL if it has no such member
+static const char *json_top_member(const char *json, int len, const char *key)
+{
+    const char *end = json + len;
+    int key_len = (int)strlen(key);
+    JsonScanner sc;
+    json_scanner_init(&sc, json, end);
+    int depth = 0;
+    for (;;)
+    {
+        const char *p = json_next(&sc);
+        if (p >= end)
+        {
+            return NULL;
+        }
+        if (*p == '{' || *p == '[')
+        {
+            depth++;
+            continue;
+        }
+        if (*p == '}' || *p == ']')
+        {
+            if (--depth == 0)
+            {
+                return NULL;
+            }
+            continue;
+        }
+        const char *name = p + 1;
+        const char *name_end = json_string_end(&sc, name);
+        if (name_end >= end)
+        {
+            return NULL;
+        }
+        p = json_skip_space(name_end + 1, end);
+        if (depth == 1 && p < end && *p == ':' && name_end - name == key_len && memcmp(name, key, key_len) == 0)
+        {
+            return json_skip_space(p + 1, end);
+        }
+    }
+}
+
+// Value of member key of the object in the top-level member container
+static const char *json_member(const char *json, int len, const char *container, const char *key)
+{
+    const char *p = json_top_member(json, len, container);
+    return p != NULL && *p == '{' ? json_top_member(p, (int)(json + len - p), key) : NULL;
+}
+
+// Whether the top-level member key is the string value
+static int json_top_string_is(const char *json, int len, const char *key, const char *value)
+{
+    const char *p = json_top_member(json, len, key);
+    size_t value_len = strlen(value);
+    return p != NULL && *p == '"' && (size_t)(json + len - p) > value_len + 1 &&
+           memcmp(p + 1, value, value_len) == 0 && p[value_len + 1] == '"';
+}
+
+// Extract up to max OrderFills from json[0..len). Returns how many were
+// found: 0 when the container is absent (another event type, an error
+// response), more than 1 only for an array container.
+int order_json_extract(JsonSchema *schema, const char *json, int len, OrderFill *fills, int max)
+{
+    if (schema->select != NULL)
+    {
+        schema = schema->select(json, len);
+        if (schema == NULL)
+        {
+            return 0;
+        }
+    }
+    if (!__atomic_load_n(&schema->ready, __ATOMIC_ACQUIRE))
+    {
+        json_schema_prepare(schema);
+    }
+    const char *end = json + len;
+    JsonScanner sc;
+    json_scanner_init(&sc, json, end);
+    int depth = 0;
+    // Depth of the current record's members, 0: not in a record
+    int record_depth = 0;
+    // Depth inside an array container whose objects are records, 0: none
+    int array_depth = 0;
+    // The container key was just seen, its value decides what follows
+    int pending = 0;
+    int count = 0;
+    int container_len = schema->container != NULL ? (int)strlen(schema->container) : 0;
+
+    while (count < max)
+    {
+        const char *p = json_next(&sc);
+        if (p >= end)
+        {
+            break;
+        }
+        char c = *p;
+        if (c == '{' || c == '[')
+        {
+            depth++;
+            int starts_record = (c == '{') && (pending || (array_depth > 0 && depth == array_depth + 1) ||
+                                               (schema->container == NULL && depth == 1));
+            if (c == '[' && pending)
+            {
+                array_depth = depth;
+            }
+            else if (starts_record && record_depth == 0)
+            {
+                record_depth = depth;
+                memset(&fills[count], 0, sizeof(OrderFill));
+            }
+            pending = 0;
+            continue;
+        }
+        if (c == '}' || c == ']')
+        {
+            if (c == '}' && depth == record_depth)
+            {
+                if (schema->finish != NULL)
+                {
+                    schema->finish(&fills[count]);
+                }
+                count++;
+                record_depth = 0;
+            }
+            else if (c == ']' && depth == array_depth)
+            {
+                array_depth = 0;
+            }
+            pending = 0;
+            depth--;
+            continue;
+        }
+
+        // A string: a key if ':' follows, otherwise a value to skip
+        const char *key = p + 1;
+        const char *key_end = json_string_end(&sc, key);
+        if (key_end >= end)
+        {
+            break;
+        }
+        p = json_skip_space(key_end + 1, end);
+        if (p >= end || *p != ':')
+        {
+            pending = 0;
+            continue;
+        }
+        int key_len = (int)(key_end - key);
+        p = json_skip_space(p + 1, end);
+        if (record_depth > 0 && depth == record_depth)
+        {
+            const JsonField *field = json_find_field(schema, key, key_len);
+            if (field != NULL)
+            {
+                json_store_value(&sc, field, p, &fills[count]);
+            }
+        }
+        else if (record_depth == 0 && array_depth == 0)
+        {
+            pending = key_len == container_len && memcmp(key, schema->container, key_len) == 0;
+        }
+    }
+    return count;
+}
+
+// ---- Exchange schemas ----
+
+// Spot sends the filled quote quantity instead of an average price
+static void binance_finish(OrderFill *fill)
+{
+    if ((fill->present & (FILL_QTY | FILL_FILLED)) == (FILL_QTY | FILL_FILLED))
+    {
+        fill->remaining_qty = fill->qty - fill->filled_qty;
+        fill->present |= FILL_REMAINING;
+    }
+    if (!(fill->present & FILL_AVG_PRICE) && (fill->present & FILL_QUOTE) && fill->filled_qty > 0)
+    {
+        fill->avg_price = fill->filled_quote / fill->filled_qty;
+        fill->present |= FILL_AVG_PRICE;
+    }
+}
+
+// Gate.io sends signed contract sizes (negative = sell) and what is left
+static void gateio_finish(OrderFill *fill)
+{
+    if (fill->present & FILL_QTY)
+    {
+        fill->side = fill->qty < 0 ? 2 : 1;
+        fill->present |= FILL_SIDE;
+        if (fill->qty < 0)
+        {
+            fill->qty = -fill->qty;
+        }
+    }
+    if (fill->present & FILL_REMAINING)
+    {
+        if (fill->remaining_qty < 0)
+        {
+            fill->remaining_qty = -fill->remaining_qty;
+        }
+        if (fill->present & FILL_QTY)
+        {
+            fill->filled_qty = fill->qty - fill->remaining_qty;
+            fill->present |= FILL_FILLED;
+        }
+    }
+}
+
+// Order reply, either the order itself ({"orderId":..,"status":"NEW",..})
+// or wrapped by the WebSocket API: {"id":..,"status":200,"result":{...}}
+static const JsonField binance_result_fields[] = {
+    JSON_FIELD("orderId", JSON_INT, order_id, FILL_ORDER_ID),
+    JSON_FIELD("clientOrderId", JSON_TEXT, client_order_id, FILL_CLIENT_ID),
+    JSON_FIELD("symbol", JSON_TEXT, symbol, FILL_SYMBOL),
+    JSON_FIELD("status", JSON_TEXT, status, FILL_STATUS),
+    JSON_FIELD("side", JSON_SIDE, side, FILL_SIDE),
+    JSON_FIELD("origQty", JSON_DECIMAL, qty, FILL_QTY),
+    JSON_FIELD("executedQty", JSON_DECIMAL, filled_qty, FILL_FILLED),
+    JSON_FIELD("avgPrice", JSON_DECIMAL, avg_price, FILL_AVG_PRICE),
+    JSON_FIELD("cummulativeQuoteQty", JSON_DECIMAL, filled_quote, FILL_QUOTE),
+};
+
+// User data stream ORDER_TRADE_UPDATE (futures): {"e":..,"o":{...}}
+static const JsonField binance_update_fields[] = {
+    JSON_FIELD("i", JSON_INT, order_id, FILL_ORDER_ID),
+    JSON_FIELD("c", JSON_TEXT, client_order_id, FILL_CLIENT_ID),
+    JSON_FIELD("s", JSON_TEXT, symbol, FILL_SYMBOL),
+    JSON_FIELD("X", JSON_TEXT, status, FILL_STATUS),
+    JSON_FIELD("x", JSON_TEXT, reason, FILL_REASON),
+    JSON_FIELD("S", JSON_SIDE, side, FILL_SIDE),
+    JSON_FIELD("q", JSON_DECIMAL, qty, FILL_QTY),
+    JSON_FIELD("z", JSON_DECIMAL, filled_qty, FILL_FILLED),
+    JSON_FIELD("ap", JSON_DECIMAL, avg_price, FILL_AVG_PRICE),
+};
+
+// User data stream executionReport (spot), the order at the top level:
+// {"e":"executionReport",..,"i":..,"X":"NEW",..,"z":..,"Z":..}
+static const JsonField binance_execution_fields[] = {
+    JSON_FIELD("i", JSON_INT, order_id, FILL_ORDER_ID),
+    JSON_FIELD("c", JSON_TEXT, client_order_id, FILL_CLIENT_ID),
+    JSON_FIELD("s", JSON_TEXT, symbol, FILL_SYMBOL),
+    JSON_FIELD("X", JSON_TEXT, status, FILL_STATUS),
+    JSON_FIELD("x", JSON_TEXT, reason, FILL_REASON),
+    JSON_FIELD("S", JSON_SIDE, side, FILL_SIDE),
+    JSON_FIELD("q", JSON_DECIMAL, qty, FILL_QTY),
+    JSON_FIELD("z", JSON_DECIMAL, filled_qty, FILL_FILLED),
+    JSON_FIELD("Z", JSON_DECIMAL, filled_quote, FILL_QUOTE),
+};
+
+// Order response ({"data":{"result":{...}}}) and futures.orders update
+// ({"result":[{...}, ...]}) share the order layout
+static const JsonField gateio_order_fields[] = {
+    JSON_FIELD("id", JSON_INT, order_id, FILL_ORDER_ID),
+    JSON_FIELD("text", JSON_TEXT, client_order_id, FILL_CLIENT_ID),
+    JSON_FIELD("contract", JSON_TEXT, symbol, FILL_SYMBOL),
+    JSON_FIELD("status", JSON_TEXT, status, FILL_STATUS),
+    JSON_FIELD("finish_as", JSON_TEXT, reason, FILL_REASON),
+    JSON_FIELD("size", JSON_DECIMAL, qty, FILL_QTY),
+    JSON_FIELD("left", JSON_DECIMAL, remaining_qty, FILL_REMAINING),
+    JSON_FIELD("fill_price", JSON_DECIMAL, avg_price, FILL_AVG_PRICE),
+};
+
+// Field schema; slots and ready are filled in on first use
+#define JSON_SCHEMA(schema_name, key, list, finish_fn)                                                               \
+    {.name = schema_name, .container = key, .fields = list, .field_count = (int)(sizeof(list) / sizeof(list[0])),     \
+     .finish = finish_fn, .slots = {0}, .ready = 0, .select = NULL}
+
+static JsonSchema binance_result_schema =
+    JSON_SCHEMA("binance result", "result", binance_result_fields, binance_finish);
+static JsonSchema binance_order_schema = JSON_SCHEMA("binance order", NULL, binance_result_fields, binance_finish);
+static JsonSchema binance_update_schema =
+    JSON_SCHEMA("binance order update", "o", binance_update_fields, binance_finish);
+static JsonSchema binance_execution_schema =
+    JSON_SCHEMA("binance execution report", NULL, binance_execution_fields, binance_finish);
+
+// Wrapped replies carry "result"; a flat reply is the order itself, an
+// error body ({"code":..,"msg":..}) neither
+static JsonSchema *binance_reply_select(const char *json, int len)
+{
+    if (json_top_member(json, len, "result") != NULL)
+    {
+        return &binance_result_schema;
+    }
+    return json_top_member(json, len, "orderId") != NULL ? &binance_order_schema : NULL;
+}
+
+// Order events by their "e"; account and balance events hold no order
+static JsonSchema *binance_event_select(const char *json, int len)
+{
+    if (json_top_string_is(json, len, "e", "ORDER_TRADE_UPDATE"))
+    {
+        return &binance_update_schema;
+    }
+    return json_top_string_is(json, len, "e", "executionReport") ? &binance_execution_schema : NULL;
+}
+
+static JsonSchema binance_reply_schema = {"binance reply", .select = binance_reply_select};
+static JsonSchema binance_event_schema = {"binance event", .select = binance_event_select};
+static JsonSchema gateio_order_schema = JSON_SCHEMA("gateio order", "result", gateio_order_fields, gateio_finish);
+
+// Schema for an exchange's response type (ORDER_RESP_EXC or
+// ORDER_RESP_AUTH), NULL if there is none
+JsonSchema *order_json_schema(int exchange, char type)
+{
+    switch (exchange)
+    {
+    case EXCHANGE_BINANCE:
+        return type == ORDER_RESP_AUTH ? &binance_event_schema : type == ORDER_RESP_EXC ? &binance_reply_schema : NULL;
+    case EXCHANGE_GATEIO:
+        return type == ORDER_RESP_AUTH || type == ORDER_RESP_EXC ? &gateio_order_schema : NULL;
+    default:
+        return NULL;
+    }
+}
+
+// Whether an exchange response reports that the request failed: Binance
+// error bodies ({"code":-2010,"msg":..}), WebSocket API errors ("error",
+// "status" 4xx/5xx) and Gate.io replies whose header status is not 200 or
+// whose data carries "errs". A response without order fields that is not
+// an error is only a receipt.
+int order_json_error(int exchange, const OrderResponse *resp)
+{
+    const char *json = resp->payload;
+    int len = resp->payload_len;
+    const char *p;
+    switch (exchange)
+    {
+    case EXCHANGE_BINANCE:
+        if (json_top_member(json, len, "error") != NULL)
+        {
+            return 1;
+        }
+        p = json_top_member(json, len, "code");
+        if (p != NULL && *p == '-')
+        {
+            return 1;
+        }
+        p = json_top_member(json, len, "status");
+        return p != NULL && *p >= '4' && *p <= '5';
+    case EXCHANGE_GATEIO:
+        if (json_member(json, len, "data", "errs") != NULL)
+        {
+            return 1;
+        }
+        p = json_member(json, len, "header", "status");
+        return p != NULL && *p == '"' && strncmp(p, "\"200\"", 5) != 0;
+    default:
+        return 0;
+    }
+}
+
+// Extract the OrderFills of a response received for exchange (a session's
+// OrderExchange)
+static inline int order_json_fills(const OrderExchange *exchange, const OrderResponse *resp, OrderFill *fills,
+                                   int max)
+{
+    JsonSchema *schema = order_json_schema((int)(exchange - order_exchanges), resp->type);
+    return schema != NULL ? order_json_extract(schema, resp->payload, resp->payload_len, fills, max) : 0;
+}
+
+void print_order_fill(const OrderFill *fill)
+{
+    printf("order %lld cid %s %s %s status %s%s%s qty %g filled %g left %g avg %g\n",
+           fill->order_id, fill->client_order_id, fill->symbol,
+           fill->side == 1 ? "BUY" : fill->side == 2 ? "SELL" : "?",
+           fill->status, fill->reason[0] != '\0' ? "/" : "", fill->reason,
+           fill->qty, fill->filled_qty, fill->remaining_qty, fill->avg_price);
+}
+
+#endif // QTX_ORDER_JSON_C
@@ -0,0 +1,679 @@
+#ifndef QTX_ORDER_MANAGER_C
+#define QTX_ORDER_MANAGER_C
+
+#include "sdk.c"
+#include "order_session.c"
+#include "order_json.c"
+
+// In-process order state for one session. Orders are created here, sent
+// through the session with the order as the request's user pointer, and
+// moved through their lifecycle by the indexed responses to those
+// requests and by auth stream updates (matched on client_order_id). Live
+// orders are linked per (account, symbol) so open orders can be counted
+// and listed without asking the exchange.
+//
+// States only move forward: an ack that arrives after the fill it belongs
+// to (Gate.io sends the order response and the auth stream fill
+// independently) is merged into the order's quantities but does not move
+// it back to ACKED. Filled quantity never decreases.
+
+#define ORDER_STATE_PENDING_NEW 0
+#define ORDER_STATE_ACKED 1
+#define ORDER_STATE_PARTIALLY_FILLED 2
+#define ORDER_STATE_PENDING_CANCEL 3
+#define ORDER_STATE_FILLED 4
+#define ORDER_STATE_CANCELLED 5
+#define ORDER_STATE_REJECTED 6
+
+static inline const char *order_state_name(int state)
+{
+    static const char *names[] = {
+        "PENDING_NEW", "ACKED", "PARTIALLY_FILLED", "PENDING_CANCEL", "FILLED", "CANCELLED", "REJECTED",
+    };
+    return state >= 0 && state <= ORDER_STATE_REJECTED ? names[state] : "?";
+}
+
+static inline int order_state_terminal(int state)
+{
+    return state >= ORDER_STATE_FILLED;
+}
+
+typedef struct
+{
+    char client_order_id[FILL_TEXT_MAX];
+    char symbol[FILL_TEXT_MAX];
+    unsigned long long cid_hash;
+    int account;
+    int side;
+    int state;
+    long long exchange_order_id;
+    double qty;
+    double price;
+    double filled_qty;
+    double avg_price;
+    // filled_qty as of the previous on_update: an update reports a fill of
+    // filled_qty - reported_filled_qty
+    double reported_filled_qty;
+    // idx of the place and of the latest cancel request, -1 if none
+    int place_idx;
+    int cancel_idx;
+    long long created_ns;
+    long long updated_ns;
+    // Links in the (account, symbol) open list, or the free list (next)
+    int next;
+    int prev;
+    int book;
+    int in_use;
+} ManagedOrder;
+
+// Live orders of one account and symbol
+typedef struct
+{
+    char symbol[FILL_TEXT_MAX];
+    unsigned long long hash;
+    int account;
+    int head;
+    unsigned int count;
+} OpenBook;
+
+typedef struct OrderManager OrderManager;
+
+// previous_state is the state before the change; when the new state is
+// terminal the order is released right after this returns
+typedef void (*OrderUpdateHandler)(OrderManager *m, const ManagedOrder *order, int previous_state, void *ctx);
+
+struct OrderManager
+{
+    OrderSession *session;
+    OrderUpdateHandler on_update;
+    void *ctx;
+
+    ManagedOrder *orders;
+    unsigned int max_orders;
+    int free_head;
+    unsigned int live;
+
+    // client_order_id -> order position, linear probing, -1 = empty
+    int *slots;
+    unsigned int slot_mask;
+
+    // (account, symbol) -> OpenBook, linear probing, never shrinks
+    OpenBook *books;
+    int *book_slots;
+    unsigned int book_mask;
+    unsigned int book_count;
+    unsigned int max_books;
+
+    unsigned long placed;
+    unsigned long cancels;
+    unsigned long rejects;
+    unsigned long fills;
+    unsigned long updates;
+    unsigned long unknown_updates;
+    unsigned long stale_responses;
+};
+
+// FNV-1a over the NUL-terminated text, with the account mixed in
+static inline unsigned long long order_key_hash(int account, const char *text)
+{
+    unsigned long long h = 1469598103934665603ULL ^ (unsigned int)account;
+    for (const unsigned char *p = (const unsigned char *)text; *p != '\0'; p++)
+    {
+        h = (h ^ *p) * 1099511628211ULL;
+    }
+    return h;
+}
+
+static unsigned int order_table_size(unsigned int entries)
+{
+    unsigned int size = 16;
+    while (size < entries * 2)
+    {
+        size <<= 1;
+    }
+    return size;
+}
+
+// Track up to max_orders live orders over up to max_books (account,
+// symbol) pairs of session. on_update (may be NULL) sees every state
+// change. The session's handlers must forward to order_manager_on_*
+// (order_manager_handlers() builds such handlers).
+int order_manager_init(OrderManager *m, OrderSession *session, unsigned int max_orders, unsigned int max_books,
+                       OrderUpdateHandler on_update, void *ctx)
+{
+    memset(m, 0, sizeof(*m));
+    if (max_orders == 0 || max_books == 0)
+    {
+        fprintf(stderr, "order manager needs max_orders and max_books > 0\n");
+        return -1;
+    }
+    unsigned int slot_count = order_table_size(max_orders);
+    unsigned int book_slot_count = order_table_size(max_books);
+    m->orders = calloc(max_orders, sizeof(ManagedOrder));
+    m->slots = malloc(slot_count * sizeof(int));
+    m->books = calloc(max_books, sizeof(OpenBook));
+    m->book_slots = malloc(book_slot_count * sizeof(int));
+    if (m->orders == NULL || m->slots == NULL || m->books == NULL || m->book_slots == NULL)
+    {
+        perror("order manager allocation failed");
+        free(m->orders);
+        free(m->slots);
+        free(m->books);
+        free(m->book_slots);
+        memset(m, 0, sizeof(*m));
+        return -1;
+    }
+    m->session = session;
+    m->on_update = on_update;
+    m->ctx = ctx;
+    m->max_orders = max_orders;
+    m->max_books = max_books;
+    m->slot_mask = slot_count - 1;
+    m->book_mask = book_slot_count - 1;
+    memset(m->slots, 0xff, slot_count * sizeof(int));
+    memset(m->book_slots, 0xff, book_slot_count * sizeof(int));
+    for (unsigned int i = 0; i < max_orders; i++)
+    {
+        m->orders[i].next = i + 1 < max_orders ? (int)i + 1 : -1;
+    }
+    m->free_head = 0;
+    return 0;
+}
+
+void order_manager_free(OrderManager *m)
+{
+    free(m->orders);
+    free(m->slots);
+    free(m->books);
+    free(m->book_slots);
+    memset(m, 0, sizeof(*m));
+}
+
+// ---- client_order_id table ----
+
+static int order_manager_slot(const OrderManager *m, const char *client_order_id, unsigned long long hash)
+{
+    for (unsigned int i = (unsigned int)hash & m->slot_mask;; i = (i + 1) & m->slot_mask)
+    {
+        int pos = m->slots[i];
+        if (pos < 0)
+        {
+            return -1;
+        }
+        const ManagedOrder *o = &m->orders[pos];
+        if (o->cid_hash == hash && strcmp(o->client_order_id, client_order_id) == 0)
+        {
+            return (int)i;
+        }
+    }
+}
+
+static void order_manager_unslot(OrderManager *m, unsigned int i)
+{
+    unsigned int j = i;
+    for (;;)
+    {
+        j = (j + 1) & m->slot_mask;
+        if (m->slots[j] < 0)
+        {
+            break;
+        }
+        unsigned int home = (unsigned int)m->orders[m->slots[j]].cid_hash & m->slot_mask;
+        // Move j into the hole unless its home lies cyclically in (i, j]
+        if (((j - home) & m->slot_mask) >= ((j - i) & m->slot_mask))
+        {
+            m->slots[i] = m->slots[j];
+            i = j;
+        }
+    }
+    m->slots[i] = -1;
+}
+
+// Order by client_order_id, NULL if not live
+ManagedOrder *order_manager_find(OrderManager *m, const char *client_order_id)
+{
+    int slot = order_manager_slot(m, client_order_id, order_key_hash(0, client_order_id));
+    return slot >= 0 ? &m->orders[m->slots[slot]] : NULL;
+}
+
+// ---- Open books ----
+
+static int order_manager_book_find(const OrderManager *m, int account, const char *symbol, unsigned long long hash,
+                                   unsigned int *empty)
+{
+    for (unsigned int i = (unsigned int)hash & m->book_mask;; i = (i + 1) & m->book_mask)
+    {
+        int b = m->book_slots[i];
+        if (b < 0)
+        {
+            *empty = i;
+            return -1;
+        }
+        const OpenBook *book = &m->books[b];
+        if (book->hash == hash && book->account == account && strcmp(book->symbol, symbol) == 0)
+        {
+            return b;
+        }
+    }
+}
+
+// Open orders of account on symbol, NULL if it never had any. count is
+// kept up to date; walk the orders from head with order_manager_next().
+const OpenBook *order_manager_book(const OrderManager *m, int account, const char *symbol)
+{
+    unsigned int empty;
+    int b = order_manager_book_find(m, account, symbol, order_key_hash(account, symbol), &empty);
+    return b >= 0 ? &m->books[b] : NULL;
+}
+
+static inline unsigned int order_manager_open_count(const OrderManager *m, int account, const char *symbol)
+{
+    const OpenBook *book = order_manager_book(m, account, symbol);
+    return book != NULL ? book->count : 0;
+}
+
+// First / next open order of a book, NULL at the end
+static inline const ManagedOrder *order_manager_first(const OrderManager *m, const OpenBook *book)
+{
+    return book != NULL && book->head >= 0 ? &m->orders[book->head] : NULL;
+}
+
+static inline const ManagedOrder *order_manager_next(const OrderManager *m, const ManagedOrder *order)
+{
+    return order->next >= 0 ? &m->orders[order->next] : NULL;
+}
+
+static int order_manager_book_of(OrderManager *m, int account, const char *symbol)
+{
+    unsigned long long hash = order_key_hash(account, symbol);
+    unsigned int empty;
+    int b = order_manager_book_find(m, account, symbol, hash, &empty);
+    if (b >= 0)
+    {
+        return b;
+    }
+    if (m->book_count >= m->max_books)
+    {
+        return -1;
+    }
+    b = (int)m->book_count++;
+    OpenBook *book = &m->books[b];
+    snprintf(book->symbol, sizeof(book->symbol), "%s", symbol);
+    book->hash = hash;
+    book->account = account;
+    book->head = -1;
+    book->count = 0;
+    m->book_slots[empty] = b;
+    return b;
+}
+
+static void order_manager_unlink(OrderManager *m, int pos)
+{
+    ManagedOrder *o = &m->orders[pos];
+    OpenBook *book = &m->books[o->book];
+    if (o->prev >= 0)
+    {
+        m->orders[o->prev].next = o->next;
+    }
+    else
+    {
+        book->head = o->next;
+    }
+    if (o->next >= 0)
+    {
+        m->orders[o->next].prev = o->prev;
+    }
+    book->count--;
+}
+
+// ---- Lifecycle ----
+
+// Create a PENDING_NEW order. client_order_id must be unique among live
+// orders. Returns NULL if it is not, or if the manager is full.
+ManagedOrder *order_manager_new(OrderManager *m, int account, const char *symbol, const char *client_order_id,
+                                int side, double qty, double price)
+{
+    unsigned long long hash = order_key_hash(0, client_order_id);
+    if (m->free_head < 0 || strlen(client_order_id) >= FILL_TEXT_MAX || strlen(symbol) >= FILL_TEXT_MAX ||
+        order_manager_slot(m, client_order_id, hash) >= 0)
+    {
+        return NULL;
+    }
+    int b = order_manager_book_of(m, account, symbol);
+    if (b < 0)
+    {
+        return NULL;
+    }
+    int pos = m->free_head;
+    ManagedOrder *o = &m->orders[pos];
+    m->free_head = o->next;
+    memset(o, 0, sizeof(*o));
+    snprintf(o->client_order_id, sizeof(o->client_order_id), "%s", client_order_id);
+    snprintf(o->symbol, sizeof(o->symbol), "%s", symbol);
+    o->cid_hash = hash;
+    o->account = account;
+    o->side = side;
+    o->qty = qty;
+    o->price = price;
+    o->state = ORDER_STATE_PENDING_NEW;
+    o->place_idx = -1;
+    o->cancel_idx = -1;
+    o->created_ns = o->updated_ns = get_current_timestamp_ns();
+    o->in_use = 1;
+
+    unsigned int i = (unsigned int)hash & m->slot_mask;
+    while (m->slots[i] >= 0)
+    {
+        i = (i + 1) & m->slot_mask;
+    }
+    m->slots[i] = pos;
+
+    OpenBook *book = &m->books[b];
+    o->book = b;
+    o->prev = -1;
+    o->next = book->head;
+    if (book->head >= 0)
+    {
+        m->orders[book->head].prev = pos;
+    }
+    book->head = pos;
+    book->count++;
+    m->live++;
+    return o;
+}
+
+// Drop an order from every index and return it to the pool
+static void order_manager_release(OrderManager *m, ManagedOrder *o)
+{
+    int pos = (int)(o - m->orders);
+    order_manager_unlink(m, pos);
+    order_manager_unslot(m, (unsigned int)order_manager_slot(m, o->client_order_id, o->cid_hash));
+    o->in_use = 0;
+    o->next = m->free_head;
+    m->free_head = pos;
+    m->live--;
+}
+
+// Move o to state (if that is forward) and notify when the state or, with
+// filled set, the filled quantity changed; terminal orders are released
+// afterwards
+static void order_manager_transition(OrderManager *m, ManagedOrder *o, int state, int filled)
+{
+    int previous = o->state;
+    if (order_state_terminal(previous))
+    {
+        return;
+    }
+    // A cancel in flight stays pending until it resolves either way
+    if (previous == ORDER_STATE_PENDING_CANCEL && !order_state_terminal(state))
+    {
+        state = ORDER_STATE_PENDING_CANCEL;
+    }
+    else if (state < previous && !order_state_terminal(state))
+    {
+        state = previous;
+    }
+    if (state == previous && !filled)
+    {
+        return;
+    }
+    o->state = state;
+    o->updated_ns = get_current_timestamp_ns();
+    m->updates++;
+    if (state == ORDER_STATE_FILLED)
+    {
+        m->fills++;
+    }
+    else if (state == ORDER_STATE_REJECTED)
+    {
+        m->rejects++;
+    }
+    if (m->on_update != NULL)
+    {
+        m->on_update(m, o, previous, m->ctx);
+    }
+    o->reported_filled_qty = o->filled_qty;
+    if (order_state_terminal(state))
+    {
+        order_manager_release(m, o);
+    }
+}
+
+// State an exchange report puts the order in
+static int order_manager_state_of(const ManagedOrder *o, const OrderFill *fill)
+{
+    const char *status = fill->status;
+    if (strcmp(status, "NEW") == 0 || strcmp(status, "open") == 0)
+    {
+        return o->filled_qty > 0 ? ORDER_STATE_PARTIALLY_FILLED : ORDER_STATE_ACKED;
+    }
+    if (strcmp(status, "PARTIALLY_FILLED") == 0)
+    {
+        return ORDER_STATE_PARTIALLY_FILLED;
+    }
+    if (strcmp(status, "FILLED") == 0)
+    {
+        return ORDER_STATE_FILLED;
+    }
+    if (strcmp(status, "REJECTED") == 0)
+    {
+        return ORDER_STATE_REJECTED;
+    }
+    if (strcmp(status, "finished") == 0)
+    {
+        // Gate.io: finish_as tells how; an order can be cancelled after
+        // filling completely in the same report
+        if (strcmp(fill->reason, "filled") == 0 || (o->qty > 0 && o->filled_qty >= o->qty))
+        {
+            return ORDER_STATE_FILLED;
+        }
+        return ORDER_STATE_CANCELLED;
+    }
+    // CANCELED, EXPIRED, EXPIRED_IN_MATCH, ...
+    return ORDER_STATE_CANCELLED;
+}
+
+// Merge an exchange report into o and advance its state
+static void order_manager_apply(OrderManager *m, ManagedOrder *o, const OrderFill *fill)
+{
+    if (fill->present & FILL_ORDER_ID)
+    {
+        o->exchange_order_id = fill->order_id;
+    }
+    int filled = (fill->present & FILL_FILLED) && fill->filled_qty > o->filled_qty;
+    if (filled)
+    {
+        o->filled_qty = fill->filled_qty;
+        if (fill->present & FILL_AVG_PRICE && fill->avg_price > 0)
+        {
+            o->avg_price = fill->avg_price;
+        }
+    }
+    if (fill->present & FILL_QTY && o->qty <= 0)
+    {
+        o->qty = fill->qty;
+    }
+    if (fill->present & FILL_STATUS)
+    {
+        order_manager_transition(m, o, order_manager_state_of(o, fill), filled);
+    }
+}
+
+// Place o through the session; on failure (-1, ORDER_RATE_LIMITED or
+// ORDER_RISK_REJECTED) o is rejected (and released)
+int order_manager_place(OrderManager *m, ManagedOrder *o, int pos_side, int order_type)
+{
+    int idx = order_place(m->session, o->account, o->symbol, o->client_order_id, pos_side, o->side, order_type,
+                          o->qty, o->price, o);
+    if (idx < 0)
+    {
+        order_manager_transition(m, o, ORDER_STATE_REJECTED, 0);
+        return idx;
+    }
+    o->place_idx = idx;
+    m->placed++;
+    return idx;
+}
+
+// Request cancellation of a live order
+int order_manager_cancel(OrderManager *m, ManagedOrder *o)
+{
+    int idx = order_cancel(m->session, o->account, o->symbol, o->client_order_id, o);
+    if (idx < 0)
+    {
+        return idx;
+    }
+    o->cancel_idx = idx;
+    m->cancels++;
+    order_manager_transition(m, o, ORDER_STATE_PENDING_CANCEL, 0);
+    return idx;
+}
+
+// The order a request was sent for, NULL if it is gone or the request was
+// not the order's latest place/cancel
+static ManagedOrder *order_manager_owner(OrderManager *m, const OrderRequest *req)
+{
+    ManagedOrder *o = (ManagedOrder *)req->user;
+    if (o == NULL || o < m->orders || o >= m->orders + m->max_orders || !o->in_use ||
+        (req->idx != o->place_idx && req->idx != o->cancel_idx))
+    {
+        return NULL;
+    }
+    return o;
+}
+
+// A failed cancel leaves the order live
+static void order_manager_cancel_failed(OrderManager *m, ManagedOrder *o)
+{
+    if (o->state == ORDER_STATE_PENDING_CANCEL)
+    {
+        int previous = o->state;
+        o->state = o->filled_qty > 0 ? ORDER_STATE_PARTIALLY_FILLED : ORDER_STATE_ACKED;
+        o->updated_ns = get_current_timestamp_ns();
+        m->updates++;
+        if (m->on_update != NULL)
+        {
+            m->on_update(m, o, previous, m->ctx);
+        }
+    }
+}
+
+// Feed an indexed response (from OrderHandlers.on_response)
+void order_manager_on_response(OrderManager *m, const OrderRequest *req, const OrderResponse *resp)
+{
+    if (req == NULL || (req->kind != ORDER_PLACE && req->kind != ORDER_CANCEL))
+    {
+        return;
+    }
+    ManagedOrder *o = order_manager_owner(m, req);
+    if (o == NULL)
+    {
+        m->stale_responses++;
+        return;
+    }
+    int cancel = req->kind == ORDER_CANCEL;
+    if (resp->type == ORDER_RESP_ERR)
+    {
+        if (cancel)
+        {
+            order_manager_cancel_failed(m, o);
+        }
+        else
+        {
+            order_manager_transition(m, o, ORDER_STATE_REJECTED, 0);
+        }
+        return;
+    }
+    if (resp->type == ORDER_RESP_EXC)
+    {
+        OrderFill fill;
+        int exchange = (int)(m->session->exchange - order_exchanges);
+        if (order_json_fills(m->session->exchange, resp, &fill, 1) == 1)
+        {
+            order_manager_apply(m, o, &fill);
+            if (fill.present & FILL_STATUS)
+            {
+                return;
+            }
+        }
+        else if (order_json_error(exchange, resp))
+        {
+            // Exchange error body (insufficient balance, unknown order, ...)
+            if (cancel)
+            {
+                order_manager_cancel_failed(m, o);
+            }
+            else
+            {
+                order_manager_transition(m, o, ORDER_STATE_REJECTED, 0);
+            }
+            return;
+        }
+    }
+    // A receipt without an order status (an ACK, a reply in a layout
+    // without a schema): the order stays live and relies on later
+    // responses and auth stream updates
+    if (!cancel)
+    {
+        order_manager_transition(m, o, ORDER_STATE_ACKED, 0);
+    }
+}
+
+// Feed an auth stream update (from OrderHandlers.on_auth)
+void order_manager_on_auth(OrderManager *m, const OrderResponse *resp)
+{
+    OrderFill fills[16];
+    int count = order_json_fills(m->session->exchange, resp, fills, 16);
+    for (int i = 0; i < count; i++)
+    {
+        ManagedOrder *o = (fills[i].present & FILL_CLIENT_ID) ? order_manager_find(m, fills[i].client_order_id)
+                                                               : NULL;
+        if (o == NULL || o->account != resp->idx)
+        {
+            m->unknown_updates++;
+            continue;
+        }
+        order_manager_apply(m, o, &fills[i]);
+    }
+}
+
+static void order_manager_response_handler(OrderSession *s, const OrderRequest *req, const OrderResponse *resp,
+                                           void *ctx)
+{
+    order_manager_on_response((OrderManager *)ctx, req, resp);
+}
+
+static void order_manager_auth_handler(OrderSession *s, const OrderResponse *resp, void *ctx)
+{
+    order_manager_on_auth((OrderManager *)ctx, resp);
+}
+
+// Session handlers that feed m, for sessions that only trade through it
+static inline OrderHandlers order_manager_handlers(OrderManager *m)
+{
+    OrderHandlers handlers = {
+        .on_response = order_manager_response_handler,
+        .on_auth = order_manager_auth_handler,
+        .ctx = m,
+    };
+    return handlers;
+}
+
+void print_order_manager_stats(const OrderManager *m)
+{
+    printf("=== Order Manager Stats ===\n");
+    printf("live %u, placed %lu, cancels %lu, fills %lu, rejects %lu, updates %lu, unknown updates %lu, "
+           "stale responses %lu\n",
+           m->live, m->placed, m->cancels, m->fills, m->rejects, m->updates, m->unknown_updates,
+           m->stale_responses);
+    for (unsigned int b = 0; b < m->book_count; b++)
+    {
+        if (m->books[b].count > 0)
+        {
+            printf("account %d %s: %u open\n", m->books[b].account, m->books[b].symbol, m->books[b].count);
+        }
+    }
+    printf("===========================\n");
+}
+
+#endif // QTX_ORDER_MANAGER_C
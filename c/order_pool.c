@@ -0,0 +1,643 @@
+#ifndef QTX_ORDER_POOL_C
+#define QTX_ORDER_POOL_C
+
+#include "sdk.c"
+#include "ring.c"
+#include "order_session.c"
+#include <stddef.h>
+#include <sys/eventfd.h>
+
+// Many accounts of one exchange, each on its own OrderSession (socket and
+// local port) driven by its own worker thread, optionally pinned to a
+// core. Every account connects with an explicit account_index
+// ("idx,0,...,account_index"), so its auth stream arrives on its own port
+// and is handled on its own core. Strategy threads queue place/cancel
+// commands into the account's ring; the worker encodes and sends them,
+// polls the socket and runs the callbacks. Nothing is shared between
+// accounts, so throughput grows with the number of accounts.
+//
+// order_pool_replace() swaps an account for a new one (new credentials or
+// a fresh connection) without stopping the others: the replacement
+// connects on its own socket and thread first, then takes over the slot;
+// the old worker finishes the commands already queued and its in-flight
+// requests before it exits.
+//
+// A command that is not sent is still answered: on_response gets a
+// request and an ORDER_RESP_ERR response with idx -1 (the request's user
+// is the command's), whose payload says why (POOL_ERR_*). This covers
+// commands refused by the session (rate limit, encode or send failure)
+// and commands queued on an account that failed to connect or was retired
+// before it connected.
+
+#define POOL_MAX_ACCOUNTS 64
+// Queued commands per account, a power of two
+#define POOL_RING_SIZE 1024
+#define POOL_CREDENTIAL_MAX 128
+
+// Account states
+#define POOL_CONNECTING 0
+#define POOL_READY 1
+#define POOL_FAILED 2
+
+// Payloads of the responses to commands that were not sent
+#define POOL_ERR_RATE_LIMITED "RATE_LIMITED"
+#define POOL_ERR_SEND_FAILED "SEND_FAILED"
+#define POOL_ERR_NOT_CONNECTED "NOT_CONNECTED"
+
+typedef struct
+{
+    char api_key[POOL_CREDENTIAL_MAX];
+    char api_secret[POOL_CREDENTIAL_MAX];
+    // OKX/Bitget passphrase, Gate.io user_id, "" if unused
+    char passphrase[POOL_CREDENTIAL_MAX];
+    int account_index;
+} PoolCredentials;
+
+typedef struct
+{
+    int kind;
+    int pos_side;
+    int side;
+    int order_type;
+    double size;
+    double price;
+    char symbol[ORDER_FIELD_MAX];
+    char client_order_id[ORDER_FIELD_MAX];
+    void *user;
+} PoolCommand;
+
+typedef struct
+{
+    _Atomic unsigned long seq;
+    PoolCommand cmd;
+} PoolCommandSlot;
+
+typedef struct OrderPool OrderPool;
+
+typedef struct
+{
+    // Set by the session's handlers; the worker owns everything below
+    OrderSession session;
+    OrderPool *pool;
+    int slot;
+    PoolCredentials credentials;
+    int cpu;
+    pthread_t thread;
+    _Atomic int state;
+    // Set once the account is replaced: finish queued work, then exit
+    _Atomic int retiring;
+    // Strategy threads inside order_pool_submit on this account
+    _Atomic int producers;
+
+    // Multi-producer command ring, as MsgRing in ring.c
+    _Alignas(CACHE_LINE) _Atomic unsigned long tail;
+    _Atomic unsigned long rejected;
+    _Alignas(CACHE_LINE) _Atomic unsigned long head;
+    // Non-zero while the worker sleeps in poll(); producers then kick event_fd
+    _Atomic int sleeping;
+    int event_fd;
+    PoolCommandSlot *commands;
+    unsigned long executed;
+    unsigned long wakeups;
+} PoolAccount;
+
+typedef struct
+{
+    int exchange;
+    const char *server_ip;
+    int server_port;
+    // Account slot i binds local_port_base + i, its replacement
+    // local_port_base + POOL_MAX_ACCOUNTS + i and so on alternating; 0: any
+    int local_port_base;
+    // Worker of slot i runs on first_cpu + i, -1: no pinning
+    int first_cpu;
+    unsigned int max_inflight;
+    int timeout_ms;
+    // Spin instead of sleeping in poll() when idle
+    int spin;
+    // Shared by every account's session, NULL for no client-side limit
+    RateLimiter *limiter;
+    // Called on the account's worker thread; order_pool_account(s) gives
+    // the account a session belongs to
+    OrderHandlers handlers;
+} OrderPoolConfig;
+
+struct OrderPool
+{
+    OrderPoolConfig config;
+    _Atomic(PoolAccount *) accounts[POOL_MAX_ACCOUNTS];
+    int count;
+    // Local port generation per slot, flips on every replacement
+    int generation[POOL_MAX_ACCOUNTS];
+};
+
+static inline PoolAccount *order_pool_account(OrderSession *s)
+{
+    return (PoolAccount *)((char *)s - offsetof(PoolAccount, session));
+}
+
+// ---- Command ring ----
+
+// Queue a command; never blocks. Returns 0, or -1 if the ring is full.
+static int pool_push(PoolAccount *a, const PoolCommand *cmd)
+{
+    unsigned long pos = atomic_load_explicit(&a->tail, memory_order_relaxed);
+    PoolCommandSlot *slot;
+    for (;;)
+    {
+        slot = &a->commands[pos & (POOL_RING_SIZE - 1)];
+        long diff = (long)(atomic_load_explicit(&slot->seq, memory_order_acquire) - pos);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&a->tail, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            atomic_fetch_add_explicit(&a->rejected, 1, memory_order_relaxed);
+            return -1;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&a->tail, memory_order_relaxed);
+        }
+    }
+    slot->cmd = *cmd;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    // Pairs with the worker's fence between sleeping = 1 and its last check
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&a->sleeping, memory_order_relaxed))
+    {
+        uint64_t one = 1;
+        if (write(a->event_fd, &one, sizeof(one)) < 0)
+        {
+            perror("eventfd write failed");
+        }
+    }
+    return 0;
+}
+
+static inline int pool_ring_empty(PoolAccount *a)
+{
+    unsigned long pos = atomic_load_explicit(&a->head, memory_order_relaxed);
+    return atomic_load_explicit(&a->commands[pos & (POOL_RING_SIZE - 1)].seq, memory_order_acquire) != pos + 1;
+}
+
+// Answer a command that was not sent with an ORDER_RESP_ERR response
+static void pool_fail(PoolAccount *a, const PoolCommand *c, const char *reason)
+{
+    const OrderHandlers *h = &a->pool->config.handlers;
+    if (h->on_response == NULL)
+    {
+        return;
+    }
+    long long now = get_current_timestamp_ns();
+    OrderRequest req = {
+        .idx = -1,
+        .kind = c->kind,
+        .account = a->credentials.account_index,
+        .sent_ns = now,
+        .user = c->user,
+        .next = -1,
+        .prev = -1,
+        .slot = -1,
+    };
+    OrderResponse resp = {
+        .idx = -1,
+        .type = ORDER_RESP_ERR,
+        .payload = reason,
+        .payload_len = (int)strlen(reason),
+        .recv_ns = now,
+    };
+    h->on_response(&a->session, &req, &resp, h->ctx);
+}
+
+// Take every queued command off the ring, unsent, answering each with reason
+static int pool_fail_queued(PoolAccount *a, const char *reason)
+{
+    int failed = 0;
+    unsigned long pos = atomic_load_explicit(&a->head, memory_order_relaxed);
+    for (;;)
+    {
+        PoolCommandSlot *slot = &a->commands[pos & (POOL_RING_SIZE - 1)];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1)
+        {
+            break;
+        }
+        PoolCommand c = slot->cmd;
+        atomic_store_explicit(&slot->seq, pos + POOL_RING_SIZE, memory_order_release);
+        pos++;
+        failed++;
+        pool_fail(a, &c, reason);
+    }
+    atomic_store_explicit(&a->head, pos, memory_order_relaxed);
+    return failed;
+}
+
+// Send every queued command the session has room for
+static int pool_execute(PoolAccount *a)
+{
+    OrderSession *s = &a->session;
+    int executed = 0;
+    unsigned long pos = atomic_load_explicit(&a->head, memory_order_relaxed);
+    while (s->free_head >= 0)
+    {
+        PoolCommandSlot *slot = &a->commands[pos & (POOL_RING_SIZE - 1)];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1)
+        {
+            break;
+        }
+        PoolCommand c = slot->cmd;
+        atomic_store_explicit(&slot->seq, pos + POOL_RING_SIZE, memory_order_release);
+        pos++;
+        executed++;
+        int account = a->credentials.account_index;
+        int idx;
+        if (c.kind == ORDER_PLACE)
+        {
+            idx = order_place(s, account, c.symbol, c.client_order_id, c.pos_side, c.side, c.order_type, c.size,
+                              c.price, c.user);
+        }
+        else
+        {
+            idx = order_cancel(s, account, c.symbol, c.client_order_id, c.user);
+        }
+        if (idx < 0)
+        {
+            pool_fail(a, &c, idx == ORDER_RATE_LIMITED ? POOL_ERR_RATE_LIMITED : POOL_ERR_SEND_FAILED);
+        }
+    }
+    atomic_store_explicit(&a->head, pos, memory_order_relaxed);
+    a->executed += executed;
+    return executed;
+}
+
+// ---- Worker ----
+
+static void pool_on_response(OrderSession *s, const OrderRequest *req, const OrderResponse *resp, void *ctx)
+{
+    PoolAccount *a = order_pool_account(s);
+    if (req != NULL && req->kind == ORDER_CONNECT)
+    {
+        atomic_store_explicit(&a->state, resp->type == ORDER_RESP_ACK ? POOL_READY : POOL_FAILED,
+                              memory_order_release);
+    }
+    const OrderHandlers *h = &a->pool->config.handlers;
+    if (h->on_response != NULL)
+    {
+        h->on_response(s, req, resp, h->ctx);
+    }
+}
+
+static void pool_on_auth(OrderSession *s, const OrderResponse *resp, void *ctx)
+{
+    const OrderHandlers *h = &order_pool_account(s)->pool->config.handlers;
+    if (h->on_auth != NULL)
+    {
+        h->on_auth(s, resp, h->ctx);
+    }
+}
+
+static void pool_on_timeout(OrderSession *s, const OrderRequest *req, void *ctx)
+{
+    PoolAccount *a = order_pool_account(s);
+    if (req->kind == ORDER_CONNECT)
+    {
+        atomic_store_explicit(&a->state, POOL_FAILED, memory_order_release);
+    }
+    const OrderHandlers *h = &a->pool->config.handlers;
+    if (h->on_timeout != NULL)
+    {
+        h->on_timeout(s, req, h->ctx);
+    }
+}
+
+// Sleep until a datagram, a command or the next wheel tick
+static void pool_idle(PoolAccount *a)
+{
+    atomic_store_explicit(&a->sleeping, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (pool_ring_empty(a))
+    {
+        struct pollfd fds[2] = {
+            {.fd = a->session.socket, .events = POLLIN},
+            {.fd = a->event_fd, .events = POLLIN},
+        };
+        // Bounded so a retiring worker notices its flag
+        int timeout = a->session.inflight > 0 ? ORDER_WHEEL_TICK_MS : 100;
+        if (poll(fds, 2, timeout) > 0 && (fds[1].revents & POLLIN))
+        {
+            uint64_t count;
+            if (read(a->event_fd, &count, sizeof(count)) > 0)
+            {
+                a->wakeups++;
+            }
+        }
+    }
+    atomic_store_explicit(&a->sleeping, 0, memory_order_relaxed);
+}
+
+static void *pool_worker_main(void *arg)
+{
+    PoolAccount *a = (PoolAccount *)arg;
+    pin_current_thread(a->cpu);
+    OrderSession *s = &a->session;
+    const PoolCredentials *c = &a->credentials;
+    if (order_connect(s, c->api_key, c->api_secret, c->passphrase, c->account_index, NULL) < 0)
+    {
+        fprintf(stderr, "account %d: connect not sent\n", c->account_index);
+        atomic_store_explicit(&a->state, POOL_FAILED, memory_order_release);
+    }
+
+    while (running)
+    {
+        // Read before the ring: every command queued before the account
+        // was told to retire is visible below
+        int retiring = atomic_load_explicit(&a->retiring, memory_order_acquire);
+        int state = atomic_load_explicit(&a->state, memory_order_acquire);
+        // Commands wait until the connect has been answered; without a
+        // connection (or one to wait for) they are failed
+        int busy = 0;
+        if (state == POOL_READY)
+        {
+            busy = pool_execute(a);
+        }
+        else if (state == POOL_FAILED || retiring)
+        {
+            busy = pool_fail_queued(a, POOL_ERR_NOT_CONNECTED);
+        }
+        busy += order_session_poll(s);
+        // Without a connection nothing in flight is worth waiting for
+        if (retiring && (state != POOL_READY || (pool_ring_empty(a) && s->inflight == 0)))
+        {
+            break;
+        }
+        if (busy == 0 && !a->pool->config.spin)
+        {
+            pool_idle(a);
+        }
+    }
+    return NULL;
+}
+
+static PoolAccount *pool_account_start(OrderPool *p, int slot, const PoolCredentials *credentials)
+{
+    const OrderPoolConfig *cfg = &p->config;
+    PoolAccount *a = aligned_alloc(CACHE_LINE, (sizeof(PoolAccount) + CACHE_LINE - 1) & ~(CACHE_LINE - 1));
+    PoolCommandSlot *commands = malloc(POOL_RING_SIZE * sizeof(PoolCommandSlot));
+    if (a == NULL || commands == NULL)
+    {
+        perror("pool account allocation failed");
+        free(a);
+        free(commands);
+        return NULL;
+    }
+    memset(a, 0, sizeof(*a));
+    a->commands = commands;
+    for (unsigned long i = 0; i < POOL_RING_SIZE; i++)
+    {
+        atomic_init(&a->commands[i].seq, i);
+    }
+    a->pool = p;
+    a->slot = slot;
+    a->credentials = *credentials;
+    a->cpu = cfg->first_cpu >= 0 ? cfg->first_cpu + slot : -1;
+    atomic_init(&a->state, POOL_CONNECTING);
+
+    int port = cfg->local_port_base > 0
+                   ? cfg->local_port_base + p->generation[slot] * POOL_MAX_ACCOUNTS + slot
+                   : 0;
+    OrderHandlers handlers = {
+        .on_response = pool_on_response,
+        .on_auth = pool_on_auth,
+        .on_timeout = pool_on_timeout,
+    };
+    a->event_fd = eventfd(0, EFD_NONBLOCK);
+    if (a->event_fd < 0)
+    {
+        perror("eventfd failed");
+        free(commands);
+        free(a);
+        return NULL;
+    }
+    if (order_session_open(&a->session, cfg->exchange, cfg->server_ip, cfg->server_port, port,
+                           cfg->max_inflight, cfg->timeout_ms, &handlers) < 0)
+    {
+        order_session_close(&a->session);
+        close(a->event_fd);
+        free(commands);
+        free(a);
+        return NULL;
+    }
+    order_session_set_limiter(&a->session, cfg->limiter);
+    int err = pthread_create(&a->thread, NULL, pool_worker_main, a);
+    if (err != 0)
+    {
+        fprintf(stderr, "pthread_create failed: %s\n", strerror(err));
+        order_session_close(&a->session);
+        close(a->event_fd);
+        free(commands);
+        free(a);
+        return NULL;
+    }
+    return a;
+}
+
+// Wait for a started account's worker to answer its connect: returns
+// POOL_READY, or POOL_FAILED on a rejection, a connect timeout or after
+// timeout_ms
+static int pool_account_wait(PoolAccount *a, int timeout_ms)
+{
+    long long deadline = get_current_timestamp_ns() + timeout_ms * 1000000LL;
+    int state;
+    while ((state = atomic_load_explicit(&a->state, memory_order_acquire)) == POOL_CONNECTING &&
+           get_current_timestamp_ns() < deadline)
+    {
+        usleep(1000);
+    }
+    return state == POOL_READY ? POOL_READY : POOL_FAILED;
+}
+
+// Let the worker drain and exit, then free the account. An account that
+// never connected fails its queued commands and exits without waiting.
+static void pool_account_stop(PoolAccount *a)
+{
+    atomic_store_explicit(&a->retiring, 1, memory_order_release);
+    pthread_join(a->thread, NULL);
+    order_session_close(&a->session);
+    close(a->event_fd);
+    free(a->commands);
+    free(a);
+}
+
+// ---- Pool ----
+
+void order_pool_init(OrderPool *p, const OrderPoolConfig *config)
+{
+    memset(p, 0, sizeof(*p));
+    p->config = *config;
+    for (int i = 0; i < POOL_MAX_ACCOUNTS; i++)
+    {
+        atomic_init(&p->accounts[i], NULL);
+    }
+}
+
+// Start an account and connect it (not waiting for the answer). Returns
+// its slot, or -1.
+int order_pool_add(OrderPool *p, const PoolCredentials *credentials)
+{
+    if (p->count >= POOL_MAX_ACCOUNTS)
+    {
+        fprintf(stderr, "order pool is full\n");
+        return -1;
+    }
+    int slot = p->count;
+    PoolAccount *a = pool_account_start(p, slot, credentials);
+    if (a == NULL)
+    {
+        return -1;
+    }
+    atomic_store_explicit(&p->accounts[slot], a, memory_order_release);
+    p->count++;
+    return slot;
+}
+
+// Block the caller until slot's account answered its connect (see
+// pool_account_wait). Other accounts keep running meanwhile.
+int order_pool_wait_ready(OrderPool *p, int slot, int timeout_ms)
+{
+    PoolAccount *a = atomic_load_explicit(&p->accounts[slot], memory_order_acquire);
+    return a != NULL ? pool_account_wait(a, timeout_ms) : POOL_FAILED;
+}
+
+// Hot swap slot to new credentials: connects the replacement on a new
+// socket and thread, moves the slot over once it is ready and retires the
+// old account after its queued and in-flight requests are done. Only the
+// caller waits; other accounts are not touched. Returns 0, or -1 (the old
+// account stays) if the replacement does not connect within timeout_ms.
+int order_pool_replace(OrderPool *p, int slot, const PoolCredentials *credentials, int timeout_ms)
+{
+    if (slot < 0 || slot >= p->count)
+    {
+        return -1;
+    }
+    p->generation[slot] ^= 1;
+    PoolAccount *next = pool_account_start(p, slot, credentials);
+    if (next == NULL)
+    {
+        p->generation[slot] ^= 1;
+        return -1;
+    }
+    if (pool_account_wait(next, timeout_ms) != POOL_READY)
+    {
+        fprintf(stderr, "replacement for account slot %d did not connect\n", slot);
+        pool_account_stop(next);
+        p->generation[slot] ^= 1;
+        return -1;
+    }
+    PoolAccount *old = atomic_exchange_explicit(&p->accounts[slot], next, memory_order_acq_rel);
+    // Producers that picked up the old account before the swap finish
+    // their push before it is told to retire
+    while (atomic_load_explicit(&old->producers, memory_order_acquire) > 0)
+    {
+        cpu_relax();
+    }
+    pool_account_stop(old);
+    return 0;
+}
+
+// Queue a command for slot's account; safe from any thread. Returns 0, or
+// -1 if the slot is empty or its ring is full.
+static int order_pool_submit(OrderPool *p, int slot, const PoolCommand *cmd)
+{
+    for (;;)
+    {
+        PoolAccount *a = atomic_load_explicit(&p->accounts[slot], memory_order_acquire);
+        if (a == NULL)
+        {
+            return -1;
+        }
+        atomic_fetch_add_explicit(&a->producers, 1, memory_order_seq_cst);
+        // Swapped out in between: the replacer may already be past its
+        // producer check, so go to the new account instead
+        if (atomic_load_explicit(&p->accounts[slot], memory_order_seq_cst) != a)
+        {
+            atomic_fetch_sub_explicit(&a->producers, 1, memory_order_release);
+            continue;
+        }
+        int rc = pool_push(a, cmd);
+        atomic_fetch_sub_explicit(&a->producers, 1, memory_order_release);
+        return rc;
+    }
+}
+
+int order_pool_place(OrderPool *p, int slot, const char *symbol, const char *client_order_id, int pos_side,
+                     int side, int order_type, double size, double price, void *user)
+{
+    PoolCommand cmd = {
+        .kind = ORDER_PLACE,
+        .pos_side = pos_side,
+        .side = side,
+        .order_type = order_type,
+        .size = size,
+        .price = price,
+        .user = user,
+    };
+    if (strlen(symbol) >= ORDER_FIELD_MAX || strlen(client_order_id) >= ORDER_FIELD_MAX)
+    {
+        return -1;
+    }
+    strcpy(cmd.symbol, symbol);
+    strcpy(cmd.client_order_id, client_order_id);
+    return order_pool_submit(p, slot, &cmd);
+}
+
+int order_pool_cancel(OrderPool *p, int slot, const char *symbol, const char *client_order_id, void *user)
+{
+    PoolCommand cmd = {.kind = ORDER_CANCEL, .user = user};
+    if (strlen(symbol) >= ORDER_FIELD_MAX || strlen(client_order_id) >= ORDER_FIELD_MAX)
+    {
+        return -1;
+    }
+    strcpy(cmd.symbol, symbol);
+    strcpy(cmd.client_order_id, client_order_id);
+    return order_pool_submit(p, slot, &cmd);
+}
+
+// Stop every account once its queued and in-flight requests are done
+void order_pool_close(OrderPool *p)
+{
+    for (int i = 0; i < p->count; i++)
+    {
+        PoolAccount *a = atomic_exchange_explicit(&p->accounts[i], NULL, memory_order_acq_rel);
+        if (a != NULL)
+        {
+            pool_account_stop(a);
+        }
+    }
+    p->count = 0;
+}
+
+void print_order_pool_stats(OrderPool *p)
+{
+    printf("=== Order Pool Stats (%s, %d accounts) ===\n", order_exchanges[p->config.exchange].name, p->count);
+    for (int i = 0; i < p->count; i++)
+    {
+        PoolAccount *a = atomic_load_explicit(&p->accounts[i], memory_order_acquire);
+        if (a == NULL)
+        {
+            continue;
+        }
+        printf("slot %d account %d cpu %d: %s, executed %lu, ring full %lu, wakeups %lu\n", i,
+               a->credentials.account_index, a->cpu,
+               atomic_load(&a->state) == POOL_READY ? "ready" : "not connected", a->executed,
+               (unsigned long)atomic_load(&a->rejected), a->wakeups);
+    }
+    printf("=====================================\n");
+}
+
+#endif // QTX_ORDER_POOL_C
@@ -0,0 +1,74 @@
+#ifndef QTX_ORDER_RESPONSE_C
+#define QTX_ORDER_RESPONSE_C
+
+#include "sdk.c"
+
+// Zero-copy parser for order server replies:
+//   idx:type:payload      indexed response, type is one character
+//   a:account:payload     auth stream update
+//   idx:message           untyped response (Bitget)
+// The result is a view into the receive buffer, nothing is copied.
+
+// Response types (single character for network efficiency)
+#define ORDER_RESP_ACK 'k'
+#define ORDER_RESP_ERR 'e'
+#define ORDER_RESP_EXC 'r'
+#define ORDER_RESP_AUTH 'a'
+// "idx:message" without a type (Bitget). Dispatch classifies it before the
+// handlers see it: "connected" answers a connect with ORDER_RESP_ACK, any
+// other answer to a connect is ORDER_RESP_ERR, the rest ORDER_RESP_EXC.
+#define ORDER_RESP_UNTYPED 0
+
+// Longest idx / account index accepted (INT_MAX)
+#define ORDER_IDX_DIGITS 10
+
+// Parsed view of one datagram; payload points into the receive buffer and
+// is only valid during the callback
+typedef struct
+{
+    // idx of an indexed response, account index of an auth update
+    int idx;
+    char type;
+    const char *payload;
+    int payload_len;
+    long long recv_ns;
+} OrderResponse;
+
+// Parse one reply of len bytes. buf[len] must be readable and not a digit
+// (the session NUL-terminates every datagram) so the idx scan needs no
+// bounds check. Returns 0, or -1 if buf is not a reply.
+static inline int order_parse(const char *buf, int len, OrderResponse *resp)
+{
+    const unsigned char *p = (const unsigned char *)buf;
+    const unsigned char *end = p + len;
+    // "a:" prefix of auth updates
+    int auth = len >= 2 && p[0] == ORDER_RESP_AUTH && p[1] == ':';
+    p += auth * 2;
+
+    // One compare per digit, the terminator ends the run
+    const unsigned char *digits = p;
+    unsigned long long value = 0;
+    unsigned int d;
+    while ((d = (unsigned int)*p - '0') < 10)
+    {
+        value = value * 10 + d;
+        p++;
+    }
+    long n = p - digits;
+    if (n == 0 || n > ORDER_IDX_DIGITS || value > INT_MAX || p >= end || *p != ':')
+    {
+        return -1;
+    }
+    p++;
+    resp->idx = (int)value;
+
+    // Type: a single character followed by ':'; otherwise untyped
+    int typed = !auth && end - p >= 2 && p[1] == ':';
+    resp->type = auth ? ORDER_RESP_AUTH : typed ? (char)p[0] : ORDER_RESP_UNTYPED;
+    p += typed * 2;
+    resp->payload = (const char *)p;
+    resp->payload_len = (int)(end - p);
+    return 0;
+}
+
+#endif // QTX_ORDER_RESPONSE_C
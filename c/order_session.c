@@ -0,0 +1,784 @@
+#ifndef QTX_ORDER_SESSION_C
+#define QTX_ORDER_SESSION_C
+
+#include "sdk.c"
+#include "histogram.c"
+#include "order_encoder.c"
+#include "order_exchange.c"
+#include "order_response.c"
+#include "rate_limiter.c"
+#include <poll.h>
+
+// Pipelined UDP order session. Requests are tagged with an idx chosen by
+// the session and tracked in an open-addressed table until the indexed
+// response ("idx:type:payload") arrives or the timer wheel expires them,
+// so any number of orders can be outstanding on one socket. Nothing
+// blocks: call order_session_poll() whenever the socket is readable (or
+// in a loop) and results are delivered through OrderHandlers. Requests
+// are encoded for the session's exchange (order_exchange.c); to drive
+// several sessions from one thread use order_gateway.c. With a
+// RateLimiter attached (order_session_set_limiter) every request takes a
+// token before it is encoded and is refused with ORDER_RATE_LIMITED
+// when its bucket is empty. With pre-trade checks attached
+// (order_session_set_pre_trade, e.g. risk_attach() in risk_check.c) every
+// place is checked before that and refused with ORDER_RISK_REJECTED.
+
+#define ORDER_BUFFER_SIZE 65536
+// Datagrams taken per recvmmsg call
+#define ORDER_RECV_BATCH 16
+// Timer wheel: ORDER_WHEEL_SLOTS slots of ORDER_WHEEL_TICK_MS each; longer
+// timeouts wrap around the wheel and count down rounds
+#define ORDER_WHEEL_SLOTS 512
+#define ORDER_WHEEL_TICK_MS 10
+
+// Request kinds, the protocol's mode field
+#define ORDER_CONNECT 0
+#define ORDER_PLACE 1
+#define ORDER_CANCEL -1
+
+// Returned instead of an idx when the rate limiter refused the request
+#define ORDER_RATE_LIMITED -2
+// Returned instead of an idx when the pre-trade checks refused a place
+#define ORDER_RISK_REJECTED -3
+
+// One outstanding request; lives in the session's pool
+typedef struct
+{
+    int idx;
+    int kind;
+    int account;
+    long long sent_ns;
+    void *user;
+    // Timer wheel links (pool positions, -1 terminated)
+    int next;
+    int prev;
+    int slot;
+    unsigned int rounds;
+} OrderRequest;
+
+typedef struct OrderSession OrderSession;
+
+typedef struct
+{
+    // Indexed response; req is NULL when idx is not in flight (late reply
+    // after a timeout, or a request sent by someone else)
+    void (*on_response)(OrderSession *s, const OrderRequest *req, const OrderResponse *resp, void *ctx);
+    // "a:account:payload" auth stream update
+    void (*on_auth)(OrderSession *s, const OrderResponse *resp, void *ctx);
+    void (*on_timeout)(OrderSession *s, const OrderRequest *req, void *ctx);
+    void *ctx;
+} OrderHandlers;
+
+// Pre-trade checks of every place sent on a session. resolve maps an
+// (account, symbol) to the checker's entry for it (NULL if it has none),
+// once per OrderTemplate and on every order_place; check returns 0 if the
+// order may go out, else the checks it failed; on_sent books an order that
+// went out. Cancels are not checked.
+typedef struct
+{
+    void *(*resolve)(void *ctx, int account, const char *symbol);
+    int (*check)(void *ctx, void *entry, int side, double size, double price);
+    void (*on_sent)(void *ctx, void *entry, int side, double size);
+    void *ctx;
+} OrderPreTrade;
+
+struct OrderSession
+{
+    const OrderExchange *exchange;
+    int socket;
+    struct sockaddr_in server;
+    OrderHandlers handlers;
+    // Shared with other sessions, NULL for no client-side limit
+    RateLimiter *limiter;
+    // check is NULL for none
+    OrderPreTrade pre_trade;
+    int next_idx;
+    long long timeout_ns;
+
+    // Pool of requests, free ones chained through next
+    OrderRequest *pool;
+    unsigned int pool_size;
+    int free_head;
+    unsigned int inflight;
+
+    // idx -> pool position, linear probing, -1 = empty
+    int *keys;
+    int *values;
+    unsigned int table_mask;
+
+    int wheel[ORDER_WHEEL_SLOTS];
+    long long wheel_tick;
+
+    char send_buf[ORDER_BUFFER_SIZE];
+    // ORDER_RECV_BATCH receive buffers of ORDER_BUFFER_SIZE, one per mmsghdr
+    char *recv_bufs;
+    struct iovec recv_iov[ORDER_RECV_BATCH];
+    struct mmsghdr recv_msgs[ORDER_RECV_BATCH];
+
+    unsigned long sent;
+    unsigned long received;
+    unsigned long recv_calls;
+    unsigned long completed;
+    unsigned long timeouts;
+    unsigned long unmatched;
+    unsigned long auth_updates;
+    unsigned long errors;
+    unsigned long send_failures;
+    unsigned long rate_limited;
+    unsigned long risk_rejected;
+    LatencyHistogram rtt;
+};
+
+static inline long long order_wheel_now(void)
+{
+    return get_current_timestamp_ns() / (ORDER_WHEEL_TICK_MS * 1000000LL);
+}
+
+// Open a non-blocking session bound to local_port (0: any) that talks to
+// the EXCHANGE_* server at server_ip:server_port. At most max_inflight
+// requests can be outstanding; each one expires after timeout_ms without a
+// response. order_session_close() releases a session even if this failed.
+int order_session_open(OrderSession *s, int exchange, const char *server_ip, int server_port, int local_port,
+                       unsigned int max_inflight, int timeout_ms, const OrderHandlers *handlers)
+{
+    memset(s, 0, sizeof(*s));
+    s->socket = -1;
+    if (exchange < 0 || exchange >= EXCHANGE_COUNT)
+    {
+        fprintf(stderr, "unknown exchange %d\n", exchange);
+        return -1;
+    }
+    s->exchange = &order_exchanges[exchange];
+    if (max_inflight == 0)
+    {
+        fprintf(stderr, "order session needs max_inflight > 0\n");
+        return -1;
+    }
+
+    unsigned int table_size = 16;
+    while (table_size < max_inflight * 2)
+    {
+        table_size <<= 1;
+    }
+    s->pool = calloc(max_inflight, sizeof(OrderRequest));
+    s->keys = malloc(table_size * sizeof(int));
+    s->values = malloc(table_size * sizeof(int));
+    s->recv_bufs = malloc((size_t)ORDER_RECV_BATCH * ORDER_BUFFER_SIZE);
+    if (s->pool == NULL || s->keys == NULL || s->values == NULL || s->recv_bufs == NULL)
+    {
+        perror("order session allocation failed");
+        free(s->pool);
+        free(s->keys);
+        free(s->values);
+        free(s->recv_bufs);
+        s->pool = NULL;
+        s->keys = NULL;
+        s->values = NULL;
+        s->recv_bufs = NULL;
+        return -1;
+    }
+    for (int i = 0; i < ORDER_RECV_BATCH; i++)
+    {
+        // Leave one byte to NUL-terminate the datagram for order_parse
+        s->recv_iov[i].iov_base = s->recv_bufs + (size_t)i * ORDER_BUFFER_SIZE;
+        s->recv_iov[i].iov_len = ORDER_BUFFER_SIZE - 1;
+        s->recv_msgs[i].msg_hdr.msg_iov = &s->recv_iov[i];
+        s->recv_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    s->pool_size = max_inflight;
+    s->table_mask = table_size - 1;
+    memset(s->keys, 0xff, table_size * sizeof(int));
+    for (unsigned int i = 0; i < max_inflight; i++)
+    {
+        s->pool[i].next = i + 1 < max_inflight ? (int)i + 1 : -1;
+    }
+    s->free_head = 0;
+    for (int i = 0; i < ORDER_WHEEL_SLOTS; i++)
+    {
+        s->wheel[i] = -1;
+    }
+    s->wheel_tick = order_wheel_now();
+    s->timeout_ns = timeout_ms * 1000000LL;
+    s->handlers = *handlers;
+
+    s->socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s->socket < 0)
+    {
+        perror("Socket creation failed");
+        return -1;
+    }
+    int flags = fcntl(s->socket, F_GETFL, 0);
+    fcntl(s->socket, F_SETFL, flags | O_NONBLOCK);
+
+    struct sockaddr_in local_addr;
+    memset(&local_addr, 0, sizeof(local_addr));
+    local_addr.sin_family = AF_INET;
+    local_addr.sin_addr.s_addr = INADDR_ANY;
+    local_addr.sin_port = htons(local_port);
+    if (bind(s->socket, (struct sockaddr *)&local_addr, sizeof(local_addr)) < 0)
+    {
+        perror("Bind failed");
+        close(s->socket);
+        s->socket = -1;
+        return -1;
+    }
+
+    s->server.sin_family = AF_INET;
+    s->server.sin_addr.s_addr = inet_addr(server_ip);
+    s->server.sin_port = htons(server_port);
+    return 0;
+}
+
+void order_session_close(OrderSession *s)
+{
+    if (s->socket >= 0)
+    {
+        close(s->socket);
+        s->socket = -1;
+    }
+    free(s->pool);
+    free(s->keys);
+    free(s->values);
+    free(s->recv_bufs);
+    s->pool = NULL;
+    s->keys = NULL;
+    s->values = NULL;
+    s->recv_bufs = NULL;
+}
+
+// Descriptor to register with epoll/select; readable means poll has work
+static inline int order_session_fd(const OrderSession *s)
+{
+    return s->socket;
+}
+
+static int order_table_find(const OrderSession *s, int idx)
+{
+    for (unsigned int i = (unsigned int)idx & s->table_mask;; i = (i + 1) & s->table_mask)
+    {
+        if (s->keys[i] == idx)
+        {
+            return (int)i;
+        }
+        if (s->keys[i] < 0)
+        {
+            return -1;
+        }
+    }
+}
+
+static void order_table_insert(OrderSession *s, int idx, int pos)
+{
+    unsigned int i = (unsigned int)idx & s->table_mask;
+    while (s->keys[i] >= 0)
+    {
+        i = (i + 1) & s->table_mask;
+    }
+    s->keys[i] = idx;
+    s->values[i] = pos;
+}
+
+// Delete slot i, shifting later members of its probe run back so lookups
+// never need tombstones
+static void order_table_remove(OrderSession *s, unsigned int i)
+{
+    unsigned int j = i;
+    for (;;)
+    {
+        j = (j + 1) & s->table_mask;
+        if (s->keys[j] < 0)
+        {
+            break;
+        }
+        unsigned int home = (unsigned int)s->keys[j] & s->table_mask;
+        // Move j into the hole unless its home lies cyclically in (i, j]
+        if (((j - home) & s->table_mask) >= ((j - i) & s->table_mask))
+        {
+            s->keys[i] = s->keys[j];
+            s->values[i] = s->values[j];
+            i = j;
+        }
+    }
+    s->keys[i] = -1;
+}
+
+static void order_wheel_link(OrderSession *s, int pos, long long deadline_tick)
+{
+    OrderRequest *req = &s->pool[pos];
+    long long ticks = deadline_tick - s->wheel_tick;
+    if (ticks < 1)
+    {
+        ticks = 1;
+    }
+    req->slot = (int)((s->wheel_tick + ticks) & (ORDER_WHEEL_SLOTS - 1));
+    req->rounds = (unsigned int)((ticks - 1) / ORDER_WHEEL_SLOTS);
+    req->prev = -1;
+    req->next = s->wheel[req->slot];
+    if (req->next >= 0)
+    {
+        s->pool[req->next].prev = pos;
+    }
+    s->wheel[req->slot] = pos;
+}
+
+static void order_wheel_unlink(OrderSession *s, int pos)
+{
+    OrderRequest *req = &s->pool[pos];
+    if (req->prev >= 0)
+    {
+        s->pool[req->prev].next = req->next;
+    }
+    else
+    {
+        s->wheel[req->slot] = req->next;
+    }
+    if (req->next >= 0)
+    {
+        s->pool[req->next].prev = req->prev;
+    }
+}
+
+// Drop a request from the wheel and the table and return it to the pool
+static void order_release(OrderSession *s, int pos, int table_slot)
+{
+    order_wheel_unlink(s, pos);
+    order_table_remove(s, (unsigned int)table_slot);
+    s->pool[pos].next = s->free_head;
+    s->free_head = pos;
+    s->inflight--;
+}
+
+// Throttle requests through rl (NULL to stop); one limiter can serve any
+// number of sessions and threads
+static inline void order_session_set_limiter(OrderSession *s, RateLimiter *rl)
+{
+    s->limiter = rl;
+}
+
+// Check every place against pre_trade (NULL to stop)
+static inline void order_session_set_pre_trade(OrderSession *s, const OrderPreTrade *pre_trade)
+{
+    s->pre_trade = pre_trade != NULL ? *pre_trade : (OrderPreTrade){0};
+}
+
+static inline void *order_pre_trade_entry(const OrderSession *s, int account, const char *symbol)
+{
+    return s->pre_trade.resolve != NULL ? s->pre_trade.resolve(s->pre_trade.ctx, account, symbol) : NULL;
+}
+
+// Before order_admit for a place: 0 if the pre-trade checks let it go,
+// else ORDER_RISK_REJECTED
+static inline int order_pre_trade(OrderSession *s, void *entry, int side, double size, double price)
+{
+    if (s->pre_trade.check == NULL || s->pre_trade.check(s->pre_trade.ctx, entry, side, size, price) == 0)
+    {
+        return 0;
+    }
+    s->risk_rejected++;
+    return ORDER_RISK_REJECTED;
+}
+
+// After a place: books it with the pre-trade checks if it went out.
+// Passes idx through.
+static inline int order_pre_trade_sent(OrderSession *s, void *entry, int side, double size, int idx)
+{
+    if (idx >= 0 && s->pre_trade.on_sent != NULL)
+    {
+        s->pre_trade.on_sent(s->pre_trade.ctx, entry, side, size);
+    }
+    return idx;
+}
+
+static inline int order_rate_class(int kind)
+{
+    return kind == ORDER_CONNECT ? RATE_CLASS_CONNECT : RATE_CLASS_ORDER;
+}
+
+// Whether a request of kind may be sent now: takes its rate limit token
+// (cancels in the priority lane). Returns 0, -1 if the session is full or
+// the limiter has no bucket for the account, or ORDER_RATE_LIMITED.
+static inline int order_admit(OrderSession *s, int kind, int account)
+{
+    if (s->free_head < 0)
+    {
+        s->send_failures++;
+        return -1;
+    }
+    if (s->limiter == NULL)
+    {
+        return 0;
+    }
+    int lane = kind == ORDER_CANCEL ? RATE_LANE_CANCEL : RATE_LANE_NORMAL;
+    int admitted = rate_limiter_acquire(s->limiter, (int)(s->exchange - order_exchanges), account,
+                                        order_rate_class(kind), lane);
+    if (admitted < 0)
+    {
+        s->send_failures++;
+        return -1;
+    }
+    if (admitted == 0)
+    {
+        s->rate_limited++;
+        return ORDER_RATE_LIMITED;
+    }
+    return 0;
+}
+
+// After order_admit: a request that failed to encode or send gives its
+// token back. Passes idx through.
+static inline int order_admitted(OrderSession *s, int kind, int account, int idx)
+{
+    if (idx < 0 && s->limiter != NULL)
+    {
+        rate_limiter_refund(s->limiter, (int)(s->exchange - order_exchanges), account, order_rate_class(kind));
+    }
+    return idx;
+}
+
+// idx that the next request sent on the session will carry
+static inline int order_next_idx(const OrderSession *s)
+{
+    return s->next_idx;
+}
+
+// Send a complete request that was encoded with idx order_next_idx(s) and
+// start tracking it. Returns that idx, or -1 if the session is full or
+// sendto failed. Not rate limited: call order_admit first.
+int order_send_encoded(OrderSession *s, int kind, int account, const char *msg, int len, void *user)
+{
+    if (s->free_head < 0)
+    {
+        s->send_failures++;
+        return -1;
+    }
+    int idx = s->next_idx;
+    long long now = get_current_timestamp_ns();
+    if (sendto(s->socket, msg, len, 0, (struct sockaddr *)&s->server, sizeof(s->server)) < 0)
+    {
+        perror("sendto failed");
+        s->send_failures++;
+        return -1;
+    }
+    // idx stays unique among in-flight requests; it wraps after 2^31
+    s->next_idx = idx == INT_MAX ? 0 : idx + 1;
+
+    int pos = s->free_head;
+    OrderRequest *req = &s->pool[pos];
+    s->free_head = req->next;
+    req->idx = idx;
+    req->kind = kind;
+    req->account = account;
+    req->sent_ns = now;
+    req->user = user;
+    order_table_insert(s, idx, pos);
+    // Round up so a request never expires before its full timeout
+    order_wheel_link(s, pos, (now + s->timeout_ns) / (ORDER_WHEEL_TICK_MS * 1000000LL) + 1);
+    s->inflight++;
+    s->sent++;
+    return idx;
+}
+
+// Send a request whose body (everything after "idx,") is already encoded.
+// Returns the idx assigned to it, or -1 on failure. Not rate limited.
+int order_send(OrderSession *s, int kind, int account, const char *body, int len, void *user)
+{
+    int head = fmt_uint(s->send_buf, (unsigned int)s->next_idx);
+    s->send_buf[head++] = ',';
+    if (head + len > (int)sizeof(s->send_buf))
+    {
+        s->send_failures++;
+        return -1;
+    }
+    memcpy(s->send_buf + head, body, len);
+    return order_send_encoded(s, kind, account, s->send_buf, head + len, user);
+}
+
+// Connect (mode 0). passphrase is the exchange's third credential (OKX/
+// Bitget passphrase, Gate.io user_id), NULL or "" to omit; account_index
+// < 0 lets the server assign one. Exchanges without accounts ignore it.
+int order_connect(OrderSession *s, const char *api_key, const char *api_secret,
+                  const char *passphrase, int account_index, void *user)
+{
+    int admit = order_admit(s, ORDER_CONNECT, account_index);
+    if (admit < 0)
+    {
+        return admit;
+    }
+    char body[1024];
+    int len = s->exchange->encode_connect(body, sizeof(body), api_key, api_secret, passphrase, account_index);
+    int idx = len < 0 ? -1 : order_send(s, ORDER_CONNECT, account_index, body, len, user);
+    return order_admitted(s, ORDER_CONNECT, account_index, idx);
+}
+
+// Place (mode 1) with the exchange's fields out of account, symbol,
+// client_order_id, pos_side, side, order_type, size, price. size and price
+// are written with up to 8 decimals; on the hot path use an OrderTemplate
+// (order_place_fast), which also snaps them to tick and lot.
+int order_place(OrderSession *s, int account, const char *symbol, const char *client_order_id,
+                int pos_side, int side, int order_type, double size, double price, void *user)
+{
+    void *entry = order_pre_trade_entry(s, account, symbol);
+    int admit = order_pre_trade(s, entry, side, size, price);
+    if (admit == 0)
+    {
+        admit = order_admit(s, ORDER_PLACE, account);
+    }
+    if (admit < 0)
+    {
+        return admit;
+    }
+    char body[512];
+    int len = s->exchange->encode_place(body, s->exchange->fields, account, symbol, client_order_id, pos_side,
+                                        side, order_type, order_round(size * 1e8), order_round(price * 1e8), 8);
+    int idx = len < 0 ? -1 : order_send(s, ORDER_PLACE, account, body, len, user);
+    return order_pre_trade_sent(s, entry, side, size, order_admitted(s, ORDER_PLACE, account, idx));
+}
+
+// Cancel (mode -1): [account,]symbol,client_order_id
+int order_cancel(OrderSession *s, int account, const char *symbol, const char *client_order_id, void *user)
+{
+    int admit = order_admit(s, ORDER_CANCEL, account);
+    if (admit < 0)
+    {
+        return admit;
+    }
+    char body[512];
+    int len = s->exchange->encode_cancel(body, s->exchange->fields, account, symbol, client_order_id);
+    int idx = len < 0 ? -1 : order_send(s, ORDER_CANCEL, account, body, len, user);
+    return order_admitted(s, ORDER_CANCEL, account, idx);
+}
+
+// order_template_init with the session's exchange field layout
+static inline int order_session_template(const OrderSession *s, OrderTemplate *t, int account, const char *symbol,
+                                         double tick_size, double lot_size, const char *cid_prefix,
+                                         unsigned long long first_cid)
+{
+    if (order_template_init(t, s->exchange->fields, account, symbol, tick_size, lot_size, cid_prefix,
+                            first_cid) < 0)
+    {
+        return -1;
+    }
+    t->pre_trade = order_pre_trade_entry(s, account, symbol);
+    return 0;
+}
+
+// Place through a template: size and price in whole lots and ticks
+// (order_size_lots/order_price_ticks convert). The client_order_id counter
+// used is stored in *cid. Returns the idx, -1 (also once the template's
+// counter is exhausted), ORDER_RATE_LIMITED or ORDER_RISK_REJECTED.
+static inline int order_place_fast(OrderSession *s, OrderTemplate *t, int pos_side, int side,
+                                   int order_type, long long size_lots, long long price_ticks,
+                                   unsigned long long *cid, void *user)
+{
+    double size = size_lots * t->lot_size;
+    int admit = order_pre_trade(s, t->pre_trade, side, size, price_ticks * t->tick_size);
+    if (admit == 0)
+    {
+        admit = order_admit(s, ORDER_PLACE, t->account);
+    }
+    if (admit < 0)
+    {
+        return admit;
+    }
+    const char *msg;
+    *cid = order_template_next_cid(t);
+    if (*cid == ORDER_CID_EXHAUSTED)
+    {
+        s->send_failures++;
+        return order_admitted(s, ORDER_PLACE, t->account, -1);
+    }
+    int len = order_encode_place(t, s->next_idx, *cid, pos_side, side, order_type,
+                                 size_lots, price_ticks, &msg);
+    int idx = order_send_encoded(s, ORDER_PLACE, t->account, msg, len, user);
+    idx = order_admitted(s, ORDER_PLACE, t->account, idx);
+    return order_pre_trade_sent(s, t->pre_trade, side, size, idx);
+}
+
+// Cancel the template's order with counter cid
+static inline int order_cancel_fast(OrderSession *s, OrderTemplate *t, unsigned long long cid, void *user)
+{
+    int admit = order_admit(s, ORDER_CANCEL, t->account);
+    if (admit < 0)
+    {
+        return admit;
+    }
+    const char *msg;
+    int len = order_encode_cancel(t, s->next_idx, cid, &msg);
+    return order_admitted(s, ORDER_CANCEL, t->account, order_send_encoded(s, ORDER_CANCEL, t->account, msg, len, user));
+}
+
+// Type of an untyped response to a request of the given kind
+static inline char order_classify_untyped(int kind, const OrderResponse *resp)
+{
+    if (kind != ORDER_CONNECT)
+    {
+        return ORDER_RESP_EXC;
+    }
+    return resp->payload_len >= 9 && memcmp(resp->payload, "connected", 9) == 0 ? ORDER_RESP_ACK : ORDER_RESP_ERR;
+}
+
+static void order_dispatch(OrderSession *s, OrderResponse *resp)
+{
+    const OrderHandlers *h = &s->handlers;
+    if (resp->type == ORDER_RESP_AUTH)
+    {
+        s->auth_updates++;
+        if (h->on_auth != NULL)
+        {
+            h->on_auth(s, resp, h->ctx);
+        }
+        return;
+    }
+
+    int slot = order_table_find(s, resp->idx);
+    if (slot < 0)
+    {
+        s->unmatched++;
+        if (resp->type == ORDER_RESP_UNTYPED)
+        {
+            resp->type = ORDER_RESP_EXC;
+        }
+        if (h->on_response != NULL)
+        {
+            h->on_response(s, NULL, resp, h->ctx);
+        }
+        return;
+    }
+    int pos = s->values[slot];
+    // Copy out so the callback may send new requests that reuse the slot
+    OrderRequest req = s->pool[pos];
+    order_release(s, pos, slot);
+    s->completed++;
+    if (resp->type == ORDER_RESP_UNTYPED)
+    {
+        resp->type = order_classify_untyped(req.kind, resp);
+    }
+    if (resp->type == ORDER_RESP_ERR)
+    {
+        s->errors++;
+    }
+    hist_record(&s->rtt, resp->recv_ns - req.sent_ns);
+    if (h->on_response != NULL)
+    {
+        h->on_response(s, &req, resp, h->ctx);
+    }
+}
+
+// Expire everything whose deadline has passed; order_session_poll does
+// this too, call it directly for sessions that had nothing to read
+int order_session_expire(OrderSession *s)
+{
+    int expired = 0;
+    long long now_tick = order_wheel_now();
+    while (s->wheel_tick < now_tick)
+    {
+        s->wheel_tick++;
+        int pos = s->wheel[s->wheel_tick & (ORDER_WHEEL_SLOTS - 1)];
+        while (pos >= 0)
+        {
+            int next = s->pool[pos].next;
+            if (s->pool[pos].rounds > 0)
+            {
+                s->pool[pos].rounds--;
+            }
+            else
+            {
+                OrderRequest req = s->pool[pos];
+                order_release(s, pos, order_table_find(s, req.idx));
+                s->timeouts++;
+                expired++;
+                if (s->handlers.on_timeout != NULL)
+                {
+                    s->handlers.on_timeout(s, &req, s->handlers.ctx);
+                }
+            }
+            pos = next;
+        }
+    }
+    return expired;
+}
+
+// Drain every queued response without blocking, up to ORDER_RECV_BATCH
+// datagrams per syscall, then run due timeouts. Returns the number of
+// responses, auth updates and timeouts delivered.
+int order_session_poll(OrderSession *s)
+{
+    int events = 0;
+    for (;;)
+    {
+        int n = recvmmsg(s->socket, s->recv_msgs, ORDER_RECV_BATCH, MSG_DONTWAIT, NULL);
+        if (n <= 0)
+        {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                perror("recvmmsg failed");
+            }
+            break;
+        }
+        s->recv_calls++;
+        s->received += n;
+        long long now = get_current_timestamp_ns();
+        for (int i = 0; i < n; i++)
+        {
+            char *buf = (char *)s->recv_iov[i].iov_base;
+            int len = (int)s->recv_msgs[i].msg_len;
+            buf[len] = '\0';
+            OrderResponse resp;
+            if (order_parse(buf, len, &resp) < 0)
+            {
+                fprintf(stderr, "unparsable order response: %.80s\n", buf);
+                continue;
+            }
+            resp.recv_ns = now;
+            order_dispatch(s, &resp);
+            events++;
+        }
+        // A short batch means the queue is empty, skip the EAGAIN call
+        if (n < ORDER_RECV_BATCH)
+        {
+            break;
+        }
+    }
+    return events + order_session_expire(s);
+}
+
+// Milliseconds until the next wheel tick, a suitable epoll_wait timeout
+// while requests are in flight (-1: nothing to time out)
+static inline int order_session_next_timeout_ms(const OrderSession *s)
+{
+    return s->inflight > 0 ? ORDER_WHEEL_TICK_MS : -1;
+}
+
+// Block until every in-flight request has completed or timed out
+void order_session_wait(OrderSession *s)
+{
+    struct pollfd pfd = {.fd = s->socket, .events = POLLIN};
+    while (s->inflight > 0)
+    {
+        poll(&pfd, 1, order_session_next_timeout_ms(s));
+        order_session_poll(s);
+    }
+}
+
+void print_order_session_stats(const OrderSession *s)
+{
+    static HistogramSnapshot snap;
+    hist_snapshot(&s->rtt, &snap);
+    printf("=== Order Session Stats (%s) ===\n", s->exchange->name);
+    printf("sent %lu, completed %lu (errors %lu), timeouts %lu, unmatched %lu, auth updates %lu, "
+           "send failures %lu, rate limited %lu, risk rejected %lu, in flight %u\n",
+           s->sent, s->completed, s->errors, s->timeouts, s->unmatched, s->auth_updates,
+           s->send_failures, s->rate_limited, s->risk_rejected, s->inflight);
+    printf("received %lu datagrams in %lu recvmmsg calls (%.2f per call)\n", s->received, s->recv_calls,
+           s->recv_calls > 0 ? (double)s->received / s->recv_calls : 0.0);
+    if (snap.total > 0)
+    {
+        printf("rtt us: p50 %.1f, p99 %.1f, max %.1f\n",
+               hist_percentile(&snap, 0.50) / 1e3,
+               hist_percentile(&snap, 0.99) / 1e3,
+               snap.max / 1e3);
+    }
+    printf("===========================\n");
+}
+
+#endif // QTX_ORDER_SESSION_C
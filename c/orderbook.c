@@ -0,0 +1,281 @@
+#ifndef QTX_ORDERBOOK_C
+#define QTX_ORDERBOOK_C
+
+#include "sdk.c"
+#include <math.h>
+
+// Levels kept per side; deeper levels of a snapshot are dropped
+#ifndef BOOK_MAX_LEVELS
+#define BOOK_MAX_LEVELS 256
+#endif
+
+#define BOOK_BID 1
+#define BOOK_ASK -1
+
+// Local L2 book rebuilt from Msg2 snapshots and patched by L1 ticks.
+// Each side is a pair of contiguous arrays ordered best first (asks
+// ascending, bids descending), so the best level is always index 0 and
+// top-N reads are sequential. No allocation happens after book_create().
+typedef struct
+{
+    double ask_price[BOOK_MAX_LEVELS];
+    double ask_size[BOOK_MAX_LEVELS];
+    double bid_price[BOOK_MAX_LEVELS];
+    double bid_size[BOOK_MAX_LEVELS];
+    int asks_len;
+    int bids_len;
+    // Header of the last applied snapshot or tick
+    long sn_id;
+    long event_ms;
+    long local_ns;
+    unsigned long snapshots;
+    unsigned long l1_updates;
+} OrderBook;
+
+// Read-only view of the best len levels of one side
+typedef struct
+{
+    const double *price;
+    const double *size;
+    int len;
+} BookSide;
+
+void book_init(OrderBook *book)
+{
+    book->asks_len = 0;
+    book->bids_len = 0;
+    book->sn_id = 0;
+    book->event_ms = 0;
+    book->local_ns = 0;
+    book->snapshots = 0;
+    book->l1_updates = 0;
+}
+
+OrderBook *book_create()
+{
+    OrderBook *book = malloc(sizeof(OrderBook));
+    if (book == NULL)
+    {
+        perror("order book allocation failed");
+        return NULL;
+    }
+    book_init(book);
+    return book;
+}
+
+void book_destroy(OrderBook *book)
+{
+    free(book);
+}
+
+// Copy up to BOOK_MAX_LEVELS levels into one side, sorting only if the
+// feed delivered them out of order. dir is 1 for ascending, -1 for descending.
+static int book_load_side(double *price, double *size, const Msg2Level *levels, int len, int dir)
+{
+    int n = len < BOOK_MAX_LEVELS ? len : BOOK_MAX_LEVELS;
+    int sorted = 1;
+    for (int i = 0; i < n; i++)
+    {
+        price[i] = levels[i].price;
+        size[i] = levels[i].size;
+        if (i > 0 && (price[i] - price[i - 1]) * dir < 0)
+        {
+            sorted = 0;
+        }
+    }
+
+    if (!sorted)
+    {
+        for (int i = 1; i < n; i++)
+        {
+            double p = price[i];
+            double s = size[i];
+            int j = i - 1;
+            while (j >= 0 && (price[j] - p) * dir > 0)
+            {
+                price[j + 1] = price[j];
+                size[j + 1] = size[j];
+                j--;
+            }
+            price[j + 1] = p;
+            size[j + 1] = s;
+        }
+    }
+    return n;
+}
+
+// Replace the whole book with a depth snapshot (asks_len asks followed by bids_len bids)
+void book_apply_snapshot(OrderBook *book, const Msg2 *msg2, const Msg2Level *levels)
+{
+    book->asks_len = book_load_side(book->ask_price, book->ask_size,
+                                    levels, msg2->asks_len, 1);
+    book->bids_len = book_load_side(book->bid_price, book->bid_size,
+                                    levels + msg2->asks_len, msg2->bids_len, -1);
+    book->sn_id = msg2->sn_id;
+    book->event_ms = msg2->event_ms;
+    book->local_ns = msg2->local_ns;
+    book->snapshots++;
+}
+
+// Drop the first n levels of a side
+static inline void book_pop_front(double *price, double *size, int *len, int n)
+{
+    if (n <= 0)
+    {
+        return;
+    }
+    *len -= n;
+    memmove(price, price + n, *len * sizeof(double));
+    memmove(size, size + n, *len * sizeof(double));
+}
+
+// Make (p, s) the best level of a side whose levels are ordered by dir
+static void book_set_top(double *price, double *size, int *len, int dir, double p, double s)
+{
+    // Levels better than or equal to the new top are gone
+    int drop = 0;
+    while (drop < *len && (price[drop] - p) * dir <= 0)
+    {
+        drop++;
+    }
+    book_pop_front(price, size, len, drop);
+    if (s <= 0)
+    {
+        return;
+    }
+
+    if (*len == BOOK_MAX_LEVELS)
+    {
+        (*len)--;
+    }
+    memmove(price + 1, price, *len * sizeof(double));
+    memmove(size + 1, size, *len * sizeof(double));
+    price[0] = p;
+    size[0] = s;
+    (*len)++;
+}
+
+// Update the top of book from an L1 tick (msg_type 1: bid, -1: ask).
+// Ticks older than the last snapshot are ignored; levels on the opposite
+// side that the new quote crosses are removed.
+void book_apply_l1(OrderBook *book, const Msg *msg)
+{
+    if (msg->event_ms < book->event_ms)
+    {
+        return;
+    }
+
+    if (msg->msg_type == 1)
+    {
+        book_set_top(book->bid_price, book->bid_size, &book->bids_len, -1, msg->price, msg->size);
+        int crossed = 0;
+        while (crossed < book->asks_len && book->ask_price[crossed] <= msg->price)
+        {
+            crossed++;
+        }
+        book_pop_front(book->ask_price, book->ask_size, &book->asks_len, crossed);
+    }
+    else if (msg->msg_type == -1)
+    {
+        book_set_top(book->ask_price, book->ask_size, &book->asks_len, 1, msg->price, msg->size);
+        int crossed = 0;
+        while (crossed < book->bids_len && book->bid_price[crossed] >= msg->price)
+        {
+            crossed++;
+        }
+        book_pop_front(book->bid_price, book->bid_size, &book->bids_len, crossed);
+    }
+    else
+    {
+        return;
+    }
+
+    book->event_ms = msg->event_ms;
+    book->local_ns = msg->local_ns;
+    book->l1_updates++;
+}
+
+// Best prices, NAN when the side is empty
+static inline double book_best_bid(const OrderBook *book)
+{
+    return book->bids_len > 0 ? book->bid_price[0] : NAN;
+}
+
+static inline double book_best_ask(const OrderBook *book)
+{
+    return book->asks_len > 0 ? book->ask_price[0] : NAN;
+}
+
+// Top n levels of a side (BOOK_BID or BOOK_ASK) without copying
+BookSide book_top(const OrderBook *book, int side, int n)
+{
+    BookSide view;
+    if (side == BOOK_BID)
+    {
+        view.price = book->bid_price;
+        view.size = book->bid_size;
+        view.len = n < book->bids_len ? n : book->bids_len;
+    }
+    else
+    {
+        view.price = book->ask_price;
+        view.size = book->ask_size;
+        view.len = n < book->asks_len ? n : book->asks_len;
+    }
+    if (view.len < 0)
+    {
+        view.len = 0;
+    }
+    return view;
+}
+
+// Mid weighted by the opposite side's cumulative size over the top depth
+// levels: (bid_vwap * ask_qty + ask_vwap * bid_qty) / (bid_qty + ask_qty).
+// depth = 1 gives the classic micro-price. NAN if either side is empty.
+double book_weighted_mid(const OrderBook *book, int depth)
+{
+    BookSide bids = book_top(book, BOOK_BID, depth);
+    BookSide asks = book_top(book, BOOK_ASK, depth);
+    double bid_qty = 0, bid_notional = 0;
+    double ask_qty = 0, ask_notional = 0;
+    for (int i = 0; i < bids.len; i++)
+    {
+        bid_qty += bids.size[i];
+        bid_notional += bids.price[i] * bids.size[i];
+    }
+    for (int i = 0; i < asks.len; i++)
+    {
+        ask_qty += asks.size[i];
+        ask_notional += asks.price[i] * asks.size[i];
+    }
+    if (bid_qty <= 0 || ask_qty <= 0)
+    {
+        return NAN;
+    }
+    double bid_vwap = bid_notional / bid_qty;
+    double ask_vwap = ask_notional / ask_qty;
+    return (bid_vwap * ask_qty + ask_vwap * bid_qty) / (bid_qty + ask_qty);
+}
+
+// Total size available at price or better on a side
+double book_cum_size(const OrderBook *book, int side, double price)
+{
+    double total = 0;
+    if (side == BOOK_BID)
+    {
+        for (int i = 0; i < book->bids_len && book->bid_price[i] >= price; i++)
+        {
+            total += book->bid_size[i];
+        }
+    }
+    else
+    {
+        for (int i = 0; i < book->asks_len && book->ask_price[i] <= price; i++)
+        {
+            total += book->ask_size[i];
+        }
+    }
+    return total;
+}
+
+#endif // QTX_ORDERBOOK_C
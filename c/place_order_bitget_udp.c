@@ -48,19 +48,14 @@
  * EXAMPLE USAGE:
  * 1. Update SERVER_IP and SERVER_PORT to match your server
  * 2. Replace API_KEY, API_SECRET, API_PASS with real credentials
- * 3. Compile: gcc -o bitget_client place_order_bitget_udp.c
+ * 3. Compile: gcc -O2 -pthread -o bitget_client place_order_bitget_udp.c
  * 4. Run: ./bitget_client
  */
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <arpa/inet.h>
-#include <time.h>
+#include "order_session.c"
+#include "risk_check.c"
 
 // Client configuration
-#define CLIENT_IP "0.0.0.0"        // Bind to any available interface
 #define CLIENT_PORT 6668           // Local port (0 for OS-assigned)
 
 // Server configuration - UPDATE THESE
@@ -68,107 +63,130 @@
 #define SERVER_PORT 6669           // Your server port (default: 6666)
 
 // Protocol constants
-#define BUFFER_SIZE 1500          // UDP buffer size
 #define API_KEY "API_KEY"         // Replace with your API key
 #define API_SECRET "API_SECRET"   // Replace with your API secret
 #define API_PASS "API_PASS"       // Replace with your API passphrase
 
+#define MAX_INFLIGHT 1024         // Requests that may be outstanding at once
+#define RECV_TIMEOUT_SEC 5        // Per-request response timeout in seconds
+#define MAX_ACCOUNTS 16           // Account indexes the rate limiter has buckets for
+
+// Market data feed (sdk.c) the price band check is quoted from
+#define FEED_SYMBOL "bitget-futures:BTCUSDT" // stream.c's name of the traded symbol
+#define FEED_INDEXES 1024         // Feed symbol indexes the risk checker keeps quotes for
+#define FEED_TIMEOUT_MS 3000      // How long to wait for the first quote
+
+// Pre-trade limits for BTCUSDT (0 = no limit)
+static const RiskLimits risk_limits = {
+    .max_size = 0.1,           // BTC per order
+    .max_notional = 10000.0,   // USDT per order
+    .price_band_bps = 50,      // At most 0.5% through the best bid/ask
+    .max_open_orders = 10,
+    .max_position = 0.5,       // BTC long or short
+};
+
 // Get UNIX timestamp for client_order_id
 long unix_time()
 {
     return (long)time(NULL);
 }
 
-// Send UDP message and wait for response
-void send_udp_message(int sock, struct sockaddr_in *server_addr, const char *message)
+// Bitget responses are untyped ("idx:message"); the session classifies
+// them: "connected" is ORDER_RESP_ACK, a failed connect ORDER_RESP_ERR and
+// exchange JSON ORDER_RESP_EXC
+void handle_response(OrderSession *s, const OrderRequest *req, const OrderResponse *resp, void *ctx)
 {
-    char buffer[BUFFER_SIZE];
-
-    // Send message to server
-    printf("Sending: %s\n", message);
-    sendto(sock, message, strlen(message), 0, (struct sockaddr *)server_addr, sizeof(*server_addr));
-
-    // Receive response from server
-    socklen_t addr_len = sizeof(*server_addr);
-    ssize_t received_bytes = recvfrom(sock, buffer, BUFFER_SIZE - 1, 0, (struct sockaddr *)server_addr, &addr_len);
-
-    if (received_bytes > 0)
-    {
-        buffer[received_bytes] = '\0'; // Null-terminate the string
-        printf("Received: %s\n\n", buffer);
-    }
-    else
+    printf("Received: %d:%.*s\n", resp->idx, resp->payload_len, resp->payload);
+    if (req != NULL && req->kind == ORDER_CONNECT && resp->type != ORDER_RESP_ACK)
     {
-        printf("Error: No response received\n\n");
+        printf("Error: connection failed\n");
     }
+    printf("\n");
+}
+
+void handle_timeout(OrderSession *s, const OrderRequest *req, void *ctx)
+{
+    printf("Error: No response received for idx %d\n\n", req->idx);
 }
 
 int main()
 {
-    // Create UDP socket
-    int sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock < 0)
+    // Holds the send and receive buffers, too large for the stack
+    static OrderSession session;
+    static RateLimiter limiter;
+    if (rate_limiter_init(&limiter, MAX_ACCOUNTS) < 0)
     {
-        perror("Socket creation failed");
         exit(EXIT_FAILURE);
     }
-
-    // Configure local address for binding
-    struct sockaddr_in local_addr;
-    memset(&local_addr, 0, sizeof(local_addr));
-    local_addr.sin_family = AF_INET;
-    local_addr.sin_addr.s_addr = inet_addr(CLIENT_IP);
-    local_addr.sin_port = htons(CLIENT_PORT);
-
-    // Bind to local port
-    if (bind(sock, (struct sockaddr *)&local_addr, sizeof(local_addr)) < 0)
+    OrderHandlers handlers = {
+        .on_response = handle_response,
+        .on_timeout = handle_timeout,
+    };
+
+    // Non-blocking socket bound to CLIENT_PORT on any interface
+    if (order_session_open(&session, EXCHANGE_BITGET, SERVER_IP, SERVER_PORT, CLIENT_PORT,
+                           MAX_INFLIGHT, RECV_TIMEOUT_SEC * 1000, &handlers) < 0)
     {
-        perror("Bind failed");
-        close(sock);
         exit(EXIT_FAILURE);
     }
+    order_session_set_limiter(&session, &limiter);
+    // Holds latency histograms, too large for the stack
+    static RiskChecker risk;
+    if (risk_init(&risk, 16, FEED_INDEXES) < 0 || risk_feed_open() < 0)
+    {
+        exit(EXIT_FAILURE);
+    }
+    // Every place on the session is checked first, refused if it fails
+    risk_attach(&risk, &session);
 
     printf("Bitget UDP Client started\n");
     printf("Server: %s:%d\n\n", SERVER_IP, SERVER_PORT);
 
-    // Configure server address
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = inet_addr(SERVER_IP);
-    server_addr.sin_port = htons(SERVER_PORT);
-
     // Generate unique client_order_id using timestamp
-    long client_order_id = unix_time();
+    char client_order_id[32];
+    snprintf(client_order_id, sizeof(client_order_id), "%ld", unix_time());
 
     // 1. CONNECT - Establish WebSocket connection with credentials
     printf("=== Step 1: Connect to Bitget ===\n");
-    char connect_msg[BUFFER_SIZE];
-    snprintf(connect_msg, sizeof(connect_msg), "0,0,%s,%s,%s", API_KEY, API_SECRET, API_PASS);
-    send_udp_message(sock, &server_addr, connect_msg);
+    order_connect(&session, API_KEY, API_SECRET, API_PASS, -1, NULL);
+    order_session_wait(&session);
 
-    // Wait briefly between operations
-    sleep(1);
-
-    // 2. PLACE ORDER - Create a PostOnly buy order
+    // 2. PLACE ORDER - Create a PostOnly buy order; the session sends it
+    // only if it passes the pre-trade risk checks against the feed's BBO
     printf("=== Step 2: Place Order ===\n");
     printf("Order: PostOnly BUY 0.02 BTC at $80,000\n");
-    char place_order_msg[BUFFER_SIZE];
-    snprintf(place_order_msg, sizeof(place_order_msg), 
-             "1,1,BTCUSDT,%ld,1,1,0.02,80000.0", client_order_id);
-    send_udp_message(sock, &server_addr, place_order_msg);
-
-    sleep(1);
+    // Without a quote no limits are added and the session refuses the order
+    int quote_index = risk_feed_quote(&risk, FEED_SYMBOL, FEED_TIMEOUT_MS);
+    if (quote_index >= 0 && risk_add_symbol(&risk, 0, "BTCUSDT", quote_index, &risk_limits) == NULL)
+    {
+        exit(EXIT_FAILURE);
+    }
+    int idx = order_place(&session, 0, "BTCUSDT", client_order_id, 0, 1, 1, 0.02, 80000.0, NULL);
+    if (idx == ORDER_RISK_REJECTED)
+    {
+        printf("Order not sent (risk checks failed, see the stats below)\n");
+    }
+    else if (idx < 0)
+    {
+        printf("Order not sent (session full, rate limited or send failed)\n");
+    }
+    else
+    {
+        order_session_wait(&session);
+    }
 
     // 3. CANCEL ORDER - Cancel the previously placed order
     printf("=== Step 3: Cancel Order ===\n");
-    char cancel_order_msg[BUFFER_SIZE];
-    snprintf(cancel_order_msg, sizeof(cancel_order_msg), 
-             "2,-1,BTCUSDT,%ld", client_order_id);
-    send_udp_message(sock, &server_addr, cancel_order_msg);
-
-    // Close socket
-    close(sock);
+    order_cancel(&session, 0, "BTCUSDT", client_order_id, NULL);
+    order_session_wait(&session);
+
+    print_order_session_stats(&session);
+    print_risk_stats(&risk);
+    print_rate_limiter_stats(&limiter);
+    order_session_close(&session);
+    risk_feed_close();
+    risk_free(&risk);
+    rate_limiter_free(&limiter);
 
     return 0;
 }
@@ -211,15 +211,9 @@
  * "10,0,API_KEY,API_SECRET,,5"                → "10:k:2" (assigned to index 2, not 5)
  */
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <arpa/inet.h>
-#include <time.h>
-#include <errno.h>
-#include <sys/select.h>
-#include <fcntl.h>
+#include "order_session.c"
+#include "order_json.c"
+#include "risk_check.c"
 
 // Server connection settings
 #define SERVER_IP "10.11.4.97"
@@ -233,27 +227,31 @@
 #define API_SECRET "YOUR_API_SECRET"
 #define USER_ID "YOUR_USER_ID" // Required for auth stream (private channel subscriptions). Leave empty if not needed.
 
-#define BUFFER_SIZE 65536  // Large buffer for JSON responses
-#define RECV_TIMEOUT_SEC 5 // Response timeout in seconds
+#define MAX_INFLIGHT 1024  // Requests that may be outstanding at once
+#define RECV_TIMEOUT_SEC 5 // Per-request response timeout in seconds
+#define MAX_ACCOUNTS 16    // Account indexes the rate limiter has buckets for
 
-// Response types (single character for network efficiency)
-#define RESP_ACK "k"
-#define RESP_ERR "e"
-#define RESP_EXC "r"
-#define RESP_AUTH "a"
+// Market data feed (sdk.c) the price band check is quoted from
+#define FEED_SYMBOL "gate-io-futures:BTC_USDT" // stream.c's name of the traded symbol
+#define FEED_INDEXES 1024    // Feed symbol indexes the risk checker keeps quotes for
+#define FEED_TIMEOUT_MS 3000 // How long to wait for the first quote
 
-// Response structure
-typedef struct {
-    int idx;
-    char response_type[16];
-    char payload[BUFFER_SIZE - 32];
-    int is_valid;
-} Response;
+// Pre-trade limits for BTC_USDT (0 = no limit). Sizes are in contracts,
+// so size * price is no notional and that check is left off.
+static const RiskLimits risk_limits = {
+    .max_size = 1000,          // Contracts per order
+    .price_band_bps = 50,      // At most 0.5% through the best bid/ask
+    .max_open_orders = 10,
+    .max_position = 5000,      // Contracts long or short
+};
 
-// Get UNIX timestamp
-long unix_time() {
-    return (long)time(NULL);
-}
+// Simple error response format: "ERROR_TYPE-description"
+// Example: "INVALID_FORMAT-missing required fields"
+// Example: "NOT_CONNECTED-please connect first"
+
+typedef struct {
+    int account_index;
+} ClientState;
 
 // Get UNIX timestamp in milliseconds
 long long unix_time_millis() {
@@ -262,222 +260,153 @@ long long unix_time_millis() {
     return (long long)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL;
 }
 
-// Parse response into structured format
-Response parse_response(const char *raw_response) {
-    Response resp = {0};
-    resp.is_valid = 0;
-    
-    // Find first colon
-    const char *first_colon = strchr(raw_response, ':');
-    if (!first_colon) return resp;
-    
-    // Find second colon
-    const char *second_colon = strchr(first_colon + 1, ':');
-    if (!second_colon) return resp;
-    
-    // Parse idx
-    char idx_str[16] = {0};
-    size_t idx_len = first_colon - raw_response;
-    if (idx_len >= sizeof(idx_str)) return resp;
-    strncpy(idx_str, raw_response, idx_len);
-    resp.idx = atoi(idx_str);
-    
-    // Parse response type
-    size_t type_len = second_colon - first_colon - 1;
-    if (type_len >= sizeof(resp.response_type)) return resp;
-    strncpy(resp.response_type, first_colon + 1, type_len);
-    
-    // Copy payload
-    strncpy(resp.payload, second_colon + 1, sizeof(resp.payload) - 1);
-    
-    resp.is_valid = 1;
-    return resp;
-}
-
-// Simple error response format: "ERROR_TYPE-description"
-// Example: "INVALID_FORMAT-missing required fields"
-// Example: "NOT_CONNECTED-please connect first"
+#define MAX_FILLS 16 // Orders extracted from one JSON payload
 
-// Send UDP message and wait for single response with timeout
-int send_and_receive(int sock, struct sockaddr_in *server_addr, 
-                     const char *message, Response *response) {
-    char buffer[BUFFER_SIZE];
-    
-    // Send message
-    if (sendto(sock, message, strlen(message), 0, 
-               (struct sockaddr *)server_addr, sizeof(*server_addr)) < 0) {
-        perror("sendto failed");
-        return -1;
-    }
-    
-    // Set up timeout
-    fd_set readfds;
-    struct timeval tv;
-    FD_ZERO(&readfds);
-    FD_SET(sock, &readfds);
-    tv.tv_sec = RECV_TIMEOUT_SEC;
-    tv.tv_usec = 0;
-    
-    // Wait for response with timeout
-    int rv = select(sock + 1, &readfds, NULL, NULL, &tv);
-    if (rv == -1) {
-        perror("select failed");
-        return -1;
-    } else if (rv == 0) {
-        printf("Timeout: No response received within %d seconds\n", RECV_TIMEOUT_SEC);
-        return -2;
+// Print the order fields extracted from a JSON payload, or at most 200
+// bytes of it when it carries none (errors, other events)
+static void print_json(const OrderSession *s, const OrderResponse *resp) {
+    OrderFill fills[MAX_FILLS];
+    int count = order_json_fills(s->exchange, resp, fills, MAX_FILLS);
+    for (int i = 0; i < count; i++) {
+        printf("Order: ");
+        print_order_fill(&fills[i]);
     }
-    
-    // Receive response
-    socklen_t addr_len = sizeof(*server_addr);
-    ssize_t received_bytes = recvfrom(sock, buffer, BUFFER_SIZE - 1, 0, 
-                                      (struct sockaddr *)server_addr, &addr_len);
-    
-    if (received_bytes > 0) {
-        buffer[received_bytes] = '\0';
-        printf("Raw response: %s\n", buffer);
-        
-        // Parse response
-        *response = parse_response(buffer);
-        if (!response->is_valid) {
-            printf("Failed to parse response\n");
-            return -3;
-        }
-        
-        return 0;
-    } else {
-        perror("recvfrom failed");
-        return -1;
+    if (count == 0) {
+        int len = resp->payload_len < 200 ? resp->payload_len : 200;
+        printf("JSON: %.*s%s\n", len, resp->payload, resp->payload_len > 200 ? "..." : "");
     }
 }
 
-// Handle response based on type
-void handle_response(const Response *resp) {
+// Indexed response, matched to its request by idx
+void handle_response(OrderSession *s, const OrderRequest *req, const OrderResponse *resp, void *ctx) {
+    ClientState *state = (ClientState *)ctx;
     printf("\n=== Response Analysis ===\n");
     printf("Index: %d\n", resp->idx);
-    printf("Type: %s\n", resp->response_type);
-    
-    if (strcmp(resp->response_type, RESP_ACK) == 0) {
+    printf("Type: %c\n", resp->type);
+    if (req != NULL) {
+        printf("Round trip: %.3f ms\n", (resp->recv_ns - req->sent_ns) / 1e6);
+    } else {
+        printf("(No request in flight with this idx, late or foreign response)\n");
+    }
+
+    if (resp->type == ORDER_RESP_ACK) {
         printf("Status: SUCCESS\n");
-        printf("Message: %s\n", resp->payload);
-        
-    } else if (strcmp(resp->response_type, RESP_ERR) == 0) {
+        printf("Message: %.*s\n", resp->payload_len, resp->payload);
+        if (req != NULL && req->kind == ORDER_CONNECT) {
+            state->account_index = atoi(resp->payload);
+        }
+    } else if (resp->type == ORDER_RESP_ERR) {
         printf("Status: ERROR\n");
-        printf("Error: %s\n", resp->payload);
-        
-    } else if (strcmp(resp->response_type, RESP_EXC) == 0) {
+        printf("Error: %.*s\n", resp->payload_len, resp->payload);
+    } else if (resp->type == ORDER_RESP_EXC) {
         printf("Status: EXCHANGE RESPONSE\n");
-        printf("JSON: %.200s%s\n", resp->payload, 
-               strlen(resp->payload) > 200 ? "..." : "");
-    } else if (strcmp(resp->response_type, RESP_AUTH) == 0) {
-        printf("Status: AUTH STREAM UPDATE\n");
-        printf("Account: %d\n", resp->idx); // idx represents account_index for auth messages
-        printf("JSON: %.200s%s\n", resp->payload, 
-               strlen(resp->payload) > 200 ? "..." : "");
+        print_json(s, resp);
     }
-    
+
+    printf("========================\n\n");
+}
+
+// Auth stream update, not tied to any request
+void handle_auth(OrderSession *s, const OrderResponse *resp, void *ctx) {
+    printf("\n=== Response Analysis ===\n");
+    printf("Status: AUTH STREAM UPDATE\n");
+    printf("Account: %d\n", resp->idx); // idx represents account_index for auth messages
+    print_json(s, resp);
     printf("========================\n\n");
 }
 
+void handle_timeout(OrderSession *s, const OrderRequest *req, void *ctx) {
+    printf("Timeout: No response to idx %d within %d seconds\n", req->idx, RECV_TIMEOUT_SEC);
+}
+
 int main() {
-    int sock = -1;
-    int ret = 0;
-    
-    // Create UDP socket
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock < 0) {
-        perror("Socket creation failed");
+    // Holds the send and receive buffers, too large for the stack
+    static OrderSession session;
+    // Client-side limits, per account index the server may assign
+    static RateLimiter limiter;
+    if (rate_limiter_init(&limiter, MAX_ACCOUNTS) < 0) {
         return EXIT_FAILURE;
     }
-    
-    // Set socket to non-blocking for select()
-    int flags = fcntl(sock, F_GETFL, 0);
-    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
-    
-    // Set local binding address (any interface, configurable port)
-    struct sockaddr_in local_addr;
-    memset(&local_addr, 0, sizeof(local_addr));
-    local_addr.sin_family = AF_INET;
-    local_addr.sin_addr.s_addr = INADDR_ANY;
-    local_addr.sin_port = htons(LOCAL_BIND_PORT);
-    
-    // Bind local port
-    if (bind(sock, (struct sockaddr *)&local_addr, sizeof(local_addr)) < 0) {
-        perror("Bind failed");
-        close(sock);
+    ClientState state = {.account_index = -1};
+    OrderHandlers handlers = {
+        .on_response = handle_response,
+        .on_auth = handle_auth,
+        .on_timeout = handle_timeout,
+        .ctx = &state,
+    };
+
+    // Non-blocking socket bound to LOCAL_BIND_PORT; responses are matched
+    // to requests by idx, so requests do not have to wait for each other
+    if (order_session_open(&session, EXCHANGE_GATEIO, SERVER_IP, SERVER_PORT, LOCAL_BIND_PORT,
+                           MAX_INFLIGHT, RECV_TIMEOUT_SEC * 1000, &handlers) < 0) {
         return EXIT_FAILURE;
     }
-    
+    order_session_set_limiter(&session, &limiter);
+    // Holds latency histograms, too large for the stack
+    static RiskChecker risk;
+    if (risk_init(&risk, 16, FEED_INDEXES) < 0 || risk_feed_open() < 0) {
+        return EXIT_FAILURE;
+    }
+    // Every place on the session is checked first and refused if it fails;
+    // cancels are never refused
+    risk_attach(&risk, &session);
+
     printf("Gate.io UDP Client connecting to %s:%d...\n\n", SERVER_IP, SERVER_PORT);
-    
-    // Set target (server) address
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = inet_addr(SERVER_IP);
-    server_addr.sin_port = htons(SERVER_PORT);
-    
+
     // Use timestamp for unique client order IDs
     long long timestamp = unix_time_millis();
-    Response response;
-    
+
     // ========================================
     // 1. CONNECT TO GATE.IO (Create new account)
     // ========================================
     printf("=== STEP 1: Connecting to Gate.io ===\n");
-    char connect_msg[BUFFER_SIZE];
-    int account_index = -1;
-    
     // Connect with user_id to enable auth stream (optional - remove user_id if not needed)
     // Option 1: With auth stream (full account updates)
-    snprintf(connect_msg, sizeof(connect_msg), 
-             "0,0,%s,%s,%s", API_KEY, API_SECRET, USER_ID);
-    
-    // Option 2: Without auth stream (basic trading only)  
-    // snprintf(connect_msg, sizeof(connect_msg), 
-    //          "0,0,%s,%s", API_KEY, API_SECRET);
-    
-    printf("Request: %s\n", connect_msg);
-    
-    ret = send_and_receive(sock, &server_addr, connect_msg, &response);
-    if (ret == 0) {
-        handle_response(&response);
-        
-        // Check if connected successfully and get account index
-        if (strcmp(response.response_type, RESP_ACK) == 0) {
-            account_index = atoi(response.payload);
-            printf("Successfully connected! Assigned account index: %d\n", account_index);
-        } else {
-            printf("Failed to connect. Exiting.\n");
-            close(sock);
-            return EXIT_FAILURE;
-        }
-    } else {
-        printf("Failed to get connect response\n");
-        close(sock);
+    order_connect(&session, API_KEY, API_SECRET, USER_ID, -1, NULL);
+
+    // Option 2: Without auth stream (basic trading only)
+    // order_connect(&session, API_KEY, API_SECRET, NULL, -1, NULL);
+
+    order_session_wait(&session);
+
+    if (state.account_index < 0) {
+        printf("Failed to connect. Exiting.\n");
+        order_session_close(&session);
         return EXIT_FAILURE;
     }
-    
-    // Wait a bit before next request
-    usleep(100000); // 100ms
-    
+    printf("Successfully connected! Assigned account index: %d\n", state.account_index);
+
+    // Limits for the assigned account, priced against the feed's BBO.
+    // Without a quote none are added and the session refuses every place.
+    int quote_index = risk_feed_quote(&risk, FEED_SYMBOL, FEED_TIMEOUT_MS);
+    if (quote_index >= 0 &&
+        risk_add_symbol(&risk, state.account_index, "BTC_USDT", quote_index, &risk_limits) == NULL) {
+        order_session_close(&session);
+        return EXIT_FAILURE;
+    }
+
     // ========================================
-    // 2. CANCEL NON-EXISTENT ORDER (Demonstrates Protocol)
+    // 2. CANCEL NON-EXISTENT ORDERS (Demonstrates Protocol and Pipelining)
     // ========================================
-    printf("=== STEP 2: Canceling Non-Existent Order ===\n");
-    char cancel_msg[BUFFER_SIZE];
-    snprintf(cancel_msg, sizeof(cancel_msg), 
-             "1,-1,%d,BTC_USDT,t-nonexistent-%lld", account_index, timestamp);
-    printf("Request: %s\n", cancel_msg);
-    printf("(Canceling non-existent order to test error handling)\n");
-    
-    ret = send_and_receive(sock, &server_addr, cancel_msg, &response);
-    if (ret == 0) {
-        handle_response(&response);
+    printf("=== STEP 2: Canceling Non-Existent Orders ===\n");
+    printf("(Canceling non-existent orders to test error handling)\n");
+    // All cancels go out back to back; responses arrive in any order and
+    // are matched to their request by idx
+    char client_order_id[64];
+    for (int i = 0; i < 3; i++) {
+        snprintf(client_order_id, sizeof(client_order_id), "t-nonexistent-%lld-%d", timestamp, i);
+        int idx = order_cancel(&session, state.account_index, "BTC_USDT", client_order_id, NULL);
+        printf("Request %d: cancel %s\n", idx, client_order_id);
     }
-    
-    // Close socket
-    close(sock);
-    
+    order_session_wait(&session);
+
+    print_order_session_stats(&session);
+    print_risk_stats(&risk);
+    print_rate_limiter_stats(&limiter);
+    order_session_close(&session);
+    risk_feed_close();
+    risk_free(&risk);
+    rate_limiter_free(&limiter);
+
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,191 @@
+#include "order_gateway.c"
+#include "risk_check.c"
+
+// Every venue from one thread: one OrderSession per exchange, all of them
+// in one OrderGateway (a single epoll set). Connects to each venue, then
+// cancels a non-existent order on each and prints every response as it
+// arrives, whichever venue it comes from. All sessions share one
+// RateLimiter with the default limits; each venue has its own RiskChecker
+// (accounts and symbols repeat across venues), quoted from the SDK feed.
+//
+// Compile: gcc -O2 -pthread -o place_order_multi place_order_multi_udp.c
+// Usage:   ./place_order_multi
+
+#define MAX_INFLIGHT 1024
+#define RECV_TIMEOUT_SEC 5
+#define MAX_ACCOUNTS 16
+#define FEED_INDEXES 1024
+#define FEED_TIMEOUT_MS 3000
+
+// Pre-trade limits (0 = no limit): BTC, and Gate.io contracts, for which
+// size * price is no notional
+static const RiskLimits btc_limits = {
+    .max_size = 0.1,
+    .max_notional = 10000.0,
+    .price_band_bps = 50,
+    .max_open_orders = 10,
+    .max_position = 0.5,
+};
+static const RiskLimits contract_limits = {
+    .max_size = 1000,
+    .price_band_bps = 50,
+    .max_open_orders = 10,
+    .max_position = 5000,
+};
+
+typedef struct
+{
+    int exchange;
+    const char *server_ip;
+    int server_port;
+    int local_port;
+    const char *api_key;
+    const char *api_secret;
+    // OKX/Bitget passphrase, Gate.io user_id, NULL if unused
+    const char *passphrase;
+    const char *symbol;
+    // Prefix of client_order_ids (Gate.io requires "t-")
+    const char *cid_prefix;
+    // stream.c's name of symbol, the price band's quote
+    const char *feed_symbol;
+    const RiskLimits *limits;
+} VenueConfig;
+
+// Servers as in the per-exchange examples; UPDATE THESE
+static const VenueConfig venues[] = {
+    {EXCHANGE_BINANCE, "10.11.4.97", 6671, 6672, "API_KEY", "API_SECRET", NULL, "BTCUSDT", "x-",
+     "binance-futures:btcusdt", &btc_limits},
+    {EXCHANGE_GATEIO, "10.11.4.97", 6670, 6671, "API_KEY", "API_SECRET", NULL, "BTC_USDT", "t-",
+     "gate-io-futures:BTC_USDT", &contract_limits},
+    {EXCHANGE_OKX, "172.30.3.142", 6669, 6669, "API_KEY", "API_SECRET", "API_PASS", "BTC-USDT", "",
+     "okx-spot:BTC-USDT", &btc_limits},
+    {EXCHANGE_BYBIT, "10.11.4.97", 6666, 6666, "API_KEY", "API_SECRET", NULL, "BTCUSDT", "", "bybit:BTCUSDT",
+     &btc_limits},
+    {EXCHANGE_BITGET, "172.30.2.221", 6669, 6668, "API_KEY", "API_SECRET", "API_PASS", "BTCUSDT", "",
+     "bitget-futures:BTCUSDT", &btc_limits},
+};
+#define VENUE_COUNT (int)(sizeof(venues) / sizeof(venues[0]))
+
+typedef struct
+{
+    const VenueConfig *config;
+    int account_index;
+    int connected;
+} VenueState;
+
+void handle_response(OrderSession *s, const OrderRequest *req, const OrderResponse *resp, void *ctx)
+{
+    VenueState *venue = (VenueState *)ctx;
+    int len = resp->payload_len < 200 ? resp->payload_len : 200;
+    printf("[%s] idx %d type %c: %.*s\n", s->exchange->name, resp->idx, resp->type, len, resp->payload);
+    if (req != NULL && req->kind == ORDER_CONNECT && resp->type == ORDER_RESP_ACK)
+    {
+        venue->connected = 1;
+        // Binance/Gate.io answer with the assigned account index
+        if (s->exchange->fields & ORDER_FIELD_ACCOUNT)
+        {
+            venue->account_index = atoi(resp->payload);
+        }
+    }
+}
+
+void handle_auth(OrderSession *s, const OrderResponse *resp, void *ctx)
+{
+    int len = resp->payload_len < 200 ? resp->payload_len : 200;
+    printf("[%s] auth update account %d: %.*s\n", s->exchange->name, resp->idx, len, resp->payload);
+}
+
+void handle_timeout(OrderSession *s, const OrderRequest *req, void *ctx)
+{
+    printf("[%s] timeout: idx %d\n", s->exchange->name, req->idx);
+}
+
+int main()
+{
+    // Holds the send and receive buffers, too large for the stack
+    static OrderSession sessions[VENUE_COUNT];
+    VenueState states[VENUE_COUNT];
+    static RateLimiter limiter;
+    // Hold latency histograms, too large for the stack
+    static RiskChecker risks[VENUE_COUNT];
+    if (rate_limiter_init(&limiter, MAX_ACCOUNTS) < 0 || risk_feed_open() < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    OrderGateway gateway;
+    if (order_gateway_init(&gateway) < 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < VENUE_COUNT; i++)
+    {
+        const VenueConfig *v = &venues[i];
+        states[i].config = v;
+        states[i].account_index = 0;
+        states[i].connected = 0;
+        OrderHandlers handlers = {
+            .on_response = handle_response,
+            .on_auth = handle_auth,
+            .on_timeout = handle_timeout,
+            .ctx = &states[i],
+        };
+        if (order_session_open(&sessions[i], v->exchange, v->server_ip, v->server_port, v->local_port,
+                               MAX_INFLIGHT, RECV_TIMEOUT_SEC * 1000, &handlers) < 0 ||
+            order_gateway_add(&gateway, &sessions[i]) < 0 || risk_init(&risks[i], 4, FEED_INDEXES) < 0)
+        {
+            return EXIT_FAILURE;
+        }
+        order_session_set_limiter(&sessions[i], &limiter);
+        // Every place is checked first; cancels are never refused
+        risk_attach(&risks[i], &sessions[i]);
+    }
+
+    // 1. Connect every venue at once, then wait for all answers together
+    printf("=== Connecting %d venues ===\n", VENUE_COUNT);
+    for (int i = 0; i < VENUE_COUNT; i++)
+    {
+        order_connect(&sessions[i], venues[i].api_key, venues[i].api_secret, venues[i].passphrase, -1, NULL);
+    }
+    order_gateway_wait(&gateway);
+
+    // Limits for each connected account, priced against the feed's BBO;
+    // a venue without a quote gets none and refuses every place
+    for (int i = 0; i < VENUE_COUNT; i++)
+    {
+        int quote_index = states[i].connected ? risk_feed_quote(&risks[i], venues[i].feed_symbol, FEED_TIMEOUT_MS) : -1;
+        if (quote_index >= 0)
+        {
+            risk_add_symbol(&risks[i], states[i].account_index, venues[i].symbol, quote_index, venues[i].limits);
+        }
+    }
+
+    // 2. Cancel a non-existent order on every connected venue
+    printf("=== Canceling non-existent orders ===\n");
+    long long timestamp = get_current_timestamp_ns() / 1000000LL;
+    for (int i = 0; i < VENUE_COUNT; i++)
+    {
+        if (!states[i].connected)
+        {
+            printf("[%s] not connected, skipped\n", sessions[i].exchange->name);
+            continue;
+        }
+        char client_order_id[64];
+        snprintf(client_order_id, sizeof(client_order_id), "%snonexistent-%lld", venues[i].cid_prefix, timestamp);
+        order_cancel(&sessions[i], states[i].account_index, venues[i].symbol, client_order_id, NULL);
+    }
+    order_gateway_wait(&gateway);
+
+    order_gateway_close(&gateway);
+    for (int i = 0; i < VENUE_COUNT; i++)
+    {
+        print_order_session_stats(&sessions[i]);
+        print_risk_stats(&risks[i]);
+        order_session_close(&sessions[i]);
+        risk_free(&risks[i]);
+    }
+    risk_feed_close();
+    print_rate_limiter_stats(&limiter);
+    rate_limiter_free(&limiter);
+    return EXIT_SUCCESS;
+}
@@ -1,102 +1,121 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <arpa/inet.h>
-#include <time.h>
+#include "order_session.c"
+#include "risk_check.c"
 
 #define SERVER_IP "172.30.3.142"
 #define SERVER_PORT 6669
-#define BUFFER_SIZE 1500
+#define LOCAL_BIND_PORT 6669
 #define API_KEY "API_KEY"
 #define API_SECRET "API_SECRET"
 #define API_PASS "API_PASS"
 
+#define MAX_INFLIGHT 1024  // 同時未回應的請求上限
+#define RECV_TIMEOUT_SEC 5 // 單一請求的回應逾時（秒）
+#define MAX_ACCOUNTS 16    // 限流器為帳戶索引 0 .. MAX_ACCOUNTS - 1 各建一組桶
+
+// 價格帶檢查所用報價的行情來源（sdk.c）
+#define FEED_SYMBOL "okx-spot:BTC-USDT" // 下單交易對在 stream.c 中的名稱
+#define FEED_INDEXES 1024     // 風控保存報價的行情 index 數
+#define FEED_TIMEOUT_MS 3000  // 等待第一筆報價的時間
+
+// BTC-USDT 的下單前風控限制（0 為不限）
+static const RiskLimits risk_limits = {
+    .max_size = 0.1,          // 單筆 BTC 數量
+    .max_notional = 10000.0,  // 單筆 USDT 名義價值
+    .price_band_bps = 50,     // 最多穿過最佳買賣價 0.5%
+    .max_open_orders = 10,
+    .max_position = 0.5,      // 多空各 0.5 BTC
+};
+
 // 獲取 UNIX 時間戳
 long unix_time()
 {
     return (long)time(NULL);
 }
 
-// 發送 UDP 訊息並等待回應
-void send_udp_message(int sock, struct sockaddr_in *server_addr, const char *message)
+// 依 idx 對應到請求的回應
+void handle_response(OrderSession *s, const OrderRequest *req, const OrderResponse *resp, void *ctx)
 {
-    char buffer[BUFFER_SIZE];
-
-    // 發送消息
-    sendto(sock, message, strlen(message), 0, (struct sockaddr *)server_addr, sizeof(*server_addr));
-
-    // 接收回應
-    socklen_t addr_len = sizeof(*server_addr);
-    ssize_t received_bytes = recvfrom(sock, buffer, BUFFER_SIZE - 1, 0, (struct sockaddr *)server_addr, &addr_len);
+    printf("Received: %d:%c:%.*s\n", resp->idx, resp->type, resp->payload_len, resp->payload);
+}
 
-    if (received_bytes > 0)
-    {
-        buffer[received_bytes] = '\0'; // 確保字符串結尾
-        printf("Received: %s\n", buffer);
-    }
+void handle_timeout(OrderSession *s, const OrderRequest *req, void *ctx)
+{
+    printf("Timeout: idx %d\n", req->idx);
 }
 
 int main()
 {
-    // 創建 UDP 套接字
-    int sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock < 0)
+    // 收發緩衝區較大，不放在堆疊上
+    static OrderSession session;
+    static RateLimiter limiter;
+    if (rate_limiter_init(&limiter, MAX_ACCOUNTS) < 0)
     {
-        perror("Socket creation failed");
         exit(EXIT_FAILURE);
     }
-
-    // 設定本地監聽地址（0.0.0.0:6669）
-    struct sockaddr_in local_addr;
-    memset(&local_addr, 0, sizeof(local_addr));
-    local_addr.sin_family = AF_INET;
-    local_addr.sin_addr.s_addr = inet_addr("0.0.0.0");
-    local_addr.sin_port = htons(6669);
-
-    // 綁定本地端口
-    if (bind(sock, (struct sockaddr *)&local_addr, sizeof(local_addr)) < 0)
+    OrderHandlers handlers = {
+        .on_response = handle_response,
+        .on_timeout = handle_timeout,
+    };
+
+    // 綁定本地端口 6669 的非阻塞 UDP 套接字
+    if (order_session_open(&session, EXCHANGE_OKX, SERVER_IP, SERVER_PORT, LOCAL_BIND_PORT,
+                           MAX_INFLIGHT, RECV_TIMEOUT_SEC * 1000, &handlers) < 0)
     {
-        perror("Bind failed");
-        close(sock);
         exit(EXIT_FAILURE);
     }
+    // 送出前先在本地檢查交易所的下單頻率限制
+    order_session_set_limiter(&session, &limiter);
+    // 含延遲直方圖，不放在堆疊上
+    static RiskChecker risk;
+    if (risk_init(&risk, 16, FEED_INDEXES) < 0 || risk_feed_open() < 0)
+    {
+        exit(EXIT_FAILURE);
+    }
+    // 每筆下單先經風控檢查，未通過則不送出
+    risk_attach(&risk, &session);
 
-    printf("Listening on UDP port 6669...\n");
-
-    // 設定目標（伺服器）地址
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = inet_addr(SERVER_IP);
-    server_addr.sin_port = htons(SERVER_PORT);
+    printf("Listening on UDP port %d...\n", LOCAL_BIND_PORT);
 
     // 取得 UNIX 時間作為 `client_order_id`
-    long client_order_id = unix_time();
+    char client_order_id[32];
+    snprintf(client_order_id, sizeof(client_order_id), "%ld", unix_time());
 
-    // // 1. 發送 `connect` 訊息
+    // 1. 發送 `connect` 訊息
     // idx, mode, api_key, api_secret, api_pass
-    char msg1[BUFFER_SIZE];
-    snprintf(msg1, sizeof(msg1), "0,0,%s,%s,%s", API_KEY, API_SECRET, API_PASS);
-    send_udp_message(sock, &server_addr, msg1);
+    order_connect(&session, API_KEY, API_SECRET, API_PASS, -1, NULL);
     // 等待連線完成
-    sleep(1);
+    order_session_wait(&session);
 
     // 2. 發送 `create` 訂單訊息
+    // 取得行情報價後才加入風控限制；沒有限制的交易對會被拒單
+    int quote_index = risk_feed_quote(&risk, FEED_SYMBOL, FEED_TIMEOUT_MS);
+    if (quote_index >= 0 && risk_add_symbol(&risk, 0, "BTC-USDT", quote_index, &risk_limits) == NULL)
+    {
+        exit(EXIT_FAILURE);
+    }
     // idx, mode, account_idx, symbol, client_order_id, side, order_type, size, price
-    char msg2[BUFFER_SIZE];
-    snprintf(msg2, sizeof(msg2), "1,1,0,BTC-USDT,%ld,1,1,0.02,80000.0", client_order_id);
-    send_udp_message(sock, &server_addr, msg2);
+    int idx = order_place(&session, 0, "BTC-USDT", client_order_id, 0, 1, 1, 0.02, 80000.0, NULL);
+    if (idx == ORDER_RISK_REJECTED)
+    {
+        printf("Order not sent (risk checks failed)\n");
+    }
+    else if (idx >= 0)
+    {
+        order_session_wait(&session);
+    }
 
     // 3. 發送 `cancel` 訂單訊息
     // idx, mode, account_idx, symbol, client_order_id
-    char msg3[BUFFER_SIZE];
-    snprintf(msg3, sizeof(msg3), "2,-1,0,BTC-USDT,%ld", client_order_id);
-    send_udp_message(sock, &server_addr, msg3);
+    order_cancel(&session, 0, "BTC-USDT", client_order_id, NULL);
+    order_session_wait(&session);
 
+    print_risk_stats(&risk);
+    print_rate_limiter_stats(&limiter);
     // 關閉套接字
-    close(sock);
+    order_session_close(&session);
+    risk_feed_close();
+    risk_free(&risk);
+    rate_limiter_free(&limiter);
 
     return 0;
 }
-
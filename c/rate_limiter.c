@@ -0,0 +1,314 @@
+#ifndef QTX_RATE_LIMITER_C
+#define QTX_RATE_LIMITER_C
+
+#include "sdk.c"
+#include "order_exchange.c"
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Client-side token buckets for the order path, one per (exchange,
+// account_index, endpoint class), so a request the exchange would reject
+// (or ban for) is refused locally before it is encoded. A bucket is kept
+// in GCRA form: a single atomic word holding the time at which it would be
+// full again. Taking a token is one compare-and-swap, so any number of
+// sessions and threads can share a limiter without locks.
+//
+// Cancels are counted against the same bucket as new orders (exchanges do
+// the same) but travel in a priority lane: the last cancel_reserve tokens
+// of the burst are theirs only, so new orders are refused first when the
+// bucket runs low; with cancel_bypass a cancel is never refused and the
+// token it takes delays the next new order instead.
+//
+// Buckets are allocated for the account indexes a limiter is created for
+// (servers assign them from 0 up); requests for a higher account are
+// refused rather than charged to another account's bucket. Requests
+// without an account (account < 0, e.g. a connect letting the server
+// assign one) use account 0's buckets.
+
+// Endpoint classes
+#define RATE_CLASS_ORDER 0   // place and cancel
+#define RATE_CLASS_CONNECT 1 // connect / login
+#define RATE_CLASS_COUNT 2
+
+// Lanes within a class
+#define RATE_LANE_NORMAL 0
+#define RATE_LANE_CANCEL 1
+
+typedef struct
+{
+    // Sustained requests per second, 0 for no limit
+    double rate;
+    // Requests allowed at once from a full bucket
+    int burst;
+    // Tokens of the burst that only cancels may take
+    int cancel_reserve;
+    // Cancels are never refused
+    int cancel_bypass;
+} RateLimit;
+
+// Defaults from the exchanges' published order limits for a regular
+// account; set your own tier's with rate_limiter_set
+static const RateLimit rate_limit_defaults[EXCHANGE_COUNT][RATE_CLASS_COUNT] = {
+    // 300 orders / 10s
+    [EXCHANGE_BINANCE] = {{30, 60, 10, 0}, {1, 5, 0, 0}},
+    // 100 requests / s
+    [EXCHANGE_GATEIO] = {{100, 100, 20, 0}, {1, 5, 0, 0}},
+    // 60 requests / 2s per instrument
+    [EXCHANGE_OKX] = {{30, 60, 10, 0}, {1, 5, 0, 0}},
+    // 10 requests / s per symbol
+    [EXCHANGE_BYBIT] = {{10, 10, 2, 0}, {1, 5, 0, 0}},
+    // 10 requests / s per symbol
+    [EXCHANGE_BITGET] = {{10, 10, 2, 0}, {1, 5, 0, 0}},
+};
+
+typedef struct
+{
+    // Time (ns) at which the bucket is full again
+    _Atomic long long tat;
+    // Written by rate_limiter_set, which must not race with acquires
+    long long interval_ns;
+    // How far tat may run ahead of now for each lane, -1 for no limit
+    long long tolerance_ns[2];
+    int cancel_bypass;
+    _Atomic uint64_t allowed;
+    _Atomic uint64_t rejected;
+    _Atomic uint64_t cancels_rejected;
+    _Atomic uint64_t cancels_bypassed;
+    // Tokens given back for requests that were not sent
+    _Atomic uint64_t refunded;
+} __attribute__((aligned(64))) RateBucket;
+
+typedef struct
+{
+    // EXCHANGE_COUNT x max_accounts x RATE_CLASS_COUNT
+    RateBucket *buckets;
+    int max_accounts;
+    // Requests refused for an account beyond max_accounts
+    _Atomic uint64_t unknown_accounts;
+} RateLimiter;
+
+static inline long long rate_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Bucket of a request, NULL for an account the limiter has none for
+static inline RateBucket *rate_bucket(RateLimiter *rl, int exchange, int account, int endpoint)
+{
+    if (account < 0)
+    {
+        account = 0;
+    }
+    else if (account >= rl->max_accounts)
+    {
+        return NULL;
+    }
+    return &rl->buckets[((size_t)exchange * rl->max_accounts + account) * RATE_CLASS_COUNT + endpoint];
+}
+
+static void rate_bucket_configure(RateBucket *b, const RateLimit *limit)
+{
+    if (limit->rate <= 0)
+    {
+        b->interval_ns = 0;
+        b->tolerance_ns[RATE_LANE_NORMAL] = -1;
+        b->tolerance_ns[RATE_LANE_CANCEL] = -1;
+        b->cancel_bypass = 0;
+        return;
+    }
+    int burst = limit->burst > 0 ? limit->burst : 1;
+    int reserve = limit->cancel_reserve < burst ? limit->cancel_reserve : burst - 1;
+    b->interval_ns = (long long)(1e9 / limit->rate);
+    b->tolerance_ns[RATE_LANE_NORMAL] = (long long)(burst - (reserve > 0 ? reserve : 0) - 1) * b->interval_ns;
+    b->tolerance_ns[RATE_LANE_CANCEL] = (long long)(burst - 1) * b->interval_ns;
+    b->cancel_bypass = limit->cancel_bypass;
+}
+
+// Set the limit of one endpoint class; account < 0 sets it for every
+// account of the exchange. Not safe against concurrent acquires on the
+// same buckets: configure before the limiter is shared.
+int rate_limiter_set(RateLimiter *rl, int exchange, int account, int endpoint, const RateLimit *limit)
+{
+    if (account >= rl->max_accounts)
+    {
+        fprintf(stderr, "rate limiter: account %d beyond the %d it was created for\n", account, rl->max_accounts);
+        return -1;
+    }
+    for (int a = 0; a < rl->max_accounts; a++)
+    {
+        if (account < 0 || a == account)
+        {
+            rate_bucket_configure(rate_bucket(rl, exchange, a, endpoint), limit);
+        }
+    }
+    return 0;
+}
+
+// Full buckets with the default limits for account indexes 0 ..
+// max_accounts - 1 of every exchange
+int rate_limiter_init(RateLimiter *rl, int max_accounts)
+{
+    memset(rl, 0, sizeof(*rl));
+    if (max_accounts <= 0)
+    {
+        fprintf(stderr, "rate limiter needs max_accounts > 0\n");
+        return -1;
+    }
+    size_t count = (size_t)EXCHANGE_COUNT * max_accounts * RATE_CLASS_COUNT;
+    rl->buckets = aligned_alloc(64, count * sizeof(RateBucket));
+    if (rl->buckets == NULL)
+    {
+        perror("rate limiter allocation failed");
+        return -1;
+    }
+    memset(rl->buckets, 0, count * sizeof(RateBucket));
+    rl->max_accounts = max_accounts;
+    for (int e = 0; e < EXCHANGE_COUNT; e++)
+    {
+        for (int c = 0; c < RATE_CLASS_COUNT; c++)
+        {
+            rate_limiter_set(rl, e, -1, c, &rate_limit_defaults[e][c]);
+        }
+    }
+    return 0;
+}
+
+void rate_limiter_free(RateLimiter *rl)
+{
+    free(rl->buckets);
+    rl->buckets = NULL;
+    rl->max_accounts = 0;
+}
+
+// Take a token for one request. Returns 1 if it may be sent, 0 if the
+// bucket is empty for its lane (counted as a rejection), -1 if the
+// limiter has no bucket for the account.
+static inline int rate_limiter_acquire(RateLimiter *rl, int exchange, int account, int endpoint, int lane)
+{
+    RateBucket *b = rate_bucket(rl, exchange, account, endpoint);
+    if (b == NULL)
+    {
+        if (atomic_fetch_add_explicit(&rl->unknown_accounts, 1, memory_order_relaxed) == 0)
+        {
+            fprintf(stderr, "rate limiter: no bucket for account %d (created for %d), request refused\n", account,
+                    rl->max_accounts);
+        }
+        return -1;
+    }
+    long long tolerance = b->tolerance_ns[lane];
+    if (tolerance < 0)
+    {
+        atomic_fetch_add_explicit(&b->allowed, 1, memory_order_relaxed);
+        return 1;
+    }
+    int bypass = lane == RATE_LANE_CANCEL && b->cancel_bypass;
+    long long now = rate_now_ns();
+    long long tat = atomic_load_explicit(&b->tat, memory_order_relaxed);
+    long long start;
+    for (;;)
+    {
+        start = tat > now ? tat : now;
+        if (start - now > tolerance && !bypass)
+        {
+            atomic_fetch_add_explicit(lane == RATE_LANE_CANCEL ? &b->cancels_rejected : &b->rejected, 1,
+                                      memory_order_relaxed);
+            return 0;
+        }
+        // On failure tat is reloaded and the check repeated
+        if (atomic_compare_exchange_weak_explicit(&b->tat, &tat, start + b->interval_ns, memory_order_relaxed,
+                                                  memory_order_relaxed))
+        {
+            break;
+        }
+    }
+    if (start - now > tolerance)
+    {
+        atomic_fetch_add_explicit(&b->cancels_bypassed, 1, memory_order_relaxed);
+    }
+    else
+    {
+        atomic_fetch_add_explicit(&b->allowed, 1, memory_order_relaxed);
+    }
+    return 1;
+}
+
+// Give back the token of an acquired request that was not sent (encoding
+// or sendto failed), so it does not count against the bucket
+static inline void rate_limiter_refund(RateLimiter *rl, int exchange, int account, int endpoint)
+{
+    RateBucket *b = rate_bucket(rl, exchange, account, endpoint);
+    if (b == NULL || b->tolerance_ns[RATE_LANE_NORMAL] < 0)
+    {
+        return;
+    }
+    long long now = rate_now_ns();
+    long long tat = atomic_load_explicit(&b->tat, memory_order_relaxed);
+    // A bucket that has refilled since holds no token of this request
+    while (tat > now)
+    {
+        if (atomic_compare_exchange_weak_explicit(&b->tat, &tat, tat - b->interval_ns, memory_order_relaxed,
+                                                  memory_order_relaxed))
+        {
+            break;
+        }
+    }
+    atomic_fetch_add_explicit(&b->refunded, 1, memory_order_relaxed);
+}
+
+// Nanoseconds until a request in the given lane would be allowed, 0 if now
+// (or never, for an account without a bucket)
+static inline long long rate_limiter_delay_ns(RateLimiter *rl, int exchange, int account, int endpoint, int lane)
+{
+    RateBucket *b = rate_bucket(rl, exchange, account, endpoint);
+    if (b == NULL)
+    {
+        return 0;
+    }
+    long long tolerance = b->tolerance_ns[lane];
+    if (tolerance < 0 || (lane == RATE_LANE_CANCEL && b->cancel_bypass))
+    {
+        return 0;
+    }
+    long long wait = atomic_load_explicit(&b->tat, memory_order_relaxed) - rate_now_ns() - tolerance;
+    return wait > 0 ? wait : 0;
+}
+
+void print_rate_limiter_stats(RateLimiter *rl)
+{
+    static const char *class_names[RATE_CLASS_COUNT] = {"order", "connect"};
+    printf("=== Rate Limiter Stats ===\n");
+    for (int e = 0; e < EXCHANGE_COUNT; e++)
+    {
+        for (int a = 0; a < rl->max_accounts; a++)
+        {
+            for (int c = 0; c < RATE_CLASS_COUNT; c++)
+            {
+                RateBucket *b = rate_bucket(rl, e, a, c);
+                uint64_t allowed = atomic_load_explicit(&b->allowed, memory_order_relaxed);
+                uint64_t rejected = atomic_load_explicit(&b->rejected, memory_order_relaxed);
+                uint64_t cancels_rejected = atomic_load_explicit(&b->cancels_rejected, memory_order_relaxed);
+                uint64_t bypassed = atomic_load_explicit(&b->cancels_bypassed, memory_order_relaxed);
+                uint64_t refunded = atomic_load_explicit(&b->refunded, memory_order_relaxed);
+                if (allowed + rejected + cancels_rejected + bypassed == 0)
+                {
+                    continue;
+                }
+                printf("%s account %d %s: allowed %lu, rejected %lu, cancels rejected %lu, cancels bypassed %lu, "
+                       "refunded %lu\n",
+                       order_exchanges[e].name, a, class_names[c], (unsigned long)allowed,
+                       (unsigned long)rejected, (unsigned long)cancels_rejected, (unsigned long)bypassed,
+                       (unsigned long)refunded);
+            }
+        }
+    }
+    uint64_t unknown = atomic_load_explicit(&rl->unknown_accounts, memory_order_relaxed);
+    if (unknown > 0)
+    {
+        printf("refused for accounts without a bucket: %lu\n", (unsigned long)unknown);
+    }
+    printf("==========================\n");
+}
+
+#endif // QTX_RATE_LIMITER_C
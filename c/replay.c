@@ -0,0 +1,247 @@
+#include "sdk.c"
+#include "journal.c"
+#include "tick_store.c"
+#include "archive.c"
+
+// Feeds a capture journal back through the same decode path as stream.c
+// (add_subscripton for acks, dispatch_packet for data), either at the
+// original pacing or as fast as possible, and reports the decode rate.
+//
+// Compile: gcc -O2 -pthread -o replay replay.c
+// Usage:   ./replay [-p] [-v] [-s root] [-z archive] <journal prefix>
+//          e.g. ./replay stream-capture-r0000
+//   -p  replay at the captured pacing (default: as fast as possible)
+//   -v  print every message like stream.c (default: count only)
+//   -s  convert the journal into a tick store under root (see tick_query.c)
+//   -z  convert the journal into a compressed archive (see archive_tool.c)
+
+typedef struct
+{
+    int verbose;
+    // Tick store to append every message to, NULL for none
+    TickStore *store;
+    // Archive to append every message to, NULL for none
+    ArchiveWriter *archive;
+    unsigned long tickers;
+    unsigned long trades;
+    unsigned long depths;
+    double checksum;
+} ReplayStats;
+
+void replay_ticker(Subscription *sub, const Msg *msg, void *ctx)
+{
+    ReplayStats *stats = (ReplayStats *)ctx;
+    stats->tickers++;
+    stats->checksum += msg->price;
+    if (stats->store != NULL)
+    {
+        tick_store_append(stats->store, sub, msg);
+    }
+    if (stats->archive != NULL)
+    {
+        archive_append(stats->archive, sub, msg);
+    }
+    if (stats->verbose)
+    {
+        printf("%s: ticker, %s, %.8g, %.8g\n",
+               sub->symbol, msg->msg_type > 0 ? "bid" : "ask", msg->price, msg->size);
+    }
+}
+
+void replay_trade(Subscription *sub, const Msg *msg, void *ctx)
+{
+    ReplayStats *stats = (ReplayStats *)ctx;
+    stats->trades++;
+    stats->checksum += msg->price;
+    if (stats->store != NULL)
+    {
+        tick_store_append(stats->store, sub, msg);
+    }
+    if (stats->archive != NULL)
+    {
+        archive_append(stats->archive, sub, msg);
+    }
+    if (stats->verbose)
+    {
+        printf("%s: trade, %s, %.8g, %.8g\n",
+               sub->symbol, msg->msg_type > 0 ? "buy" : "sell", msg->price, msg->size);
+    }
+}
+
+void replay_depth(Subscription *sub, const Msg2 *msg2, const Msg2Level *levels, void *ctx)
+{
+    ReplayStats *stats = (ReplayStats *)ctx;
+    stats->depths++;
+    if (msg2->asks_len + msg2->bids_len > 0)
+    {
+        stats->checksum += levels[0].price;
+    }
+    if (stats->store != NULL)
+    {
+        tick_store_append_depth(stats->store, sub, msg2, levels);
+    }
+    if (stats->archive != NULL)
+    {
+        archive_append_depth(stats->archive, sub, msg2, levels);
+    }
+    if (stats->verbose)
+    {
+        printf("%s: depth, %d, %d\n", sub->symbol, msg2->asks_len, msg2->bids_len);
+    }
+}
+
+static long long monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Wait until offset_ns has passed since start_ns: sleep for long gaps,
+// spin for the last stretch
+static void pace_until(long long start_ns, long long offset_ns)
+{
+    for (;;)
+    {
+        long long ahead = offset_ns - (monotonic_ns() - start_ns);
+        if (ahead <= 0)
+        {
+            return;
+        }
+        if (ahead > 100000)
+        {
+            struct timespec ts = {0, ahead - 50000};
+            if (ahead - 50000 >= 1000000000LL)
+            {
+                ts.tv_sec = (ahead - 50000) / 1000000000LL;
+                ts.tv_nsec = (ahead - 50000) % 1000000000LL;
+            }
+            nanosleep(&ts, NULL);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int paced = 0;
+    const char *prefix = NULL;
+    const char *store_root = NULL;
+    const char *archive_path = NULL;
+    ReplayStats stats = {0};
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-p") == 0)
+        {
+            paced = 1;
+        }
+        else if (strcmp(argv[i], "-v") == 0)
+        {
+            stats.verbose = 1;
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        {
+            store_root = argv[++i];
+        }
+        else if (strcmp(argv[i], "-z") == 0 && i + 1 < argc)
+        {
+            archive_path = argv[++i];
+        }
+        else
+        {
+            prefix = argv[i];
+        }
+    }
+    if (prefix == NULL)
+    {
+        fprintf(stderr, "usage: %s [-p] [-v] [-s root] [-z archive] <journal prefix>\n", argv[0]);
+        return 1;
+    }
+
+    static JournalReader reader;
+    if (journal_reader_open(&reader, prefix) < 0)
+    {
+        return 1;
+    }
+    static TickStore store;
+    if (store_root != NULL)
+    {
+        if (tick_store_init(&store, store_root) < 0)
+        {
+            journal_reader_close(&reader);
+            return 1;
+        }
+        stats.store = &store;
+    }
+    static ArchiveWriter archive;
+    if (archive_path != NULL)
+    {
+        if (archive_open(&archive, archive_path) < 0)
+        {
+            journal_reader_close(&reader);
+            return 1;
+        }
+        stats.archive = &archive;
+    }
+
+    StreamHandlers handlers = {
+        .on_ticker = replay_ticker,
+        .on_trade = replay_trade,
+        .on_depth = replay_depth,
+        .ctx = &stats,
+    };
+
+    // Acks are '\0'-terminated in place by add_subscripton, so they are
+    // copied out of the read-only mapping; data packets decode in place
+    char ack[UDP_SIZE];
+    unsigned long datagrams = 0, messages = 0, bytes = 0;
+    long long first_recv_ns = -1;
+    long long start_ns = monotonic_ns();
+    const JournalRecord *rec;
+    while ((rec = journal_reader_next(&reader)) != NULL)
+    {
+        const char *payload = (const char *)(rec + 1);
+        if (paced)
+        {
+            if (first_recv_ns < 0)
+            {
+                first_recv_ns = rec->recv_ns;
+            }
+            pace_until(start_ns, rec->recv_ns - first_recv_ns);
+        }
+
+        datagrams++;
+        bytes += rec->len;
+        if (rec->src_port == SUBSCRIPTION_MANAGER_PORT)
+        {
+            int len = rec->len < UDP_SIZE ? (int)rec->len : UDP_SIZE - 1;
+            memcpy(ack, payload, len);
+            add_subscripton(ack, len);
+            continue;
+        }
+        recv_timestamp_ns = rec->recv_ns;
+        messages += dispatch_packet(payload, (int)rec->len, &handlers);
+    }
+    long long elapsed_ns = monotonic_ns() - start_ns;
+    journal_reader_close(&reader);
+
+    double seconds = elapsed_ns / 1e9;
+    printf("=== Replay ===\n");
+    printf("datagrams: %lu, messages: %lu (tickers %lu, trades %lu, depth %lu)\n",
+           datagrams, messages, stats.tickers, stats.trades, stats.depths);
+    printf("elapsed: %.3f s, %.0f msgs/s, %.1f MB/s (checksum %.8g)\n",
+           seconds, seconds > 0 ? messages / seconds : 0.0,
+           seconds > 0 ? bytes / seconds / 1e6 : 0.0, stats.checksum);
+    if (stats.store != NULL)
+    {
+        print_tick_store_stats(stats.store);
+        tick_store_close(stats.store);
+    }
+    if (stats.archive != NULL)
+    {
+        archive_close(stats.archive);
+        print_archive_stats(stats.archive);
+    }
+    print_seq_stats();
+    free_subscriptions();
+    return 0;
+}
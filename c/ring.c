@@ -0,0 +1,525 @@
+#ifndef QTX_RING_C
+#define QTX_RING_C
+
+#include "sdk.c"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define CACHE_LINE 64
+
+// Consumer wait strategies
+#define RING_WAIT_SPIN 0
+#define RING_WAIT_BLOCK 1
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Eventcount shared by every ring one consumer drains. Producers only touch
+// the futex when a consumer has registered as sleeping, so spinning
+// consumers never cost the receive thread a syscall.
+typedef struct
+{
+    _Alignas(CACHE_LINE) _Atomic unsigned int seq;
+    _Atomic int waiters;
+} RingSignal;
+
+void ring_signal_init(RingSignal *sig)
+{
+    atomic_init(&sig->seq, 0);
+    atomic_init(&sig->waiters, 0);
+}
+
+static inline void ring_notify(RingSignal *sig)
+{
+    // Orders the slot publish before the waiters check (paired with
+    // the fetch_add in ring_prepare_wait)
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&sig->waiters, memory_order_relaxed) > 0)
+    {
+        atomic_fetch_add_explicit(&sig->seq, 1, memory_order_release);
+        syscall(SYS_futex, &sig->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+// Blocking wait protocol for consumers:
+//   token = ring_prepare_wait(sig);
+//   if (all rings still empty) ring_wait(sig, token, timeout_ms);
+//   else ring_cancel_wait(sig);
+unsigned int ring_prepare_wait(RingSignal *sig)
+{
+    atomic_fetch_add_explicit(&sig->waiters, 1, memory_order_seq_cst);
+    return atomic_load_explicit(&sig->seq, memory_order_acquire);
+}
+
+void ring_wait(RingSignal *sig, unsigned int token, long timeout_ms)
+{
+    struct timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    syscall(SYS_futex, &sig->seq, FUTEX_WAIT_PRIVATE, token, &ts, NULL, 0);
+    atomic_fetch_sub_explicit(&sig->waiters, 1, memory_order_relaxed);
+}
+
+void ring_cancel_wait(RingSignal *sig)
+{
+    atomic_fetch_sub_explicit(&sig->waiters, 1, memory_order_relaxed);
+}
+
+// Raise *high_water to value; producers race benignly on the max
+static inline void ring_track_high_water(_Atomic unsigned long *high_water, unsigned long value)
+{
+    unsigned long seen = atomic_load_explicit(high_water, memory_order_relaxed);
+    while (value > seen &&
+           !atomic_compare_exchange_weak_explicit(high_water, &seen, value,
+                                                  memory_order_relaxed, memory_order_relaxed))
+    {
+    }
+}
+
+// ===================================================================
+// Fixed-size ring of decoded Msg records
+// ===================================================================
+
+// One decoded L1/trade message plus its subscription and receive times
+typedef struct
+{
+    Msg msg;
+    Subscription *sub;
+    long long recv_ns;
+    long long kernel_ns;
+} RingMsg;
+
+typedef struct
+{
+    _Atomic unsigned long seq;
+    RingMsg rec;
+} MsgSlot;
+
+// Bounded ring with per-slot sequence numbers. A single consumer pops; one
+// producer (or several, when multi_producer is set) pushes. Producer and
+// consumer cursors sit on separate cache lines.
+typedef struct
+{
+    _Alignas(CACHE_LINE) _Atomic unsigned long tail;
+    _Atomic unsigned long pushed;
+    _Atomic unsigned long drops;
+    _Atomic unsigned long high_water;
+    _Alignas(CACHE_LINE) _Atomic unsigned long head;
+    _Alignas(CACHE_LINE) MsgSlot *slots;
+    unsigned long mask;
+    int multi_producer;
+    RingSignal *signal;
+} MsgRing;
+
+// capacity must be a power of two
+int msg_ring_init(MsgRing *ring, unsigned long capacity, int multi_producer, RingSignal *signal)
+{
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+    {
+        fprintf(stderr, "ring capacity %lu is not a power of two\n", capacity);
+        return -1;
+    }
+    ring->slots = aligned_alloc(CACHE_LINE, capacity * sizeof(MsgSlot));
+    if (ring->slots == NULL)
+    {
+        perror("ring allocation failed");
+        return -1;
+    }
+    for (unsigned long i = 0; i < capacity; i++)
+    {
+        atomic_init(&ring->slots[i].seq, i);
+    }
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->pushed, 0);
+    atomic_init(&ring->drops, 0);
+    atomic_init(&ring->high_water, 0);
+    ring->mask = capacity - 1;
+    ring->multi_producer = multi_producer;
+    ring->signal = signal;
+    return 0;
+}
+
+void msg_ring_free(MsgRing *ring)
+{
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+// Never blocks: a full ring drops the message and counts it
+int msg_ring_push(MsgRing *ring, Subscription *sub, const Msg *msg)
+{
+    unsigned long pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    MsgSlot *slot;
+    for (;;)
+    {
+        slot = &ring->slots[pos & ring->mask];
+        unsigned long seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        long diff = (long)(seq - pos);
+        if (diff == 0)
+        {
+            if (!ring->multi_producer)
+            {
+                atomic_store_explicit(&ring->tail, pos + 1, memory_order_relaxed);
+                break;
+            }
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            atomic_fetch_add_explicit(&ring->drops, 1, memory_order_relaxed);
+            return -1;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        }
+    }
+
+    slot->rec.msg = *msg;
+    slot->rec.sub = sub;
+    slot->rec.recv_ns = recv_timestamp_ns;
+    slot->rec.kernel_ns = recv_kernel_ns;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    atomic_fetch_add_explicit(&ring->pushed, 1, memory_order_relaxed);
+    ring_track_high_water(&ring->high_water,
+                          pos + 1 - atomic_load_explicit(&ring->head, memory_order_relaxed));
+    if (ring->signal != NULL)
+    {
+        ring_notify(ring->signal);
+    }
+    return 0;
+}
+
+// Oldest record in place, or NULL if empty. Single consumer; the record
+// stays valid until msg_ring_release().
+const RingMsg *msg_ring_peek(MsgRing *ring)
+{
+    unsigned long pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    MsgSlot *slot = &ring->slots[pos & ring->mask];
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1)
+    {
+        return NULL;
+    }
+    return &slot->rec;
+}
+
+void msg_ring_release(MsgRing *ring)
+{
+    unsigned long pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    MsgSlot *slot = &ring->slots[pos & ring->mask];
+    atomic_store_explicit(&slot->seq, pos + ring->mask + 1, memory_order_release);
+    atomic_store_explicit(&ring->head, pos + 1, memory_order_relaxed);
+}
+
+// Single consumer. Returns 1 and fills *out, or 0 if the ring is empty.
+int msg_ring_pop(MsgRing *ring, RingMsg *out)
+{
+    const RingMsg *rec = msg_ring_peek(ring);
+    if (rec == NULL)
+    {
+        return 0;
+    }
+    *out = *rec;
+    msg_ring_release(ring);
+    return 1;
+}
+
+static inline int msg_ring_empty(MsgRing *ring)
+{
+    unsigned long pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    return atomic_load_explicit(&ring->slots[pos & ring->mask].seq, memory_order_acquire) != pos + 1;
+}
+
+// Pop with the given wait strategy. Returns 0 once timeout_ms passes
+// without data so callers can check their own stop flag.
+int msg_ring_wait_pop(MsgRing *ring, RingMsg *out, int strategy, long timeout_ms)
+{
+    if (msg_ring_pop(ring, out))
+    {
+        return 1;
+    }
+
+    if (strategy == RING_WAIT_BLOCK && ring->signal != NULL)
+    {
+        unsigned int token = ring_prepare_wait(ring->signal);
+        if (msg_ring_empty(ring))
+        {
+            ring_wait(ring->signal, token, timeout_ms);
+        }
+        else
+        {
+            ring_cancel_wait(ring->signal);
+        }
+        return msg_ring_pop(ring, out);
+    }
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned int spins = 1;; spins++)
+    {
+        if (msg_ring_pop(ring, out))
+        {
+            return 1;
+        }
+        cpu_relax();
+        if ((spins & 1023) == 0)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 +
+                              (now.tv_nsec - start.tv_nsec) / 1000000;
+            if (elapsed_ms >= timeout_ms)
+            {
+                return 0;
+            }
+        }
+    }
+}
+
+// ===================================================================
+// Variable-size single-producer ring of depth snapshots
+// ===================================================================
+
+// Header of a record in the depth ring; levels holds asks then bids
+typedef struct
+{
+    // Bytes taken by this record, including the header; multiple of 8
+    uint32_t size;
+    uint32_t pad;
+    Subscription *sub;
+    long long recv_ns;
+    long long kernel_ns;
+    Msg2 msg2;
+    Msg2Level levels[];
+} DepthRecord;
+
+// Marks the unused tail of the buffer when a record did not fit before wrapping
+#define DEPTH_RING_WRAP UINT32_MAX
+
+typedef struct
+{
+    _Alignas(CACHE_LINE) _Atomic unsigned long tail;
+    _Atomic unsigned long pushed;
+    _Atomic unsigned long drops;
+    _Atomic unsigned long high_water;
+    _Alignas(CACHE_LINE) _Atomic unsigned long head;
+    _Alignas(CACHE_LINE) char *buf;
+    unsigned long mask;
+    RingSignal *signal;
+} DepthRing;
+
+// bytes must be a power of two and comfortably larger than one UDP packet
+int depth_ring_init(DepthRing *ring, unsigned long bytes, RingSignal *signal)
+{
+    if (bytes < 2 * UDP_SIZE || (bytes & (bytes - 1)) != 0)
+    {
+        fprintf(stderr, "depth ring size %lu must be a power of two >= %d\n", bytes, 2 * UDP_SIZE);
+        return -1;
+    }
+    ring->buf = aligned_alloc(CACHE_LINE, bytes);
+    if (ring->buf == NULL)
+    {
+        perror("depth ring allocation failed");
+        return -1;
+    }
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->pushed, 0);
+    atomic_init(&ring->drops, 0);
+    atomic_init(&ring->high_water, 0);
+    ring->mask = bytes - 1;
+    ring->signal = signal;
+    return 0;
+}
+
+void depth_ring_free(DepthRing *ring)
+{
+    free(ring->buf);
+    ring->buf = NULL;
+}
+
+// Copy one snapshot into the ring; drops it if there is no room
+int depth_ring_push(DepthRing *ring, Subscription *sub, const Msg2 *msg2, const Msg2Level *levels)
+{
+    size_t levels_len = (size_t)(msg2->asks_len + msg2->bids_len);
+    unsigned long need = (sizeof(DepthRecord) + levels_len * sizeof(Msg2Level) + 7) & ~7UL;
+    unsigned long capacity = ring->mask + 1;
+    unsigned long pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    unsigned long offset = pos & ring->mask;
+    unsigned long skip = offset + need > capacity ? capacity - offset : 0;
+
+    if (need > capacity / 2 || pos + skip + need - head > capacity)
+    {
+        atomic_fetch_add_explicit(&ring->drops, 1, memory_order_relaxed);
+        return -1;
+    }
+
+    if (skip > 0)
+    {
+        *(uint32_t *)(ring->buf + offset) = DEPTH_RING_WRAP;
+        pos += skip;
+        offset = 0;
+    }
+
+    DepthRecord *rec = (DepthRecord *)(ring->buf + offset);
+    rec->size = (uint32_t)need;
+    rec->sub = sub;
+    rec->recv_ns = recv_timestamp_ns;
+    rec->kernel_ns = recv_kernel_ns;
+    rec->msg2 = *msg2;
+    memcpy(rec->levels, levels, levels_len * sizeof(Msg2Level));
+    atomic_store_explicit(&ring->tail, pos + need, memory_order_release);
+
+    atomic_fetch_add_explicit(&ring->pushed, 1, memory_order_relaxed);
+    ring_track_high_water(&ring->high_water, pos + need - head);
+    if (ring->signal != NULL)
+    {
+        ring_notify(ring->signal);
+    }
+    return 0;
+}
+
+// Oldest record without copying, or NULL if empty. The record stays valid
+// until depth_ring_release().
+const DepthRecord *depth_ring_peek(DepthRing *ring)
+{
+    unsigned long pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (pos == atomic_load_explicit(&ring->tail, memory_order_acquire))
+    {
+        return NULL;
+    }
+    unsigned long offset = pos & ring->mask;
+    if (*(uint32_t *)(ring->buf + offset) == DEPTH_RING_WRAP)
+    {
+        pos += ring->mask + 1 - offset;
+        atomic_store_explicit(&ring->head, pos, memory_order_release);
+        offset = 0;
+    }
+    return (const DepthRecord *)(ring->buf + offset);
+}
+
+void depth_ring_release(DepthRing *ring, const DepthRecord *rec)
+{
+    unsigned long pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, pos + rec->size, memory_order_release);
+}
+
+static inline int depth_ring_empty(DepthRing *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_relaxed) ==
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+// ===================================================================
+// Receive thread: drains the socket and only pushes into rings
+// ===================================================================
+
+typedef struct
+{
+    MsgRing *ticks;
+    DepthRing *depth;
+    // The caller's gap callback and its ctx, run on the receive thread
+    void (*on_resync)(Subscription *sub, int msg_type, long expected_sn, long received_sn, void *ctx);
+    void *resync_ctx;
+    int cpu;
+    int fifo_priority;
+    pthread_t thread;
+} ReceiveThread;
+
+static void ring_push_msg(Subscription *sub, const Msg *msg, void *ctx)
+{
+    msg_ring_push(((ReceiveThread *)ctx)->ticks, sub, msg);
+}
+
+static void ring_push_depth(Subscription *sub, const Msg2 *msg2, const Msg2Level *levels, void *ctx)
+{
+    depth_ring_push(((ReceiveThread *)ctx)->depth, sub, msg2, levels);
+}
+
+static void ring_forward_resync(Subscription *sub, int msg_type, long expected_sn, long received_sn, void *ctx)
+{
+    ReceiveThread *rt = (ReceiveThread *)ctx;
+    rt->on_resync(sub, msg_type, expected_sn, received_sn, rt->resync_ctx);
+}
+
+static void *receive_thread_main(void *arg)
+{
+    ReceiveThread *rt = (ReceiveThread *)arg;
+    pin_current_thread(rt->cpu);
+    set_realtime_priority(rt->fifo_priority);
+
+    StreamHandlers handlers = {
+        .on_ticker = ring_push_msg,
+        .on_trade = ring_push_msg,
+        .on_depth = ring_push_depth,
+        .on_resync = rt->on_resync != NULL ? ring_forward_resync : NULL,
+        .ctx = rt,
+    };
+    while (running)
+    {
+        receive_batch(&handlers);
+    }
+    return NULL;
+}
+
+// Start the receive thread on cpu (-1: no pinning), under SCHED_FIFO when
+// fifo_priority > 0. init_batch_receiver() must have been called. The
+// socket gets a receive timeout so the thread notices `running` going to 0.
+// Gaps are found while decoding, so the on_resync of handlers (may be
+// NULL) is called from the receive thread, ahead of the gapped message
+// reaching the ring; its other callbacks are left to the consumer.
+int start_receive_thread(ReceiveThread *rt, MsgRing *ticks, DepthRing *depth, const StreamHandlers *handlers,
+                         int cpu, int fifo_priority)
+{
+    rt->ticks = ticks;
+    rt->depth = depth;
+    rt->on_resync = handlers != NULL ? handlers->on_resync : NULL;
+    rt->resync_ctx = handlers != NULL ? handlers->ctx : NULL;
+    rt->cpu = cpu;
+    rt->fifo_priority = fifo_priority;
+
+    struct timeval tv = {0, 100000};
+    setsockopt(manager.socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    int err = pthread_create(&rt->thread, NULL, receive_thread_main, rt);
+    if (err != 0)
+    {
+        fprintf(stderr, "pthread_create failed: %s\n", strerror(err));
+        return -1;
+    }
+    return 0;
+}
+
+void join_receive_thread(ReceiveThread *rt)
+{
+    pthread_join(rt->thread, NULL);
+}
+
+void print_ring_stats(const MsgRing *ticks, const DepthRing *depth)
+{
+    printf("=== Ring Stats ===\n");
+    printf("ticks: pushed %lu, dropped %lu, high-water %lu / %lu slots\n",
+           atomic_load(&ticks->pushed), atomic_load(&ticks->drops),
+           atomic_load(&ticks->high_water), ticks->mask + 1);
+    printf("depth: pushed %lu, dropped %lu, high-water %lu / %lu bytes\n",
+           atomic_load(&depth->pushed), atomic_load(&depth->drops),
+           atomic_load(&depth->high_water), depth->mask + 1);
+    printf("==================\n");
+}
+
+#endif // QTX_RING_C
@@ -0,0 +1,442 @@
+#ifndef QTX_RISK_CHECK_C
+#define QTX_RISK_CHECK_C
+
+#include "sdk.c"
+#include "histogram.c"
+#include "order_manager.c"
+#include <float.h>
+
+// Pre-trade risk checks. risk_attach() runs them on every place an
+// OrderSession sends (order_place, order_place_fast and everything built
+// on them); a strategy may also call risk_check() itself. Limits and
+// exposure are kept per (account, symbol) in a RiskSymbol resolved once
+// and kept; the price band reference is the symbol's latest BBO, written
+// by the feed thread (risk_on_ticker) into atomic doubles, so the check
+// shares no lock with the feed or the sender. Every check is evaluated on
+// every order (no early exit, no allocation), the failures come back as a
+// RISK_* mask and each one is counted and timed on its own.
+//
+// Exposure: risk_on_sent() after a place went out (done by risk_attach()),
+// then either risk_on_fill()/risk_on_closed() or risk_on_order_update()
+// as the OrderManager's update handler.
+
+// Checks, bits of the mask risk_check() returns
+#define RISK_MAX_SIZE 1
+#define RISK_MAX_NOTIONAL 2
+#define RISK_PRICE_BAND 4     // outside the band or no quote yet
+#define RISK_OPEN_ORDERS 8
+#define RISK_POSITION 16      // position plus open orders on that side
+#define RISK_CHECKS 5
+// Not a check: no limits were added for the order's (account, symbol)
+#define RISK_NO_LIMITS 32
+
+static const char *risk_check_names[RISK_CHECKS] = {
+    "max size", "max notional", "price band", "open orders", "position",
+};
+
+// Limits of one account and symbol, 0 for no limit
+typedef struct
+{
+    double max_size;
+    double max_notional;
+    // How far through the BBO an order may be priced: a buy above
+    // ask * (1 + bps / 1e4) or a sell below bid * (1 - bps / 1e4) fails
+    double price_band_bps;
+    int max_open_orders;
+    // Absolute position in either direction
+    double max_position;
+} RiskLimits;
+
+// Best bid and ask of one feed symbol; single writer (the feed thread)
+typedef struct
+{
+    _Atomic double bid;
+    _Atomic double ask;
+} __attribute__((aligned(64))) RiskQuote;
+
+typedef struct
+{
+    char symbol[MAX_SYMBOL_LEN];
+    unsigned long long hash;
+    int account;
+    const RiskQuote *quote;
+    // Limits with "no limit" as DBL_MAX / INT_MAX so every check compares
+    double max_size;
+    double max_notional;
+    double band;
+    int max_open_orders;
+    double max_position;
+    // Exposure: open quantity by side (0 buy, 1 sell), position in base
+    // units, positive long
+    int open_orders;
+    double open_qty[2];
+    double position;
+} RiskSymbol;
+
+typedef struct
+{
+    RiskSymbol *symbols;
+    int symbol_count;
+    int max_symbols;
+    // Indexed by the feed's symbol index (Subscription.index)
+    RiskQuote *quotes;
+    unsigned int quote_count;
+    // Time every check into its own latency histogram (on by default)
+    int timed;
+
+    unsigned long checks;
+    unsigned long passed;
+    unsigned long failed[RISK_CHECKS];
+    // Places refused by risk_attach() for RISK_NO_LIMITS
+    unsigned long no_limits;
+    LatencyHistogram latency[RISK_CHECKS];
+} RiskChecker;
+
+// Room for max_symbols (account, symbol) pairs and feed symbol indexes
+// below max_quotes
+int risk_init(RiskChecker *r, int max_symbols, unsigned int max_quotes)
+{
+    memset(r, 0, sizeof(*r));
+    r->symbols = calloc(max_symbols, sizeof(RiskSymbol));
+    r->quotes = aligned_alloc(64, (size_t)max_quotes * sizeof(RiskQuote));
+    if (r->symbols == NULL || r->quotes == NULL)
+    {
+        perror("risk checker allocation failed");
+        free(r->symbols);
+        free(r->quotes);
+        return -1;
+    }
+    for (unsigned int i = 0; i < max_quotes; i++)
+    {
+        atomic_init(&r->quotes[i].bid, 0);
+        atomic_init(&r->quotes[i].ask, 0);
+    }
+    r->max_symbols = max_symbols;
+    r->quote_count = max_quotes;
+    r->timed = 1;
+    return 0;
+}
+
+void risk_free(RiskChecker *r)
+{
+    free(r->symbols);
+    free(r->quotes);
+    r->symbols = NULL;
+    r->quotes = NULL;
+}
+
+static inline double risk_limit(double limit)
+{
+    return limit > 0 ? limit : DBL_MAX;
+}
+
+// Limits for account's symbol, priced against feed symbol quote_index.
+// Returns the entry to pass to risk_check, NULL if full or out of range.
+RiskSymbol *risk_add_symbol(RiskChecker *r, int account, const char *symbol, unsigned int quote_index,
+                            const RiskLimits *limits)
+{
+    if (r->symbol_count >= r->max_symbols || quote_index >= r->quote_count || strlen(symbol) >= MAX_SYMBOL_LEN)
+    {
+        fprintf(stderr, "risk: cannot add %s\n", symbol);
+        return NULL;
+    }
+    RiskSymbol *rs = &r->symbols[r->symbol_count++];
+    snprintf(rs->symbol, sizeof(rs->symbol), "%s", symbol);
+    rs->hash = order_key_hash(account, symbol);
+    rs->account = account;
+    rs->quote = &r->quotes[quote_index];
+    rs->max_size = risk_limit(limits->max_size);
+    rs->max_notional = risk_limit(limits->max_notional);
+    // No band: any positive quote passes, a missing one still fails
+    rs->band = limits->price_band_bps > 0 ? limits->price_band_bps / 1e4 : 1e300;
+    rs->max_open_orders = limits->max_open_orders > 0 ? limits->max_open_orders : INT_MAX;
+    rs->max_position = risk_limit(limits->max_position);
+    return rs;
+}
+
+// Entry of account's symbol, NULL if not added
+RiskSymbol *risk_symbol(RiskChecker *r, int account, const char *symbol)
+{
+    unsigned long long hash = order_key_hash(account, symbol);
+    for (int i = 0; i < r->symbol_count; i++)
+    {
+        RiskSymbol *rs = &r->symbols[i];
+        if (rs->hash == hash && rs->account == account && strcmp(rs->symbol, symbol) == 0)
+        {
+            return rs;
+        }
+    }
+    return NULL;
+}
+
+// ---- Quotes (feed thread) ----
+
+static inline void risk_set_quote(RiskChecker *r, unsigned int index, double bid, double ask)
+{
+    if (index < r->quote_count)
+    {
+        atomic_store_explicit(&r->quotes[index].bid, bid, memory_order_relaxed);
+        atomic_store_explicit(&r->quotes[index].ask, ask, memory_order_relaxed);
+    }
+}
+
+// StreamHandlers.on_ticker with the RiskChecker as ctx
+void risk_on_ticker(Subscription *sub, const Msg *msg, void *ctx)
+{
+    RiskChecker *r = (RiskChecker *)ctx;
+    if (sub->index < r->quote_count)
+    {
+        atomic_store_explicit(msg->msg_type > 0 ? &r->quotes[sub->index].bid : &r->quotes[sub->index].ask,
+                              msg->price, memory_order_relaxed);
+    }
+}
+
+// ---- Check (strategy thread) ----
+
+// Check number check (bit 1 << check of the mask) of an order of size
+// at price; dir is 1 for a buy, -1 for a sell
+static inline int risk_eval(const RiskSymbol *rs, int check, double dir, double size, double price)
+{
+    int sell = dir < 0;
+    switch (check)
+    {
+    case 0:
+        return (size > rs->max_size) * RISK_MAX_SIZE;
+    case 1:
+        return (size * price > rs->max_notional) * RISK_MAX_NOTIONAL;
+    case 2:
+    {
+        double ref = atomic_load_explicit(sell ? &rs->quote->bid : &rs->quote->ask, memory_order_relaxed);
+        // Buy: price <= ask * (1 + band); sell: price >= bid * (1 - band)
+        double bound = ref * (1.0 + dir * rs->band);
+        return (((price - bound) * dir > 0) | !(ref > 0)) * RISK_PRICE_BAND;
+    }
+    case 3:
+        return (rs->open_orders >= rs->max_open_orders) * RISK_OPEN_ORDERS;
+    default:
+        return (dir * rs->position + rs->open_qty[sell] + size > rs->max_position) * RISK_POSITION;
+    }
+}
+
+// Check an order of size at price; side 1 buys, anything else sells.
+// Returns 0 if it may be sent, otherwise the RISK_* checks it fails.
+static inline int risk_check(RiskChecker *r, const RiskSymbol *rs, int side, double size, double price)
+{
+    double dir = side != 1 ? -1.0 : 1.0;
+    int fail = 0;
+    if (r->timed)
+    {
+        // One clock read between checks, so each histogram holds one check
+        // plus one read
+        long long start = get_current_timestamp_ns();
+        for (int i = 0; i < RISK_CHECKS; i++)
+        {
+            fail |= risk_eval(rs, i, dir, size, price);
+            long long now = get_current_timestamp_ns();
+            hist_record(&r->latency[i], now - start);
+            start = now;
+        }
+    }
+    else
+    {
+        fail = risk_eval(rs, 0, dir, size, price) | risk_eval(rs, 1, dir, size, price) |
+               risk_eval(rs, 2, dir, size, price) | risk_eval(rs, 3, dir, size, price) |
+               risk_eval(rs, 4, dir, size, price);
+    }
+
+    r->checks++;
+    r->passed += fail == 0;
+    for (int i = 0; i < RISK_CHECKS; i++)
+    {
+        r->failed[i] += (fail >> i) & 1;
+    }
+    return fail;
+}
+
+// ---- Exposure ----
+
+// A place of size went out
+static inline void risk_on_sent(RiskSymbol *rs, int side, double size)
+{
+    rs->open_orders++;
+    rs->open_qty[side != 1] += size;
+}
+
+// qty of an open order filled
+static inline void risk_on_fill(RiskSymbol *rs, int side, double qty)
+{
+    rs->position += side != 1 ? -qty : qty;
+    rs->open_qty[side != 1] -= qty;
+}
+
+// An open order is done with remaining unfilled
+static inline void risk_on_closed(RiskSymbol *rs, int side, double remaining)
+{
+    rs->open_orders--;
+    rs->open_qty[side != 1] -= remaining;
+}
+
+// OrderUpdateHandler body: books the update of an order that was counted
+// with risk_on_sent (placed through the session, place_idx set)
+void risk_on_order_update(RiskChecker *r, const ManagedOrder *o, int previous_state)
+{
+    if (o->place_idx < 0)
+    {
+        return;
+    }
+    RiskSymbol *rs = risk_symbol(r, o->account, o->symbol);
+    if (rs == NULL)
+    {
+        return;
+    }
+    double filled = o->filled_qty - o->reported_filled_qty;
+    if (filled > 0)
+    {
+        risk_on_fill(rs, o->side, filled);
+    }
+    if (order_state_terminal(o->state) && !order_state_terminal(previous_state))
+    {
+        double remaining = o->qty - o->filled_qty;
+        risk_on_closed(rs, o->side, remaining > 0 ? remaining : 0);
+    }
+}
+
+// ---- Session (sending thread) ----
+
+static void *risk_session_resolve(void *ctx, int account, const char *symbol)
+{
+    return risk_symbol((RiskChecker *)ctx, account, symbol);
+}
+
+static int risk_session_check(void *ctx, void *entry, int side, double size, double price)
+{
+    RiskChecker *r = (RiskChecker *)ctx;
+    if (entry == NULL)
+    {
+        r->no_limits++;
+        return RISK_NO_LIMITS;
+    }
+    return risk_check(r, (const RiskSymbol *)entry, side, size, price);
+}
+
+static void risk_session_sent(void *ctx, void *entry, int side, double size)
+{
+    risk_on_sent((RiskSymbol *)entry, side, size);
+}
+
+// Check every place s sends and book the ones that go out; a place of an
+// (account, symbol) without limits is refused. Add the symbols before
+// building OrderTemplates on s. The checker's counters are not atomic: one
+// sending thread per checker.
+void risk_attach(RiskChecker *r, OrderSession *s)
+{
+    OrderPreTrade pre_trade = {
+        .resolve = risk_session_resolve,
+        .check = risk_session_check,
+        .on_sent = risk_session_sent,
+        .ctx = r,
+    };
+    order_session_set_pre_trade(s, &pre_trade);
+}
+
+// ---- Quotes from the SDK feed ----
+
+// Receive batch size of risk_feed_open()
+#define RISK_FEED_BATCH 64
+
+// For a client without a feed loop of its own: open the SDK's subscription
+// socket for risk_feed_quote()
+int risk_feed_open(void)
+{
+    if (init_subscription_manager() < 0 || init_batch_receiver(RISK_FEED_BATCH, 0) < 0)
+    {
+        return -1;
+    }
+    // Lets the blocking receive give up while the feed is quiet
+    struct timeval tv = {0, 100000};
+    setsockopt(manager.socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return 0;
+}
+
+void risk_feed_close(void)
+{
+    free_batch_receiver();
+    free_subscriptions();
+    close(manager.socket);
+}
+
+static const Subscription *risk_feed_subscription(const char *feed_symbol)
+{
+    for (int i = 0; i < manager.subscription_count; i++)
+    {
+        if (strcmp(manager.subscriptions[i]->symbol, feed_symbol) == 0)
+        {
+            return manager.subscriptions[i];
+        }
+    }
+    return NULL;
+}
+
+// Subscribe to feed_symbol ("venue:symbol", as stream.c) and receive with
+// risk_on_ticker until the feed acked it and quoted both sides, for at
+// most timeout_ms. Returns the symbol's feed index, the quote_index of
+// risk_add_symbol(), or -1 if it was not quoted in time. Quotes of other
+// symbols keep flowing into r meanwhile; call again to catch up on them.
+int risk_feed_quote(RiskChecker *r, const char *feed_symbol, int timeout_ms)
+{
+    StreamHandlers handlers = {.on_ticker = risk_on_ticker, .ctx = r};
+    const Subscription *sub = risk_feed_subscription(feed_symbol);
+    if (sub == NULL && subscribe(feed_symbol) < 0)
+    {
+        return -1;
+    }
+    long long deadline = get_current_timestamp_ns() + timeout_ms * 1000000LL;
+    do
+    {
+        if (receive_batch(&handlers) < 0)
+        {
+            return -1;
+        }
+        sub = sub != NULL ? sub : risk_feed_subscription(feed_symbol);
+        if (sub != NULL && sub->index >= r->quote_count)
+        {
+            fprintf(stderr, "risk: %s has feed index %u, quotes are kept for %u\n", feed_symbol, sub->index,
+                    r->quote_count);
+            return -1;
+        }
+        if (sub != NULL && atomic_load_explicit(&r->quotes[sub->index].bid, memory_order_relaxed) > 0 &&
+            atomic_load_explicit(&r->quotes[sub->index].ask, memory_order_relaxed) > 0)
+        {
+            return (int)sub->index;
+        }
+    } while (get_current_timestamp_ns() < deadline);
+    fprintf(stderr, "risk: no quote for %s within %d ms\n", feed_symbol, timeout_ms);
+    return -1;
+}
+
+void print_risk_stats(const RiskChecker *r)
+{
+    static HistogramSnapshot snap;
+    printf("=== Risk Check Stats ===\n");
+    printf("checks %lu, passed %lu, refused without limits %lu\n", r->checks, r->passed, r->no_limits);
+    for (int i = 0; i < RISK_CHECKS; i++)
+    {
+        printf("  %-13s failed %lu", risk_check_names[i], r->failed[i]);
+        hist_snapshot(&r->latency[i], &snap);
+        if (snap.total > 0)
+        {
+            printf(", ns (incl. one clock read) p50 %.0f, p99 %.0f, max %.0f", (double)hist_percentile(&snap, 0.50),
+                   (double)hist_percentile(&snap, 0.99), (double)snap.max);
+        }
+        printf("\n");
+    }
+    for (int i = 0; i < r->symbol_count; i++)
+    {
+        const RiskSymbol *rs = &r->symbols[i];
+        printf("%s account %d: position %g, open orders %d (buy %g, sell %g)\n", rs->symbol, rs->account,
+               rs->position, rs->open_orders, rs->open_qty[0], rs->open_qty[1]);
+    }
+    printf("========================\n");
+}
+
+#endif // QTX_RISK_CHECK_C
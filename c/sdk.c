@@ -1,5 +1,10 @@
+#ifndef QTX_SDK_C
+#define QTX_SDK_C
+
+#define _GNU_SOURCE
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,30 +12,291 @@
 #include <string.h>
 #include <arpa/inet.h>
 #include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
 
 #define UDP_SIZE 65536
-#define MAX_SYMBOLS 100
 #define MAX_SYMBOL_LEN 64
+// Build with -DSUBSCRIPTION_MANAGER='"127.0.0.1"' to use a local sim_feed
+#ifndef SUBSCRIPTION_MANAGER
 #define SUBSCRIPTION_MANAGER "10.11.4.97"
+#endif
 #define SUBSCRIPTION_MANAGER_PORT 9080
 #define LOCAL_BINDING_PORT 9088
+// Upper bound for the number of datagrams fetched by one recvmmsg call
+#define RECV_BATCH_MAX 1024
+// Per-datagram control buffer, room for one scm_timestamping
+#define RX_CONTROL_LEN 64
+
+#define RX_TIMESTAMP_NONE 0
+#define RX_TIMESTAMP_SOFTWARE 1
+#define RX_TIMESTAMP_HARDWARE 2
+
+// RECV_MODE_BLOCK sleeps in recvmmsg until data arrives; RECV_MODE_SPIN
+// polls with MSG_DONTWAIT and returns at once, the caller loops
+#define RECV_MODE_BLOCK 0
+#define RECV_MODE_SPIN 1
+
+// Older libc headers lack the busy polling options added in Linux 5.11
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
+
+typedef struct Msg
+{
+    // 1: L1 Bid, -1: L1 Ask, 2: L2 Bid, -2: L2 Ask, 3: Buy Trade, -3: Sell Trade
+    int msg_type;
+    // Index of symbol
+    int index;
+    // Transaction Time MS
+    long tx_ms;
+    // Event Time MS
+    long event_ms;
+    // Local Time NS
+    long local_ns;
+    // Sequence Number / Trade ID
+    long sn_id;
+    // Price
+    double price;
+    // Size
+    double size;
+} Msg;
+
+typedef struct Msg2
+{
+    // 1: L1 Bid, -1: L1 Ask, 2: L2 Bid, -2: L2 Ask, 3: Buy Trade, -3: Sell Trade
+    int msg_type;
+    // Index of symbol
+    int index;
+    // Transaction Time MS
+    long tx_ms;
+    // Event Time MS
+    long event_ms;
+    // Local Time NS
+    long local_ns;
+    // Sequence Number / Trade ID
+    long sn_id;
+    // not used
+    int asks_idx;
+    // Number of asks
+    int asks_len;
+    // not used
+    int bids_idx;
+    // Number of bids
+    int bids_len;
+} Msg2;
+
+typedef struct
+{
+    double price;
+    double size;
+} Msg2Level;
+
+// Sequence channels: L1 bids and asks are tracked apart because both sides
+// of one exchange update may carry the same sn_id; buy and sell trades share
+// the venue's trade id sequence.
+#define SEQ_CHANNEL_BID 0
+#define SEQ_CHANNEL_ASK 1
+#define SEQ_CHANNEL_TRADE 2
+#define SEQ_CHANNEL_DEPTH 3
+#define SEQ_CHANNELS 4
+
+// Bit of a channel in SeqTracker.contiguous
+#define SEQ_CONTIGUOUS(channel) (1U << (channel))
+#define SEQ_CONTIGUOUS_ALL ((1U << SEQ_CHANNELS) - 1)
+#define SEQ_MAX_VENUE_RULES 32
+
+#define SEQ_IN_ORDER 0
+#define SEQ_DUPLICATE 1
+#define SEQ_STALE 2
+#define SEQ_GAP 3
+
+// Per-symbol sn_id tracking. Messages with sn_id <= 0 are not tracked.
+typedef struct
+{
+    long last_sn[SEQ_CHANNELS];
+    unsigned long in_order;
+    unsigned long duplicates;
+    unsigned long stale;
+    unsigned long gaps;
+    // Sum of sn_id values skipped over by gaps
+    unsigned long missing;
+    // Set by an L1 gap, cleared by the next depth snapshot
+    int awaiting_snapshot;
+    // SEQ_CONTIGUOUS bits of the channels whose sn_id steps by exactly 1;
+    // on the others it only has to increase, so a jump is no gap
+    unsigned int contiguous;
+} SeqTracker;
+
+// Channels on which a venue numbers its messages consecutively, matched on
+// the "venue:" prefix of a symbol. Trade ids of these venues step by one per
+// symbol; book ticker and depth update ids skip values as a matter of course
+// on every venue, so they are only checked for order unless a rule says so.
+typedef struct
+{
+    char venue[MAX_SYMBOL_LEN];
+    unsigned int contiguous;
+} SeqVenueRule;
+
+static SeqVenueRule seq_venue_rules[SEQ_MAX_VENUE_RULES] = {
+    {"binance-futures", SEQ_CONTIGUOUS(SEQ_CHANNEL_TRADE)},
+    {"binance", SEQ_CONTIGUOUS(SEQ_CHANNEL_TRADE)},
+    // sim_feed.c numbers every channel consecutively
+    {"sim", SEQ_CONTIGUOUS_ALL},
+};
+static int seq_venue_rule_count = 3;
+
+// A symbol name as published to consumers, never modified once set. The
+// names a slot held before stay allocated, chained from the newest, since
+// a consumer may still be printing one; free_subscriptions() frees them.
+typedef struct SymbolName
+{
+    struct SymbolName *previous;
+    char symbol[];
+} SymbolName;
 
 typedef struct
 {
-    char symbol[MAX_SYMBOL_LEN];
+    // Points into names; a symbol reassigning the slot gets a new string.
+    // Threads other than the one processing acks read it through
+    // subscription_symbol().
+    const char *symbol;
+    SymbolName *names;
     unsigned int index;
+    SeqTracker seq;
+    // 0 after unsubscribe; the entry stays in the index table for reuse
+    int active;
+    // Bumped whenever add_subscripton() (re)assigns the slot to a symbol
+    unsigned int generation;
+    // Per-symbol user state, owned by the caller. add_subscripton() never
+    // touches it, since another thread may be using it; the caller records
+    // the generation it was built for in state_generation and resets it
+    // when subscription_generation() differs.
+    void *state;
+    unsigned int state_generation;
 } Subscription;
 
+// Callbacks invoked for every decoded message. Any of them may be NULL.
+typedef struct
+{
+    // L1 ticker, msg_type 1 (bid) or -1 (ask)
+    void (*on_ticker)(Subscription *sub, const Msg *msg, void *ctx);
+    // Trade, msg_type 3 (buy) or -3 (sell)
+    void (*on_trade)(Subscription *sub, const Msg *msg, void *ctx);
+    // Depth snapshot, levels holds asks_len asks followed by bids_len bids
+    void (*on_depth)(Subscription *sub, const Msg2 *msg2, const Msg2Level *levels, void *ctx);
+    // An L1 gap left the top of book unreliable until the next depth snapshot
+    void (*on_resync)(Subscription *sub, int msg_type, long expected_sn, long received_sn, void *ctx);
+    void *ctx;
+} StreamHandlers;
+
+// Runs in add_subscripton() once sub holds its (new) symbol and before any
+// of its messages are dispatched, on the thread processing acks. Returning
+// < 0 refuses the subscription: it stays inactive and its messages are dropped.
+typedef int (*SubscriptionHook)(Subscription *sub, void *ctx);
+#define MAX_SUBSCRIPTION_HOOKS 8
+
+// Per-symbol table for state kept outside the SDK, indexed like
+// manager.by_index but split in fixed chunks that are never moved, so one
+// thread can add entries while others read them without a lock. Chunks are
+// allocated as indexes reach them. The directory of chunk pointers doubles
+// when an index falls past it and is republished whole; the directory it
+// replaces stays allocated until index_table_free(), as a reader may still
+// be looking it up.
+#define INDEX_CHUNK_BITS 10
+#define INDEX_CHUNK (1U << INDEX_CHUNK_BITS)
+#define INDEX_TABLE_MIN_CHUNKS 16
+
+typedef struct IndexDirectory
+{
+    unsigned int chunks;
+    struct IndexDirectory *retired;
+    void **chunk[];
+} IndexDirectory;
+
+// Zero-initialized tables are empty
+typedef struct
+{
+    IndexDirectory *dir;
+} IndexTable;
+
+// Sees every raw datagram, subscription acks included, before it is decoded
+typedef void (*DatagramHook)(const char *buf, int len, unsigned short src_port,
+                             long long recv_ns, void *ctx);
+
+// Ring of per-slot buffers filled by a single recvmmsg call
+typedef struct
+{
+    unsigned int vlen;
+    int use_timeout;
+    struct timespec timeout;
+    char *bufs;
+    struct iovec *iovecs;
+    struct mmsghdr *msgs;
+    struct sockaddr_in *addrs;
+    char *controls;
+    // RX_TIMESTAMP_* requested by enable_rx_timestamps()
+    int timestamping;
+    // Datagrams that carried a hardware / only a software kernel timestamp
+    unsigned long hw_stamps;
+    unsigned long sw_stamps;
+    // RECV_MODE_* set by set_receive_mode()
+    int mode;
+    // Spin mode: recvmmsg calls that found the socket empty
+    unsigned long empty_polls;
+    // Number of recvmmsg calls and datagrams received so far
+    unsigned long calls;
+    unsigned long packets;
+    // per_call[n]: number of calls that returned n datagrams (n <= vlen)
+    unsigned long *per_call;
+    DatagramHook on_datagram;
+    void *datagram_ctx;
+} BatchReceiver;
+
 typedef struct
 {
     int socket;
     char buf[UDP_SIZE];
-    Subscription subscriptions[MAX_SYMBOLS];
+    // Active subscriptions in subscription order. Entries are heap allocated
+    // so pointers held by by_index and by user code survive array growth.
+    Subscription **subscriptions;
     int subscription_count;
+    int subscription_capacity;
+    // Direct-indexed by the server-assigned index, NULL for unused slots
+    Subscription **by_index;
+    unsigned int index_capacity;
+    SubscriptionHook hooks[MAX_SUBSCRIPTION_HOOKS];
+    void *hook_ctx[MAX_SUBSCRIPTION_HOOKS];
+    int hook_count;
+    BatchReceiver batch;
 } SubscriptionManager;
 
 SubscriptionManager manager;
 volatile sig_atomic_t running = 1;
+// Receive time (CLOCK_REALTIME ns) of the datagram being dispatched on this
+// thread. receive_batch() sets it before calling handlers; consumers of
+// rings or journals set it from the stored value.
+__thread long long recv_timestamp_ns;
+// Kernel RX timestamp of the same datagram (SO_TIMESTAMPING, hardware if the
+// NIC provided one), 0 when timestamping is off or the datagram had none
+__thread long long recv_kernel_ns;
+
+long long get_current_timestamp_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
 int init_subscription_manager()
 {
@@ -67,6 +333,288 @@ int init_subscription_manager()
     return 0;
 }
 
+// O(1) lookup by the server-assigned index, used for every message
+static inline Subscription *find_subscription(unsigned int index)
+{
+    Subscription *sub = index < manager.index_capacity ? manager.by_index[index] : NULL;
+    return sub != NULL && sub->active ? sub : NULL;
+}
+
+// Generation of the symbol now holding sub's slot, safe to read from a
+// thread other than the one processing subscription acks
+static inline unsigned int subscription_generation(const Subscription *sub)
+{
+    return __atomic_load_n(&sub->generation, __ATOMIC_ACQUIRE);
+}
+
+// Symbol now holding sub's slot; like subscription_generation(), safe to
+// call from any thread, and the string stays valid until free_subscriptions()
+static inline const char *subscription_symbol(const Subscription *sub)
+{
+    return __atomic_load_n(&sub->symbol, __ATOMIC_ACQUIRE);
+}
+
+const char *find_symbol(int index)
+{
+    Subscription *sub = find_subscription((unsigned int)index);
+    return sub != NULL ? subscription_symbol(sub) : NULL;
+}
+
+// Entry at index, NULL if none was set; safe against a concurrent setter
+static inline void *index_table_get(const IndexTable *t, unsigned int index)
+{
+    IndexDirectory *d = __atomic_load_n(&t->dir, __ATOMIC_ACQUIRE);
+    if (d == NULL || (index >> INDEX_CHUNK_BITS) >= d->chunks)
+    {
+        return NULL;
+    }
+    void **chunk = __atomic_load_n(&d->chunk[index >> INDEX_CHUNK_BITS], __ATOMIC_ACQUIRE);
+    return chunk != NULL ? __atomic_load_n(&chunk[index & (INDEX_CHUNK - 1)], __ATOMIC_ACQUIRE) : NULL;
+}
+
+// Replace t's directory with one covering chunk c, carrying the chunks over
+static IndexDirectory *index_table_grow(IndexTable *t, unsigned int c)
+{
+    IndexDirectory *d = t->dir;
+    unsigned int chunks = d != NULL ? d->chunks : INDEX_TABLE_MIN_CHUNKS;
+    while (chunks <= c)
+    {
+        chunks *= 2;
+    }
+    IndexDirectory *grown = calloc(1, sizeof(IndexDirectory) + (size_t)chunks * sizeof(grown->chunk[0]));
+    if (grown == NULL)
+    {
+        perror("index table allocation failed");
+        return NULL;
+    }
+    grown->chunks = chunks;
+    if (d != NULL)
+    {
+        memcpy(grown->chunk, d->chunk, (size_t)d->chunks * sizeof(d->chunk[0]));
+        grown->retired = d;
+    }
+    __atomic_store_n(&t->dir, grown, __ATOMIC_RELEASE);
+    return grown;
+}
+
+// Publish value at index. One thread at a time may set entries of a table.
+int index_table_set(IndexTable *t, unsigned int index, void *value)
+{
+    unsigned int c = index >> INDEX_CHUNK_BITS;
+    IndexDirectory *d = t->dir;
+    if (d == NULL || c >= d->chunks)
+    {
+        d = index_table_grow(t, c);
+        if (d == NULL)
+        {
+            return -1;
+        }
+    }
+    void **chunk = d->chunk[c];
+    if (chunk == NULL)
+    {
+        chunk = calloc(INDEX_CHUNK, sizeof(*chunk));
+        if (chunk == NULL)
+        {
+            perror("index table allocation failed");
+            return -1;
+        }
+        __atomic_store_n(&d->chunk[c], chunk, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&chunk[index & (INDEX_CHUNK - 1)], value, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// Iterate: returns the next non-NULL entry at or after *index and leaves
+// *index on it, NULL at the end. Start from 0, continue from *index + 1.
+void *index_table_next(const IndexTable *t, unsigned int *index)
+{
+    IndexDirectory *d = __atomic_load_n(&t->dir, __ATOMIC_ACQUIRE);
+    if (d == NULL)
+    {
+        return NULL;
+    }
+    // Wider than the index: the last chunk may end at 2^32
+    unsigned long long end = (unsigned long long)d->chunks << INDEX_CHUNK_BITS;
+    for (unsigned long long i = *index; i < end; i++)
+    {
+        void **chunk = __atomic_load_n(&d->chunk[i >> INDEX_CHUNK_BITS], __ATOMIC_ACQUIRE);
+        if (chunk == NULL)
+        {
+            i |= INDEX_CHUNK - 1;
+            continue;
+        }
+        void *value = __atomic_load_n(&chunk[i & (INDEX_CHUNK - 1)], __ATOMIC_ACQUIRE);
+        if (value != NULL)
+        {
+            *index = (unsigned int)i;
+            return value;
+        }
+    }
+    return NULL;
+}
+
+// Free the chunks and directories, not the entries; no other thread may be using t
+void index_table_free(IndexTable *t)
+{
+    IndexDirectory *d = t->dir;
+    if (d != NULL)
+    {
+        for (unsigned int i = 0; i < d->chunks; i++)
+        {
+            free(d->chunk[i]);
+        }
+    }
+    while (d != NULL)
+    {
+        IndexDirectory *retired = d->retired;
+        free(d);
+        d = retired;
+    }
+    t->dir = NULL;
+}
+
+// Register a hook run for every symbol subscribed afterwards
+int add_subscription_hook(SubscriptionHook hook, void *ctx)
+{
+    if (manager.hook_count == MAX_SUBSCRIPTION_HOOKS)
+    {
+        fprintf(stderr, "too many subscription hooks\n");
+        return -1;
+    }
+    manager.hooks[manager.hook_count] = hook;
+    manager.hook_ctx[manager.hook_count] = ctx;
+    manager.hook_count++;
+    return 0;
+}
+
+// Grow the index table (doubling) until index fits
+static int reserve_index(unsigned int index)
+{
+    if (index < manager.index_capacity)
+    {
+        return 0;
+    }
+
+    unsigned int capacity = manager.index_capacity ? manager.index_capacity : 64;
+    while (capacity <= index)
+    {
+        if (capacity > UINT_MAX / 2)
+        {
+            return -1;
+        }
+        capacity *= 2;
+    }
+
+    Subscription **table = realloc(manager.by_index, capacity * sizeof(*table));
+    if (table == NULL)
+    {
+        return -1;
+    }
+    memset(table + manager.index_capacity, 0,
+           (capacity - manager.index_capacity) * sizeof(*table));
+    manager.by_index = table;
+    manager.index_capacity = capacity;
+    return 0;
+}
+
+static int append_active(Subscription *sub)
+{
+    if (manager.subscription_count == manager.subscription_capacity)
+    {
+        int capacity = manager.subscription_capacity ? manager.subscription_capacity * 2 : 16;
+        Subscription **list = realloc(manager.subscriptions, capacity * sizeof(*list));
+        if (list == NULL)
+        {
+            return -1;
+        }
+        manager.subscriptions = list;
+        manager.subscription_capacity = capacity;
+    }
+    manager.subscriptions[manager.subscription_count++] = sub;
+    return 0;
+}
+
+static void remove_active(Subscription *sub)
+{
+    for (int i = 0; i < manager.subscription_count; i++)
+    {
+        if (manager.subscriptions[i] == sub)
+        {
+            for (int j = i; j < manager.subscription_count - 1; j++)
+            {
+                manager.subscriptions[j] = manager.subscriptions[j + 1];
+            }
+            manager.subscription_count--;
+            break;
+        }
+    }
+    sub->active = 0;
+}
+
+// Set which channels of venue ("binance", "okx-swap", ...) are numbered
+// consecutively. Applies to symbols subscribed afterwards.
+int set_seq_rule(const char *venue, unsigned int contiguous)
+{
+    for (int i = 0; i < seq_venue_rule_count; i++)
+    {
+        if (strcmp(seq_venue_rules[i].venue, venue) == 0)
+        {
+            seq_venue_rules[i].contiguous = contiguous;
+            return 0;
+        }
+    }
+    if (seq_venue_rule_count == SEQ_MAX_VENUE_RULES)
+    {
+        fprintf(stderr, "too many sequence rules, %s ignored\n", venue);
+        return -1;
+    }
+    SeqVenueRule *rule = &seq_venue_rules[seq_venue_rule_count++];
+    snprintf(rule->venue, sizeof(rule->venue), "%s", venue);
+    rule->contiguous = contiguous;
+    return 0;
+}
+
+static unsigned int seq_rule_of(const char *symbol)
+{
+    size_t len = strcspn(symbol, ":");
+    for (int i = 0; i < seq_venue_rule_count; i++)
+    {
+        if (strlen(seq_venue_rules[i].venue) == len && strncmp(seq_venue_rules[i].venue, symbol, len) == 0)
+        {
+            return seq_venue_rules[i].contiguous;
+        }
+    }
+    return 0;
+}
+
+// Release every table entry; call once the receive loop has stopped
+void free_subscriptions()
+{
+    for (unsigned int i = 0; i < manager.index_capacity; i++)
+    {
+        Subscription *sub = manager.by_index[i];
+        if (sub == NULL)
+        {
+            continue;
+        }
+        while (sub->names != NULL)
+        {
+            SymbolName *previous = sub->names->previous;
+            free(sub->names);
+            sub->names = previous;
+        }
+        free(sub);
+    }
+    free(manager.by_index);
+    free(manager.subscriptions);
+    manager.by_index = NULL;
+    manager.subscriptions = NULL;
+    manager.index_capacity = 0;
+    manager.subscription_count = 0;
+    manager.subscription_capacity = 0;
+}
+
 int subscribe(const char *symbol)
 {
     printf("Subscribing to symbol: %s\n", symbol);
@@ -91,32 +639,94 @@ int subscribe(const char *symbol)
     return 0;
 }
 
-int add_subscripton(int len)
+// buf must have room for a terminating '\0' at buf[len]
+int add_subscripton(char *buf, int len)
 {
-    manager.buf[len] = '\0';
+    buf[len] = '\0';
     unsigned int index;
     char subscripted_symbol[MAX_SYMBOL_LEN] = {0};
-    if (sscanf(manager.buf, "%u:%63s", &index, subscripted_symbol) == 2)
+    if (sscanf(buf, "%u:%63s", &index, subscripted_symbol) == 2)
     {
         // 检查是否已经订阅
+        Subscription *sub = find_subscription(index);
+        if (sub != NULL && strcmp(sub->symbol, subscripted_symbol) == 0)
+        {
+            return 0; // 已经订阅过了
+        }
+
+        if (reserve_index(index) < 0)
+        {
+            fprintf(stderr, "Failed to grow index table for %s (index %u)\n",
+                    subscripted_symbol, index);
+            return -1;
+        }
+
+        // The server re-assigned this symbol to a new index: retire the old slot.
+        // Only new registrations reach this scan, never the data path.
         for (int i = 0; i < manager.subscription_count; i++)
         {
-            if (strcmp(manager.subscriptions[i].symbol, subscripted_symbol) == 0)
+            if (strcmp(manager.subscriptions[i]->symbol, subscripted_symbol) == 0)
+            {
+                remove_active(manager.subscriptions[i]);
+                break;
+            }
+        }
+
+        // 添加新订阅, reusing the slot's storage if this index was seen before
+        sub = manager.by_index[index];
+        if (sub == NULL)
+        {
+            sub = calloc(1, sizeof(Subscription));
+            if (sub == NULL)
             {
-                return 0; // 已经订阅过了
+                perror("subscription allocation failed");
+                return -1;
             }
+            manager.by_index[index] = sub;
+        }
+        else if (sub->active)
+        {
+            remove_active(sub);
         }
 
-        // 添加新订阅
-        if (manager.subscription_count < MAX_SYMBOLS)
+        if (sub->symbol == NULL || strcmp(sub->symbol, subscripted_symbol) != 0)
         {
-            strncpy(manager.subscriptions[manager.subscription_count].symbol,
-                    subscripted_symbol, MAX_SYMBOL_LEN - 1);
-            manager.subscriptions[manager.subscription_count].symbol[MAX_SYMBOL_LEN - 1] = '\0';
-            manager.subscriptions[manager.subscription_count].index = index;
-            manager.subscription_count++;
-            printf("Successfully subscribed to %s with index %u\n", subscripted_symbol, index);
+            size_t len = strlen(subscripted_symbol) + 1;
+            SymbolName *name = malloc(sizeof(SymbolName) + len);
+            if (name == NULL)
+            {
+                perror("subscription allocation failed");
+                return -1;
+            }
+            memcpy(name->symbol, subscripted_symbol, len);
+            name->previous = sub->names;
+            sub->names = name;
+            // The generation store below publishes it along with the slot
+            __atomic_store_n(&sub->symbol, name->symbol, __ATOMIC_RELEASE);
+        }
+        if (append_active(sub) < 0)
+        {
+            perror("subscription list allocation failed");
+            return -1;
         }
+        sub->index = index;
+        memset(&sub->seq, 0, sizeof(sub->seq));
+        sub->seq.contiguous = seq_rule_of(subscripted_symbol);
+        // A consumer may still hold state built for the slot's previous
+        // symbol; the new generation tells it to reset that state itself
+        __atomic_store_n(&sub->generation, sub->generation + 1, __ATOMIC_RELEASE);
+        for (int i = 0; i < manager.hook_count; i++)
+        {
+            if (manager.hooks[i](sub, manager.hook_ctx[i]) < 0)
+            {
+                remove_active(sub);
+                fprintf(stderr, "Subscription to %s (index %u) refused, its messages will be dropped\n",
+                        subscripted_symbol, index);
+                return -1;
+            }
+        }
+        sub->active = 1;
+        printf("Successfully subscribed to %s with index %u\n", subscripted_symbol, index);
     }
 
     return 0;
@@ -129,17 +739,17 @@ int unsubscribe(const char *symbol)
     printf("Unsubscribing from symbol: %s\n", symbol);
 
     // 查找订阅
-    int pos = -1;
+    Subscription *sub = NULL;
     for (int i = 0; i < manager.subscription_count; i++)
     {
-        if (strcmp(manager.subscriptions[i].symbol, symbol) == 0)
+        if (strcmp(manager.subscriptions[i]->symbol, symbol) == 0)
         {
-            pos = i;
+            sub = manager.subscriptions[i];
             break;
         }
     }
 
-    if (pos >= 0)
+    if (sub != NULL)
     {
         // 发送取消订阅请求
         struct sockaddr_in server_addr;
@@ -155,12 +765,9 @@ int unsubscribe(const char *symbol)
             return -1;
         }
 
-        // 移除订阅
-        for (int i = pos; i < manager.subscription_count - 1; i++)
-        {
-            manager.subscriptions[i] = manager.subscriptions[i + 1];
-        }
-        manager.subscription_count--;
+        // 移除订阅; the entry is kept in by_index so the data path never
+        // touches freed memory
+        remove_active(sub);
     }
     else
     {
@@ -180,7 +787,7 @@ int unsubscribe_all()
     // 从后向前遍历以避免数组重排的影响
     for (int i = count - 1; i >= 0; i--)
     {
-        if (unsubscribe(manager.subscriptions[i].symbol) != 0)
+        if (unsubscribe(manager.subscriptions[i]->symbol) != 0)
         {
             success = 0;
         }
@@ -196,14 +803,458 @@ void print_status()
     for (int i = 0; i < manager.subscription_count; i++)
     {
         printf("Symbol: %s (index: %u)\n",
-               manager.subscriptions[i].symbol,
-               manager.subscriptions[i].index);
+               manager.subscriptions[i]->symbol,
+               manager.subscriptions[i]->index);
     }
     printf("==================\n");
 }
 
+// msg_type + 3 -> sequence channel, -1 for untracked types
+static const signed char seq_channel_of[7] = {
+    SEQ_CHANNEL_TRADE, -1, SEQ_CHANNEL_ASK, -1, SEQ_CHANNEL_BID, SEQ_CHANNEL_DEPTH, SEQ_CHANNEL_TRADE};
+
+static const char *const seq_channel_names[SEQ_CHANNELS] = {"bid", "ask", "trade", "depth"};
+
+// Name of the sequence channel a msg_type is tracked on
+const char *seq_channel_name(int msg_type)
+{
+    unsigned int slot = (unsigned int)(msg_type + 3);
+    int channel = slot < 7 ? seq_channel_of[slot] : -1;
+    return channel < 0 ? "untracked" : seq_channel_names[channel];
+}
+
+// Classify sn_id against the last one seen on the message's channel.
+// Only in-order and gap messages advance the channel; on a gap *expected
+// receives the sn_id that should have arrived. Gaps exist only on
+// contiguous channels; elsewhere any increase is in order.
+static inline int seq_check(SeqTracker *seq, int msg_type, long sn_id, long *expected)
+{
+    unsigned int slot = (unsigned int)(msg_type + 3);
+    int channel = slot < 7 ? seq_channel_of[slot] : -1;
+    if (channel < 0 || sn_id <= 0)
+    {
+        return SEQ_IN_ORDER;
+    }
+
+    long last = seq->last_sn[channel];
+    if (sn_id == last + 1 || last == 0 || (sn_id > last && !(seq->contiguous & SEQ_CONTIGUOUS(channel))))
+    {
+        seq->last_sn[channel] = sn_id;
+        seq->in_order++;
+        return SEQ_IN_ORDER;
+    }
+    if (sn_id > last)
+    {
+        *expected = last + 1;
+        seq->last_sn[channel] = sn_id;
+        seq->gaps++;
+        seq->missing += sn_id - last - 1;
+        return SEQ_GAP;
+    }
+    if (sn_id == last)
+    {
+        seq->duplicates++;
+        return SEQ_DUPLICATE;
+    }
+    seq->stale++;
+    return SEQ_STALE;
+}
+
+// Walk every Msg in a data packet, or the single Msg2 of a depth packet,
+// and hand it to the matching handler. Returns the number of messages seen.
+int dispatch_packet(const char *buf, int len, const StreamHandlers *handlers)
+{
+    int count = 0;
+    int offset = 0;
+    while (offset + (int)sizeof(Msg) <= len)
+    {
+        const Msg *msg = (const Msg *)(buf + offset);
+        Subscription *sub = find_subscription((unsigned int)msg->index);
+        count++;
+
+        if (sub != NULL)
+        {
+            // Msg and Msg2 share the header layout, so sn_id is read the same way
+            long expected = 0;
+            int seq = seq_check(&sub->seq, msg->msg_type, msg->sn_id, &expected);
+            if (seq == SEQ_DUPLICATE || seq == SEQ_STALE)
+            {
+                // Dropped before any handler sees it
+                if (msg->msg_type == 2)
+                {
+                    break;
+                }
+                offset += sizeof(Msg);
+                continue;
+            }
+            if (seq == SEQ_GAP && abs(msg->msg_type) == 1)
+            {
+                sub->seq.awaiting_snapshot = 1;
+                if (handlers->on_resync != NULL)
+                {
+                    handlers->on_resync(sub, msg->msg_type, expected, msg->sn_id, handlers->ctx);
+                }
+            }
+
+            if (msg->msg_type == 2)
+            {
+                // L2 消息佔用整個UDP包
+                const Msg2 *msg2 = (const Msg2 *)buf;
+                sub->seq.awaiting_snapshot = 0;
+                size_t need = sizeof(Msg2) +
+                              (size_t)(msg2->asks_len + msg2->bids_len) * sizeof(Msg2Level);
+                if (msg2->asks_len >= 0 && msg2->bids_len >= 0 && need <= (size_t)len &&
+                    handlers->on_depth != NULL)
+                {
+                    handlers->on_depth(sub, msg2, (const Msg2Level *)(buf + sizeof(Msg2)),
+                                       handlers->ctx);
+                }
+                break;
+            }
+            else if (abs(msg->msg_type) == 1)
+            {
+                if (handlers->on_ticker != NULL)
+                {
+                    handlers->on_ticker(sub, msg, handlers->ctx);
+                }
+            }
+            else if (abs(msg->msg_type) == 3)
+            {
+                if (handlers->on_trade != NULL)
+                {
+                    handlers->on_trade(sub, msg, handlers->ctx);
+                }
+            }
+        }
+
+        offset += sizeof(Msg);
+    }
+    return count;
+}
+
+// Prepare the batched receive path: vlen slots of UDP_SIZE bytes each.
+// timeout_ms <= 0 blocks until at least one datagram arrives.
+int init_batch_receiver(unsigned int vlen, long timeout_ms)
+{
+    BatchReceiver *b = &manager.batch;
+    if (vlen == 0 || vlen > RECV_BATCH_MAX)
+    {
+        fprintf(stderr, "invalid batch size %u (1..%d)\n", vlen, RECV_BATCH_MAX);
+        return -1;
+    }
+
+    memset(b, 0, sizeof(*b));
+    b->vlen = vlen;
+    b->bufs = malloc((size_t)vlen * UDP_SIZE);
+    b->iovecs = calloc(vlen, sizeof(struct iovec));
+    b->msgs = calloc(vlen, sizeof(struct mmsghdr));
+    b->addrs = calloc(vlen, sizeof(struct sockaddr_in));
+    b->controls = calloc(vlen, RX_CONTROL_LEN);
+    b->per_call = calloc(vlen + 1, sizeof(unsigned long));
+    if (!b->bufs || !b->iovecs || !b->msgs || !b->addrs || !b->controls || !b->per_call)
+    {
+        perror("batch receiver allocation failed");
+        free(b->bufs);
+        free(b->iovecs);
+        free(b->msgs);
+        free(b->addrs);
+        free(b->controls);
+        free(b->per_call);
+        memset(b, 0, sizeof(*b));
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < vlen; i++)
+    {
+        // Leave one byte so subscription acks can be '\0' terminated in place
+        b->iovecs[i].iov_base = b->bufs + (size_t)i * UDP_SIZE;
+        b->iovecs[i].iov_len = UDP_SIZE - 1;
+    }
+
+    if (timeout_ms > 0)
+    {
+        b->use_timeout = 1;
+        b->timeout.tv_sec = timeout_ms / 1000;
+        b->timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    }
+    return 0;
+}
+
+// Install a raw datagram hook; call after init_batch_receiver()
+void set_datagram_hook(DatagramHook hook, void *ctx)
+{
+    manager.batch.on_datagram = hook;
+    manager.batch.datagram_ctx = ctx;
+}
+
+// Ask the kernel to timestamp every received datagram (SO_TIMESTAMPING).
+// mode RX_TIMESTAMP_SOFTWARE stamps in the network stack on arrival;
+// RX_TIMESTAMP_HARDWARE additionally enables NIC stamping on hw_ifname
+// (needs CAP_NET_ADMIN and a NIC that supports it) and falls back to
+// software stamps otherwise. Hardware stamps come from the NIC clock, so
+// they only compare with CLOCK_REALTIME when phc2sys keeps the two in
+// sync. Call after init_batch_receiver().
+int enable_rx_timestamps(int mode, const char *hw_ifname)
+{
+    BatchReceiver *b = &manager.batch;
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (mode == RX_TIMESTAMP_HARDWARE)
+    {
+        flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+        if (hw_ifname != NULL)
+        {
+            struct hwtstamp_config config;
+            memset(&config, 0, sizeof(config));
+            config.tx_type = HWTSTAMP_TX_OFF;
+            config.rx_filter = HWTSTAMP_FILTER_ALL;
+            struct ifreq ifr;
+            memset(&ifr, 0, sizeof(ifr));
+            snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", hw_ifname);
+            ifr.ifr_data = (char *)&config;
+            if (ioctl(manager.socket, SIOCSHWTSTAMP, &ifr) < 0)
+            {
+                fprintf(stderr, "hardware rx timestamps unavailable on %s: %s, using software\n",
+                        hw_ifname, strerror(errno));
+            }
+        }
+    }
+    else if (mode != RX_TIMESTAMP_SOFTWARE)
+    {
+        b->timestamping = RX_TIMESTAMP_NONE;
+        return 0;
+    }
+
+    if (setsockopt(manager.socket, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0)
+    {
+        perror("setsockopt SO_TIMESTAMPING failed");
+        return -1;
+    }
+    b->timestamping = mode;
+    return 0;
+}
+
+// Kernel timestamp from a received message's control data, 0 if none.
+// scm_timestamping.ts[0] is the software stamp, ts[2] the raw hardware one.
+static inline long long rx_timestamp_of(BatchReceiver *b, const struct msghdr *hdr)
+{
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(hdr); c != NULL; c = CMSG_NXTHDR((struct msghdr *)hdr, c))
+    {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_TIMESTAMPING)
+        {
+            continue;
+        }
+        const struct scm_timestamping *ts = (const struct scm_timestamping *)CMSG_DATA(c);
+        if (ts->ts[2].tv_sec != 0 || ts->ts[2].tv_nsec != 0)
+        {
+            b->hw_stamps++;
+            return (long long)ts->ts[2].tv_sec * 1000000000LL + ts->ts[2].tv_nsec;
+        }
+        if (ts->ts[0].tv_sec != 0 || ts->ts[0].tv_nsec != 0)
+        {
+            b->sw_stamps++;
+            return (long long)ts->ts[0].tv_sec * 1000000000LL + ts->ts[0].tv_nsec;
+        }
+    }
+    return 0;
+}
+
+// Select blocking or spinning receive. In RECV_MODE_SPIN, busy_poll_us > 0
+// also sets SO_BUSY_POLL and SO_PREFER_BUSY_POLL so each poll runs the
+// NIC's receive queue directly instead of waiting for its interrupt; raising
+// SO_BUSY_POLL above net.core.busy_read needs CAP_NET_ADMIN, failures only
+// warn. Pin the spinning thread to an isolated core (pin_current_thread).
+int set_receive_mode(int mode, int busy_poll_us)
+{
+    BatchReceiver *b = &manager.batch;
+    b->mode = mode;
+    if (mode != RECV_MODE_SPIN || busy_poll_us <= 0)
+    {
+        return 0;
+    }
+
+    if (setsockopt(manager.socket, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) < 0)
+    {
+        perror("setsockopt SO_BUSY_POLL failed");
+        return 0;
+    }
+    int prefer = 1;
+    if (setsockopt(manager.socket, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)) < 0)
+    {
+        perror("setsockopt SO_PREFER_BUSY_POLL failed");
+    }
+    return 0;
+}
+
+void free_batch_receiver()
+{
+    BatchReceiver *b = &manager.batch;
+    free(b->bufs);
+    free(b->iovecs);
+    free(b->msgs);
+    free(b->addrs);
+    free(b->controls);
+    free(b->per_call);
+    memset(b, 0, sizeof(*b));
+}
+
+// Receive up to vlen datagrams with one recvmmsg call and dispatch each one.
+// Returns the number of datagrams received, 0 on timeout, -1 on error.
+int receive_batch(const StreamHandlers *handlers)
+{
+    BatchReceiver *b = &manager.batch;
+
+    // recvmmsg overwrites msg_len/msg_namelen, so the headers are reset every call
+    for (unsigned int i = 0; i < b->vlen; i++)
+    {
+        struct msghdr *hdr = &b->msgs[i].msg_hdr;
+        hdr->msg_name = &b->addrs[i];
+        hdr->msg_namelen = sizeof(struct sockaddr_in);
+        hdr->msg_iov = &b->iovecs[i];
+        hdr->msg_iovlen = 1;
+        if (b->timestamping)
+        {
+            hdr->msg_control = b->controls + (size_t)i * RX_CONTROL_LEN;
+            hdr->msg_controllen = RX_CONTROL_LEN;
+        }
+        else
+        {
+            hdr->msg_control = NULL;
+            hdr->msg_controllen = 0;
+        }
+        hdr->msg_flags = 0;
+    }
+
+    struct timespec timeout = b->timeout;
+    int spin = b->mode == RECV_MODE_SPIN;
+    int n = recvmmsg(manager.socket, b->msgs, b->vlen, spin ? MSG_DONTWAIT : MSG_WAITFORONE,
+                     spin || !b->use_timeout ? NULL : &timeout);
+    if (n < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        {
+            b->empty_polls += spin;
+            return 0;
+        }
+        perror("recvmmsg failed");
+        return -1;
+    }
+
+    b->calls++;
+    b->packets += n;
+    b->per_call[n]++;
+
+    // One clock read covers the whole batch; all of it was queued by now
+    long long recv_ns = get_current_timestamp_ns();
+    recv_timestamp_ns = recv_ns;
+
+    for (int i = 0; i < n; i++)
+    {
+        char *buf = (char *)b->iovecs[i].iov_base;
+        int len = (int)b->msgs[i].msg_len;
+        if (b->timestamping)
+        {
+            recv_kernel_ns = rx_timestamp_of(b, &b->msgs[i].msg_hdr);
+        }
+        if (b->on_datagram != NULL)
+        {
+            b->on_datagram(buf, len, ntohs(b->addrs[i].sin_port), recv_ns, b->datagram_ctx);
+        }
+
+        // 订阅
+        if (ntohs(b->addrs[i].sin_port) == SUBSCRIPTION_MANAGER_PORT)
+        {
+            add_subscripton(buf, len);
+            continue;
+        }
+        dispatch_packet(buf, len, handlers);
+    }
+    return n;
+}
+
+// Run the calling thread under SCHED_FIFO at priority (1..99) so nothing
+// but higher real-time work preempts it; 0 leaves the policy unchanged.
+// Needs CAP_SYS_NICE or an RLIMIT_RTPRIO allowance. A spinning FIFO thread
+// never yields, so only combine this with a dedicated core.
+int set_realtime_priority(int priority)
+{
+    if (priority <= 0)
+    {
+        return 0;
+    }
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0)
+    {
+        fprintf(stderr, "failed to set SCHED_FIFO priority %d: %s\n", priority, strerror(err));
+        return -1;
+    }
+    return 0;
+}
+
+// Pin the calling thread to one CPU; cpu < 0 leaves the affinity unchanged
+int pin_current_thread(int cpu)
+{
+    if (cpu < 0)
+    {
+        return 0;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0)
+    {
+        fprintf(stderr, "failed to pin thread to cpu %d: %s\n", cpu, strerror(err));
+        return -1;
+    }
+    return 0;
+}
+
+void print_seq_stats()
+{
+    printf("=== Sequence Stats ===\n");
+    for (int i = 0; i < manager.subscription_count; i++)
+    {
+        const Subscription *sub = manager.subscriptions[i];
+        printf("%s: in-order %lu, gaps %lu (missing %lu), duplicates %lu, stale %lu%s\n",
+               sub->symbol, sub->seq.in_order, sub->seq.gaps, sub->seq.missing,
+               sub->seq.duplicates, sub->seq.stale,
+               sub->seq.awaiting_snapshot ? ", awaiting snapshot" : "");
+    }
+    printf("======================\n");
+}
+
+void print_batch_stats()
+{
+    BatchReceiver *b = &manager.batch;
+    printf("=== Batch Receive Stats ===\n");
+    printf("recvmmsg calls: %lu, datagrams: %lu, avg per call: %.2f\n",
+           b->calls, b->packets, b->calls ? (double)b->packets / b->calls : 0.0);
+    if (b->mode == RECV_MODE_SPIN)
+    {
+        printf("spin mode empty polls: %lu\n", b->empty_polls);
+    }
+    if (b->timestamping)
+    {
+        printf("kernel rx timestamps: hardware %lu, software %lu, missing %lu\n",
+               b->hw_stamps, b->sw_stamps, b->packets - b->hw_stamps - b->sw_stamps);
+    }
+    for (unsigned int n = 1; n <= b->vlen; n++)
+    {
+        if (b->per_call[n] > 0)
+        {
+            printf("  %u datagram(s): %lu call(s)\n", n, b->per_call[n]);
+        }
+    }
+    printf("===========================\n");
+}
+
 void handle_signal(int sig)
 {
     running = 0;
     unsubscribe_all();
 }
+
+#endif // QTX_SDK_C
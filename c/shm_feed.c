@@ -0,0 +1,405 @@
+#ifndef QTX_SHM_FEED_C
+#define QTX_SHM_FEED_C
+
+#include "sdk.c"
+#include "ring.c"
+#include <sys/stat.h>
+
+// POSIX shared-memory fan-out of the decoded feed. One publisher process
+// owns the subscription socket and appends every Msg / depth snapshot to a
+// broadcast ring; any number of readers mmap the segment and follow it
+// without syscalls. Readers never block the publisher: a reader that falls
+// more than a ring behind is told so and skips to the live position.
+
+#define SHM_FEED_NAME "/qtx_stream"
+#define SHM_FEED_MAGIC 0x51545846454544UL // "QTXFEED"
+
+#define SHM_REC_MSG 1
+#define SHM_REC_DEPTH 2
+#define SHM_REC_WRAP 3
+
+// Header in front of every record. seq is the byte position the record was
+// written at and is stored last, so a reader that sees seq == its own
+// position knows the record is complete.
+typedef struct
+{
+    _Atomic unsigned long seq;
+    uint32_t size; // header + payload, multiple of 8
+    int32_t type;
+} ShmRecord;
+
+// Symbol name for one server index, guarded by a seqlock (odd while written)
+typedef struct
+{
+    _Atomic unsigned int version;
+    char symbol[MAX_SYMBOL_LEN];
+} ShmSymbol;
+
+typedef struct
+{
+    _Atomic unsigned long magic;
+    unsigned long ring_bytes;
+    unsigned long ring_offset;
+    unsigned int max_symbols;
+    // End of the bytes the publisher may be overwriting
+    _Alignas(CACHE_LINE) _Atomic unsigned long claimed;
+    // End of the last complete record
+    _Alignas(CACHE_LINE) _Atomic unsigned long published;
+    _Alignas(CACHE_LINE) ShmSymbol symbols[];
+} ShmFeedHeader;
+
+typedef struct
+{
+    ShmFeedHeader *hdr;
+    char *ring;
+    unsigned long mask;
+    size_t map_len;
+    char name[64];
+    unsigned long pos;
+    unsigned long records;
+    unsigned long drops;
+} ShmPublisher;
+
+// One record copied out of the ring
+typedef struct
+{
+    int type;
+    const Msg *msg;           // SHM_REC_MSG
+    const Msg2 *msg2;         // SHM_REC_DEPTH
+    const Msg2Level *levels;  // SHM_REC_DEPTH, asks then bids
+} ShmRecordView;
+
+typedef struct
+{
+    const ShmFeedHeader *hdr;
+    const char *ring;
+    unsigned long mask;
+    size_t map_len;
+    unsigned long pos;
+    unsigned long records;
+    unsigned long overruns;
+    _Alignas(16) char buf[UDP_SIZE];
+} ShmReader;
+
+static size_t shm_feed_ring_offset(unsigned int max_symbols)
+{
+    size_t len = sizeof(ShmFeedHeader) + (size_t)max_symbols * sizeof(ShmSymbol);
+    return (len + 4095) & ~(size_t)4095;
+}
+
+// Create (or replace) the segment. ring_bytes must be a power of two.
+// The segment names server indexes below max_symbols; register
+// shm_publisher_on_subscribe() to fill the names and refuse larger indexes.
+int shm_publisher_create(ShmPublisher *pub, const char *name, unsigned long ring_bytes,
+                         unsigned int max_symbols)
+{
+    if (ring_bytes < 2 * UDP_SIZE || (ring_bytes & (ring_bytes - 1)) != 0)
+    {
+        fprintf(stderr, "shm ring size %lu must be a power of two >= %d\n", ring_bytes, 2 * UDP_SIZE);
+        return -1;
+    }
+
+    memset(pub, 0, sizeof(*pub));
+    snprintf(pub->name, sizeof(pub->name), "%s", name);
+    size_t ring_offset = shm_feed_ring_offset(max_symbols);
+    pub->map_len = ring_offset + ring_bytes;
+
+    // A fresh segment each run; readers of a previous one must re-attach
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        perror("shm_open failed");
+        return -1;
+    }
+    if (ftruncate(fd, pub->map_len) < 0)
+    {
+        perror("ftruncate failed");
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    void *base = mmap(NULL, pub->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        perror("mmap failed");
+        shm_unlink(name);
+        return -1;
+    }
+
+    pub->hdr = (ShmFeedHeader *)base;
+    pub->ring = (char *)base + ring_offset;
+    pub->mask = ring_bytes - 1;
+    pub->hdr->ring_bytes = ring_bytes;
+    pub->hdr->ring_offset = ring_offset;
+    pub->hdr->max_symbols = max_symbols;
+    atomic_store_explicit(&pub->hdr->claimed, 0, memory_order_relaxed);
+    atomic_store_explicit(&pub->hdr->published, 0, memory_order_relaxed);
+    // Readers refuse the segment until the header is complete
+    atomic_store_explicit(&pub->hdr->magic, SHM_FEED_MAGIC, memory_order_release);
+    return 0;
+}
+
+void shm_publisher_destroy(ShmPublisher *pub)
+{
+    if (pub->hdr != NULL)
+    {
+        munmap(pub->hdr, pub->map_len);
+        shm_unlink(pub->name);
+    }
+    memset(pub, 0, sizeof(*pub));
+}
+
+// SubscriptionHook: publish sub's symbol name under its index before any
+// of its records. The name table is part of the segment and cannot grow,
+// so an index readers could not resolve refuses the subscription.
+// Register with add_subscription_hook(shm_publisher_on_subscribe, pub).
+int shm_publisher_on_subscribe(Subscription *sub, void *ctx)
+{
+    ShmPublisher *pub = (ShmPublisher *)ctx;
+    if (sub->index >= pub->hdr->max_symbols)
+    {
+        fprintf(stderr, "shm: %s has index %u, the segment names only %u symbols; raise max_symbols\n",
+                sub->symbol, sub->index, pub->hdr->max_symbols);
+        return -1;
+    }
+    ShmSymbol *entry = &pub->hdr->symbols[sub->index];
+    unsigned int version = atomic_load_explicit(&entry->version, memory_order_relaxed);
+    atomic_store_explicit(&entry->version, version + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    // Zero-padded: the name is shorter than the entry
+    strncpy(entry->symbol, sub->symbol, MAX_SYMBOL_LEN);
+    atomic_store_explicit(&entry->version, version + 2, memory_order_release);
+    return 0;
+}
+
+// Append one record made of two payload parts
+static int shm_publish(ShmPublisher *pub, int type, const void *head, size_t head_len,
+                       const void *tail, size_t tail_len)
+{
+    unsigned long capacity = pub->mask + 1;
+    unsigned long need = (sizeof(ShmRecord) + head_len + tail_len + 7) & ~7UL;
+    if (need > capacity / 2)
+    {
+        pub->drops++;
+        return -1;
+    }
+
+    unsigned long pos = pub->pos;
+    unsigned long offset = pos & pub->mask;
+    unsigned long skip = offset + need > capacity ? capacity - offset : 0;
+
+    // Announce the overwrite before touching any byte of the old lap
+    atomic_store_explicit(&pub->hdr->claimed, pos + skip + need, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    if (skip > 0)
+    {
+        // A tail too short for a record header gets no marker; readers
+        // recognise it by its length
+        if (skip >= sizeof(ShmRecord))
+        {
+            ShmRecord *wrap = (ShmRecord *)(pub->ring + offset);
+            wrap->size = (uint32_t)skip;
+            wrap->type = SHM_REC_WRAP;
+            atomic_store_explicit(&wrap->seq, pos, memory_order_release);
+        }
+        pos += skip;
+        offset = 0;
+    }
+
+    ShmRecord *rec = (ShmRecord *)(pub->ring + offset);
+    rec->size = (uint32_t)need;
+    rec->type = type;
+    memcpy((char *)(rec + 1), head, head_len);
+    if (tail_len > 0)
+    {
+        memcpy((char *)(rec + 1) + head_len, tail, tail_len);
+    }
+    atomic_store_explicit(&rec->seq, pos, memory_order_release);
+
+    pub->pos = pos + need;
+    atomic_store_explicit(&pub->hdr->published, pub->pos, memory_order_release);
+    pub->records++;
+    return 0;
+}
+
+static void shm_publish_msg(Subscription *sub, const Msg *msg, void *ctx)
+{
+    ShmPublisher *pub = (ShmPublisher *)ctx;
+    shm_publish(pub, SHM_REC_MSG, msg, sizeof(Msg), NULL, 0);
+}
+
+static void shm_publish_depth(Subscription *sub, const Msg2 *msg2, const Msg2Level *levels, void *ctx)
+{
+    ShmPublisher *pub = (ShmPublisher *)ctx;
+    shm_publish(pub, SHM_REC_DEPTH, msg2, sizeof(Msg2), levels,
+                (size_t)(msg2->asks_len + msg2->bids_len) * sizeof(Msg2Level));
+}
+
+// Handlers that forward every decoded message into the segment
+StreamHandlers shm_publisher_handlers(ShmPublisher *pub)
+{
+    StreamHandlers handlers = {
+        .on_ticker = shm_publish_msg,
+        .on_trade = shm_publish_msg,
+        .on_depth = shm_publish_depth,
+        .ctx = pub,
+    };
+    return handlers;
+}
+
+// Attach to a publisher's segment read-only, starting at the live position
+int shm_reader_attach(ShmReader *reader, const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        perror("shm_open failed");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ShmFeedHeader))
+    {
+        fprintf(stderr, "shm segment %s is not initialised\n", name);
+        close(fd);
+        return -1;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        perror("mmap failed");
+        return -1;
+    }
+
+    const ShmFeedHeader *hdr = (const ShmFeedHeader *)base;
+    if (atomic_load_explicit(&((ShmFeedHeader *)hdr)->magic, memory_order_acquire) != SHM_FEED_MAGIC ||
+        hdr->ring_offset + hdr->ring_bytes > (size_t)st.st_size)
+    {
+        fprintf(stderr, "shm segment %s has an unexpected layout\n", name);
+        munmap(base, st.st_size);
+        return -1;
+    }
+
+    reader->hdr = hdr;
+    reader->ring = (const char *)base + hdr->ring_offset;
+    reader->mask = hdr->ring_bytes - 1;
+    reader->map_len = st.st_size;
+    reader->pos = atomic_load_explicit(&((ShmFeedHeader *)hdr)->published, memory_order_acquire);
+    reader->records = 0;
+    reader->overruns = 0;
+    return 0;
+}
+
+void shm_reader_detach(ShmReader *reader)
+{
+    if (reader->hdr != NULL)
+    {
+        munmap((void *)reader->hdr, reader->map_len);
+        reader->hdr = NULL;
+    }
+}
+
+// Fetch the next record. Returns 1 with *view filled, 0 if caught up, or
+// -1 if the publisher lapped this reader (it resumes at the live position).
+// The view points into the reader's buffer and is valid until the next call.
+int shm_reader_next(ShmReader *reader, ShmRecordView *view)
+{
+    ShmFeedHeader *hdr = (ShmFeedHeader *)reader->hdr;
+    unsigned long capacity = reader->mask + 1;
+    for (;;)
+    {
+        unsigned long published = atomic_load_explicit(&hdr->published, memory_order_acquire);
+        unsigned long pos = reader->pos;
+        if (pos == published)
+        {
+            return 0;
+        }
+
+        unsigned long offset = pos & reader->mask;
+        if (capacity - offset < sizeof(ShmRecord))
+        {
+            // Unmarked tail, the next record starts the next lap
+            reader->pos = pos + capacity - offset;
+            continue;
+        }
+
+        const ShmRecord *rec = (const ShmRecord *)(reader->ring + offset);
+        unsigned long seq = atomic_load_explicit(&((ShmRecord *)rec)->seq, memory_order_acquire);
+        uint32_t size = rec->size;
+        int type = rec->type;
+        size_t payload = size - sizeof(ShmRecord);
+        int sane = seq == pos && size >= sizeof(ShmRecord) && size <= capacity &&
+                   (type == SHM_REC_WRAP || payload <= sizeof(reader->buf));
+        if (sane && type != SHM_REC_WRAP)
+        {
+            memcpy(reader->buf, rec + 1, payload);
+        }
+
+        // Anything the publisher claimed past pos + capacity may have torn our copy
+        atomic_thread_fence(memory_order_acquire);
+        unsigned long claimed = atomic_load_explicit(&hdr->claimed, memory_order_relaxed);
+        if (!sane || claimed - pos > capacity)
+        {
+            reader->overruns++;
+            reader->pos = atomic_load_explicit(&hdr->published, memory_order_acquire);
+            return -1;
+        }
+
+        reader->pos = pos + size;
+        if (type == SHM_REC_WRAP)
+        {
+            continue;
+        }
+
+        reader->records++;
+        view->type = type;
+        view->msg = NULL;
+        view->msg2 = NULL;
+        view->levels = NULL;
+        if (type == SHM_REC_MSG)
+        {
+            view->msg = (const Msg *)reader->buf;
+        }
+        else
+        {
+            view->msg2 = (const Msg2 *)reader->buf;
+            view->levels = (const Msg2Level *)(reader->buf + sizeof(Msg2));
+        }
+        return 1;
+    }
+}
+
+// Copy the symbol name of a server index; returns 0 on success, -1 if unknown
+int shm_reader_symbol(const ShmReader *reader, unsigned int index, char *out)
+{
+    if (index >= reader->hdr->max_symbols)
+    {
+        return -1;
+    }
+    ShmSymbol *entry = (ShmSymbol *)&reader->hdr->symbols[index];
+    for (;;)
+    {
+        unsigned int before = atomic_load_explicit(&entry->version, memory_order_acquire);
+        if (before == 0)
+        {
+            return -1;
+        }
+        if (before & 1)
+        {
+            cpu_relax();
+            continue;
+        }
+        memcpy(out, entry->symbol, MAX_SYMBOL_LEN);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&entry->version, memory_order_relaxed) == before)
+        {
+            out[MAX_SYMBOL_LEN - 1] = '\0';
+            return 0;
+        }
+    }
+}
+
+#endif // QTX_SHM_FEED_C
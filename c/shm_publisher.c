@@ -0,0 +1,72 @@
+#include "sdk.c"
+#include "shm_feed.c"
+
+// Receives the feed once and fans it out to local processes through
+// POSIX shared memory. Run shm_reader (or any program using
+// shm_reader_attach) in as many processes as needed.
+//
+// Compile: gcc -O2 -pthread -o shm_publisher shm_publisher.c -lrt
+
+#define SHM_RING_BYTES (64UL << 20)
+// Symbol names are shared for server indexes below this value; symbols
+// the server assigns a larger index are refused at subscribe time
+#define SHM_MAX_SYMBOLS 4096
+#define RECV_BATCH_VLEN 64
+
+int main()
+{
+    // The publisher is the only process that talks to the subscription
+    // manager, so LOCAL_BINDING_PORT is bound exactly once per box
+    if (init_subscription_manager() < 0)
+    {
+        return 1;
+    }
+
+    const char *default_symbols[] = {
+        "binance-futures:btcusdt",
+        "binance:btcusdt",
+        "okx-swap:BTC-USDT-SWAP",
+        "okx-spot:BTC-USDT",
+        "bybit:BTCUSDT", // This is the futures of Bybit
+        "gate-io-futures:BTC_USDT",
+        "kucoin-futures:XBTUSDTM",
+        "kucoin:BTC-USDT",
+        "bitget-futures:BTCUSDT", // implementation in progress
+        "bitget:BTCUSDT", // implementation in progress
+    };
+    for (int i = 0; i < sizeof(default_symbols) / sizeof(default_symbols[0]); i++)
+    {
+        if (subscribe(default_symbols[i]) < 0)
+        {
+            fprintf(stderr, "Failed to subscribe to %s\n", default_symbols[i]);
+        }
+    }
+
+    static ShmPublisher publisher;
+    if (init_batch_receiver(RECV_BATCH_VLEN, 0) < 0 ||
+        shm_publisher_create(&publisher, SHM_FEED_NAME, SHM_RING_BYTES, SHM_MAX_SYMBOLS) < 0 ||
+        add_subscription_hook(shm_publisher_on_subscribe, &publisher) < 0)
+    {
+        close(manager.socket);
+        return 1;
+    }
+    printf("Publishing to shared memory %s (%lu bytes)\n", SHM_FEED_NAME, SHM_RING_BYTES);
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    StreamHandlers handlers = shm_publisher_handlers(&publisher);
+    while (running)
+    {
+        receive_batch(&handlers);
+    }
+
+    printf("Published %lu records, dropped %lu\n", publisher.records, publisher.drops);
+    print_seq_stats();
+    shm_publisher_destroy(&publisher);
+    free_batch_receiver();
+    free_subscriptions();
+    close(manager.socket);
+    printf("Gracefully shut down\n");
+    return 0;
+}
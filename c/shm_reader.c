@@ -0,0 +1,60 @@
+#include "shm_feed.c"
+
+// Follows the feed written by shm_publisher. Any number of readers can run
+// at once; none of them opens a socket or makes a syscall per message.
+//
+// Compile: gcc -O2 -pthread -o shm_reader shm_reader.c -lrt
+
+static ShmReader reader;
+
+int main()
+{
+    if (shm_reader_attach(&reader, SHM_FEED_NAME) < 0)
+    {
+        fprintf(stderr, "Is shm_publisher running?\n");
+        return 1;
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    char symbol[MAX_SYMBOL_LEN];
+    ShmRecordView view;
+    while (running)
+    {
+        int rc = shm_reader_next(&reader, &view);
+        if (rc == 0)
+        {
+            cpu_relax();
+            continue;
+        }
+        if (rc < 0)
+        {
+            fprintf(stderr, "reader overrun, skipped to live position\n");
+            continue;
+        }
+
+        if (view.type == SHM_REC_DEPTH)
+        {
+            if (shm_reader_symbol(&reader, view.msg2->index, symbol) < 0)
+            {
+                continue;
+            }
+            printf("%s: depth, %d, %d\n", symbol, view.msg2->asks_len, view.msg2->bids_len);
+        }
+        else if (shm_reader_symbol(&reader, view.msg->index, symbol) == 0)
+        {
+            printf("%s: %s, %s, %.8g, %.8g\n",
+                   symbol,
+                   abs(view.msg->msg_type) == 1 ? "ticker" : "trade",
+                   abs(view.msg->msg_type) == 1 ? (view.msg->msg_type > 0 ? "bid" : "ask")
+                                                : (view.msg->msg_type > 0 ? "buy" : "sell"),
+                   view.msg->price,
+                   view.msg->size);
+        }
+    }
+
+    printf("Read %lu records, %lu overruns\n", reader.records, reader.overruns);
+    shm_reader_detach(&reader);
+    return 0;
+}
@@ -0,0 +1,642 @@
+#include "sdk.c"
+#include <poll.h>
+#include <stdarg.h>
+
+// Local stand-in for the UDP order server, for load testing the order
+// clients without an exchange. Speaks the documented protocol:
+//   idx,0,key,secret[,pass][,account_index]   -> idx:k:account_index
+//   idx,1,account,symbol,cid,pos_side,side,order_type,size,price
+//                                              -> idx:r:{order json}
+//   idx,-1,account,symbol,cid                  -> idx:r:{cancel json}
+// with Binance or Gate.io JSON payloads. A placed order fills with
+// probability fill_pct; the fill follows as an auth update
+// ("a:account:{...}") sent to the address the account logged in from,
+// as Gate.io does. Error replies ("idx:e:TYPE-description") cover
+// INVALID_FORMAT, NOT_CONNECTED, AUTH_FAILED (api keys starting with
+// "BAD"; a failed replacement keeps the old account), ORDER_NOT_FOUND,
+// DUPLICATE_ORDER and TOO_MANY_ORDERS. Connecting with an account_index
+// below the account count replaces that account, as on the real server.
+//
+// Every reply is held for latency_us plus a uniform 0..jitter_us, and
+// each request or reply is dropped with probability loss_pct.
+//
+// Compile: gcc -O2 -pthread -o sim_exchange sim_exchange.c
+// Usage:   ./sim_exchange [port] [binance|gateio] [latency_us] [jitter_us] [loss_pct] [fill_pct]
+
+#define SIM_MAX_ACCOUNTS 64
+// Open orders tracked, a power of two; at most half may be used
+#define SIM_ORDER_SLOTS 65536
+#define SIM_FIELD_MAX 64
+// Replies waiting for their send time
+#define SIM_QUEUE_SIZE 16384
+#define SIM_REPLY_MAX 640
+#define SIM_BUFFER_SIZE 2048
+#define SIM_VLEN 64
+
+typedef struct
+{
+    char api_key[SIM_FIELD_MAX];
+    // Where the login came from; auth updates go there
+    struct sockaddr_in auth_addr;
+} SimAccount;
+
+typedef struct
+{
+    int used;
+    int account;
+    unsigned long long hash;
+    char cid[SIM_FIELD_MAX];
+    char symbol[SIM_FIELD_MAX];
+    int side;
+    char size[32];
+    char price[32];
+    long long id;
+} SimOrder;
+
+typedef struct
+{
+    long long due_ns;
+    struct sockaddr_in to;
+    int len;
+    char data[SIM_REPLY_MAX];
+} SimReply;
+
+typedef struct
+{
+    int socket;
+    int gateio;
+    long long latency_ns;
+    long long jitter_ns;
+    double loss;
+    double fill;
+    unsigned long long rng;
+
+    SimAccount accounts[SIM_MAX_ACCOUNTS];
+    int account_count;
+    SimOrder *orders;
+    int open_orders;
+    long long next_order_id;
+
+    // Min-heap on due_ns of positions in replies; free positions stacked
+    SimReply *replies;
+    int *heap;
+    int heap_len;
+    int *free_list;
+    int free_len;
+
+    unsigned long requests;
+    unsigned long connects;
+    unsigned long places;
+    unsigned long cancels;
+    unsigned long fills;
+    unsigned long errors;
+    unsigned long dropped;
+    unsigned long overflow;
+    unsigned long sent;
+} SimExchange;
+
+// xorshift64*, uniform in [0, 1)
+static inline double sim_random(SimExchange *x)
+{
+    x->rng ^= x->rng >> 12;
+    x->rng ^= x->rng << 25;
+    x->rng ^= x->rng >> 27;
+    return (double)((x->rng * 2685821657736338717ULL) >> 11) / (double)(1ULL << 53);
+}
+
+// ---- Delayed replies ----
+
+static void sim_heap_up(SimExchange *x, int i)
+{
+    while (i > 0)
+    {
+        int parent = (i - 1) / 2;
+        if (x->replies[x->heap[parent]].due_ns <= x->replies[x->heap[i]].due_ns)
+        {
+            break;
+        }
+        int t = x->heap[parent];
+        x->heap[parent] = x->heap[i];
+        x->heap[i] = t;
+        i = parent;
+    }
+}
+
+static void sim_heap_down(SimExchange *x, int i)
+{
+    for (;;)
+    {
+        int least = i;
+        int l = 2 * i + 1;
+        int r = l + 1;
+        if (l < x->heap_len && x->replies[x->heap[l]].due_ns < x->replies[x->heap[least]].due_ns)
+        {
+            least = l;
+        }
+        if (r < x->heap_len && x->replies[x->heap[r]].due_ns < x->replies[x->heap[least]].due_ns)
+        {
+            least = r;
+        }
+        if (least == i)
+        {
+            return;
+        }
+        int t = x->heap[least];
+        x->heap[least] = x->heap[i];
+        x->heap[i] = t;
+        i = least;
+    }
+}
+
+// Queue a printf-formatted reply to to, subject to latency, jitter and loss
+__attribute__((format(printf, 3, 4))) static void sim_reply(SimExchange *x, const struct sockaddr_in *to,
+                                                            const char *fmt, ...)
+{
+    if (x->loss > 0 && sim_random(x) < x->loss)
+    {
+        x->dropped++;
+        return;
+    }
+    if (x->free_len == 0)
+    {
+        x->overflow++;
+        return;
+    }
+    int pos = x->free_list[--x->free_len];
+    SimReply *r = &x->replies[pos];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(r->data, sizeof(r->data), fmt, args);
+    va_end(args);
+    r->len = len < (int)sizeof(r->data) ? len : (int)sizeof(r->data) - 1;
+    r->to = *to;
+    r->due_ns = get_current_timestamp_ns() + x->latency_ns +
+                (x->jitter_ns > 0 ? (long long)(sim_random(x) * x->jitter_ns) : 0);
+    x->heap[x->heap_len] = pos;
+    sim_heap_up(x, x->heap_len++);
+}
+
+// Send every reply that is due. Returns the ns until the next one, -1 if
+// none is queued.
+static long long sim_flush(SimExchange *x)
+{
+    struct mmsghdr msgs[SIM_VLEN];
+    struct iovec iov[SIM_VLEN];
+    int done[SIM_VLEN];
+    for (;;)
+    {
+        long long now = get_current_timestamp_ns();
+        int n = 0;
+        while (x->heap_len > 0 && n < SIM_VLEN && x->replies[x->heap[0]].due_ns <= now)
+        {
+            int pos = x->heap[0];
+            x->heap[0] = x->heap[--x->heap_len];
+            sim_heap_down(x, 0);
+            SimReply *r = &x->replies[pos];
+            iov[n].iov_base = r->data;
+            iov[n].iov_len = r->len;
+            memset(&msgs[n], 0, sizeof(msgs[n]));
+            msgs[n].msg_hdr.msg_iov = &iov[n];
+            msgs[n].msg_hdr.msg_iovlen = 1;
+            msgs[n].msg_hdr.msg_name = &r->to;
+            msgs[n].msg_hdr.msg_namelen = sizeof(r->to);
+            done[n++] = pos;
+        }
+        if (n > 0)
+        {
+            int sent = sendmmsg(x->socket, msgs, n, 0);
+            x->sent += sent > 0 ? sent : 0;
+            for (int i = 0; i < n; i++)
+            {
+                x->free_list[x->free_len++] = done[i];
+            }
+        }
+        if (n < SIM_VLEN)
+        {
+            break;
+        }
+    }
+    if (x->heap_len == 0)
+    {
+        return -1;
+    }
+    long long wait = x->replies[x->heap[0]].due_ns - get_current_timestamp_ns();
+    return wait > 0 ? wait : 0;
+}
+
+// ---- Orders ----
+
+static unsigned long long sim_hash(int account, const char *cid)
+{
+    unsigned long long h = 1469598103934665603ULL ^ (unsigned int)account;
+    for (const unsigned char *p = (const unsigned char *)cid; *p != '\0'; p++)
+    {
+        h = (h ^ *p) * 1099511628211ULL;
+    }
+    return h;
+}
+
+static SimOrder *sim_find(SimExchange *x, int account, const char *cid, unsigned long long hash)
+{
+    for (unsigned int i = (unsigned int)hash & (SIM_ORDER_SLOTS - 1);; i = (i + 1) & (SIM_ORDER_SLOTS - 1))
+    {
+        SimOrder *o = &x->orders[i];
+        if (!o->used)
+        {
+            return o;
+        }
+        if (o->hash == hash && o->account == account && strcmp(o->cid, cid) == 0)
+        {
+            return o;
+        }
+    }
+}
+
+// Backward-shift delete keeps probe chains intact
+static void sim_remove(SimExchange *x, SimOrder *o)
+{
+    unsigned int i = (unsigned int)(o - x->orders);
+    x->orders[i].used = 0;
+    x->open_orders--;
+    for (unsigned int j = (i + 1) & (SIM_ORDER_SLOTS - 1); x->orders[j].used; j = (j + 1) & (SIM_ORDER_SLOTS - 1))
+    {
+        unsigned int home = (unsigned int)x->orders[j].hash & (SIM_ORDER_SLOTS - 1);
+        if (((j - home) & (SIM_ORDER_SLOTS - 1)) >= ((j - i) & (SIM_ORDER_SLOTS - 1)))
+        {
+            x->orders[i] = x->orders[j];
+            x->orders[j].used = 0;
+            i = j;
+        }
+    }
+}
+
+// Order JSON for a reply (r:) or a fill update (a:) in the exchange's format
+static void sim_send_order(SimExchange *x, const struct sockaddr_in *to, const char *prefix, const SimOrder *o,
+                           const char *status, int filled)
+{
+    if (x->gateio)
+    {
+        const char *sign = o->side == 2 ? "-" : "";
+        int finished = strcmp(status, "open") != 0;
+        if (prefix[0] == 'a')
+        {
+            sim_reply(x, to,
+                      "%s{\"channel\":\"futures.orders\",\"event\":\"update\",\"result\":[{\"id\":%lld,"
+                      "\"text\":\"%s\",\"contract\":\"%s\",\"size\":%s%s,\"left\":%s%s,\"fill_price\":\"%s\","
+                      "\"status\":\"%s\",\"finish_as\":\"%s\"}]}",
+                      prefix, o->id, o->cid, o->symbol, sign, o->size, filled ? "" : sign, filled ? "0" : o->size,
+                      o->price, finished ? "finished" : "open", finished ? status : "_new");
+        }
+        else
+        {
+            sim_reply(x, to,
+                      "%s{\"header\":{\"status\":\"200\"},\"data\":{\"result\":{\"id\":%lld,\"text\":\"%s\","
+                      "\"contract\":\"%s\",\"size\":%s%s,\"left\":%s%s,\"fill_price\":\"0\",\"status\":\"%s\","
+                      "\"finish_as\":\"%s\"}}}",
+                      prefix, o->id, o->cid, o->symbol, sign, o->size, sign, o->size,
+                      finished ? "finished" : "open", finished ? status : "_new");
+        }
+        return;
+    }
+    const char *side = o->side == 2 ? "SELL" : "BUY";
+    if (prefix[0] == 'a')
+    {
+        sim_reply(x, to,
+                  "%s{\"e\":\"ORDER_TRADE_UPDATE\",\"E\":%lld,\"o\":{\"s\":\"%s\",\"c\":\"%s\",\"S\":\"%s\","
+                  "\"q\":\"%s\",\"p\":\"%s\",\"ap\":\"%s\",\"x\":\"TRADE\",\"X\":\"%s\",\"i\":%lld,\"z\":\"%s\"}}",
+                  prefix, get_current_timestamp_ns() / 1000000, o->symbol, o->cid, side, o->size, o->price,
+                  o->price, status, o->id, filled ? o->size : "0");
+    }
+    else
+    {
+        sim_reply(x, to,
+                  "%s{\"id\":\"%lld\",\"status\":200,\"result\":{\"symbol\":\"%s\",\"orderId\":%lld,"
+                  "\"clientOrderId\":\"%s\",\"price\":\"%s\",\"origQty\":\"%s\",\"executedQty\":\"0\","
+                  "\"status\":\"%s\",\"side\":\"%s\"}}",
+                  prefix, o->id, o->symbol, o->id, o->cid, o->price, o->size, status, side);
+    }
+}
+
+// ---- Requests ----
+
+static void sim_error(SimExchange *x, const struct sockaddr_in *from, const char *idx, const char *error)
+{
+    x->errors++;
+    sim_reply(x, from, "%s:e:%s", idx, error);
+}
+
+// Split buf at commas in place; returns the field count (at most max)
+static int sim_split(char *buf, char **fields, int max)
+{
+    int n = 0;
+    fields[n++] = buf;
+    for (char *p = buf; *p != '\0' && n < max; p++)
+    {
+        if (*p == ',')
+        {
+            *p = '\0';
+            fields[n++] = p + 1;
+        }
+    }
+    return n;
+}
+
+static void sim_connect(SimExchange *x, const struct sockaddr_in *from, const char *idx, char **f, int n)
+{
+    x->connects++;
+    if (n < 4 || f[2][0] == '\0' || f[3][0] == '\0')
+    {
+        sim_error(x, from, idx, "INVALID_FORMAT-missing api key or secret");
+        return;
+    }
+    if (strncmp(f[2], "BAD", 3) == 0)
+    {
+        // A failed replacement leaves the existing account in place
+        sim_error(x, from, idx, "AUTH_FAILED-invalid api key");
+        return;
+    }
+    int requested = n >= 6 && f[5][0] != '\0' ? atoi(f[5]) : -1;
+    int index = requested >= 0 && requested < x->account_count ? requested : x->account_count;
+    if (index >= SIM_MAX_ACCOUNTS)
+    {
+        sim_error(x, from, idx, "TOO_MANY_ACCOUNTS-no free account slot");
+        return;
+    }
+    if (index == x->account_count)
+    {
+        x->account_count++;
+    }
+    SimAccount *a = &x->accounts[index];
+    snprintf(a->api_key, sizeof(a->api_key), "%s", f[2]);
+    a->auth_addr = *from;
+    sim_reply(x, from, "%s:k:%d", idx, index);
+}
+
+// Positive integer without sign, point or exponent
+static int sim_is_count(const char *s)
+{
+    if (*s == '\0' || *s == '0')
+    {
+        return 0;
+    }
+    for (; *s != '\0'; s++)
+    {
+        if ((unsigned int)(*s - '0') >= 10)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void sim_place(SimExchange *x, const struct sockaddr_in *from, const char *idx, char **f, int n)
+{
+    x->places++;
+    if (n < 10)
+    {
+        sim_error(x, from, idx, "INVALID_FORMAT-missing required fields");
+        return;
+    }
+    int account = atoi(f[2]);
+    const char *symbol = f[3];
+    const char *cid = f[4];
+    int side = atoi(f[6]);
+    if (account < 0 || account >= x->account_count)
+    {
+        sim_error(x, from, idx, "NOT_CONNECTED-please connect first");
+        return;
+    }
+    if ((side != 1 && side != 2) || symbol[0] == '\0' || cid[0] == '\0' || strlen(symbol) >= SIM_FIELD_MAX ||
+        strlen(cid) >= SIM_FIELD_MAX || strlen(f[8]) >= 32 || strlen(f[9]) >= 32)
+    {
+        sim_error(x, from, idx, "INVALID_FORMAT-bad side, symbol or client order id");
+        return;
+    }
+    if (x->gateio && (strncmp(cid, "t-", 2) != 0 || strlen(cid) >= 30 || !sim_is_count(f[8])))
+    {
+        sim_error(x, from, idx, "INVALID_FORMAT-text must start with t- and size be a positive integer");
+        return;
+    }
+    unsigned long long hash = sim_hash(account, cid);
+    SimOrder *o = sim_find(x, account, cid, hash);
+    if (o->used)
+    {
+        sim_error(x, from, idx, "DUPLICATE_ORDER-client order id in use");
+        return;
+    }
+    if (x->open_orders >= SIM_ORDER_SLOTS / 2)
+    {
+        sim_error(x, from, idx, "TOO_MANY_ORDERS-open order limit reached");
+        return;
+    }
+    o->used = 1;
+    o->account = account;
+    o->hash = hash;
+    strcpy(o->cid, cid);
+    strcpy(o->symbol, symbol);
+    o->side = side;
+    strcpy(o->size, f[8]);
+    strcpy(o->price, f[9]);
+    o->id = ++x->next_order_id;
+    x->open_orders++;
+
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "%s:r:", idx);
+    sim_send_order(x, from, prefix, o, x->gateio ? "open" : "NEW", 0);
+    if (x->fill > 0 && sim_random(x) < x->fill)
+    {
+        snprintf(prefix, sizeof(prefix), "a:%d:", account);
+        sim_send_order(x, &x->accounts[account].auth_addr, prefix, o, x->gateio ? "filled" : "FILLED", 1);
+        x->fills++;
+        sim_remove(x, o);
+    }
+}
+
+static void sim_cancel(SimExchange *x, const struct sockaddr_in *from, const char *idx, char **f, int n)
+{
+    x->cancels++;
+    if (n < 5)
+    {
+        sim_error(x, from, idx, "INVALID_FORMAT-missing required fields");
+        return;
+    }
+    int account = atoi(f[2]);
+    if (account < 0 || account >= x->account_count)
+    {
+        sim_error(x, from, idx, "NOT_CONNECTED-please connect first");
+        return;
+    }
+    SimOrder *o = sim_find(x, account, f[4], sim_hash(account, f[4]));
+    if (!o->used)
+    {
+        sim_error(x, from, idx, "ORDER_NOT_FOUND-unknown order");
+        return;
+    }
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "%s:r:", idx);
+    sim_send_order(x, from, prefix, o, x->gateio ? "cancelled" : "CANCELED", 0);
+    sim_remove(x, o);
+}
+
+static void sim_request(SimExchange *x, char *buf, const struct sockaddr_in *from)
+{
+    x->requests++;
+    if (x->loss > 0 && sim_random(x) < x->loss)
+    {
+        x->dropped++;
+        return;
+    }
+    char *f[12];
+    int n = sim_split(buf, f, 12);
+    const char *idx = f[0];
+    if (n < 2 || (!sim_is_count(idx) && strcmp(idx, "0") != 0))
+    {
+        x->errors++;
+        return;
+    }
+    if (strcmp(f[1], "0") == 0)
+    {
+        sim_connect(x, from, idx, f, n);
+    }
+    else if (strcmp(f[1], "1") == 0)
+    {
+        sim_place(x, from, idx, f, n);
+    }
+    else if (strcmp(f[1], "-1") == 0)
+    {
+        sim_cancel(x, from, idx, f, n);
+    }
+    else
+    {
+        sim_error(x, from, idx, "INVALID_FORMAT-unknown mode");
+    }
+}
+
+static int sim_open(SimExchange *x, int port)
+{
+    x->orders = calloc(SIM_ORDER_SLOTS, sizeof(SimOrder));
+    x->replies = malloc(SIM_QUEUE_SIZE * sizeof(SimReply));
+    x->heap = malloc(SIM_QUEUE_SIZE * sizeof(int));
+    x->free_list = malloc(SIM_QUEUE_SIZE * sizeof(int));
+    if (x->orders == NULL || x->replies == NULL || x->heap == NULL || x->free_list == NULL)
+    {
+        perror("simulator allocation failed");
+        return -1;
+    }
+    for (int i = 0; i < SIM_QUEUE_SIZE; i++)
+    {
+        x->free_list[i] = SIM_QUEUE_SIZE - 1 - i;
+    }
+    x->free_len = SIM_QUEUE_SIZE;
+
+    x->socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (x->socket < 0)
+    {
+        perror("Socket creation failed");
+        return -1;
+    }
+    int buf_size = 8 * 1024 * 1024;
+    setsockopt(x->socket, SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size));
+    setsockopt(x->socket, SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if (bind(x->socket, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("Bind failed");
+        return -1;
+    }
+    return 0;
+}
+
+static void print_sim_stats(const SimExchange *x)
+{
+    printf("requests %lu (connects %lu, places %lu, cancels %lu), fills %lu, errors %lu, replies sent %lu, "
+           "dropped %lu, queue overflow %lu, accounts %d, open orders %d\n",
+           x->requests, x->connects, x->places, x->cancels, x->fills, x->errors, x->sent, x->dropped,
+           x->overflow, x->account_count, x->open_orders);
+}
+
+int main(int argc, char *argv[])
+{
+    static SimExchange x;
+    int port = argc > 1 ? atoi(argv[1]) : 6671;
+    x.gateio = argc > 2 ? strcmp(argv[2], "gateio") == 0 : 0;
+    x.latency_ns = argc > 3 ? atol(argv[3]) * 1000LL : 0;
+    x.jitter_ns = argc > 4 ? atol(argv[4]) * 1000LL : 0;
+    x.loss = argc > 5 ? atof(argv[5]) / 100.0 : 0;
+    x.fill = argc > 6 ? atof(argv[6]) / 100.0 : 1.0;
+    x.rng = (unsigned long long)get_current_timestamp_ns() | 1;
+    if (sim_open(&x, port) < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    printf("%s simulator on UDP port %d: latency %lld us, jitter %lld us, loss %.2f%%, fill %.0f%%\n",
+           x.gateio ? "gateio" : "binance", port, x.latency_ns / 1000, x.jitter_ns / 1000, x.loss * 100,
+           x.fill * 100);
+
+    static char bufs[SIM_VLEN][SIM_BUFFER_SIZE];
+    struct iovec iov[SIM_VLEN];
+    struct sockaddr_in from[SIM_VLEN];
+    struct mmsghdr msgs[SIM_VLEN];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < SIM_VLEN; i++)
+    {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = sizeof(bufs[i]) - 1;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &from[i];
+    }
+
+    long long next_report = get_current_timestamp_ns() + 10000000000LL;
+    long long wait_ns = -1;
+    while (running)
+    {
+        struct pollfd pfd = {.fd = x.socket, .events = POLLIN};
+        // ppoll for sub-millisecond reply delays; wake at least every 100 ms
+        // for the signal flag and the report
+        if (wait_ns < 0 || wait_ns > 100000000LL)
+        {
+            wait_ns = 100000000LL;
+        }
+        struct timespec timeout = {wait_ns / 1000000000LL, wait_ns % 1000000000LL};
+        ppoll(&pfd, 1, &timeout, NULL);
+        for (;;)
+        {
+            for (int i = 0; i < SIM_VLEN; i++)
+            {
+                msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+            }
+            int n = recvmmsg(x.socket, msgs, SIM_VLEN, MSG_DONTWAIT, NULL);
+            if (n <= 0)
+            {
+                break;
+            }
+            for (int i = 0; i < n; i++)
+            {
+                bufs[i][msgs[i].msg_len] = '\0';
+                sim_request(&x, bufs[i], &from[i]);
+            }
+            // Send what is due between batches so zero latency stays zero
+            sim_flush(&x);
+            if (n < SIM_VLEN)
+            {
+                break;
+            }
+        }
+        wait_ns = sim_flush(&x);
+        if (get_current_timestamp_ns() >= next_report)
+        {
+            print_sim_stats(&x);
+            next_report += 10000000000LL;
+        }
+    }
+    print_sim_stats(&x);
+    close(x.socket);
+    return 0;
+}
@@ -0,0 +1,662 @@
+#include "sdk.c"
+#include <poll.h>
+
+// Local stand-in for the market data server, for exercising stream.c and
+// benchmarking the decode loop without the live manager. Speaks the
+// subscription protocol on the manager port:
+//   symbol       -> index:symbol (ack sent from the manager port)
+//   -symbol      -> no reply, the stream stops
+// and streams synthetic data for every subscription from a second socket
+// to the address the subscription came from: datagrams of batch packed
+// Msg (L1 bid/ask and trades, per-channel sn_id sequences) at rate
+// messages per second per client, spread round-robin over its symbols,
+// plus a Msg2 + Msg2Level depth snapshot of levels per side depth_hz
+// times per second per symbol. Each datagram is dropped with probability
+// loss_pct (its sn_ids are spent, so the client sees a gap) or held back
+// behind the client's next datagram with probability reorder_pct.
+//
+// "#rate N" on the manager port changes the sender's rate to N msgs/s
+// (bench_feed.c steps the load with it) and is acked with "#rate N",
+// which the SDK ignores. Pausing ("#rate 0") and resuming send one
+// message per sequence channel of every stream that is never dropped or
+// held back: on a pause every gap loss_pct made has then been followed by
+// a message the client sees, on a resume no sequence starts with a gap
+// the client cannot see. "#stats" is
+// answered with "#stats N": the messages dropped on purpose for the
+// client so far, which a receiver takes off the gaps it counts.
+//
+// Compile: gcc -O2 -pthread -o sim_feed sim_feed.c
+// Usage:   ./sim_feed [rate] [batch] [depth_hz] [levels] [loss_pct] [reorder_pct] [port]
+//          Point clients at it with -DSUBSCRIPTION_MANAGER='"127.0.0.1"'; the
+//          SDK recognises acks by source port, so keep port at 9080
+
+#define FEED_MAX_CLIENTS 64
+#define FEED_MAX_SYMBOLS 65536
+#define FEED_MAX_BATCH 64
+#define FEED_MAX_LEVELS 256
+#define FEED_PACKET_MAX (sizeof(Msg2) + 2 * FEED_MAX_LEVELS * sizeof(Msg2Level))
+#define FEED_VLEN 64
+// A client further behind than this skips ahead instead of bursting
+#define FEED_MAX_LAG_NS 100000000LL
+// Prices and sizes are quoted on a decimal grid like a venue's tick and
+// lot size: 0.01 and 0.001
+#define FEED_PRICE_GRID 100
+#define FEED_SIZE_GRID 1000
+
+// One subscription of one client, with its own sequences and price
+typedef struct
+{
+    int index;
+    long sn[SEQ_CHANNELS];
+    double mid;
+} FeedStream;
+
+typedef struct
+{
+    struct sockaddr_in addr;
+    FeedStream *streams;
+    int stream_count;
+    int stream_capacity;
+    // Round-robin cursors for ticks and depth snapshots
+    int next_stream;
+    int next_depth;
+
+    // Pacing: generated messages since start_ns at rate
+    double rate;
+    long long start_ns;
+    unsigned long generated;
+    long long next_depth_ns;
+
+    // A datagram held back to go out after the next one
+    int held_len;
+    char held[FEED_PACKET_MAX];
+
+    unsigned long msgs;
+    unsigned long depths;
+    unsigned long packets;
+    unsigned long dropped;
+    // Messages in the dropped datagrams
+    unsigned long dropped_msgs;
+    unsigned long reordered;
+    unsigned long skipped;
+} FeedClient;
+
+typedef struct
+{
+    int manager_socket;
+    int data_socket;
+    int batch;
+    double rate;
+    double depth_hz;
+    int levels;
+    double loss;
+    double reorder;
+    unsigned long long rng;
+
+    char (*symbols)[MAX_SYMBOL_LEN];
+    int symbol_count;
+    FeedClient clients[FEED_MAX_CLIENTS];
+    int client_count;
+
+    // Datagrams waiting for the next sendmmsg
+    char out[FEED_VLEN][FEED_PACKET_MAX];
+    struct sockaddr_in out_addr[FEED_VLEN];
+    int out_len[FEED_VLEN];
+    int out_count;
+
+    unsigned long requests;
+    unsigned long subscribes;
+    unsigned long unsubscribes;
+    unsigned long rejected;
+    unsigned long send_errors;
+} SimFeed;
+
+// xorshift64*, uniform in [0, 1)
+static inline double feed_random(SimFeed *f)
+{
+    f->rng ^= f->rng >> 12;
+    f->rng ^= f->rng << 25;
+    f->rng ^= f->rng >> 27;
+    return (double)((f->rng * 2685821657736338717ULL) >> 11) / (double)(1ULL << 53);
+}
+
+// ticks on the grid of 1 / per_unit, the double a venue's decimal string
+// parses to
+static inline double feed_grid(long ticks, double per_unit)
+{
+    return (double)ticks / per_unit;
+}
+
+// ---- Sending ----
+
+static void feed_flush(SimFeed *f)
+{
+    struct iovec iov[FEED_VLEN];
+    struct mmsghdr msgs[FEED_VLEN];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < f->out_count; i++)
+    {
+        iov[i].iov_base = f->out[i];
+        iov[i].iov_len = f->out_len[i];
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &f->out_addr[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(f->out_addr[i]);
+    }
+    int done = 0;
+    while (done < f->out_count)
+    {
+        int n = sendmmsg(f->data_socket, msgs + done, f->out_count - done, 0);
+        if (n <= 0)
+        {
+            // Receiver gone or buffer full: the rest of the batch is lost
+            f->send_errors += f->out_count - done;
+            break;
+        }
+        done += n;
+    }
+    f->out_count = 0;
+}
+
+// Buffer for the next outgoing datagram
+static inline char *feed_slot(SimFeed *f)
+{
+    if (f->out_count == FEED_VLEN)
+    {
+        feed_flush(f);
+    }
+    return f->out[f->out_count];
+}
+
+static inline void feed_push(SimFeed *f, const FeedClient *c, int len)
+{
+    f->out_addr[f->out_count] = c->addr;
+    f->out_len[f->out_count] = len;
+    f->out_count++;
+}
+
+// Queue the datagram built in feed_slot(), holding msgs sequenced
+// messages, applying loss and reordering
+static void feed_commit(SimFeed *f, FeedClient *c, int len, int msgs)
+{
+    c->packets++;
+    if (f->loss > 0 && feed_random(f) < f->loss)
+    {
+        c->dropped++;
+        c->dropped_msgs += msgs;
+        return;
+    }
+    if (c->held_len == 0 && f->reorder > 0 && feed_random(f) < f->reorder)
+    {
+        memcpy(c->held, f->out[f->out_count], len);
+        c->held_len = len;
+        c->reordered++;
+        return;
+    }
+    feed_push(f, c, len);
+    if (c->held_len > 0)
+    {
+        memcpy(feed_slot(f), c->held, c->held_len);
+        feed_push(f, c, c->held_len);
+        c->held_len = 0;
+    }
+}
+
+// ---- Synthetic data ----
+
+// Message of the kind r picks: < 0.4 bid, < 0.8 ask, < 0.9 buy trade,
+// else sell trade
+static void feed_fill_msg(SimFeed *f, FeedStream *st, Msg *m, long long now_ns, double r)
+{
+    st->mid *= 1.0 + (feed_random(f) - 0.5) * 1e-4;
+    // Bid and ask straddle the mid at least one tick apart
+    long bid = (long)((st->mid - st->mid * 5e-5) * FEED_PRICE_GRID);
+    long ask = (long)((st->mid + st->mid * 5e-5) * FEED_PRICE_GRID) + 1;
+    m->index = st->index;
+    m->tx_ms = now_ns / 1000000;
+    m->event_ms = m->tx_ms;
+    m->local_ns = now_ns;
+    m->size = feed_grid(1 + (long)(feed_random(f) * FEED_SIZE_GRID), FEED_SIZE_GRID);
+    if (r < 0.4)
+    {
+        m->msg_type = 1;
+        m->sn_id = ++st->sn[SEQ_CHANNEL_BID];
+        m->price = feed_grid(bid, FEED_PRICE_GRID);
+    }
+    else if (r < 0.8)
+    {
+        m->msg_type = -1;
+        m->sn_id = ++st->sn[SEQ_CHANNEL_ASK];
+        m->price = feed_grid(ask, FEED_PRICE_GRID);
+    }
+    else
+    {
+        int buy = r < 0.9;
+        m->msg_type = buy ? 3 : -3;
+        m->sn_id = ++st->sn[SEQ_CHANNEL_TRADE];
+        m->price = feed_grid(buy ? ask : bid, FEED_PRICE_GRID);
+    }
+}
+
+static void feed_send_depth(SimFeed *f, FeedClient *c, FeedStream *st, long long now_ns)
+{
+    char *buf = feed_slot(f);
+    Msg2 *m = (Msg2 *)buf;
+    Msg2Level *levels = (Msg2Level *)(buf + sizeof(Msg2));
+    memset(m, 0, sizeof(*m));
+    m->msg_type = 2;
+    m->index = st->index;
+    m->tx_ms = now_ns / 1000000;
+    m->event_ms = m->tx_ms;
+    m->local_ns = now_ns;
+    m->sn_id = ++st->sn[SEQ_CHANNEL_DEPTH];
+    m->asks_len = f->levels;
+    m->bids_len = f->levels;
+    long mid = (long)(st->mid * FEED_PRICE_GRID);
+    long step = (long)(st->mid * 1e-4 * FEED_PRICE_GRID);
+    step = step > 0 ? step : 1;
+    for (int i = 0; i < f->levels; i++)
+    {
+        // Asks ascending, then bids descending
+        levels[i].price = feed_grid(mid + 1 + i * step, FEED_PRICE_GRID);
+        levels[i].size = feed_grid(100 + (long)(feed_random(f) * FEED_SIZE_GRID), FEED_SIZE_GRID);
+        levels[f->levels + i].price = feed_grid(mid - i * step, FEED_PRICE_GRID);
+        levels[f->levels + i].size = feed_grid(100 + (long)(feed_random(f) * FEED_SIZE_GRID), FEED_SIZE_GRID);
+    }
+    c->depths++;
+    feed_commit(f, c, sizeof(Msg2) + 2 * f->levels * sizeof(Msg2Level), 1);
+}
+
+// Emit everything due for c by now; returns when its next datagram is due
+static long long feed_generate(SimFeed *f, FeedClient *c, long long now_ns)
+{
+    if (c->stream_count == 0 || c->rate <= 0)
+    {
+        return now_ns + FEED_MAX_LAG_NS;
+    }
+
+    unsigned long due = (unsigned long)((now_ns - c->start_ns) * c->rate / 1e9);
+    if (due > c->generated + (unsigned long)(c->rate * FEED_MAX_LAG_NS / 1e9) + f->batch)
+    {
+        // Too far behind (sender starved of CPU): restart pacing from now
+        c->skipped += due - c->generated;
+        c->start_ns = now_ns;
+        c->generated = 0;
+        due = 0;
+    }
+    while (due >= c->generated + f->batch)
+    {
+        Msg *msgs = (Msg *)feed_slot(f);
+        for (int i = 0; i < f->batch; i++)
+        {
+            FeedStream *st = &c->streams[c->next_stream];
+            c->next_stream = (c->next_stream + 1) % c->stream_count;
+            feed_fill_msg(f, st, &msgs[i], now_ns, feed_random(f));
+        }
+        c->generated += f->batch;
+        c->msgs += f->batch;
+        feed_commit(f, c, f->batch * sizeof(Msg), f->batch);
+    }
+    long long next = c->start_ns + (long long)((c->generated + f->batch) * 1e9 / c->rate);
+
+    if (f->depth_hz > 0)
+    {
+        long long interval = (long long)(1e9 / (f->depth_hz * c->stream_count));
+        while (c->next_depth_ns <= now_ns)
+        {
+            feed_send_depth(f, c, &c->streams[c->next_depth], now_ns);
+            c->next_depth = (c->next_depth + 1) % c->stream_count;
+            c->next_depth_ns += interval;
+            if (c->next_depth_ns < now_ns - FEED_MAX_LAG_NS)
+            {
+                c->next_depth_ns = now_ns;
+            }
+        }
+        if (c->next_depth_ns < next)
+        {
+            next = c->next_depth_ns;
+        }
+    }
+    return next;
+}
+
+// On a pause or resume: a bid, an ask, a trade and (with depth on) a
+// snapshot of every stream, neither dropped nor held back; the held
+// datagram goes out behind the first of them
+static void feed_mark_sequences(SimFeed *f, FeedClient *c)
+{
+    double loss = f->loss;
+    double reorder = f->reorder;
+    f->loss = 0;
+    f->reorder = 0;
+    long long now_ns = get_current_timestamp_ns();
+    static const double kinds[3] = {0.0, 0.5, 0.85};
+    for (int i = 0; i < c->stream_count; i++)
+    {
+        Msg *msgs = (Msg *)feed_slot(f);
+        for (int k = 0; k < 3; k++)
+        {
+            feed_fill_msg(f, &c->streams[i], &msgs[k], now_ns, kinds[k]);
+        }
+        c->msgs += 3;
+        feed_commit(f, c, 3 * sizeof(Msg), 3);
+        if (f->depth_hz > 0)
+        {
+            feed_send_depth(f, c, &c->streams[i], now_ns);
+        }
+    }
+    feed_flush(f);
+    f->loss = loss;
+    f->reorder = reorder;
+}
+
+// ---- Subscription manager ----
+
+static FeedClient *feed_client(SimFeed *f, const struct sockaddr_in *from)
+{
+    for (int i = 0; i < f->client_count; i++)
+    {
+        FeedClient *c = &f->clients[i];
+        if (c->addr.sin_addr.s_addr == from->sin_addr.s_addr && c->addr.sin_port == from->sin_port)
+        {
+            return c;
+        }
+    }
+    if (f->client_count == FEED_MAX_CLIENTS)
+    {
+        return NULL;
+    }
+    FeedClient *c = &f->clients[f->client_count++];
+    memset(c, 0, sizeof(*c));
+    c->addr = *from;
+    c->rate = f->rate;
+    c->start_ns = get_current_timestamp_ns();
+    c->next_depth_ns = c->start_ns;
+    return c;
+}
+
+// Server-wide index of symbol, assigned on first subscription
+static int feed_symbol_index(SimFeed *f, const char *symbol)
+{
+    for (int i = 0; i < f->symbol_count; i++)
+    {
+        if (strcmp(f->symbols[i], symbol) == 0)
+        {
+            return i;
+        }
+    }
+    if (f->symbol_count == FEED_MAX_SYMBOLS)
+    {
+        return -1;
+    }
+    snprintf(f->symbols[f->symbol_count], MAX_SYMBOL_LEN, "%s", symbol);
+    return f->symbol_count++;
+}
+
+static int feed_find_stream(const FeedClient *c, int index)
+{
+    for (int i = 0; i < c->stream_count; i++)
+    {
+        if (c->streams[i].index == index)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void feed_reply(SimFeed *f, const struct sockaddr_in *to, const char *reply)
+{
+    sendto(f->manager_socket, reply, strlen(reply), 0, (const struct sockaddr *)to, sizeof(*to));
+}
+
+static void feed_subscribe(SimFeed *f, FeedClient *c, const char *symbol)
+{
+    int index = feed_symbol_index(f, symbol);
+    if (index < 0)
+    {
+        f->rejected++;
+        return;
+    }
+    if (feed_find_stream(c, index) < 0)
+    {
+        if (c->stream_count == c->stream_capacity)
+        {
+            int capacity = c->stream_capacity ? c->stream_capacity * 2 : 16;
+            FeedStream *streams = realloc(c->streams, capacity * sizeof(*streams));
+            if (streams == NULL)
+            {
+                f->rejected++;
+                return;
+            }
+            c->streams = streams;
+            c->stream_capacity = capacity;
+        }
+        if (c->stream_count == 0)
+        {
+            // Pacing starts with the first stream, not at the idle client's creation
+            c->start_ns = get_current_timestamp_ns();
+            c->generated = 0;
+            c->next_depth_ns = c->start_ns;
+        }
+        FeedStream *st = &c->streams[c->stream_count++];
+        memset(st, 0, sizeof(*st));
+        st->index = index;
+        st->mid = 100.0 + index;
+    }
+    f->subscribes++;
+    // Re-subscribing is acked again, the SDK treats it as a no-op
+    char ack[MAX_SYMBOL_LEN + 16];
+    snprintf(ack, sizeof(ack), "%d:%s", index, symbol);
+    feed_reply(f, &c->addr, ack);
+}
+
+static void feed_unsubscribe(SimFeed *f, FeedClient *c, const char *symbol)
+{
+    for (int i = 0; i < f->symbol_count; i++)
+    {
+        if (strcmp(f->symbols[i], symbol) == 0)
+        {
+            int pos = feed_find_stream(c, i);
+            if (pos >= 0)
+            {
+                c->streams[pos] = c->streams[--c->stream_count];
+                c->next_stream = 0;
+                c->next_depth = 0;
+                f->unsubscribes++;
+            }
+            return;
+        }
+    }
+}
+
+static void feed_request(SimFeed *f, char *buf, int len, const struct sockaddr_in *from)
+{
+    f->requests++;
+    while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r' || buf[len - 1] == ' '))
+    {
+        len--;
+    }
+    buf[len] = '\0';
+    if (len == 0 || len >= MAX_SYMBOL_LEN)
+    {
+        f->rejected++;
+        return;
+    }
+    FeedClient *c = feed_client(f, from);
+    if (c == NULL)
+    {
+        f->rejected++;
+        return;
+    }
+    if (buf[0] == '#')
+    {
+        double rate;
+        if (sscanf(buf, "#rate %lf", &rate) == 1 && rate >= 0)
+        {
+            if ((rate == 0) != (c->rate == 0))
+            {
+                feed_mark_sequences(f, c);
+            }
+            c->rate = rate;
+            c->start_ns = get_current_timestamp_ns();
+            c->generated = 0;
+            feed_reply(f, from, buf);
+        }
+        else if (strcmp(buf, "#stats") == 0)
+        {
+            char reply[64];
+            snprintf(reply, sizeof(reply), "#stats %lu", c->dropped_msgs);
+            feed_reply(f, from, reply);
+        }
+        else
+        {
+            f->rejected++;
+        }
+    }
+    else if (buf[0] == '-')
+    {
+        feed_unsubscribe(f, c, buf + 1);
+    }
+    else
+    {
+        feed_subscribe(f, c, buf);
+    }
+}
+
+static int feed_bind(int port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        perror("Socket creation failed");
+        return -1;
+    }
+    int buf_size = 8 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("Bind failed");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void print_feed_stats(const SimFeed *f)
+{
+    printf("requests %lu (subscribes %lu, unsubscribes %lu, rejected %lu), symbols %d, clients %d, "
+           "send errors %lu\n",
+           f->requests, f->subscribes, f->unsubscribes, f->rejected, f->symbol_count, f->client_count,
+           f->send_errors);
+    for (int i = 0; i < f->client_count; i++)
+    {
+        const FeedClient *c = &f->clients[i];
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &c->addr.sin_addr, ip, sizeof(ip));
+        printf("  %s:%d: %d symbols, rate %.0f, msgs %lu, depth %lu, datagrams %lu (dropped %lu, "
+               "reordered %lu), skipped %lu\n",
+               ip, ntohs(c->addr.sin_port), c->stream_count, c->rate, c->msgs, c->depths, c->packets,
+               c->dropped, c->reordered, c->skipped);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static SimFeed f;
+    f.rate = argc > 1 ? atof(argv[1]) : 10000;
+    f.batch = argc > 2 ? atoi(argv[2]) : 8;
+    f.depth_hz = argc > 3 ? atof(argv[3]) : 10;
+    f.levels = argc > 4 ? atoi(argv[4]) : 20;
+    f.loss = argc > 5 ? atof(argv[5]) / 100.0 : 0;
+    f.reorder = argc > 6 ? atof(argv[6]) / 100.0 : 0;
+    int port = argc > 7 ? atoi(argv[7]) : SUBSCRIPTION_MANAGER_PORT;
+    if (f.batch < 1 || f.batch > FEED_MAX_BATCH || f.levels < 0 || f.levels > FEED_MAX_LEVELS)
+    {
+        fprintf(stderr, "batch must be 1..%d, levels 0..%d\n", FEED_MAX_BATCH, FEED_MAX_LEVELS);
+        return EXIT_FAILURE;
+    }
+    f.rng = (unsigned long long)get_current_timestamp_ns() | 1;
+    f.symbols = calloc(FEED_MAX_SYMBOLS, MAX_SYMBOL_LEN);
+    if (f.symbols == NULL)
+    {
+        perror("symbol table allocation failed");
+        return EXIT_FAILURE;
+    }
+    // Data goes out from an ephemeral port, only acks come from the manager port
+    f.manager_socket = feed_bind(port);
+    f.data_socket = feed_bind(0);
+    if (f.manager_socket < 0 || f.data_socket < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    printf("feed simulator on UDP port %d: %.0f msgs/s per client, %d per datagram, depth %.1f/s x %d levels, "
+           "loss %.2f%%, reorder %.2f%%\n",
+           port, f.rate, f.batch, f.depth_hz, f.levels, f.loss * 100, f.reorder * 100);
+
+    char buf[MAX_SYMBOL_LEN + 64];
+    long long next_report = get_current_timestamp_ns() + 10000000000LL;
+    long long wait_ns = 0;
+    while (running)
+    {
+        struct pollfd pfd = {.fd = f.manager_socket, .events = POLLIN};
+        // ppoll for sub-millisecond pacing; wake at least every 100 ms for
+        // the signal flag and the report
+        if (wait_ns > 100000000LL)
+        {
+            wait_ns = 100000000LL;
+        }
+        if (wait_ns > 0)
+        {
+            struct timespec timeout = {wait_ns / 1000000000LL, wait_ns % 1000000000LL};
+            ppoll(&pfd, 1, &timeout, NULL);
+        }
+        for (;;)
+        {
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            int n = recvfrom(f.manager_socket, buf, sizeof(buf) - 1, MSG_DONTWAIT, (struct sockaddr *)&from,
+                             &from_len);
+            if (n < 0)
+            {
+                break;
+            }
+            feed_request(&f, buf, n, &from);
+        }
+
+        long long now = get_current_timestamp_ns();
+        long long next = now + 100000000LL;
+        for (int i = 0; i < f.client_count; i++)
+        {
+            long long due = feed_generate(&f, &f.clients[i], now);
+            if (due < next)
+            {
+                next = due;
+            }
+        }
+        feed_flush(&f);
+        wait_ns = next - get_current_timestamp_ns();
+
+        if (now >= next_report)
+        {
+            print_feed_stats(&f);
+            next_report += 10000000000LL;
+        }
+    }
+    print_feed_stats(&f);
+    for (int i = 0; i < f.client_count; i++)
+    {
+        free(f.clients[i].streams);
+    }
+    free(f.symbols);
+    close(f.manager_socket);
+    close(f.data_socket);
+    return 0;
+}
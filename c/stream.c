@@ -1,60 +1,251 @@
 #include "sdk.c"
+#include "orderbook.c"
+#include "ring.c"
+#include "journal.c"
+#include "histogram.c"
+#include "consolidated_bbo.c"
+#include "trade_agg.c"
+#include "tick_store.c"
+#include "archive.c"
 
-typedef struct Msg
+// Number of datagrams fetched per recvmmsg call
+#define RECV_BATCH_VLEN 64
+// recvmmsg timeout in milliseconds, 0 blocks until data arrives
+#define RECV_BATCH_TIMEOUT_MS 0
+
+// 1: a receive thread only drains the socket into lock-free rings and the
+// main thread consumes them; 0: handlers run inline on the receiving thread
+#define USE_RECV_THREAD 1
+// CPU cores for the receive and consumer threads, -1 leaves them unpinned
+#define RECV_THREAD_CPU -1
+#define CONSUMER_CPU -1
+// SCHED_FIFO priority of the receive thread, 0 keeps the default policy
+#define RECV_THREAD_FIFO_PRIO 0
+// RECV_MODE_SPIN polls the socket without sleeping (burns RECV_THREAD_CPU);
+// RECV_BUSY_POLL_US > 0 adds SO_BUSY_POLL on top. Compare modes with bench_recv.
+#define RECV_MODE RECV_MODE_BLOCK
+#define RECV_BUSY_POLL_US 50
+// RING_WAIT_SPIN burns the consumer core for the lowest wake-up latency
+#define CONSUMER_WAIT RING_WAIT_BLOCK
+#define TICK_RING_SLOTS 65536
+#define DEPTH_RING_BYTES (16UL << 20)
+
+// 1: append every raw datagram to a binary journal (replay with ./replay)
+#define CAPTURE_JOURNAL 0
+#define CAPTURE_PREFIX "stream-capture"
+#define CAPTURE_SEGMENT_BYTES (256UL << 20)
+
+// 1: append every decoded message to a compressed archive at
+// CAPTURE_ARCHIVE_PATH, several times smaller than the journal (read with
+// ./archive_tool)
+#define CAPTURE_ARCHIVE 0
+#define CAPTURE_ARCHIVE_PATH "stream-capture.qa"
+
+// Kernel RX timestamps: RX_TIMESTAMP_NONE, _SOFTWARE or _HARDWARE. With
+// them the latency dump splits wire time into network and socket queueing.
+#define RX_TIMESTAMPS RX_TIMESTAMP_SOFTWARE
+// Interface to enable NIC stamping on for RX_TIMESTAMP_HARDWARE, e.g. "eth0"
+#define RX_TIMESTAMP_IFNAME NULL
+
+// Per symbol/type latency histograms, dumped every LATENCY_DUMP_SEC seconds
+// to LATENCY_DUMP_PATH ("-" for stdout)
+#define LATENCY_HISTOGRAMS 1
+#define LATENCY_DUMP_PATH "stream-latency.log"
+#define LATENCY_DUMP_SEC 10
+
+// 1: keep a consolidated top of book over the perpetuals in bbo_symbols
+// and print it whenever the best bid or ask changes
+#define CONSOLIDATED_BBO 1
+
+// 1: aggregate every symbol's trades into OHLCV bars (TRADE_BAR_MS time
+// bars, TRADE_BAR_TRADES tick bars, printed as they complete) and rolling
+// VWAP / imbalance windows over TRADE_WINDOW_MS and TRADE_WINDOW_TRADES
+#define TRADE_AGGREGATION 1
+#define TRADE_WINDOW_MS 60000
+#define TRADE_WINDOW_TRADES 1000
+#define TRADE_BAR_MS 1000
+#define TRADE_BAR_TRADES 100
+
+// 1: store every decoded tick, trade and depth snapshot in a columnar
+// tick store under TICK_STORE_ROOT (query with ./tick_query)
+#define TICK_STORE 0
+#define TICK_STORE_ROOT "ticks"
+
+LatencyRegistry latency;
+BboRegistry bbo;
+TradeRegistry trades;
+TickStore tick_store;
+ArchiveWriter archive;
+
+static inline void record_arrival(Subscription *sub, int msg_type, long event_ms, long local_ns)
+{
+#if LATENCY_HISTOGRAMS
+    latency_record_arrival(&latency, sub, msg_type, event_ms, local_ns, recv_timestamp_ns,
+                           recv_kernel_ns);
+#endif
+}
+
+static inline void record_handled(Subscription *sub, int msg_type)
+{
+#if LATENCY_HISTOGRAMS
+    latency_record_handler(&latency, sub, msg_type, recv_timestamp_ns, get_current_timestamp_ns());
+#endif
+}
+
+static inline void print_bbo(int changed, const ConsolidatedBook *book)
+{
+    if (changed)
+    {
+        printf("%s: bbo, %.8g@%s / %.8g@%s, spread %.8g\n",
+               book->symbol,
+               book->best_bid,
+               bbo_venue_name(book, book->best_bid_venue),
+               book->best_ask_venue >= 0 ? book->best_ask : NAN,
+               bbo_venue_name(book, book->best_ask_venue),
+               bbo_spread(book));
+    }
+}
+
+void print_bar(const TradeAggregator *agg, int kind, const TradeBar *bar, void *ctx)
+{
+    printf("%s: bar, %s, %.8g, %.8g, %.8g, %.8g, %.8g, vwap %.8g, trades %u\n",
+           agg->symbol,
+           kind == TRADE_BAR_TIME ? "time" : "tick",
+           bar->open,
+           bar->high,
+           bar->low,
+           bar->close,
+           bar->volume,
+           trade_bar_vwap(bar),
+           bar->trades);
+}
+
+// The symbol's book, cleared for reuse when the server gave its index to
+// another symbol since the book was built
+static OrderBook *symbol_book(Subscription *sub)
+{
+    unsigned int generation = subscription_generation(sub);
+    OrderBook *book = (OrderBook *)sub->state;
+    if (book != NULL && sub->state_generation != generation)
+    {
+        book_init(book);
+    }
+    sub->state_generation = generation;
+    return book;
+}
+
+void print_ticker(Subscription *sub, const Msg *msg, void *ctx)
 {
-    // 1: L1 Bid, -1: L1 Ask, 2: L2 Bid, -2: L2 Ask, 3: Buy Trade, -3: Sell Trade
-    int msg_type;
-    // Index of symbol
-    int index;
-    // Transaction Time MS
-    long tx_ms;
-    // Event Time MS
-    long event_ms;
-    // Local Time NS
-    long local_ns;
-    // Sequence Number / Trade ID
-    long sn_id;
-    // Price
-    double price;
-    // Size
-    double size;
-} Msg;
-
-typedef struct Msg2
+    record_arrival(sub, msg->msg_type, msg->event_ms, msg->local_ns);
+    long long latency = get_current_timestamp_ns() - msg->local_ns;
+    // Keep the local book's top in sync between depth snapshots
+    OrderBook *book = symbol_book(sub);
+    if (book != NULL)
+    {
+        book_apply_l1(book, msg);
+    }
+    printf("%s: ticker, %s, %.8g, %.8g, %lld\n",
+           subscription_symbol(sub),
+           msg->msg_type > 0 ? "bid" : "ask",
+           msg->price,
+           msg->size,
+           latency);
+#if CONSOLIDATED_BBO
+    ConsolidatedBook *consolidated = NULL;
+    int changed = bbo_apply_l1(&bbo, sub, msg, &consolidated);
+    print_bbo(changed, consolidated);
+#endif
+#if TICK_STORE
+    tick_store_append(&tick_store, sub, msg);
+#endif
+#if CAPTURE_ARCHIVE
+    archive_append(&archive, sub, msg);
+#endif
+    record_handled(sub, msg->msg_type);
+}
+
+void print_trade(Subscription *sub, const Msg *msg, void *ctx)
 {
-    // 1: L1 Bid, -1: L1 Ask, 2: L2 Bid, -2: L2 Ask, 3: Buy Trade, -3: Sell Trade
-    int msg_type;
-    // Index of symbol
-    int index;
-    // Transaction Time MS
-    long tx_ms;
-    // Event Time MS
-    long event_ms;
-    // Local Time NS
-    long local_ns;
-    // Sequence Number / Trade ID
-    long sn_id;
-    // not used
-    int asks_idx;
-    // Number of asks
-    int asks_len;
-    // not used
-    int bids_idx;
-    // Number of bids
-    int bids_len;
-} Msg2;
-
-typedef struct
+    record_arrival(sub, msg->msg_type, msg->event_ms, msg->local_ns);
+    long long latency = get_current_timestamp_ns() - msg->local_ns;
+    printf("%s: trade, %s, %.8g, %.8g, %lld\n",
+           subscription_symbol(sub),
+           msg->msg_type > 0 ? "buy" : "sell",
+           msg->price,
+           msg->size,
+           latency);
+#if TRADE_AGGREGATION
+    const TradeAggregator *agg = trade_on_trade(&trades, sub, msg);
+    if (agg != NULL)
+    {
+        printf("%s: window, vwap %.8g, imbalance %+.3f, last %lu trades vwap %.8g\n",
+               subscription_symbol(sub),
+               trade_window_vwap(&agg->by_time),
+               trade_window_imbalance(&agg->by_time),
+               trade_window_count(agg, &agg->by_count),
+               trade_window_vwap(&agg->by_count));
+    }
+#endif
+#if TICK_STORE
+    tick_store_append(&tick_store, sub, msg);
+#endif
+#if CAPTURE_ARCHIVE
+    archive_append(&archive, sub, msg);
+#endif
+    record_handled(sub, msg->msg_type);
+}
+
+void print_depth(Subscription *sub, const Msg2 *msg2, const Msg2Level *levels, void *ctx)
 {
-    double price;
-    double size;
-} Msg2Level;
+    record_arrival(sub, msg2->msg_type, msg2->event_ms, msg2->local_ns);
+    long long latency = get_current_timestamp_ns() - msg2->local_ns;
+    printf("%s: depth, %d, %d, %lld\n",
+           subscription_symbol(sub), msg2->asks_len, msg2->bids_len, latency);
+
+    printf("asks: ");
+    for (int i = 0; i < msg2->asks_len; i++)
+    {
+        printf("%.8g:%.8g, ", levels[i].price, levels[i].size);
+    }
+    printf("\nbids: ");
+    for (int i = 0; i < msg2->bids_len; i++)
+    {
+        printf("%.8g:%.8g, ", levels[msg2->asks_len + i].price,
+               levels[msg2->asks_len + i].size);
+    }
+    printf("\n");
 
-long long get_current_timestamp_ns()
+    // Each symbol slot owns one book, allocated on its first snapshot
+    OrderBook *book = symbol_book(sub);
+    if (book == NULL)
+    {
+        book = book_create();
+        sub->state = book;
+    }
+    if (book != NULL)
+    {
+        book_apply_snapshot(book, msg2, levels);
+        printf("book: %.8g / %.8g, wmid5 %.8g\n",
+               book_best_bid(book), book_best_ask(book), book_weighted_mid(book, 5));
+    }
+#if CONSOLIDATED_BBO
+    ConsolidatedBook *consolidated = NULL;
+    int changed = bbo_apply_depth(&bbo, sub, msg2, levels, &consolidated);
+    print_bbo(changed, consolidated);
+#endif
+#if TICK_STORE
+    tick_store_append_depth(&tick_store, sub, msg2, levels);
+#endif
+#if CAPTURE_ARCHIVE
+    archive_append_depth(&archive, sub, msg2, levels);
+#endif
+    record_handled(sub, msg2->msg_type);
+}
+
+void print_resync(Subscription *sub, int msg_type, long expected_sn, long received_sn, void *ctx)
 {
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    printf("%s: gap on %s, expected %ld got %ld, waiting for depth snapshot\n",
+           subscription_symbol(sub), seq_channel_name(msg_type), expected_sn, received_sn);
 }
 
 int main()
@@ -92,6 +283,87 @@ int main()
     }
     print_status();
 
+#if CONSOLIDATED_BBO
+    // The same perpetual on every venue, consolidated as BTCUSDT
+    const char *bbo_symbols[] = {
+        "binance-futures:btcusdt",
+        "okx-swap:BTC-USDT-SWAP",
+        "bybit:BTCUSDT",
+        "gate-io-futures:BTC_USDT",
+        "kucoin-futures:XBTUSDTM",
+        "bitget-futures:BTCUSDT",
+    };
+    if (bbo_init(&bbo, 16) < 0 || add_subscription_hook(bbo_on_subscribe, &bbo) < 0)
+    {
+        close(manager.socket);
+        return 1;
+    }
+    for (int i = 0; i < sizeof(bbo_symbols) / sizeof(bbo_symbols[0]); i++)
+    {
+        bbo_add(&bbo, bbo_symbols[i], NULL);
+    }
+#endif
+
+    if (init_batch_receiver(RECV_BATCH_VLEN, RECV_BATCH_TIMEOUT_MS) < 0)
+    {
+        close(manager.socket);
+        return 1;
+    }
+
+    if (set_receive_mode(RECV_MODE, RECV_BUSY_POLL_US) < 0 ||
+        enable_rx_timestamps(RX_TIMESTAMPS, RX_TIMESTAMP_IFNAME) < 0)
+    {
+        close(manager.socket);
+        return 1;
+    }
+
+#if TRADE_AGGREGATION
+    if (trade_registry_init(&trades, TRADE_WINDOW_MS, TRADE_WINDOW_TRADES, TRADE_BAR_MS, TRADE_BAR_TRADES) < 0 ||
+        add_subscription_hook(trade_on_subscribe, &trades) < 0)
+    {
+        close(manager.socket);
+        return 1;
+    }
+    trades.on_bar = print_bar;
+#endif
+
+#if TICK_STORE
+    if (tick_store_init(&tick_store, TICK_STORE_ROOT) < 0)
+    {
+        close(manager.socket);
+        return 1;
+    }
+#endif
+
+#if CAPTURE_JOURNAL
+    static Journal journal;
+    if (journal_open(&journal, CAPTURE_PREFIX, CAPTURE_SEGMENT_BYTES) < 0)
+    {
+        close(manager.socket);
+        return 1;
+    }
+    set_datagram_hook(journal_capture, &journal);
+    printf("Capturing to %s-%06lu.qj (replay with ./replay %s)\n", journal.prefix, journal.segment, journal.prefix);
+#endif
+
+#if CAPTURE_ARCHIVE
+    if (archive_open(&archive, CAPTURE_ARCHIVE_PATH) < 0)
+    {
+        close(manager.socket);
+        return 1;
+    }
+#endif
+
+#if LATENCY_HISTOGRAMS
+    LatencyReporter reporter;
+    if (latency_init(&latency) < 0 || add_subscription_hook(latency_on_subscribe, &latency) < 0 ||
+        start_latency_reporter(&reporter, &latency, LATENCY_DUMP_PATH, LATENCY_DUMP_SEC) < 0)
+    {
+        close(manager.socket);
+        return 1;
+    }
+#endif
+
     // 设置信号处理
     signal(SIGINT, handle_signal);
     signal(SIGTERM, handle_signal);
@@ -100,104 +372,130 @@ int main()
     // that was used for sending subscription requests
     // This is CRITICAL: the server sends data to the IP:port it saw
     // in the subscription request, so we must receive on that same socket
+    // recvmmsg drains up to RECV_BATCH_VLEN datagrams per syscall, so a burst
+    // across all subscribed symbols costs one wake-up instead of one per packet
+    StreamHandlers handlers = {
+        .on_ticker = print_ticker,
+        .on_trade = print_trade,
+        .on_depth = print_depth,
+        .on_resync = print_resync,
+    };
+#if USE_RECV_THREAD
+    RingSignal ring_signal;
+    MsgRing ticks;
+    DepthRing depth;
+    ReceiveThread receiver;
+    ring_signal_init(&ring_signal);
+    if (msg_ring_init(&ticks, TICK_RING_SLOTS, 0, &ring_signal) < 0 ||
+        depth_ring_init(&depth, DEPTH_RING_BYTES, &ring_signal) < 0 ||
+        start_receive_thread(&receiver, &ticks, &depth, &handlers, RECV_THREAD_CPU,
+                             RECV_THREAD_FIFO_PRIO) < 0)
+    {
+        close(manager.socket);
+        return 1;
+    }
+    pin_current_thread(CONSUMER_CPU);
+
     while (running)
     {
-        struct sockaddr_in from_addr;
-        socklen_t from_len = sizeof(from_addr);
-        // Receive on manager.socket - the same socket used for subscribe()
-        int len = recvfrom(manager.socket, manager.buf, UDP_SIZE, 0,
-                           (struct sockaddr *)&from_addr, &from_len);
-        if (len < 0)
+        // Merge the two rings by local_ns so snapshots and ticks reach the
+        // book in feed order
+        const RingMsg *tick = msg_ring_peek(&ticks);
+        const DepthRecord *snapshot = depth_ring_peek(&depth);
+        if (tick != NULL && (snapshot == NULL || tick->msg.local_ns <= snapshot->msg2.local_ns))
         {
-            perror("recvfrom failed");
-            continue;
+            recv_timestamp_ns = tick->recv_ns;
+            recv_kernel_ns = tick->kernel_ns;
+            if (abs(tick->msg.msg_type) == 1)
+            {
+                handlers.on_ticker(tick->sub, &tick->msg, NULL);
+            }
+            else
+            {
+                handlers.on_trade(tick->sub, &tick->msg, NULL);
+            }
+            msg_ring_release(&ticks);
         }
-
-        // 订阅
-        if (ntohs(from_addr.sin_port) == SUBSCRIPTION_MANAGER_PORT)
+        else if (snapshot != NULL)
         {
-            add_subscripton(len);
-            continue;
+            recv_timestamp_ns = snapshot->recv_ns;
+            recv_kernel_ns = snapshot->kernel_ns;
+            handlers.on_depth(snapshot->sub, &snapshot->msg2, snapshot->levels, NULL);
+            depth_ring_release(&depth, snapshot);
         }
-
-        // 處理UDP包中的所有消息
-        int offset = 0;
-        while (offset + sizeof(Msg) <= len)
+        else if (CONSUMER_WAIT == RING_WAIT_BLOCK)
         {
-            Msg *msg = (Msg *)(manager.buf + offset);
-            
-            // 查找对应的订阅
-            const char *symbol = NULL;
-            for (int i = 0; i < manager.subscription_count; i++)
+            unsigned int token = ring_prepare_wait(&ring_signal);
+            if (msg_ring_empty(&ticks) && depth_ring_empty(&depth))
             {
-                if (manager.subscriptions[i].index == msg->index)
-                {
-                    symbol = manager.subscriptions[i].symbol;
-                    break;
-                }
+                ring_wait(&ring_signal, token, 100);
             }
-
-            if (symbol != NULL)
+            else
             {
-                long long now = get_current_timestamp_ns();
-                long long latency = now - msg->local_ns;
-
-                if (msg->msg_type == 2)
-                {
-                    // L2 消息處理 - 整個UDP包應該只包含一個L2消息
-                    Msg2 *msg2 = (Msg2 *)manager.buf;
-                    Msg2Level *levels = (Msg2Level *)(manager.buf + sizeof(Msg2));
-                    printf("%s: depth, %d, %d, %lld\n",
-                           symbol, msg2->asks_len, msg2->bids_len, latency);
-
-                    printf("asks: ");
-                    for (int i = 0; i < msg2->asks_len; i++)
-                    {
-                        printf("%.8g:%.8g, ", levels[i].price, levels[i].size);
-                    }
-                    printf("\nbids: ");
-                    for (int i = 0; i < msg2->bids_len; i++)
-                    {
-                        printf("%.8g:%.8g, ", levels[msg2->asks_len + i].price,
-                               levels[msg2->asks_len + i].size);
-                    }
-                    printf("\n");
-                    
-                    // L2 消息佔用整個UDP包，直接跳出循環
-                    break;
-                }
-                else if (abs(msg->msg_type) == 1)
-                {
-                    // 处理 ticker 数据
-                    printf("%s: ticker, %s, %.8g, %.8g, %lld\n",
-                           symbol,
-                           msg->msg_type > 0 ? "bid" : "ask",
-                           msg->price,
-                           msg->size,
-                           latency);
-                }
-                else if (abs(msg->msg_type) == 3)
-                {
-                    // 处理交易数据
-                    printf("%s: trade, %s, %.8g, %.8g, %lld\n",
-                           symbol,
-                           msg->msg_type > 0 ? "buy" : "sell",
-                           msg->price,
-                           msg->size,
-                           latency);
-                }
+                ring_cancel_wait(&ring_signal);
             }
-            
-            // 移動到下一個消息
-            offset += sizeof(Msg);
+        }
+        else
+        {
+            cpu_relax();
         }
     }
 
+    join_receive_thread(&receiver);
+    print_ring_stats(&ticks, &depth);
+    msg_ring_free(&ticks);
+    depth_ring_free(&depth);
+#else
+    while (running)
+    {
+        // Receive on manager.socket - the same socket used for subscribe()
+        receive_batch(&handlers);
+    }
+#endif
+
     // // 清理资源前先取消订阅所有符号
     // printf("Unsubscribing all symbols...\n");
     // unsubscribe_all();
 
     // 清理资源
+#if CAPTURE_JOURNAL
+    printf("Captured %lu datagrams (%lu bytes, %lu rotations, %lu waited for a segment, %lu dropped)\n",
+           journal.records, journal.bytes, journal.rotations, journal.stalls, journal.drops);
+    journal_close(&journal);
+#endif
+#if CAPTURE_ARCHIVE
+    archive_close(&archive);
+    print_archive_stats(&archive);
+#endif
+#if LATENCY_HISTOGRAMS
+    stop_latency_reporter(&reporter);
+    printf("Latency since start (us):\n");
+    latency_dump(&latency, stdout, 0);
+    latency_free(&latency);
+#endif
+#if TRADE_AGGREGATION
+    print_trade_stats(&trades);
+    trade_registry_free(&trades);
+#endif
+#if CONSOLIDATED_BBO
+    print_bbo_stats(&bbo);
+    bbo_free(&bbo);
+#endif
+#if TICK_STORE
+    print_tick_store_stats(&tick_store);
+    tick_store_close(&tick_store);
+#endif
+    print_seq_stats();
+    print_batch_stats();
+    free_batch_receiver();
+    for (unsigned int i = 0; i < manager.index_capacity; i++)
+    {
+        if (manager.by_index[i] != NULL)
+        {
+            book_destroy((OrderBook *)manager.by_index[i]->state);
+        }
+    }
+    free_subscriptions();
     close(manager.socket);
     printf("Gracefully shut down\n");
     return 0;
@@ -0,0 +1,817 @@
+#ifndef QTX_TICK_STORE_C
+#define QTX_TICK_STORE_C
+
+#include "sdk.c"
+#include <stdint.h>
+#include <math.h>
+#include <sys/stat.h>
+
+// Columnar, append-only store of decoded feed messages for research
+// queries. Each symbol and UTC day is a directory
+//   <root>/<symbol>/<YYYYMMDD>/<column>.col
+// holding one mmap'd file per Msg field (event_ms, local_ns, sn_id, price,
+// size, type) and, for depth snapshots, per Msg2 field plus price and size
+// columns for each side with TICK_DEPTH_LEVELS levels. Rows are laid out
+// in chunks of TICK_CHUNK_ROWS, level-major inside a chunk (all level 0
+// values, then all level 1 values, ...), so reading one level across time
+// is sequential; single-level columns are plain arrays. Files grow by
+// doubling (fallocate + mremap) and are trimmed to whole chunks on close.
+//
+// The event_ms column holds the message time used for partitioning and
+// queries: event_ms, or local_ns when the venue leaves event_ms unset.
+// A message older than its symbol's open day stays in that day.
+//
+// Queries map a partition read-only and scan columns with 4-lane vector
+// filters (AVX2 where the CPU has it); see tick_range_stats() and
+// tick_select_range().
+
+#define TICK_COLUMN_MAGIC 0x314c4f4354585451UL // "QTXTCOL1"
+#define TICK_COLUMN_VERSION 1
+#define TICK_CHUNK_ROWS 1024
+// First allocation of a partition's columns, in rows
+#define TICK_INITIAL_ROWS (64 * TICK_CHUNK_ROWS)
+#define TICK_INITIAL_DEPTH_ROWS (4 * TICK_CHUNK_ROWS)
+// Levels stored per side of a depth snapshot; deeper levels are dropped
+#ifndef TICK_DEPTH_LEVELS
+#define TICK_DEPTH_LEVELS 20
+#endif
+// Partition directory path; column file names add at most 32 bytes
+#define TICK_PATH_MAX 512
+
+// Columns of L1 ticks and trades
+#define TICK_EVENT_MS 0
+#define TICK_LOCAL_NS 1
+#define TICK_SN_ID 2
+#define TICK_PRICE 3
+#define TICK_SIZE 4
+#define TICK_TYPE 5
+#define TICK_COLUMNS 6
+
+// Columns of depth snapshots
+#define DEPTH_EVENT_MS 0
+#define DEPTH_LOCAL_NS 1
+#define DEPTH_SN_ID 2
+#define DEPTH_ASKS_LEN 3
+#define DEPTH_BIDS_LEN 4
+#define DEPTH_ASK_PRICE 5
+#define DEPTH_ASK_SIZE 6
+#define DEPTH_BID_PRICE 7
+#define DEPTH_BID_SIZE 8
+#define DEPTH_COLUMNS 9
+
+// Bit of msg_type t (-3..3) in the type masks of the queries
+#define TICK_TYPE_BIT(t) (1u << ((t) + 3))
+#define TICK_TRADES (TICK_TYPE_BIT(3) | TICK_TYPE_BIT(-3))
+#define TICK_L1 (TICK_TYPE_BIT(1) | TICK_TYPE_BIT(-1))
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define TICK_SIMD_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define TICK_SIMD_CLONES
+#endif
+
+typedef struct
+{
+    const char *name;
+    uint32_t elem_size;
+    uint32_t levels;
+} TickColumnSpec;
+
+static const TickColumnSpec tick_column_specs[TICK_COLUMNS] = {
+    {"event_ms", 8, 1}, {"local_ns", 8, 1}, {"sn_id", 8, 1}, {"price", 8, 1}, {"size", 8, 1}, {"type", 1, 1},
+};
+
+static const TickColumnSpec depth_column_specs[DEPTH_COLUMNS] = {
+    {"depth_event_ms", 8, 1},
+    {"depth_local_ns", 8, 1},
+    {"depth_sn_id", 8, 1},
+    {"depth_asks_len", 4, 1},
+    {"depth_bids_len", 4, 1},
+    {"depth_ask_price", 8, TICK_DEPTH_LEVELS},
+    {"depth_ask_size", 8, TICK_DEPTH_LEVELS},
+    {"depth_bid_price", 8, TICK_DEPTH_LEVELS},
+    {"depth_bid_size", 8, TICK_DEPTH_LEVELS},
+};
+
+// 64 bytes, so the data that follows is 64-byte aligned in the mapping
+typedef struct
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t elem_size;
+    uint32_t levels;
+    uint32_t chunk_rows;
+    int32_t day;
+    // Rows written; updated after the row's data
+    uint64_t rows;
+    uint64_t capacity;
+    uint64_t reserved[2];
+} TickColumnHeader;
+
+// Element index of (row, level) in a column with levels values per row
+static inline uint64_t tick_offset(uint64_t row, uint32_t level, uint32_t levels)
+{
+    return ((row / TICK_CHUNK_ROWS) * levels + level) * TICK_CHUNK_ROWS + row % TICK_CHUNK_ROWS;
+}
+
+static inline size_t tick_column_bytes(const TickColumnSpec *spec, uint64_t rows)
+{
+    uint64_t chunks = (rows + TICK_CHUNK_ROWS - 1) / TICK_CHUNK_ROWS;
+    return sizeof(TickColumnHeader) + chunks * TICK_CHUNK_ROWS * spec->levels * spec->elem_size;
+}
+
+// ---- Writer ----
+
+typedef struct
+{
+    int fd;
+    char *base;
+    size_t map_len;
+    TickColumnHeader *hdr;
+    char *data;
+} TickColumn;
+
+// Columns of one group (ticks or depth) sharing row count and capacity
+typedef struct
+{
+    TickColumn *columns;
+    const TickColumnSpec *specs;
+    int count;
+    uint64_t initial_rows;
+    int open;
+    uint64_t rows;
+    uint64_t capacity;
+} TickGroup;
+
+typedef struct
+{
+    char symbol[MAX_SYMBOL_LEN];
+    // subscription_generation() of the index when this store was made for it
+    unsigned int generation;
+    // Open partition, 0 for none, and its bounds in ms
+    int day;
+    long day_start_ms;
+    long day_end_ms;
+    TickColumn tick_columns[TICK_COLUMNS];
+    TickColumn depth_columns[DEPTH_COLUMNS];
+    TickGroup ticks;
+    TickGroup depth;
+} TickSymbolStore;
+
+typedef struct
+{
+    char root[256];
+    // Indexed by the feed's symbol index (Subscription.index), grows with
+    // the subscriptions
+    IndexTable slots;
+    unsigned long rows;
+    unsigned long depth_rows;
+    unsigned long partitions;
+    // Messages not stored: allocation or file errors
+    unsigned long errors;
+} TickStore;
+
+// YYYYMMDD of a UTC time in ms
+static inline int tick_day_of(long ms)
+{
+    time_t sec = ms / 1000;
+    struct tm tm;
+    gmtime_r(&sec, &tm);
+    return (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+}
+
+// mkdir -p, path is modified in place and restored
+static int tick_mkdirs(char *path)
+{
+    for (char *p = path + 1; *p != '\0'; p++)
+    {
+        if (*p == '/')
+        {
+            *p = '\0';
+            int err = mkdir(path, 0755) < 0 && errno != EEXIST;
+            *p = '/';
+            if (err)
+            {
+                return -1;
+            }
+        }
+    }
+    return mkdir(path, 0755) < 0 && errno != EEXIST ? -1 : 0;
+}
+
+// <root>/<symbol>/<YYYYMMDD>, '/' in the symbol replaced by '_'
+static void tick_partition_dir(char *out, size_t size, const char *root, const char *symbol, int day)
+{
+    char name[MAX_SYMBOL_LEN];
+    snprintf(name, sizeof(name), "%s", symbol);
+    for (char *p = name; *p != '\0'; p++)
+    {
+        *p = *p == '/' ? '_' : *p;
+    }
+    snprintf(out, size, "%s/%s/%08d", root, name, day);
+}
+
+static int tick_column_map(TickColumn *c, size_t len)
+{
+    int err = posix_fallocate(c->fd, 0, len);
+    if (err != 0)
+    {
+        fprintf(stderr, "tick store fallocate failed: %s\n", strerror(err));
+        return -1;
+    }
+    char *base = c->base == NULL ? mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0)
+                                 : mremap(c->base, c->map_len, len, MREMAP_MAYMOVE);
+    if (base == MAP_FAILED)
+    {
+        perror("tick store mmap failed");
+        return -1;
+    }
+    c->base = base;
+    c->map_len = len;
+    c->hdr = (TickColumnHeader *)base;
+    c->data = base + sizeof(TickColumnHeader);
+    return 0;
+}
+
+// Open or create one column file; *rows receives the rows it already has
+static int tick_column_open(TickColumn *c, const char *dir, const TickColumnSpec *spec, int day,
+                            uint64_t capacity, uint64_t *rows)
+{
+    char path[TICK_PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/%s.col", dir, spec->name);
+    memset(c, 0, sizeof(*c));
+    c->fd = open(path, O_CREAT | O_RDWR, 0644);
+    if (c->fd < 0)
+    {
+        perror("tick store open failed");
+        return -1;
+    }
+
+    TickColumnHeader hdr;
+    struct stat st;
+    *rows = 0;
+    if (fstat(c->fd, &st) == 0 && st.st_size > 0)
+    {
+        // Existing partition of the same day: continue after its rows
+        if (st.st_size < (off_t)sizeof(hdr) || pread(c->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+            hdr.magic != TICK_COLUMN_MAGIC || hdr.version != TICK_COLUMN_VERSION ||
+            hdr.elem_size != spec->elem_size || hdr.levels != spec->levels || hdr.chunk_rows != TICK_CHUNK_ROWS)
+        {
+            fprintf(stderr, "%s is not a tick column\n", path);
+            close(c->fd);
+            return -1;
+        }
+        *rows = hdr.rows;
+        while (capacity < hdr.rows)
+        {
+            capacity *= 2;
+        }
+    }
+    if (tick_column_map(c, tick_column_bytes(spec, capacity)) < 0)
+    {
+        close(c->fd);
+        return -1;
+    }
+    if (*rows == 0)
+    {
+        memset(c->hdr, 0, sizeof(*c->hdr));
+        c->hdr->magic = TICK_COLUMN_MAGIC;
+        c->hdr->version = TICK_COLUMN_VERSION;
+        c->hdr->header_size = sizeof(TickColumnHeader);
+        c->hdr->elem_size = spec->elem_size;
+        c->hdr->levels = spec->levels;
+        c->hdr->chunk_rows = TICK_CHUNK_ROWS;
+        c->hdr->day = day;
+    }
+    c->hdr->capacity = capacity;
+    return 0;
+}
+
+static void tick_column_close(TickColumn *c, const TickColumnSpec *spec)
+{
+    if (c->base == NULL)
+    {
+        return;
+    }
+    size_t used = tick_column_bytes(spec, c->hdr->rows);
+    munmap(c->base, c->map_len);
+    if (ftruncate(c->fd, used) < 0)
+    {
+        perror("tick store trim failed");
+    }
+    close(c->fd);
+    c->base = NULL;
+}
+
+static void tick_group_close(TickGroup *g)
+{
+    for (int i = 0; i < g->count; i++)
+    {
+        tick_column_close(&g->columns[i], &g->specs[i]);
+    }
+    g->open = 0;
+    g->rows = 0;
+}
+
+static int tick_group_open(TickGroup *g, const char *dir, int day)
+{
+    uint64_t rows = UINT64_MAX;
+    for (int i = 0; i < g->count; i++)
+    {
+        uint64_t column_rows;
+        if (tick_column_open(&g->columns[i], dir, &g->specs[i], day, g->initial_rows, &column_rows) < 0)
+        {
+            for (int j = 0; j < i; j++)
+            {
+                tick_column_close(&g->columns[j], &g->specs[j]);
+            }
+            return -1;
+        }
+        // A crash can leave columns a row apart; keep what all of them have
+        rows = column_rows < rows ? column_rows : rows;
+    }
+    g->rows = rows;
+    g->capacity = g->columns[0].hdr->capacity;
+    for (int i = 1; i < g->count; i++)
+    {
+        if (g->columns[i].hdr->capacity < g->capacity)
+        {
+            g->capacity = g->columns[i].hdr->capacity;
+        }
+    }
+    g->open = 1;
+    return 0;
+}
+
+// Room for one more row in every column of the group
+static int tick_group_reserve(TickGroup *g)
+{
+    if (g->rows < g->capacity)
+    {
+        return 0;
+    }
+    uint64_t capacity = g->capacity * 2;
+    for (int i = 0; i < g->count; i++)
+    {
+        if (tick_column_map(&g->columns[i], tick_column_bytes(&g->specs[i], capacity)) < 0)
+        {
+            return -1;
+        }
+        g->columns[i].hdr->capacity = capacity;
+    }
+    g->capacity = capacity;
+    return 0;
+}
+
+// Publish the row just written
+static inline void tick_group_commit(TickGroup *g)
+{
+    g->rows++;
+    for (int i = 0; i < g->count; i++)
+    {
+        g->columns[i].hdr->rows = g->rows;
+    }
+}
+
+static inline void *tick_cell(TickGroup *g, int column, uint64_t row, uint32_t level)
+{
+    const TickColumnSpec *spec = &g->specs[column];
+    return g->columns[column].data + tick_offset(row, level, spec->levels) * spec->elem_size;
+}
+
+int tick_store_init(TickStore *t, const char *root)
+{
+    memset(t, 0, sizeof(*t));
+    snprintf(t->root, sizeof(t->root), "%s", root);
+    return 0;
+}
+
+static void tick_symbol_close(TickSymbolStore *s)
+{
+    tick_group_close(&s->ticks);
+    tick_group_close(&s->depth);
+    free(s);
+}
+
+void tick_store_close(TickStore *t)
+{
+    unsigned int i = 0;
+    for (TickSymbolStore *s; (s = index_table_next(&t->slots, &i)) != NULL; i++)
+    {
+        tick_symbol_close(s);
+    }
+    index_table_free(&t->slots);
+}
+
+static TickSymbolStore *tick_slot(TickStore *t, const Subscription *sub)
+{
+    TickSymbolStore *s = index_table_get(&t->slots, sub->index);
+    unsigned int generation = subscription_generation(sub);
+    if (s != NULL && s->generation == generation)
+    {
+        return s;
+    }
+    const char *symbol = subscription_symbol(sub);
+    if (s != NULL && strcmp(s->symbol, symbol) == 0)
+    {
+        s->generation = generation;
+        return s;
+    }
+    // First message of this index, or of a new symbol on a reused index
+    TickSymbolStore *fresh = calloc(1, sizeof(TickSymbolStore));
+    if (fresh == NULL)
+    {
+        return NULL;
+    }
+    snprintf(fresh->symbol, sizeof(fresh->symbol), "%s", symbol);
+    fresh->generation = generation;
+    fresh->ticks = (TickGroup){.columns = fresh->tick_columns, .specs = tick_column_specs, .count = TICK_COLUMNS,
+                               .initial_rows = TICK_INITIAL_ROWS};
+    fresh->depth = (TickGroup){.columns = fresh->depth_columns, .specs = depth_column_specs,
+                               .count = DEPTH_COLUMNS, .initial_rows = TICK_INITIAL_DEPTH_ROWS};
+    if (index_table_set(&t->slots, sub->index, fresh) < 0)
+    {
+        free(fresh);
+        return NULL;
+    }
+    if (s != NULL)
+    {
+        tick_symbol_close(s);
+    }
+    return fresh;
+}
+
+// Make group g of s write into the partition of ms, rolling over to a new
+// day when ms passed the open one
+static int tick_partition_for(TickStore *t, TickSymbolStore *s, TickGroup *g, long ms)
+{
+    if (s->day == 0 || ms >= s->day_end_ms)
+    {
+        tick_group_close(&s->ticks);
+        tick_group_close(&s->depth);
+        s->day = tick_day_of(ms);
+        s->day_start_ms = ms - ms % 86400000L;
+        s->day_end_ms = s->day_start_ms + 86400000L;
+        t->partitions++;
+    }
+    if (!g->open)
+    {
+        char dir[TICK_PATH_MAX];
+        tick_partition_dir(dir, sizeof(dir), t->root, s->symbol, s->day);
+        if (tick_mkdirs(dir) < 0)
+        {
+            perror("tick store mkdir failed");
+            return -1;
+        }
+        if (tick_group_open(g, dir, s->day) < 0)
+        {
+            return -1;
+        }
+    }
+    return tick_group_reserve(g);
+}
+
+// Store an L1 tick or trade
+int tick_store_append(TickStore *t, const Subscription *sub, const Msg *msg)
+{
+    TickSymbolStore *s = tick_slot(t, sub);
+    long ms = msg->event_ms > 0 ? msg->event_ms : msg->local_ns / 1000000;
+    if (s == NULL || tick_partition_for(t, s, &s->ticks, ms) < 0)
+    {
+        t->errors++;
+        return -1;
+    }
+    TickGroup *g = &s->ticks;
+    uint64_t row = g->rows;
+    *(int64_t *)tick_cell(g, TICK_EVENT_MS, row, 0) = ms;
+    *(int64_t *)tick_cell(g, TICK_LOCAL_NS, row, 0) = msg->local_ns;
+    *(int64_t *)tick_cell(g, TICK_SN_ID, row, 0) = msg->sn_id;
+    *(double *)tick_cell(g, TICK_PRICE, row, 0) = msg->price;
+    *(double *)tick_cell(g, TICK_SIZE, row, 0) = msg->size;
+    *(int8_t *)tick_cell(g, TICK_TYPE, row, 0) = (int8_t)msg->msg_type;
+    tick_group_commit(g);
+    t->rows++;
+    return 0;
+}
+
+// Store a depth snapshot, the best TICK_DEPTH_LEVELS levels of each side;
+// missing levels are stored with price and size 0
+int tick_store_append_depth(TickStore *t, const Subscription *sub, const Msg2 *msg2, const Msg2Level *levels)
+{
+    TickSymbolStore *s = tick_slot(t, sub);
+    long ms = msg2->event_ms > 0 ? msg2->event_ms : msg2->local_ns / 1000000;
+    if (s == NULL || tick_partition_for(t, s, &s->depth, ms) < 0)
+    {
+        t->errors++;
+        return -1;
+    }
+    TickGroup *g = &s->depth;
+    uint64_t row = g->rows;
+    int asks = msg2->asks_len < TICK_DEPTH_LEVELS ? msg2->asks_len : TICK_DEPTH_LEVELS;
+    int bids = msg2->bids_len < TICK_DEPTH_LEVELS ? msg2->bids_len : TICK_DEPTH_LEVELS;
+    *(int64_t *)tick_cell(g, DEPTH_EVENT_MS, row, 0) = ms;
+    *(int64_t *)tick_cell(g, DEPTH_LOCAL_NS, row, 0) = msg2->local_ns;
+    *(int64_t *)tick_cell(g, DEPTH_SN_ID, row, 0) = msg2->sn_id;
+    *(int32_t *)tick_cell(g, DEPTH_ASKS_LEN, row, 0) = asks;
+    *(int32_t *)tick_cell(g, DEPTH_BIDS_LEN, row, 0) = bids;
+    const Msg2Level *bid_levels = levels + msg2->asks_len;
+    for (int l = 0; l < TICK_DEPTH_LEVELS; l++)
+    {
+        *(double *)tick_cell(g, DEPTH_ASK_PRICE, row, l) = l < asks ? levels[l].price : 0;
+        *(double *)tick_cell(g, DEPTH_ASK_SIZE, row, l) = l < asks ? levels[l].size : 0;
+        *(double *)tick_cell(g, DEPTH_BID_PRICE, row, l) = l < bids ? bid_levels[l].price : 0;
+        *(double *)tick_cell(g, DEPTH_BID_SIZE, row, l) = l < bids ? bid_levels[l].size : 0;
+    }
+    tick_group_commit(g);
+    t->depth_rows++;
+    return 0;
+}
+
+void print_tick_store_stats(const TickStore *t)
+{
+    printf("=== Tick Store (%s) ===\n", t->root);
+    printf("rows %lu, depth rows %lu, partitions %lu, errors %lu\n", t->rows, t->depth_rows, t->partitions,
+           t->errors);
+    printf("=======================\n");
+}
+
+// ---- Reader ----
+
+typedef struct
+{
+    const char *data;
+    uint64_t rows;
+    uint32_t levels;
+    void *base;
+    size_t map_len;
+} TickColumnView;
+
+typedef struct
+{
+    TickColumnView ticks[TICK_COLUMNS];
+    TickColumnView depth[DEPTH_COLUMNS];
+    uint64_t rows;
+    uint64_t depth_rows;
+} TickPartition;
+
+static int tick_view_open(TickColumnView *v, const char *dir, const TickColumnSpec *spec)
+{
+    char path[TICK_PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/%s.col", dir, spec->name);
+    memset(v, 0, sizeof(*v));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(TickColumnHeader))
+    {
+        close(fd);
+        return -1;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        return -1;
+    }
+    const TickColumnHeader *hdr = (const TickColumnHeader *)base;
+    if (hdr->magic != TICK_COLUMN_MAGIC || hdr->version != TICK_COLUMN_VERSION ||
+        hdr->elem_size != spec->elem_size || hdr->levels != spec->levels || hdr->chunk_rows != TICK_CHUNK_ROWS)
+    {
+        fprintf(stderr, "%s is not a tick column\n", path);
+        munmap(base, st.st_size);
+        return -1;
+    }
+    // Scans read the whole column front to back
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+    v->base = base;
+    v->map_len = st.st_size;
+    v->data = (const char *)base + hdr->header_size;
+    v->levels = hdr->levels;
+    v->rows = hdr->rows;
+    // Never trust rows beyond what the file holds
+    while (v->rows > 0 && tick_column_bytes(spec, v->rows) > (size_t)st.st_size)
+    {
+        v->rows--;
+    }
+    return 0;
+}
+
+static void tick_view_close(TickColumnView *v)
+{
+    if (v->base != NULL)
+    {
+        munmap(v->base, v->map_len);
+        v->base = NULL;
+    }
+}
+
+// Map one group; *rows is the row count every column has, 0 if the group
+// is missing
+static int tick_group_view(TickColumnView *views, const TickColumnSpec *specs, int count, const char *dir,
+                           uint64_t *rows)
+{
+    *rows = UINT64_MAX;
+    for (int i = 0; i < count; i++)
+    {
+        if (tick_view_open(&views[i], dir, &specs[i]) < 0)
+        {
+            for (int j = 0; j < i; j++)
+            {
+                tick_view_close(&views[j]);
+            }
+            *rows = 0;
+            return -1;
+        }
+        *rows = views[i].rows < *rows ? views[i].rows : *rows;
+    }
+    return 0;
+}
+
+// Map the partition of symbol on day (YYYYMMDD). Either group may be
+// missing; fails only if both are.
+int tick_partition_open(TickPartition *p, const char *root, const char *symbol, int day)
+{
+    char dir[TICK_PATH_MAX];
+    memset(p, 0, sizeof(*p));
+    tick_partition_dir(dir, sizeof(dir), root, symbol, day);
+    int ticks = tick_group_view(p->ticks, tick_column_specs, TICK_COLUMNS, dir, &p->rows);
+    int depth = tick_group_view(p->depth, depth_column_specs, DEPTH_COLUMNS, dir, &p->depth_rows);
+    if (ticks < 0 && depth < 0)
+    {
+        fprintf(stderr, "no tick partition at %s\n", dir);
+        return -1;
+    }
+    return 0;
+}
+
+void tick_partition_close(TickPartition *p)
+{
+    for (int i = 0; i < TICK_COLUMNS; i++)
+    {
+        tick_view_close(&p->ticks[i]);
+    }
+    for (int i = 0; i < DEPTH_COLUMNS; i++)
+    {
+        tick_view_close(&p->depth[i]);
+    }
+}
+
+static inline const int64_t *tick_i64(const TickColumnView *v)
+{
+    return (const int64_t *)v->data;
+}
+
+static inline const double *tick_f64(const TickColumnView *v)
+{
+    return (const double *)v->data;
+}
+
+// Level level of a depth column for TICK_CHUNK_ROWS rows from chunk's
+// first row, contiguous
+static inline const double *tick_level_chunk(const TickColumnView *v, uint64_t chunk, uint32_t level)
+{
+    return (const double *)v->data + tick_offset(chunk * TICK_CHUNK_ROWS, level, v->levels);
+}
+
+static inline double tick_level(const TickColumnView *v, uint64_t row, uint32_t level)
+{
+    return ((const double *)v->data)[tick_offset(row, level, v->levels)];
+}
+
+// ---- Queries ----
+
+typedef long long TickV4i __attribute__((vector_size(32)));
+typedef double TickV4d __attribute__((vector_size(32)));
+
+// Row numbers from *cursor on whose time lies in [from_ms, to_ms) go to
+// out, at most max (> 0) of them; *cursor moves past the rows examined,
+// rows when done. Works on the event_ms column of either group.
+TICK_SIMD_CLONES
+size_t tick_select_range(const TickColumnView *time, uint64_t rows, long from_ms, long to_ms, uint64_t *cursor,
+                         uint64_t *out, size_t max)
+{
+    const int64_t *t = tick_i64(time);
+    TickV4i from = {from_ms, from_ms, from_ms, from_ms};
+    TickV4i to = {to_ms, to_ms, to_ms, to_ms};
+    uint64_t i = *cursor;
+    size_t n = 0;
+    for (; i + 4 <= rows && n + 4 <= max; i += 4)
+    {
+        TickV4i v;
+        memcpy(&v, t + i, sizeof(v));
+        TickV4i in = (v >= from) & (v < to);
+        if ((in[0] | in[1] | in[2] | in[3]) == 0)
+        {
+            continue;
+        }
+        // Branchless compaction: every lane is written, only hits advance
+        for (int k = 0; k < 4; k++)
+        {
+            out[n] = i + k;
+            n += in[k] & 1;
+        }
+    }
+    // Tail rows, and rows for the last slots of out once fewer than 4 are
+    // left (all of them when max < 4), so a call with max > 0 always
+    // examines at least one row
+    for (; i < rows && n < max; i++)
+    {
+        if (t[i] >= from_ms && t[i] < to_ms)
+        {
+            out[n++] = i;
+        }
+    }
+    *cursor = i;
+    return n;
+}
+
+typedef struct
+{
+    uint64_t count;
+    double volume;
+    double notional;
+    double buy_volume;
+    double low;
+    double high;
+} TickRangeStats;
+
+// Count, volume, notional, buy volume and price range of the tick rows in
+// [from_ms, to_ms) whose type is in type_mask (TICK_TYPE_BIT, TICK_TRADES).
+// One pass over event_ms, type, price and size with no branch on the data.
+TICK_SIMD_CLONES
+TickRangeStats tick_range_stats(const TickPartition *p, long from_ms, long to_ms, unsigned int type_mask)
+{
+    const int64_t *t = tick_i64(&p->ticks[TICK_EVENT_MS]);
+    const double *price = tick_f64(&p->ticks[TICK_PRICE]);
+    const double *size = tick_f64(&p->ticks[TICK_SIZE]);
+    const int8_t *type = (const int8_t *)p->ticks[TICK_TYPE].data;
+    uint64_t rows = p->rows;
+
+    // msg_type + 3 -> lane mask for the type filter and for buys
+    long long want[8], buy[8];
+    for (int k = 0; k < 8; k++)
+    {
+        want[k] = (type_mask >> k) & 1 ? -1 : 0;
+        buy[k] = k > 3 ? -1 : 0;
+    }
+    TickV4i from = {from_ms, from_ms, from_ms, from_ms};
+    TickV4i to = {to_ms, to_ms, to_ms, to_ms};
+    TickV4i count = {0, 0, 0, 0};
+    TickV4d volume = {0, 0, 0, 0};
+    TickV4d notional = {0, 0, 0, 0};
+    TickV4d buy_volume = {0, 0, 0, 0};
+    TickV4d low = {INFINITY, INFINITY, INFINITY, INFINITY};
+    TickV4d high = {-INFINITY, -INFINITY, -INFINITY, -INFINITY};
+    uint64_t i = 0;
+    for (; i + 4 <= rows; i += 4)
+    {
+        TickV4i v;
+        TickV4d px, sz;
+        memcpy(&v, t + i, sizeof(v));
+        memcpy(&px, price + i, sizeof(px));
+        memcpy(&sz, size + i, sizeof(sz));
+        int k0 = (type[i] + 3) & 7, k1 = (type[i + 1] + 3) & 7, k2 = (type[i + 2] + 3) & 7, k3 = (type[i + 3] + 3) & 7;
+        TickV4i in = (v >= from) & (v < to) & (TickV4i){want[k0], want[k1], want[k2], want[k3]};
+        TickV4i is_buy = (TickV4i){buy[k0], buy[k1], buy[k2], buy[k3]};
+
+        TickV4d sz_in = (TickV4d)((TickV4i)sz & in);
+        count -= in;
+        volume += sz_in;
+        notional += px * sz_in;
+        buy_volume += (TickV4d)((TickV4i)sz_in & is_buy);
+        TickV4i lower = (px < low) & in;
+        TickV4i higher = (px > high) & in;
+        low = (TickV4d)(((TickV4i)px & lower) | ((TickV4i)low & ~lower));
+        high = (TickV4d)(((TickV4i)px & higher) | ((TickV4i)high & ~higher));
+    }
+
+    TickRangeStats s = {0, 0, 0, 0, INFINITY, -INFINITY};
+    for (int k = 0; k < 4; k++)
+    {
+        s.count += count[k];
+        s.volume += volume[k];
+        s.notional += notional[k];
+        s.buy_volume += buy_volume[k];
+        s.low = low[k] < s.low ? low[k] : s.low;
+        s.high = high[k] > s.high ? high[k] : s.high;
+    }
+    for (; i < rows; i++)
+    {
+        if (t[i] >= from_ms && t[i] < to_ms && ((type_mask >> ((type[i] + 3) & 7)) & 1))
+        {
+            s.count++;
+            s.volume += size[i];
+            s.notional += price[i] * size[i];
+            s.buy_volume += type[i] > 0 ? size[i] : 0;
+            s.low = price[i] < s.low ? price[i] : s.low;
+            s.high = price[i] > s.high ? price[i] : s.high;
+        }
+    }
+    return s;
+}
+
+#endif // QTX_TICK_STORE_C
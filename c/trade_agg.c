@@ -0,0 +1,390 @@
+#ifndef QTX_TRADE_AGG_C
+#define QTX_TRADE_AGG_C
+
+#include "sdk.c"
+#include <math.h>
+
+// Incremental statistics over each symbol's trade stream (msg_type 3 buy,
+// -3 sell): time and tick OHLCV bars, and two rolling windows, the last
+// window_ms of trades and the last window_trades trades, each with volume,
+// VWAP and signed volume imbalance. Trades go into a fixed ring per symbol
+// that both windows read from their own head; a trade adds itself to the
+// running sums and evicts what fell out of each window, so an update is
+// O(1) amortised and allocates nothing. Aggregators are created when a
+// symbol's subscription is acknowledged (trade_on_subscribe) and
+// addressed by subscription index, like the latency registry.
+//
+// Time is the trade's event_ms, local_ns when the venue leaves it unset;
+// the time window ends at the latest trade (trade_expire() moves it on
+// without one). Time bars are aligned to multiples of bar_ms and only
+// bars with trades are emitted.
+
+// Trades kept per symbol, a power of two; bounds both windows
+#ifndef TRADE_RING_SIZE
+#define TRADE_RING_SIZE 4096
+#endif
+// Completed bars kept per symbol and kind
+#define TRADE_BAR_HISTORY 64
+
+#define TRADE_BAR_TIME 0
+#define TRADE_BAR_TICK 1
+
+typedef struct
+{
+    long start_ms;
+    long end_ms;
+    double open;
+    double high;
+    double low;
+    double close;
+    double volume;
+    double notional;
+    double buy_volume;
+    unsigned int trades;
+} TradeBar;
+
+typedef struct
+{
+    long ms;
+    double price;
+    double size;
+    int buy;
+} TradeEntry;
+
+// Running sums of the trades between head and the ring's tail
+typedef struct
+{
+    unsigned long head;
+    double volume;
+    double notional;
+    double buy_volume;
+} TradeWindow;
+
+typedef struct TradeAggregator
+{
+    char symbol[MAX_SYMBOL_LEN];
+    TradeEntry ring[TRADE_RING_SIZE];
+    unsigned long tail;
+    TradeWindow by_time;
+    TradeWindow by_count;
+    TradeBar bar[2];
+    TradeBar history[2][TRADE_BAR_HISTORY];
+    unsigned long bars[2];
+    unsigned long trades;
+    // Trades pushed out of the time window early because the ring was full
+    unsigned long overflows;
+    // Next aggregator replaced by a later symbol on the same index
+    struct TradeAggregator *retired;
+} TradeAggregator;
+
+typedef struct
+{
+    IndexTable slots;
+    // Aggregators of reused indexes; the trade handler may still be using
+    // one, so they live until trade_registry_free()
+    TradeAggregator *retired;
+    long window_ms;
+    unsigned int window_trades;
+    long bar_ms;
+    unsigned int bar_trades;
+    // Called with each completed bar, may be NULL
+    void (*on_bar)(const TradeAggregator *agg, int kind, const TradeBar *bar, void *ctx);
+    void *ctx;
+    // Trades of symbols without an aggregator
+    unsigned long untracked;
+} TradeRegistry;
+
+// window_trades must be below TRADE_RING_SIZE; 0 disables a bar kind
+int trade_registry_init(TradeRegistry *r, long window_ms, unsigned int window_trades, long bar_ms,
+                        unsigned int bar_trades)
+{
+    memset(r, 0, sizeof(*r));
+    if (window_trades == 0 || window_trades >= TRADE_RING_SIZE)
+    {
+        fprintf(stderr, "trade window must be 1..%d trades\n", TRADE_RING_SIZE - 1);
+        return -1;
+    }
+    r->window_ms = window_ms;
+    r->window_trades = window_trades;
+    r->bar_ms = bar_ms;
+    r->bar_trades = bar_trades;
+    return 0;
+}
+
+// SubscriptionHook: give sub's index an aggregator for its symbol, so the
+// trade handler never allocates. Register with
+// add_subscription_hook(trade_on_subscribe, r).
+int trade_on_subscribe(Subscription *sub, void *ctx)
+{
+    TradeRegistry *r = ctx;
+    TradeAggregator *old = index_table_get(&r->slots, sub->index);
+    if (old != NULL && strcmp(old->symbol, sub->symbol) == 0)
+    {
+        return 0;
+    }
+    TradeAggregator *agg = calloc(1, sizeof(TradeAggregator));
+    if (agg == NULL)
+    {
+        perror("trade aggregator allocation failed");
+        return -1;
+    }
+    snprintf(agg->symbol, sizeof(agg->symbol), "%s", sub->symbol);
+    if (index_table_set(&r->slots, sub->index, agg) < 0)
+    {
+        free(agg);
+        return -1;
+    }
+    if (old != NULL)
+    {
+        old->retired = r->retired;
+        r->retired = old;
+    }
+    return 0;
+}
+
+void trade_registry_free(TradeRegistry *r)
+{
+    unsigned int i = 0;
+    for (TradeAggregator *agg; (agg = index_table_next(&r->slots, &i)) != NULL; i++)
+    {
+        free(agg);
+    }
+    while (r->retired != NULL)
+    {
+        TradeAggregator *next = r->retired->retired;
+        free(r->retired);
+        r->retired = next;
+    }
+    index_table_free(&r->slots);
+}
+
+static inline TradeAggregator *trade_slot(TradeRegistry *r, const Subscription *sub)
+{
+    return index_table_get(&r->slots, sub->index);
+}
+
+// Aggregator of a subscription index, NULL if it has none
+static inline const TradeAggregator *trade_aggregator(const TradeRegistry *r, unsigned int index)
+{
+    return index_table_get(&r->slots, index);
+}
+
+// ---- Windows ----
+
+static inline void trade_window_add(TradeWindow *w, const TradeEntry *t)
+{
+    w->volume += t->size;
+    w->notional += t->price * t->size;
+    w->buy_volume += t->buy ? t->size : 0;
+}
+
+static inline void trade_window_pop(TradeWindow *w, const TradeEntry *t, unsigned long tail)
+{
+    w->head++;
+    if (w->head == tail)
+    {
+        // Empty: reset instead of letting the subtractions drift
+        w->volume = 0;
+        w->notional = 0;
+        w->buy_volume = 0;
+        return;
+    }
+    w->volume -= t->size;
+    w->notional -= t->price * t->size;
+    w->buy_volume -= t->buy ? t->size : 0;
+}
+
+static inline void trade_evict_time(TradeAggregator *agg, long now_ms, long window_ms)
+{
+    while (agg->by_time.head != agg->tail)
+    {
+        const TradeEntry *t = &agg->ring[agg->by_time.head & (TRADE_RING_SIZE - 1)];
+        if (t->ms > now_ms - window_ms)
+        {
+            break;
+        }
+        trade_window_pop(&agg->by_time, t, agg->tail);
+    }
+}
+
+// Move the time window's end to now_ms without a trade
+void trade_expire(TradeRegistry *r, TradeAggregator *agg, long now_ms)
+{
+    trade_evict_time(agg, now_ms, r->window_ms);
+}
+
+// ---- Bars ----
+
+static inline void trade_bar_start(TradeBar *bar, long ms, const TradeEntry *t)
+{
+    bar->start_ms = ms;
+    bar->end_ms = t->ms;
+    bar->open = t->price;
+    bar->high = t->price;
+    bar->low = t->price;
+    bar->close = t->price;
+    bar->volume = 0;
+    bar->notional = 0;
+    bar->buy_volume = 0;
+    bar->trades = 0;
+}
+
+static inline void trade_bar_add(TradeBar *bar, const TradeEntry *t)
+{
+    bar->end_ms = t->ms > bar->end_ms ? t->ms : bar->end_ms;
+    bar->high = t->price > bar->high ? t->price : bar->high;
+    bar->low = t->price < bar->low ? t->price : bar->low;
+    bar->close = t->price;
+    bar->volume += t->size;
+    bar->notional += t->price * t->size;
+    bar->buy_volume += t->buy ? t->size : 0;
+    bar->trades++;
+}
+
+static void trade_bar_close(TradeRegistry *r, TradeAggregator *agg, int kind)
+{
+    TradeBar *bar = &agg->bar[kind];
+    agg->history[kind][agg->bars[kind] % TRADE_BAR_HISTORY] = *bar;
+    agg->bars[kind]++;
+    if (r->on_bar != NULL)
+    {
+        r->on_bar(agg, kind, bar, r->ctx);
+    }
+    bar->trades = 0;
+}
+
+// ---- Update (dispatching thread) ----
+
+static inline void trade_update(TradeRegistry *r, TradeAggregator *agg, const Msg *msg)
+{
+    TradeEntry *t = &agg->ring[agg->tail & (TRADE_RING_SIZE - 1)];
+    if (agg->tail - agg->by_time.head == TRADE_RING_SIZE)
+    {
+        // The slot about to be reused is still inside the time window
+        trade_window_pop(&agg->by_time, t, agg->tail);
+        agg->overflows++;
+    }
+    t->ms = msg->event_ms > 0 ? msg->event_ms : msg->local_ns / 1000000;
+    t->price = msg->price;
+    t->size = msg->size;
+    t->buy = msg->msg_type > 0;
+    agg->tail++;
+    agg->trades++;
+
+    trade_window_add(&agg->by_time, t);
+    trade_window_add(&agg->by_count, t);
+    if (agg->tail - agg->by_count.head > r->window_trades)
+    {
+        trade_window_pop(&agg->by_count, &agg->ring[agg->by_count.head & (TRADE_RING_SIZE - 1)], agg->tail);
+    }
+    trade_evict_time(agg, t->ms, r->window_ms);
+
+    if (r->bar_ms > 0)
+    {
+        TradeBar *bar = &agg->bar[TRADE_BAR_TIME];
+        long start = t->ms - t->ms % r->bar_ms;
+        // A late trade stays in the open bar
+        if (bar->trades > 0 && start > bar->start_ms)
+        {
+            trade_bar_close(r, agg, TRADE_BAR_TIME);
+        }
+        if (bar->trades == 0)
+        {
+            trade_bar_start(bar, start, t);
+        }
+        trade_bar_add(bar, t);
+    }
+    if (r->bar_trades > 0)
+    {
+        TradeBar *bar = &agg->bar[TRADE_BAR_TICK];
+        if (bar->trades == 0)
+        {
+            trade_bar_start(bar, t->ms, t);
+        }
+        trade_bar_add(bar, t);
+        if (bar->trades == r->bar_trades)
+        {
+            trade_bar_close(r, agg, TRADE_BAR_TICK);
+        }
+    }
+}
+
+// Add one trade message; returns its symbol's aggregator, NULL if untracked
+TradeAggregator *trade_on_trade(TradeRegistry *r, const Subscription *sub, const Msg *msg)
+{
+    if (msg->msg_type != 3 && msg->msg_type != -3)
+    {
+        return NULL;
+    }
+    TradeAggregator *agg = trade_slot(r, sub);
+    if (agg == NULL)
+    {
+        r->untracked++;
+        return NULL;
+    }
+    trade_update(r, agg, msg);
+    return agg;
+}
+
+// StreamHandlers.on_trade with the TradeRegistry as ctx
+void trade_agg_handler(Subscription *sub, const Msg *msg, void *ctx)
+{
+    trade_on_trade((TradeRegistry *)ctx, sub, msg);
+}
+
+// ---- Queries ----
+
+static inline unsigned long trade_window_count(const TradeAggregator *agg, const TradeWindow *w)
+{
+    return agg->tail - w->head;
+}
+
+static inline double trade_window_vwap(const TradeWindow *w)
+{
+    return w->volume > 0 ? w->notional / w->volume : NAN;
+}
+
+// (buy - sell) / (buy + sell) volume, in [-1, 1]; 0 for an empty window
+static inline double trade_window_imbalance(const TradeWindow *w)
+{
+    return w->volume > 0 ? (2 * w->buy_volume - w->volume) / w->volume : 0;
+}
+
+static inline double trade_bar_vwap(const TradeBar *bar)
+{
+    return bar->volume > 0 ? bar->notional / bar->volume : NAN;
+}
+
+// ago-th most recent completed bar of a kind (0 the latest), NULL if none
+static inline const TradeBar *trade_last_bar(const TradeAggregator *agg, int kind, unsigned long ago)
+{
+    if (ago >= agg->bars[kind] || ago >= TRADE_BAR_HISTORY)
+    {
+        return NULL;
+    }
+    return &agg->history[kind][(agg->bars[kind] - 1 - ago) % TRADE_BAR_HISTORY];
+}
+
+void print_trade_stats(const TradeRegistry *r)
+{
+    printf("=== Trade Aggregation ===\n");
+    unsigned int i = 0;
+    for (const TradeAggregator *agg; (agg = index_table_next(&r->slots, &i)) != NULL; i++)
+    {
+        printf("%s: trades %lu, time bars %lu, tick bars %lu, window overflows %lu\n", agg->symbol, agg->trades,
+               agg->bars[TRADE_BAR_TIME], agg->bars[TRADE_BAR_TICK], agg->overflows);
+        printf("  last %ld ms: %lu trades, volume %.8g, vwap %.8g, imbalance %+.3f\n", r->window_ms,
+               trade_window_count(agg, &agg->by_time), agg->by_time.volume, trade_window_vwap(&agg->by_time),
+               trade_window_imbalance(&agg->by_time));
+        printf("  last %lu trades: volume %.8g, vwap %.8g, imbalance %+.3f\n",
+               trade_window_count(agg, &agg->by_count), agg->by_count.volume, trade_window_vwap(&agg->by_count),
+               trade_window_imbalance(&agg->by_count));
+    }
+    if (r->untracked > 0)
+    {
+        printf("untracked trades: %lu\n", r->untracked);
+    }
+    printf("=========================\n");
+}
+
+#endif // QTX_TRADE_AGG_C